@@ -0,0 +1,1447 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <sys/stat.h>
+#include "file.h"
+#include "page.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "btree.h"
+#include "checksum.h"
+#include "heapfile.h"
+#include "log.h"
+#include "pax_page.h"
+#include "parallel_filescan.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/end_of_file_exception.h"
+#include "exceptions/index_scan_completed_exception.h"
+
+// Micro benchmarks for the storage layer.  Run as
+//   ./badgerdb_bench <benchmark> [size]
+// with no arguments to list the available benchmarks.
+
+using namespace badgerdb;
+
+// -----------------------------------------------------------------------------
+// Globals
+// -----------------------------------------------------------------------------
+const std::string benchFileName = "bench.db";
+
+typedef std::chrono::steady_clock Clock;
+
+// -----------------------------------------------------------------------------
+// Helpers
+// -----------------------------------------------------------------------------
+
+double elapsedSeconds(const Clock::time_point& start)
+{
+	return std::chrono::duration<double>(Clock::now() - start).count();
+}
+
+void removeBenchFile()
+{
+	try
+	{
+		File::remove(benchFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	if (File::exists(ZoneMap::nameFor(benchFileName)))
+	{
+		File::remove(ZoneMap::nameFor(benchFileName));
+	}
+	if (File::exists(BloomFilterFile::nameFor(benchFileName)))
+	{
+		File::remove(BloomFilterFile::nameFor(benchFileName));
+	}
+}
+
+// -----------------------------------------------------------------------------
+// loadBenchmark
+// -----------------------------------------------------------------------------
+
+void loadBenchmark(int numPages)
+{
+	// Loads a relation one page at a time the way createRelationForward does,
+	// reporting the allocation rate per window.  The rate should stay flat as
+	// the file grows.
+	std::cout << "load benchmark: " << numPages << " pages" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		const int window = numPages >= 10 ? numPages / 10 : 1;
+		const std::string record(80, 'r');
+
+		Clock::time_point start = Clock::now();
+		Clock::time_point windowStart = start;
+		for (int i = 1; i <= numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord(record);
+			file.writePage(pageNo, page);
+
+			if (i % window == 0)
+			{
+				std::cout << "  pages " << i - window + 1 << "-" << i << ": "
+				          << window / elapsedSeconds(windowStart) << " pages/s" << std::endl;
+				windowStart = Clock::now();
+			}
+		}
+		std::cout << "  total: " << elapsedSeconds(start) << " s" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// churnBenchmark
+// -----------------------------------------------------------------------------
+
+void churnBenchmark(int numPages)
+{
+	// Fills a file, then deletes and reallocates pages at random positions.
+	// Each delete and reuse should cost a constant number of page I/Os no
+	// matter how large the file is.
+	std::cout << "churn benchmark: " << numPages << " pages" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+
+		const int numOps = numPages / 2;
+		std::srand(1);
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numOps; i++)
+		{
+			file.deletePage(1 + std::rand() % numPages);
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+		std::cout << "  " << numOps / elapsedSeconds(start) << " delete+reuse pairs/s" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// ioBenchmark
+// -----------------------------------------------------------------------------
+
+void printIOStats(const std::string& phase, const FileIOStats& stats, int numOps)
+{
+	std::cout << "  " << phase << ": "
+	          << static_cast<double>(stats.reads) / numOps << " reads/op, "
+	          << static_cast<double>(stats.writes) / numOps << " writes/op, "
+	          << static_cast<double>(stats.bytesread + stats.byteswritten) / numOps
+	          << " bytes/op, "
+	          << static_cast<double>(stats.mappedreads) / numOps << " mapped reads/op"
+	          << std::endl;
+}
+
+void ioBenchmark(int numPages)
+{
+	// Counts the physical reads and writes behind each logical page operation.
+	// Reading or writing a page should cost exactly one I/O.
+	std::cout << "io benchmark: " << numPages << " pages" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		const std::string record(80, 'r');
+
+		File::clearIOStats();
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			file.allocatePage(pageNo);
+		}
+		printIOStats("allocatePage", File::getIOStats(), numPages);
+
+		File::clearIOStats();
+		for (PageId pageNo = 1; pageNo <= static_cast<PageId>(numPages); pageNo++)
+		{
+			file.readPage(pageNo);
+		}
+		printIOStats("readPage", File::getIOStats(), numPages);
+
+		// Only count the writes, not the reads that fetch each page first.
+		FileIOStats writeStats;
+		for (PageId pageNo = 1; pageNo <= static_cast<PageId>(numPages); pageNo++)
+		{
+			Page page = file.readPage(pageNo);
+			page.insertRecord(record);
+			File::clearIOStats();
+			file.writePage(pageNo, page);
+			writeStats.reads += File::getIOStats().reads;
+			writeStats.writes += File::getIOStats().writes;
+			writeStats.bytesread += File::getIOStats().bytesread;
+			writeStats.byteswritten += File::getIOStats().byteswritten;
+		}
+		printIOStats("writePage", writeStats, numPages);
+
+		File::clearIOStats();
+		for (PageId pageNo = 1; pageNo <= static_cast<PageId>(numPages); pageNo += 2)
+		{
+			file.deletePage(pageNo);
+		}
+		printIOStats("deletePage", File::getIOStats(), (numPages + 1) / 2);
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// scanBenchmark
+// -----------------------------------------------------------------------------
+
+void scanBenchmark(int numPages)
+{
+	// Scans a relation through the buffer pool.  Moving between pages only
+	// needs the allocation bitmap, so every page is read from disk once.
+	std::cout << "scan benchmark: " << numPages << " pages" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		const std::string record(80, 'r');
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord(record);
+			file.writePage(pageNo, page);
+		}
+		// Leave holes so the scan has to skip free pages.
+		for (PageId pageNo = 3; pageNo <= static_cast<PageId>(numPages); pageNo += 3)
+		{
+			file.deletePage(pageNo);
+		}
+	}
+	{
+		BufMgr bufMgr(100);
+		FileScan scan(benchFileName, &bufMgr);
+		File::clearIOStats();
+		Clock::time_point start = Clock::now();
+		int numRecords = 0;
+		try
+		{
+			RecordId rid;
+			while (true)
+			{
+				scan.scanNext(rid);
+				numRecords++;
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+		const double seconds = elapsedSeconds(start);
+		std::cout << "  " << numRecords << " records in " << seconds << " s" << std::endl;
+		printIOStats("scan", File::getIOStats(), numRecords);
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// lookupBenchmark
+// -----------------------------------------------------------------------------
+
+void lookupBenchmark(int numPages)
+{
+	// Probes random pages of a file much larger than the buffer pool, first
+	// through frames and then through a read-only mapping.  Once the OS has
+	// the file cached the mapped lookups make no system calls.
+	std::cout << "lookup benchmark: " << numPages << " pages" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		const std::string record(80, 'r');
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord(record);
+			file.writePage(pageNo, page);
+		}
+	}
+
+	const int numLookups = 10 * numPages;
+	{
+		BufMgr bufMgr(100);
+		PageFile file = PageFile::open(benchFileName);
+		std::srand(1);
+		File::clearIOStats();
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numLookups; i++)
+		{
+			const PageId pageNo = 1 + std::rand() % numPages;
+			Page* page;
+			bufMgr.readPage(&file, pageNo, page);
+			bufMgr.unPinPage(&file, pageNo, false);
+		}
+		std::cout << "  buffered: " << numLookups / elapsedSeconds(start) << " lookups/s" << std::endl;
+		printIOStats("buffered", File::getIOStats(), numLookups);
+	}
+	{
+		BufMgr bufMgr(100);
+		PageFile file = PageFile::openReadOnly(benchFileName);
+		std::srand(1);
+		File::clearIOStats();
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numLookups; i++)
+		{
+			const Page* page;
+			bufMgr.readMappedPage(&file, 1 + std::rand() % numPages, page);
+		}
+		std::cout << "  mapped: " << numLookups / elapsedSeconds(start) << " lookups/s" << std::endl;
+		printIOStats("mapped", File::getIOStats(), numLookups);
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// btreeBenchmark
+// -----------------------------------------------------------------------------
+
+void createKeyRelation(int numRecords, bool randomOrder)
+{
+	// Writes a relation of 80 byte records whose first 4 bytes are the keys
+	// 0 to numRecords - 1, in ascending or random order.
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		std::vector<int> keys(numRecords);
+		for (int i = 0; i < numRecords; i++)
+		{
+			keys[i] = i;
+		}
+		std::srand(1);
+		for (int i = numRecords - 1; randomOrder && i > 0; i--)
+		{
+			std::swap(keys[i], keys[std::rand() % (i + 1)]);
+		}
+
+		char record[80];
+		memset(record, ' ', sizeof(record));
+		PageId pageNo;
+		Page page = file.allocatePage(pageNo);
+		for (int i = 0; i < numRecords; i++)
+		{
+			memcpy(record, &keys[i], sizeof(int));
+			const std::string data(record, sizeof(record));
+			if (page.getFreeSpace() < data.size() + 8)
+			{
+				file.writePage(pageNo, page);
+				page = file.allocatePage(pageNo);
+			}
+			page.insertRecord(data);
+		}
+		file.writePage(pageNo, page);
+	}
+}
+
+int fullIndexScan(BTreeIndex& index, int numRecords)
+{
+	const int low = 0;
+	const int high = numRecords;
+	int numFound = 0;
+	index.startScan(&low, GTE, &high, LT);
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			index.scanNext(rid);
+			numFound++;
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index.endScan();
+	return numFound;
+}
+
+void btreeBenchmark(int numRecords, bool randomOrder)
+{
+	// Builds an integer index from records in ascending or random key order,
+	// then reports how much of the leaf chain is physically sequential and how
+	// long a full index scan takes.  In random order leaves split all over the
+	// key space.
+	std::cout << "btree benchmark: " << numRecords << " records in "
+	          << (randomOrder ? "random" : "ascending") << " order" << std::endl;
+	createKeyRelation(numRecords, randomOrder);
+
+	std::string indexName;
+	{
+		BufMgr bufMgr(100);
+		Clock::time_point start = Clock::now();
+		BTreeIndex index(benchFileName, indexName, &bufMgr, 0, INTEGER);
+		std::cout << "  build: " << elapsedSeconds(start) << " s" << std::endl;
+		std::cout << "  leaf chain contiguity: " << index.leafContiguity() << std::endl;
+		std::ifstream indexFile(indexName.c_str(), std::ios::binary | std::ios::ate);
+		std::cout << "  index size: " << indexFile.tellg() / Page::SIZE << " pages" << std::endl;
+
+		File::clearIOStats();
+		start = Clock::now();
+		const int numFound = fullIndexScan(index, numRecords);
+		std::cout << "  full scan: " << numFound << " entries in "
+		          << elapsedSeconds(start) << " s" << std::endl;
+	}
+	File::remove(indexName);
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// compressBenchmark
+// -----------------------------------------------------------------------------
+
+void compressBenchmark(int numRecords, bool randomOrder)
+{
+	// Builds the same index as a plain and as a compressed file and compares
+	// the disk space they take and the bytes read per page by a full scan
+	// with a cold buffer pool.
+	std::cout << "compress benchmark: " << numRecords << " records in "
+	          << (randomOrder ? "random" : "ascending") << " order" << std::endl;
+	createKeyRelation(numRecords, randomOrder);
+
+	long diskBytes[2];
+	for (int compressed = 0; compressed <= 1; compressed++)
+	{
+		std::string indexName;
+		{
+			BufMgr bufMgr(100);
+			Clock::time_point start = Clock::now();
+			BTreeIndex index(benchFileName, indexName, &bufMgr, 0, INTEGER, compressed);
+			std::cout << "  " << (compressed ? "compressed" : "plain")
+			          << " build: " << elapsedSeconds(start) << " s" << std::endl;
+		}
+
+		struct stat indexStat;
+		stat(indexName.c_str(), &indexStat);
+		diskBytes[compressed] = static_cast<long>(indexStat.st_blocks) * 512;
+		std::cout << "    file size " << indexStat.st_size / 1024 << " KB, "
+		          << diskBytes[compressed] / 1024 << " KB on disk" << std::endl;
+
+		{
+			BufMgr bufMgr(100);
+			BTreeIndex index(benchFileName, indexName, &bufMgr, 0, INTEGER);
+			File::clearIOStats();
+			Clock::time_point start = Clock::now();
+			const int numFound = fullIndexScan(index, numRecords);
+			const FileIOStats stats = File::getIOStats();
+			std::cout << "    full scan: " << numFound << " entries in "
+			          << elapsedSeconds(start) << " s, "
+			          << static_cast<double>(stats.bytesread) / stats.reads
+			          << " bytes read per page read" << std::endl;
+		}
+		File::remove(indexName);
+	}
+	std::cout << "  compression ratio: "
+	          << static_cast<double>(diskBytes[0]) / diskBytes[1] << std::endl;
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// checksumBenchmark
+// -----------------------------------------------------------------------------
+
+void checksumBenchmark(int numPages)
+{
+	// Compares the time to read a page with checksums off and on, through the
+	// stream and through a read-only mapping, which verifies each page once.
+	std::cout << "checksum benchmark: " << numPages << " pages, "
+	          << (Checksum::isHardwareAccelerated() ? "hardware" : "table")
+	          << " CRC32C" << std::endl;
+	removeBenchFile();
+	{
+		PageFile file = PageFile::create(benchFileName);
+		const std::string record(80, 'r');
+		for (int i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			while (page.hasSpaceForRecord(record))
+			{
+				page.insertRecord(record);
+			}
+			file.writePage(pageNo, page);
+		}
+	}
+
+	const int numRounds = 10;
+	double readSeconds[2];
+	for (int checksums = 0; checksums <= 1; checksums++)
+	{
+		{
+			PageFile file = PageFile::open(benchFileName);
+			file.setChecksums(checksums);
+			File::clearIOStats();
+			Clock::time_point start = Clock::now();
+			for (int round = 0; round < numRounds; round++)
+			{
+				for (PageId pageNo = 1; pageNo <= static_cast<PageId>(numPages); pageNo++)
+				{
+					file.readPage(pageNo);
+				}
+			}
+			readSeconds[checksums] = elapsedSeconds(start);
+			std::cout << "  " << (checksums ? "checksums on" : "checksums off")
+			          << ": readPage " << 1e6 * readSeconds[checksums] / (numRounds * numPages)
+			          << " us/page, " << File::getIOStats().checksumsverified
+			          << " verified, " << File::getIOStats().checksumsfailed << " failed" << std::endl;
+		}
+		{
+			// Only the first round verifies the pages, and touching them also
+			// faults them into the mapping.
+			PageFile file = PageFile::openReadOnly(benchFileName);
+			File::clearIOStats();
+			for (int round = 0; round < numRounds; round++)
+			{
+				Clock::time_point start = Clock::now();
+				for (PageId pageNo = 1; pageNo <= static_cast<PageId>(numPages); pageNo++)
+				{
+					file.mappedPage(pageNo);
+				}
+				if (round == 0 || round == numRounds - 1)
+				{
+					std::cout << "    mappedPage " << (round == 0 ? "first" : "last")
+					          << " round " << 1e6 * elapsedSeconds(start) / numPages
+					          << " us/page" << std::endl;
+				}
+			}
+			std::cout << "    " << File::getIOStats().checksumsverified
+			          << " mapped pages verified" << std::endl;
+		}
+	}
+	std::cout << "  readPage overhead: "
+	          << 100 * (readSeconds[1] - readSeconds[0]) / readSeconds[0] << "%" << std::endl;
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// walBenchmark
+// -----------------------------------------------------------------------------
+
+void walBenchmark(int numRecords)
+{
+	// Inserts small records through HeapFile, committing every few inserts,
+	// once with DURABILITY_COMMIT and once with a write-ahead log.  The log
+	// replaces a data page write and sync per commit by a small sequential
+	// append.
+	const int commitEvery = 10;
+	const std::string logFileName = "bench.log";
+	const std::string record(60, 'w');
+	std::cout << "wal benchmark: " << numRecords << " records, commit every "
+	          << commitEvery << std::endl;
+	for (int logged = 0; logged <= 1; logged++)
+	{
+		removeBenchFile();
+		std::remove(logFileName.c_str());
+		File::clearIOStats();
+		double seconds;
+		int syncs;
+		long logBytes = 0;
+		{
+			BufMgr bufMgr(100);
+			LogMgr* log = NULL;
+			if (logged)
+			{
+				log = new LogMgr(logFileName);
+				bufMgr.setLog(log);
+			}
+			else
+			{
+				bufMgr.setDurability(DURABILITY_COMMIT);
+			}
+			{
+				HeapFile heapFile(benchFileName, &bufMgr, true);
+				Clock::time_point start = Clock::now();
+				for (int i = 1; i <= numRecords; i++)
+				{
+					heapFile.insertRecord(record);
+					if (i % commitEvery == 0)
+					{
+						bufMgr.commit();
+					}
+				}
+				bufMgr.commit();
+				seconds = elapsedSeconds(start);
+			}
+			syncs = bufMgr.getBufStats().syncs;
+			if (log != NULL)
+			{
+				syncs += log->getLogStats().syncs;
+				logBytes = log->getLogStats().bytes;
+			}
+			bufMgr.close();
+			bufMgr.setLog(NULL);
+			delete log;
+		}
+		std::cout << "  " << (logged ? "write-ahead log" : "DURABILITY_COMMIT") << ": "
+		          << 1e6 * seconds / numRecords << " us/record, " << syncs << " syncs, "
+		          << File::getIOStats().byteswritten << " data bytes written, "
+		          << logBytes << " log bytes" << std::endl;
+	}
+	removeBenchFile();
+	std::remove(logFileName.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// tablespaceBenchmark
+// -----------------------------------------------------------------------------
+
+void tablespaceBenchmark(int numFiles)
+{
+	// Creates many one-page relations, then opens each again and reads its
+	// page, once as files of their own and once as segments of a tablespace.
+	const std::string tablespaceName = "bench.ts";
+	const std::string record(80, 't');
+	std::cout << "tablespace benchmark: " << numFiles << " relations" << std::endl;
+	for (int inTablespace = 0; inTablespace <= 1; inTablespace++)
+	{
+		std::remove(tablespaceName.c_str());
+		std::vector<std::string> names;
+		for (int i = 0; i < numFiles; i++)
+		{
+			names.push_back((inTablespace ? tablespaceName + ":" : std::string("bench.rel.")) +
+			                std::to_string(i));
+		}
+
+		Clock::time_point start = Clock::now();
+		for (int i = 0; i < numFiles; i++)
+		{
+			PageFile file = PageFile::create(names[i]);
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord(record);
+			file.writePage(pageNo, page);
+		}
+		const double createSeconds = elapsedSeconds(start);
+
+		start = Clock::now();
+		for (int i = 0; i < numFiles; i++)
+		{
+			PageFile file = PageFile::open(names[i]);
+			file.readPage(file.getFirstPageNo());
+		}
+		const double openSeconds = elapsedSeconds(start);
+
+		std::cout << "  " << (inTablespace ? "tablespace" : "one file each") << ": create "
+		          << 1e6 * createSeconds / numFiles << " us/relation, open and read "
+		          << 1e6 * openSeconds / numFiles << " us/relation, "
+		          << (inTablespace ? 1 : numFiles) << " files" << std::endl;
+
+		if (!inTablespace)
+		{
+			for (int i = 0; i < numFiles; i++)
+			{
+				File::remove(names[i]);
+			}
+		}
+	}
+	std::remove(tablespaceName.c_str());
+}
+
+// -----------------------------------------------------------------------------
+// heapLoadBenchmark
+// -----------------------------------------------------------------------------
+
+void heapLoadBenchmark(int numRecords)
+{
+	// Loads a relation from structs through HeapFile, first building a
+	// std::string per record, then inserting straight from the struct, then
+	// inserting batches of records that fill a page in one pass.
+	struct BenchRecord
+	{
+		int i;
+		double d;
+		char s[64];
+	};
+	const int batchSize = 64;
+	std::cout << "heapload benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes" << std::endl;
+	std::vector<BenchRecord> records(numRecords);
+	for (int i = 0; i < numRecords; i++)
+	{
+		records[i].i = i;
+		records[i].d = i;
+		std::snprintf(records[i].s, sizeof(records[i].s), "%05d string record", i);
+	}
+	const char* methods[] = {"std::string", "pointer", "batch"};
+	for (int method = 0; method < 3; method++)
+	{
+		removeBenchFile();
+		BufMgr bufMgr(100);
+		{
+			HeapFile heapFile(benchFileName, &bufMgr, true);
+			Clock::time_point start = Clock::now();
+			if (method == 0)
+			{
+				for (int i = 0; i < numRecords; i++)
+				{
+					std::string data(reinterpret_cast<const char*>(&records[i]), sizeof(BenchRecord));
+					heapFile.insertRecord(data);
+				}
+			}
+			else if (method == 1)
+			{
+				for (int i = 0; i < numRecords; i++)
+				{
+					heapFile.insertRecord(reinterpret_cast<const char*>(&records[i]), sizeof(BenchRecord));
+				}
+			}
+			else
+			{
+				RecordView batch[batchSize];
+				for (int i = 0; i < numRecords; i += batchSize)
+				{
+					const int count = std::min(batchSize, numRecords - i);
+					for (int j = 0; j < count; j++)
+					{
+						batch[j].data = reinterpret_cast<const char*>(&records[i + j]);
+						batch[j].length = sizeof(BenchRecord);
+					}
+					heapFile.insertRecords(batch, count);
+				}
+			}
+			const double seconds = elapsedSeconds(start);
+			std::cout << "  " << methods[method] << ": " << 1e9 * seconds / numRecords
+			          << " ns/record" << std::endl;
+			heapFile.close();
+		}
+		bufMgr.close();
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// paxBenchmark
+// -----------------------------------------------------------------------------
+
+void paxBenchmark(int numRecords)
+{
+	// Counts the records whose int attribute passes a filter, in a relation
+	// of slotted pages and in one of PAX pages.  The PAX scans read only the
+	// int column, first a record at a time through FileScan and then a
+	// minipage at a time.
+	struct BenchRecord
+	{
+		int i;
+		double d;
+		char s[64];
+	};
+	std::vector<PaxColumn> columns;
+	const PaxColumn iColumn = {0, sizeof(int)};
+	const PaxColumn dColumn = {offsetof(BenchRecord, d), sizeof(double)};
+	const PaxColumn sColumn = {offsetof(BenchRecord, s), 64};
+	columns.push_back(iColumn);
+	columns.push_back(dColumn);
+	columns.push_back(sColumn);
+	const int limit = numRecords / 10;
+	std::cout << "pax benchmark: " << numRecords << " records, filter i < " << limit << std::endl;
+
+	for (int pax = 0; pax <= 1; pax++)
+	{
+		removeBenchFile();
+		int numPages = 0;
+		{
+			BufMgr bufMgr(100);
+			PageFile file = PageFile::create(benchFileName);
+			HeapFile* heapFile = pax ? NULL : new HeapFile(benchFileName, &bufMgr);
+			Page* page = NULL;
+			PageId pageNo = Page::INVALID_NUMBER;
+			PaxPage paxPage;
+			BenchRecord record;
+			memset(&record, 0, sizeof(record));
+			for (int i = 0; i < numRecords; i++)
+			{
+				record.i = static_cast<int>(i * 7919LL % numRecords);
+				record.d = i;
+				std::snprintf(record.s, sizeof(record.s), "%05d string record", i);
+				if (!pax)
+				{
+					heapFile->insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+					continue;
+				}
+				if (page == NULL || !paxPage.hasSpaceForRecord())
+				{
+					if (page != NULL)
+					{
+						bufMgr.unPinPage(&file, pageNo, true);
+					}
+					bufMgr.allocPage(&file, pageNo, page);
+					PaxPage::format(*page, columns, sizeof(record));
+					paxPage = PaxPage(page);
+					numPages++;
+				}
+				paxPage.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+			}
+			if (page != NULL)
+			{
+				bufMgr.unPinPage(&file, pageNo, true);
+			}
+			if (heapFile != NULL)
+			{
+				heapFile->close();
+				delete heapFile;
+			}
+			bufMgr.flushFile(&file);
+			if (!pax)
+			{
+				for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+				{
+					numPages++;
+				}
+			}
+		}
+
+		BufMgr bufMgr(100);
+		for (int minipages = 0; minipages <= pax; minipages++)
+		{
+			Clock::time_point start = Clock::now();
+			int matches = 0;
+			if (!minipages)
+			{
+				FileScan scan(benchFileName, &bufMgr);
+				try
+				{
+					RecordId rid;
+					while (true)
+					{
+						scan.scanNext(rid);
+						int i;
+						if (pax)
+						{
+							i = scan.getColumnValue<int>(0);
+						}
+						else
+						{
+							memcpy(&i, scan.getRecordView().data, sizeof(i));
+						}
+						matches += i < limit;
+					}
+				}
+				catch(const EndOfFileException &e)
+				{
+				}
+			}
+			else
+			{
+				PageFile file(benchFileName, false);
+				for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+				{
+					Page* page;
+					bufMgr.readPage(&file, iter.page_number(), page);
+					const PaxPage paxPage(page);
+					const int* values = paxPage.columnArray<int>(0);
+					const std::uint8_t* used = paxPage.usedBitmap();
+					for (std::uint16_t row = 0; row < paxPage.numRows(); row++)
+					{
+						matches += (values[row] < limit) & (used[row / 8] >> (row % 8)) & 1;
+					}
+					bufMgr.unPinPage(&file, iter.page_number(), false);
+				}
+				bufMgr.flushFile(&file);
+			}
+			const double seconds = elapsedSeconds(start);
+			std::cout << "  " << (!pax ? "slotted, FileScan" : minipages ? "PAX, minipages" : "PAX, FileScan")
+			          << ": " << matches << " matches on " << numPages << " pages, "
+			          << 1e9 * seconds / numRecords << " ns/record" << std::endl;
+		}
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// slotsBenchmark
+// -----------------------------------------------------------------------------
+
+void slotsBenchmark(int numOps)
+{
+	// Churns small records on a single page holding hundreds of them: deletes
+	// a batch of random records and inserts as many new ones, then deletes
+	// every record and refills the page.
+	const std::string record(16, 's');
+	const int batchSize = 16;
+	std::cout << "slots benchmark: " << numOps << " operations on one page of "
+	          << record.size() << "-byte records" << std::endl;
+	std::srand(1);
+	Page page;
+	std::vector<RecordId> rids;
+	while (page.hasSpaceForRecord(record))
+	{
+		rids.push_back(page.insertRecord(record));
+	}
+	std::cout << "  " << rids.size() << " records per page" << std::endl;
+
+	Clock::time_point start = Clock::now();
+	int ops = 0;
+	while (ops < numOps)
+	{
+		for (int i = 0; i < batchSize; i++)
+		{
+			const std::size_t index = std::rand() % rids.size();
+			page.deleteRecord(rids[index]);
+			rids[index] = rids.back();
+			rids.pop_back();
+		}
+		for (int i = 0; i < batchSize; i++)
+		{
+			rids.push_back(page.insertRecord(record));
+		}
+		ops += 2 * batchSize;
+	}
+	std::cout << "  delete " << batchSize << ", insert " << batchSize << ": "
+	          << 1e9 * elapsedSeconds(start) / ops << " ns/operation" << std::endl;
+
+	start = Clock::now();
+	ops = 0;
+	while (ops < numOps)
+	{
+		std::random_shuffle(rids.begin(), rids.end());
+		const std::size_t numRecords = rids.size();
+		for (std::size_t i = 0; i < numRecords; i++)
+		{
+			page.deleteRecord(rids[i]);
+		}
+		rids.clear();
+		while (page.hasSpaceForRecord(record))
+		{
+			rids.push_back(page.insertRecord(record));
+		}
+		ops += numRecords + rids.size();
+	}
+	std::cout << "  delete all, refill: " << 1e9 * elapsedSeconds(start) / ops
+	          << " ns/operation" << std::endl;
+}
+
+// -----------------------------------------------------------------------------
+// filterBenchmark
+// -----------------------------------------------------------------------------
+
+void filterBenchmark(int numRecords)
+{
+	// Runs location = "New York" AND rating > 1000 over a relation, first
+	// copying every record out of the scan and testing the copy, then pushing
+	// the predicate down into FileScan.
+	struct BenchRecord
+	{
+		int rating;
+		char location[32];
+		char comment[60];
+	};
+	const char* locations[] = {"New York", "Madison", "Chicago", "Seattle"};
+	std::cout << "filter benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes" << std::endl;
+	removeBenchFile();
+	{
+		BufMgr bufMgr(100);
+		HeapFile heapFile(benchFileName, &bufMgr, true);
+		BenchRecord record;
+		memset(&record, 0, sizeof(record));
+		for (int i = 0; i < numRecords; i++)
+		{
+			record.rating = static_cast<int>(i * 7919LL % 2000);
+			std::strncpy(record.location, locations[i % 4], sizeof(record.location));
+			std::snprintf(record.comment, sizeof(record.comment), "%07d comment", i);
+			heapFile.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		heapFile.close();
+		bufMgr.close();
+	}
+	const Predicate predicate = Predicate::allOf(
+		Predicate::stringAt(offsetof(BenchRecord, location), sizeof(BenchRecord::location), EQUAL, "New York"),
+		Predicate::intAt(offsetof(BenchRecord, rating), GREATER, 1000));
+
+	BufMgr bufMgr(100);
+	for (int pushdown = 0; pushdown <= 1; pushdown++)
+	{
+		Clock::time_point start = Clock::now();
+		int matches = 0;
+		{
+			FileScan scan(benchFileName, &bufMgr, pushdown ? predicate : Predicate());
+			try
+			{
+				RecordId rid;
+				while (true)
+				{
+					scan.scanNext(rid);
+					if (pushdown)
+					{
+						matches++;
+						continue;
+					}
+					const std::string data = scan.getRecord();
+					const BenchRecord* copy = reinterpret_cast<const BenchRecord*>(data.data());
+					matches += std::strncmp(copy->location, "New York", sizeof(copy->location)) == 0 &&
+					           copy->rating > 1000;
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+		}
+		const double seconds = elapsedSeconds(start);
+		std::cout << "  " << (pushdown ? "predicate in FileScan" : "getRecord and test")
+		          << ": " << matches << " matches, "
+		          << 1e9 * seconds / numRecords << " ns/record" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// parallelBenchmark
+// -----------------------------------------------------------------------------
+
+void parallelBenchmark(int numRecords)
+{
+	// Counts the records matching a predicate with a ParallelFileScan on 1, 2,
+	// 4 and 8 threads.
+	struct BenchRecord
+	{
+		int rating;
+		char location[32];
+		char comment[60];
+	};
+	std::cout << "parallel benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes" << std::endl;
+	removeBenchFile();
+	{
+		BufMgr bufMgr(100);
+		HeapFile heapFile(benchFileName, &bufMgr, true);
+		BenchRecord record;
+		memset(&record, 0, sizeof(record));
+		for (int i = 0; i < numRecords; i++)
+		{
+			record.rating = static_cast<int>(i * 7919LL % 2000);
+			std::snprintf(record.location, sizeof(record.location), "%s", i % 4 ? "Madison" : "New York");
+			std::snprintf(record.comment, sizeof(record.comment), "%07d comment", i);
+			heapFile.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		heapFile.close();
+		bufMgr.close();
+	}
+	const Predicate predicate = Predicate::allOf(
+		Predicate::stringAt(offsetof(BenchRecord, location), sizeof(BenchRecord::location), EQUAL, "New York"),
+		Predicate::intAt(offsetof(BenchRecord, rating), GREATER, 1000));
+
+	BufMgr bufMgr(100);
+	for (std::size_t numThreads = 1; numThreads <= 8; numThreads *= 2)
+	{
+		Clock::time_point start = Clock::now();
+		std::vector<int> matches(numThreads, 0);
+		std::size_t numMorsels;
+		{
+			ParallelFileScan scan(benchFileName, &bufMgr, numThreads, predicate);
+			numMorsels = scan.morsels().numMorsels();
+			scan.run([&matches](FileScan& stream, std::size_t thread)
+			{
+				try
+				{
+					RecordId rid;
+					while (true)
+					{
+						stream.scanNext(rid);
+						matches[thread]++;
+					}
+				}
+				catch(const EndOfFileException &e)
+				{
+				}
+			});
+		}
+		const double seconds = elapsedSeconds(start);
+		int total = 0;
+		for (std::size_t i = 0; i < numThreads; i++)
+		{
+			total += matches[i];
+		}
+		std::cout << "  " << numThreads << " threads: " << total << " matches in "
+		          << numMorsels << " morsels, " << seconds << " s, "
+		          << numRecords / seconds / 1e6 << " M records/s" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// batchBenchmark
+// -----------------------------------------------------------------------------
+
+void batchBenchmark(int numRecords)
+{
+	// Sums an int attribute over a relation, first a record at a time with
+	// scanNext, then a batch at a time reading the record views, then a batch
+	// at a time reading the attribute projected into an array.
+	struct BenchRecord
+	{
+		int rating;
+		char location[32];
+		char comment[60];
+	};
+	std::cout << "batch benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes, batches of "
+	          << RecordBatch::DEFAULT_CAPACITY << std::endl;
+	removeBenchFile();
+	{
+		BufMgr bufMgr(100);
+		HeapFile heapFile(benchFileName, &bufMgr, true);
+		BenchRecord record;
+		memset(&record, 0, sizeof(record));
+		for (int i = 0; i < numRecords; i++)
+		{
+			record.rating = i % 2000;
+			std::snprintf(record.comment, sizeof(record.comment), "%07d comment", i);
+			heapFile.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		heapFile.close();
+		bufMgr.close();
+	}
+
+	BufMgr bufMgr(100);
+	const char* methods[] = {"scanNext", "batch, record views", "batch, projected column"};
+	for (int method = 0; method < 3; method++)
+	{
+		Clock::time_point start = Clock::now();
+		long long sum = 0;
+		{
+			FileScan scan(benchFileName, &bufMgr);
+			if (method == 0)
+			{
+				try
+				{
+					RecordId rid;
+					while (true)
+					{
+						scan.scanNext(rid);
+						int rating;
+						memcpy(&rating, scan.getRecordView().data, sizeof(rating));
+						sum += rating;
+					}
+				}
+				catch(const EndOfFileException &e)
+				{
+				}
+			}
+			else
+			{
+				RecordBatch batch(RecordBatch::DEFAULT_CAPACITY, method == 1);
+				const std::size_t column = batch.addColumn(offsetof(BenchRecord, rating), sizeof(int));
+				while (scan.scanNextBatch(batch))
+				{
+					if (method == 1)
+					{
+						const RecordView* records = batch.records();
+						for (std::size_t i = 0; i < batch.size(); i++)
+						{
+							int rating;
+							memcpy(&rating, records[i].data, sizeof(rating));
+							sum += rating;
+						}
+					}
+					else
+					{
+						const int* ratings = batch.column<int>(column);
+						for (std::size_t i = 0; i < batch.size(); i++)
+						{
+							sum += ratings[i];
+						}
+					}
+				}
+			}
+		}
+		const double seconds = elapsedSeconds(start);
+		std::cout << "  " << methods[method] << ": sum " << sum << ", "
+		          << 1e9 * seconds / numRecords << " ns/record" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// zoneMapBenchmark
+// -----------------------------------------------------------------------------
+
+void zoneMapBenchmark(int numRecords)
+{
+	// Runs amount > limit, matching about 1% of the records, over a relation
+	// of bids whose amounts roughly rise with insertion order, without and
+	// with a zone map on amount, and times loading with the zone map kept up
+	// to date.
+	struct BenchRecord
+	{
+		int bidId;
+		double amount;
+		char bidder[48];
+	};
+	std::cout << "zonemap benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes" << std::endl;
+	std::vector<ZoneAttribute> attributes(1);
+	attributes[0].offset = offsetof(BenchRecord, amount);
+	attributes[0].type = DOUBLE_ATTRIBUTE;
+	const double limit = numRecords * 0.99;
+	const Predicate predicate = Predicate::doubleAt(offsetof(BenchRecord, amount), GREATER, limit);
+
+	BufMgr bufMgr(100);
+	for (int zoneMap = 0; zoneMap <= 1; zoneMap++)
+	{
+		removeBenchFile();
+		Clock::time_point start = Clock::now();
+		{
+			HeapFile heapFile(benchFileName, &bufMgr, true);
+			if (zoneMap)
+			{
+				heapFile.createZoneMap(attributes);
+			}
+			BenchRecord record;
+			memset(&record, 0, sizeof(record));
+			srand(7);
+			for (int i = 0; i < numRecords; i++)
+			{
+				record.bidId = i;
+				record.amount = i + rand() % 1000;
+				std::snprintf(record.bidder, sizeof(record.bidder), "bidder %d", rand() % 5000);
+				heapFile.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+			}
+			heapFile.close();
+		}
+		const double loadSeconds = elapsedSeconds(start);
+
+		start = Clock::now();
+		int matches = 0;
+		ScanStats stats;
+		{
+			FileScan scan(benchFileName, &bufMgr, predicate);
+			try
+			{
+				RecordId rid;
+				while (true)
+				{
+					scan.scanNext(rid);
+					matches++;
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+			stats = scan.getScanStats();
+		}
+		const double scanSeconds = elapsedSeconds(start);
+		std::cout << "  " << (zoneMap ? "with zone map" : "without zone map")
+		          << ": load " << 1e9 * loadSeconds / numRecords << " ns/record, scan "
+		          << matches << " matches, " << stats.pagesRead << " pages read, "
+		          << stats.pagesSkipped() << " skipped, "
+		          << 1e9 * scanSeconds / numRecords << " ns/record" << std::endl;
+	}
+	removeBenchFile();
+}
+
+// -----------------------------------------------------------------------------
+// bloomBenchmark
+// -----------------------------------------------------------------------------
+
+void bloomBenchmark(int numRecords)
+{
+	// Looks up UserID IN (five IDs) in a relation of users in no particular
+	// order, without Bloom filters and with filters of UserID sized for a few
+	// false positive rates.
+	struct BenchRecord
+	{
+		char userId[16];
+		int age;
+		char name[40];
+	};
+	std::cout << "bloom benchmark: " << numRecords << " records of "
+	          << sizeof(BenchRecord) << " bytes" << std::endl;
+	removeBenchFile();
+	{
+		BufMgr bufMgr(100);
+		HeapFile heapFile(benchFileName, &bufMgr, true);
+		BenchRecord record;
+		memset(&record, 0, sizeof(record));
+		for (int i = 0; i < numRecords; i++)
+		{
+			std::snprintf(record.userId, sizeof(record.userId), "user%07d", static_cast<int>(i * 7919LL % numRecords));
+			record.age = 18 + i % 60;
+			std::snprintf(record.name, sizeof(record.name), "name %d", i);
+			heapFile.insertRecord(reinterpret_cast<const char*>(&record), sizeof(record));
+		}
+		heapFile.close();
+		bufMgr.close();
+	}
+	Predicate predicate = Predicate::stringAt(offsetof(BenchRecord, userId), sizeof(BenchRecord::userId), EQUAL, "user0000000");
+	for (int i = 1; i < 5; i++)
+	{
+		char userId[16];
+		std::snprintf(userId, sizeof(userId), "user%07d", i * numRecords / 5);
+		predicate = Predicate::anyOf(predicate,
+			Predicate::stringAt(offsetof(BenchRecord, userId), sizeof(BenchRecord::userId), EQUAL, userId));
+	}
+	std::vector<FilterAttribute> attributes(1);
+	attributes[0].offset = offsetof(BenchRecord, userId);
+	attributes[0].width = sizeof(BenchRecord::userId);
+	attributes[0].type = STRING_ATTRIBUTE;
+
+	BufMgr bufMgr(100);
+	const double rates[] = {0, 0.1, 0.01, 0.001};
+	for (int i = 0; i < 4; i++)
+	{
+		std::size_t filterBits = 0;
+		if (rates[i] > 0)
+		{
+			HeapFile heapFile(benchFileName, &bufMgr);
+			heapFile.createBloomFilters(attributes, rates[i]);
+			filterBits = BloomFilterFile(benchFileName, &bufMgr).filterBits();
+		}
+		Clock::time_point start = Clock::now();
+		int matches = 0;
+		ScanStats stats;
+		{
+			FileScan scan(benchFileName, &bufMgr, predicate);
+			try
+			{
+				RecordId rid;
+				while (true)
+				{
+					scan.scanNext(rid);
+					matches++;
+				}
+			}
+			catch(const EndOfFileException &e)
+			{
+			}
+			stats = scan.getScanStats();
+		}
+		const double seconds = elapsedSeconds(start);
+		if (rates[i] > 0)
+		{
+			std::cout << "  false positive rate " << rates[i] << ", " << filterBits << " bits per page";
+		}
+		else
+		{
+			std::cout << "  without Bloom filters";
+		}
+		std::cout << ": " << matches << " matches, " << stats.pagesRead << " pages read, skip rate "
+		          << stats.skipRate() << ", " << 1e9 * seconds / numRecords << " ns/record" << std::endl;
+	}
+	removeBenchFile();
+}
+
+int main(int argc, char **argv)
+{
+	const std::string name = argc > 1 ? argv[1] : "";
+	const int size = argc > 2 ? std::atoi(argv[2]) : 0;
+
+	if (name == "load")
+	{
+		loadBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "churn")
+	{
+		churnBenchmark(size > 0 ? size : 100000);
+	}
+	else if (name == "io")
+	{
+		ioBenchmark(size > 0 ? size : 10000);
+	}
+	else if (name == "scan")
+	{
+		scanBenchmark(size > 0 ? size : 100000);
+	}
+	else if (name == "lookup")
+	{
+		lookupBenchmark(size > 0 ? size : 20000);
+	}
+	else if (name == "btree")
+	{
+		btreeBenchmark(size > 0 ? size : 400000, false);
+		btreeBenchmark(size > 0 ? size : 400000, true);
+	}
+	else if (name == "compress")
+	{
+		compressBenchmark(size > 0 ? size : 400000, false);
+		compressBenchmark(size > 0 ? size : 400000, true);
+	}
+	else if (name == "checksum")
+	{
+		checksumBenchmark(size > 0 ? size : 20000);
+	}
+	else if (name == "wal")
+	{
+		walBenchmark(size > 0 ? size : 20000);
+	}
+	else if (name == "tablespace")
+	{
+		tablespaceBenchmark(size > 0 ? size : 2000);
+	}
+	else if (name == "heapload")
+	{
+		heapLoadBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "pax")
+	{
+		paxBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "slots")
+	{
+		slotsBenchmark(size > 0 ? size : 2000000);
+	}
+	else if (name == "filter")
+	{
+		filterBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "parallel")
+	{
+		parallelBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "batch")
+	{
+		batchBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "zonemap")
+	{
+		zoneMapBenchmark(size > 0 ? size : 1000000);
+	}
+	else if (name == "bloom")
+	{
+		bloomBenchmark(size > 0 ? size : 1000000);
+	}
+	else
+	{
+		std::cout << "usage: " << argv[0] << " <benchmark> [size]" << std::endl;
+		std::cout << "  load [pages]    allocate and fill pages (default 1000000)" << std::endl;
+		std::cout << "  churn [pages]   delete and reuse random pages (default 100000)" << std::endl;
+		std::cout << "  io [pages]      count file I/Os per page operation (default 10000)" << std::endl;
+		std::cout << "  scan [pages]    scan a relation through the buffer pool (default 100000)" << std::endl;
+		std::cout << "  lookup [pages]  random page lookups, buffered and mapped (default 20000)" << std::endl;
+		std::cout << "  btree [records] build an index in ascending and random key order (default 400000)" << std::endl;
+		std::cout << "  compress [records] compare plain and compressed index files (default 400000)" << std::endl;
+		std::cout << "  checksum [pages] read pages with checksums off and on (default 20000)" << std::endl;
+		std::cout << "  wal [records]   small inserts committed with and without a log (default 20000)" << std::endl;
+		std::cout << "  tablespace [relations] small relations as files and as tablespace segments (default 2000)" << std::endl;
+		std::cout << "  heapload [records] load a relation from structs three ways (default 1000000)" << std::endl;
+		std::cout << "  pax [records]   filter on one attribute, slotted and PAX pages (default 1000000)" << std::endl;
+		std::cout << "  slots [ops]     delete-heavy record churn on one page (default 2000000)" << std::endl;
+		std::cout << "  filter [records] select records by a predicate, copied and pushed down (default 1000000)" << std::endl;
+		std::cout << "  parallel [records] scan with a predicate on 1 to 8 threads (default 1000000)" << std::endl;
+		std::cout << "  batch [records] sum an attribute record by record and in batches (default 1000000)" << std::endl;
+		std::cout << "  zonemap [records] range predicate on sorted data, without and with a zone map (default 1000000)" << std::endl;
+		std::cout << "  bloom [records] equality lookups on a string, without and with Bloom filters (default 1000000)" << std::endl;
+		return 1;
+	}
+
+	return 0;
+}
@@ -0,0 +1,358 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "bloom_filter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <sstream>
+
+#include "exceptions/invalid_bloom_filter_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Marks the first page of a file of Bloom filters.
+ */
+const std::uint32_t BLOOM_FILTER_MAGIC = 0x424c4f4d;
+
+/**
+ * Page holding the Header.
+ */
+const PageId HEADER_PAGE = 1;
+
+/**
+ * Flag at the start of an entry of a page that has one.
+ */
+const std::uint64_t HAS_ENTRY = 1;
+
+/**
+ * Most bits set for each value.
+ */
+const std::size_t MAX_HASHES = 16;
+
+char* pageBytes(Page* page) {
+  return reinterpret_cast<char*>(page);
+}
+
+void clearEntry(char* entry, const std::size_t entry_size) {
+  memcpy(entry, &HAS_ENTRY, sizeof(HAS_ENTRY));
+  memset(entry + sizeof(HAS_ENTRY), 0, entry_size - sizeof(HAS_ENTRY));
+}
+
+std::size_t expectedWidth(const FilterAttribute& attribute) {
+  switch (attribute.type) {
+    case INT_ATTRIBUTE:
+      return sizeof(std::int32_t);
+    case DOUBLE_ATTRIBUTE:
+      return sizeof(double);
+    default:
+      return attribute.width;
+  }
+}
+
+// Finalizer of splitmix64, which spreads every input bit over the output.
+std::uint64_t mix(std::uint64_t h) {
+  h ^= h >> 30;
+  h *= 0xbf58476d1ce4e5b9ULL;
+  h ^= h >> 27;
+  h *= 0x94d049bb133111ebULL;
+  h ^= h >> 31;
+  return h;
+}
+
+}
+
+const std::size_t BloomFilterFile::MAX_ATTRIBUTES;
+const double BloomFilterFile::DEFAULT_FALSE_POSITIVE_RATE = 0.01;
+
+std::string BloomFilterFile::nameFor(const std::string& relation_name) {
+  return relation_name + ".bloom";
+}
+
+BloomFilterFile::BloomFilterFile(const std::string& relation_name,
+                                 BufMgr* buf_mgr)
+    : name_(nameFor(relation_name)),
+      buf_mgr_(buf_mgr),
+      file_(new BlobFile(name_, false)) {
+  Page* page;
+  buf_mgr_->readPage(file_, HEADER_PAGE, page);
+  Header header;
+  memcpy(&header, pageBytes(page), sizeof(header));
+  buf_mgr_->unPinPage(file_, HEADER_PAGE, false);
+  if (header.magic != BLOOM_FILTER_MAGIC ||
+      header.num_attributes == 0 || header.num_attributes > MAX_ATTRIBUTES ||
+      header.filter_bits == 0 || header.filter_bits % 64 != 0 ||
+      header.num_hashes == 0) {
+    delete file_;
+    throw InvalidBloomFilterException(name_ + " doesn't hold Bloom filters");
+  }
+  setLayout(header);
+}
+
+BloomFilterFile::BloomFilterFile(const std::string& relation_name,
+                                 BufMgr* buf_mgr,
+                                 const std::vector<FilterAttribute>& attributes,
+                                 const double false_positive_rate,
+                                 const std::size_t records_per_page)
+    : name_(nameFor(relation_name)),
+      buf_mgr_(buf_mgr),
+      file_(NULL) {
+  if (attributes.empty() || attributes.size() > MAX_ATTRIBUTES) {
+    std::stringstream ss;
+    ss << attributes.size() << " attributes given, but filters are kept of 1 "
+       << "to " << MAX_ATTRIBUTES;
+    throw InvalidBloomFilterException(ss.str());
+  }
+  if (!(false_positive_rate > 0 && false_positive_rate < 1)) {
+    std::stringstream ss;
+    ss << "false positive rate " << false_positive_rate
+       << " is not between 0 and 1";
+    throw InvalidBloomFilterException(ss.str());
+  }
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = BLOOM_FILTER_MAGIC;
+  header.num_attributes = attributes.size();
+  header.false_positive_rate = false_positive_rate;
+  for (std::size_t i = 0; i < attributes.size(); ++i) {
+    const FilterAttribute& attribute = attributes[i];
+    if (attribute.type != INT_ATTRIBUTE &&
+        attribute.type != DOUBLE_ATTRIBUTE &&
+        attribute.type != STRING_ATTRIBUTE) {
+      std::stringstream ss;
+      ss << "attribute at offset " << attribute.offset
+         << " has unknown type " << attribute.type;
+      throw InvalidBloomFilterException(ss.str());
+    }
+    if (attribute.width == 0 || attribute.width != expectedWidth(attribute)) {
+      std::stringstream ss;
+      ss << "attribute at offset " << attribute.offset << " has width "
+         << attribute.width << ", which doesn't fit its type";
+      throw InvalidBloomFilterException(ss.str());
+    }
+    header.attributes[i] = attribute;
+  }
+
+  // The usual sizing: -ln(p) / ln(2)^2 bits per value, of which ln(2) times
+  // bits per value are set for each, as far as a page's filters fit a page.
+  const double ln2 = std::log(2.0);
+  const double values = std::max<std::size_t>(records_per_page, 1);
+  const std::size_t max_bits =
+      (Page::SIZE - sizeof(HAS_ENTRY)) / attributes.size() / 8 * 64;
+  const std::size_t bits = static_cast<std::size_t>(
+      std::ceil(values * -std::log(false_positive_rate) / (ln2 * ln2)));
+  header.filter_bits = std::min(max_bits, std::max<std::size_t>(
+      (bits + 63) / 64 * 64, 64));
+  header.num_hashes = std::min(MAX_HASHES, std::max<std::size_t>(
+      static_cast<std::size_t>(header.filter_bits / values * ln2 + 0.5), 1));
+
+  if (File::exists(name_)) {
+    File::remove(name_);
+  }
+  file_ = new BlobFile(name_, true);
+  PageId page_number;
+  Page* page;
+  buf_mgr_->allocPage(file_, page_number, page);
+  memset(pageBytes(page), 0, Page::SIZE);
+  memcpy(pageBytes(page), &header, sizeof(header));
+  buf_mgr_->unPinPage(file_, page_number, true);
+  setLayout(header);
+}
+
+BloomFilterFile::~BloomFilterFile() {
+  try {
+    flush();
+  } catch (...) {
+    return;
+  }
+  delete file_;
+}
+
+void BloomFilterFile::flush() {
+  buf_mgr_->flushFile(file_);
+}
+
+void BloomFilterFile::setLayout(const Header& header) {
+  attributes_.assign(header.attributes,
+                     header.attributes + header.num_attributes);
+  false_positive_rate_ = header.false_positive_rate;
+  filter_bits_ = header.filter_bits;
+  num_hashes_ = header.num_hashes;
+  entry_size_ = sizeof(HAS_ENTRY) + attributes_.size() * filter_bits_ / 8;
+  entries_per_page_ = Page::SIZE / entry_size_;
+  num_pages_ = header.num_pages;
+}
+
+char* BloomFilterFile::pinEntry(const PageId page_number, const bool allocate,
+                                PageId& entry_page) {
+  const std::uint32_t index = page_number / entries_per_page_;
+  if (index >= num_pages_) {
+    // Another instance may have added the page since the header was read.
+    Page* page;
+    buf_mgr_->readPage(file_, HEADER_PAGE, page);
+    memcpy(&num_pages_, pageBytes(page) + offsetof(Header, num_pages),
+           sizeof(num_pages_));
+    buf_mgr_->unPinPage(file_, HEADER_PAGE, false);
+  }
+  if (index >= num_pages_) {
+    if (!allocate) {
+      entry_page = Page::INVALID_NUMBER;
+      return NULL;
+    }
+    addPages(index + 1);
+  }
+  entry_page = HEADER_PAGE + 1 + index;
+  Page* page;
+  buf_mgr_->readPage(file_, entry_page, page);
+  return pageBytes(page) + (page_number % entries_per_page_) * entry_size_;
+}
+
+void BloomFilterFile::addPages(const std::uint32_t num_pages) {
+  while (num_pages_ < num_pages) {
+    PageId page_number;
+    Page* page;
+    buf_mgr_->allocPage(file_, page_number, page);
+    memset(pageBytes(page), 0, Page::SIZE);
+    buf_mgr_->unPinPage(file_, page_number, true);
+    // Entries are found by position, so pages have to come in order, which
+    // they do since none is ever freed.
+    if (page_number != HEADER_PAGE + 1 + num_pages_) {
+      std::stringstream ss;
+      ss << "page " << page_number << " of " << name_ << " allocated where "
+         << "page " << HEADER_PAGE + 1 + num_pages_ << " was expected";
+      throw InvalidBloomFilterException(ss.str());
+    }
+    ++num_pages_;
+  }
+  Page* header;
+  buf_mgr_->readPage(file_, HEADER_PAGE, header);
+  memcpy(pageBytes(header) + offsetof(Header, num_pages), &num_pages_,
+         sizeof(num_pages_));
+  buf_mgr_->unPinPage(file_, HEADER_PAGE, true);
+}
+
+void BloomFilterFile::clearPage(const PageId page_number) {
+  PageId entry_page;
+  clearEntry(pinEntry(page_number, true, entry_page), entry_size_);
+  buf_mgr_->unPinPage(file_, entry_page, true);
+}
+
+void BloomFilterFile::include(const PageId page_number, const char* record,
+                              const std::size_t length, const bool truncated) {
+  PageId entry_page;
+  char* entry = pinEntry(page_number, true, entry_page);
+  std::uint64_t flag;
+  memcpy(&flag, entry, sizeof(flag));
+  bool dirty = false;
+  if (flag != HAS_ENTRY) {
+    clearEntry(entry, entry_size_);
+    dirty = true;
+  }
+
+  // Most values of a page repeat, so the page is only dirtied when a bit
+  // gets set.
+  std::uint8_t* filter =
+      reinterpret_cast<std::uint8_t*>(entry + sizeof(HAS_ENTRY));
+  for (std::size_t i = 0; i < attributes_.size();
+       ++i, filter += filter_bits_ / 8) {
+    const FilterAttribute& attribute = attributes_[i];
+    if (attribute.offset + attribute.width > length) {
+      if (truncated) {
+        // The value is unknown, so the filter has to claim every value.
+        dirty = true;
+        memset(filter, 0xFF, filter_bits_ / 8);
+      }
+      continue;
+    }
+    const std::uint64_t hash =
+        hashValue(static_cast<AttributeType>(attribute.type),
+                  record + attribute.offset, attribute.width);
+    const std::uint64_t step = mix(hash) | 1;
+    for (std::size_t j = 0; j < num_hashes_; ++j) {
+      const std::size_t bit = (hash + j * step) % filter_bits_;
+      const std::uint8_t mask = 1 << (bit % 8);
+      if (!(filter[bit / 8] & mask)) {
+        filter[bit / 8] |= mask;
+        dirty = true;
+      }
+    }
+  }
+  buf_mgr_->unPinPage(file_, entry_page, dirty);
+}
+
+bool BloomFilterFile::mayMatch(const PageId page_number,
+                               const Predicate& predicate) {
+  PageId entry_page;
+  const char* entry = pinEntry(page_number, false, entry_page);
+  if (entry == NULL) {
+    return true;
+  }
+  std::uint64_t flag;
+  memcpy(&flag, entry, sizeof(flag));
+  const bool may_match =
+      flag != HAS_ENTRY || predicate.mayMatch(PageFilter(*this, entry));
+  buf_mgr_->unPinPage(file_, entry_page, false);
+  return may_match;
+}
+
+bool BloomFilterFile::PageFilter::mayContain(const std::size_t offset,
+                                             const AttributeType type,
+                                             const char* value,
+                                             const std::size_t width) const {
+  const std::uint8_t* filter =
+      reinterpret_cast<const std::uint8_t*>(entry_ + sizeof(HAS_ENTRY));
+  for (std::size_t i = 0; i < file_.attributes_.size();
+       ++i, filter += file_.filter_bits_ / 8) {
+    const FilterAttribute& attribute = file_.attributes_[i];
+    if (attribute.offset != offset || attribute.type != type ||
+        attribute.width != width) {
+      continue;
+    }
+    const std::uint64_t hash = hashValue(type, value, width);
+    const std::uint64_t step = mix(hash) | 1;
+    for (std::size_t j = 0; j < file_.num_hashes_; ++j) {
+      const std::size_t bit = (hash + j * step) % file_.filter_bits_;
+      if (!(filter[bit / 8] & (1 << (bit % 8)))) {
+        return false;
+      }
+    }
+    return true;
+  }
+  return true;
+}
+
+std::uint64_t BloomFilterFile::hashValue(const AttributeType type,
+                                         const char* value,
+                                         const std::size_t width) {
+  std::size_t length = width;
+  double number;
+  if (type == STRING_ATTRIBUTE) {
+    // Strings compare like strncmp, so bytes after a NUL don't count.
+    length = strnlen(value, width);
+  } else if (type == DOUBLE_ATTRIBUTE) {
+    memcpy(&number, value, sizeof(number));
+    if (number == 0) {
+      number = 0;
+      value = reinterpret_cast<const char*>(&number);
+    }
+  }
+
+  // FNV-1a, then mixed so that every bit depends on every byte.
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  for (std::size_t i = 0; i < length; ++i) {
+    hash ^= static_cast<std::uint8_t>(value[i]);
+    hash *= 0x100000001b3ULL;
+  }
+  return mix(hash);
+}
+
+}
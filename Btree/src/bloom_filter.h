@@ -0,0 +1,331 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "predicate.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An attribute BloomFilterFile keeps filters of.
+ */
+struct FilterAttribute {
+  /**
+   * Offset of the attribute within a record, in bytes.
+   */
+  std::uint32_t offset;
+
+  /**
+   * Width of the attribute in bytes: 4 for an int, 8 for a double.
+   */
+  std::uint32_t width;
+
+  /**
+   * Type of the attribute, an AttributeType.
+   */
+  std::uint32_t type;
+};
+
+/**
+ * @brief Bloom filters of chosen attributes on each page of a relation, so
+ * scans with equality predicates can skip pages no record of which has the
+ * value looked for.
+ *
+ * The filters live in a BlobFile of their own next to the relation, named
+ * by nameFor(), laid out like a ZoneMap: the first page describes the
+ * filters, and the pages after it hold one entry per page of the relation,
+ * indexed by page number, with a filter per attribute.
+ *
+ * Every filter has the same number of bits, chosen when the file is created
+ * from a false positive rate and the number of records a page is expected
+ * to hold.  Pages holding more records than that get more false positives.
+ * Values are hashed as Predicate compares them: strings up to their first
+ * NUL, and both zeros of a double alike.
+ *
+ * Values are never removed, so records that are deleted or updated leave
+ * theirs in, which keeps the filters correct but less selective.  A page
+ * with no entry yet is never skipped, and an attribute of a record whose
+ * tail is in an overflow chain that can't be read from the page fills its
+ * filter.
+ *
+ * @warning This class is not threadsafe.
+ */
+class BloomFilterFile {
+ public:
+  /**
+   * Most attributes filters are kept of.
+   */
+  static const std::size_t MAX_ATTRIBUTES = 16;
+
+  /**
+   * False positive rate used if none is given.
+   */
+  static const double DEFAULT_FALSE_POSITIVE_RATE;
+
+  /**
+   * Returns the name of the file holding the Bloom filters of a relation.
+   *
+   * @param relation_name   Name of the relation's file.
+   */
+  static std::string nameFor(const std::string& relation_name);
+
+  /**
+   * Opens the Bloom filters of a relation.
+   *
+   * @param relation_name   Name of the relation's file.
+   * @param buf_mgr         Buffer Manager instance used to read and write
+   *                        pages of the filters.
+   * @throws  FileNotFoundException         If the relation has no filters.
+   * @throws  InvalidBloomFilterException   If the file doesn't hold filters.
+   */
+  BloomFilterFile(const std::string& relation_name, BufMgr* buf_mgr);
+
+  /**
+   * Creates empty Bloom filters of a relation, replacing any it has.  No
+   * page has an entry until one is added with clearPage or include.
+   *
+   * @param relation_name       Name of the relation's file.
+   * @param buf_mgr             Buffer Manager instance used to read and
+   *                            write pages of the filters.
+   * @param attributes          Attributes to keep filters of.
+   * @param false_positive_rate Rate at which a filter of a full page is to
+   *                            claim a value it doesn't hold.
+   * @param records_per_page    Number of records a page is expected to hold.
+   * @throws  InvalidBloomFilterException   If there are no attributes, more
+   *                                        than MAX_ATTRIBUTES, one has an
+   *                                        unknown type or a width that
+   *                                        doesn't fit it, or the rate isn't
+   *                                        between 0 and 1.
+   */
+  BloomFilterFile(const std::string& relation_name, BufMgr* buf_mgr,
+                  const std::vector<FilterAttribute>& attributes,
+                  const double false_positive_rate,
+                  const std::size_t records_per_page);
+
+  /**
+   * Flushes the pages of the filters out of the buffer pool and closes the
+   * file.  If they can't be written, the file is left open, since frames of
+   * the buffer pool still refer to it; call flush first to find out.
+   */
+  ~BloomFilterFile();
+
+  /**
+   * Writes the pages of the filters out of the buffer pool.
+   *
+   * @throws  PagePinnedException   If a page of the filters is pinned.
+   * @throws  FileIOException       If a page can't be written.
+   */
+  void flush();
+
+  /**
+   * Returns the attributes filters are kept of.
+   */
+  const std::vector<FilterAttribute>& attributes() const {
+    return attributes_;
+  }
+
+  /**
+   * Returns the false positive rate the filters were sized for.
+   */
+  double falsePositiveRate() const { return false_positive_rate_; }
+
+  /**
+   * Returns the number of bits of each filter.
+   */
+  std::size_t filterBits() const { return filter_bits_; }
+
+  /**
+   * Returns the number of bits set for each value.
+   */
+  std::size_t numHashes() const { return num_hashes_; }
+
+  /**
+   * Gives a page an entry with empty filters, as for a page without
+   * records.
+   *
+   * @param page_number   Number of the relation's page.
+   */
+  void clearPage(const PageId page_number);
+
+  /**
+   * Adds the attributes of a record to the filters of a page.  A page
+   * without an entry gets one first.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param record        First byte of the record.
+   * @param length        Length of the record in bytes.
+   * @param truncated     Whether the record goes on past length, so that
+   *                      attributes past it have unknown values.
+   */
+  void include(const PageId page_number, const char* record,
+               const std::size_t length, const bool truncated = false);
+
+  /**
+   * Returns whether any record of a page may match a predicate.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param predicate     Predicate to check.
+   */
+  bool mayMatch(const PageId page_number, const Predicate& predicate);
+
+ private:
+  /**
+   * @brief Layout of the first page of the file.
+   */
+  struct Header {
+    /**
+     * BLOOM_FILTER_MAGIC.
+     */
+    std::uint32_t magic;
+
+    /**
+     * Number of attributes.
+     */
+    std::uint32_t num_attributes;
+
+    /**
+     * Number of pages of entries following this one.
+     */
+    std::uint32_t num_pages;
+
+    /**
+     * Number of bits of each filter, a multiple of 64.
+     */
+    std::uint32_t filter_bits;
+
+    /**
+     * Number of bits set for each value.
+     */
+    std::uint32_t num_hashes;
+
+    /**
+     * False positive rate the filters were sized for.
+     */
+    double false_positive_rate;
+
+    /**
+     * Attributes, num_attributes of them.
+     */
+    FilterAttribute attributes[MAX_ATTRIBUTES];
+  };
+
+  /**
+   * @brief The filters of one page, as seen by Predicate::mayMatch.
+   */
+  class PageFilter : public ValueFilter {
+   public:
+    PageFilter(const BloomFilterFile& file, const char* entry)
+        : file_(file), entry_(entry) {}
+
+    virtual bool mayContain(const std::size_t offset, const AttributeType type,
+                            const char* value,
+                            const std::size_t width) const;
+
+   private:
+    const BloomFilterFile& file_;
+    const char* entry_;
+  };
+
+  /**
+   * Not copyable; the file is closed when this is destroyed.
+   */
+  BloomFilterFile(const BloomFilterFile&);
+  BloomFilterFile& operator=(const BloomFilterFile&);
+
+  /**
+   * Sets up the layout of entries from the header.
+   */
+  void setLayout(const Header& header);
+
+  /**
+   * Reads and pins the page of entries holding a relation page's entry.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param allocate      Whether to add pages of entries up to it if the
+   *                      file doesn't reach it yet.
+   * @param entry_page    Set to the number of the pinned page, or
+   *                      Page::INVALID_NUMBER if there is none.
+   * @return  First byte of the entry, or NULL if there is no such page.
+   */
+  char* pinEntry(const PageId page_number, const bool allocate,
+                 PageId& entry_page);
+
+  /**
+   * Adds pages of entries, filled with entries of no page, until the file
+   * has the given number of them.
+   */
+  void addPages(const std::uint32_t num_pages);
+
+  /**
+   * Returns the hash of an attribute value, normalized so that values
+   * Predicate finds equal hash alike.
+   */
+  static std::uint64_t hashValue(const AttributeType type, const char* value,
+                                 const std::size_t width);
+
+  /**
+   * Name of the file holding the filters.
+   */
+  std::string name_;
+
+  /**
+   * Buffer Manager instance used to read and write pages of the filters.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File holding the filters.
+   */
+  BlobFile* file_;
+
+  /**
+   * Attributes filters are kept of.
+   */
+  std::vector<FilterAttribute> attributes_;
+
+  /**
+   * False positive rate the filters were sized for.
+   */
+  double false_positive_rate_;
+
+  /**
+   * Number of bits of each filter.
+   */
+  std::size_t filter_bits_;
+
+  /**
+   * Number of bits set for each value.
+   */
+  std::size_t num_hashes_;
+
+  /**
+   * Size of an entry in bytes: a flag followed by a filter per attribute.
+   */
+  std::size_t entry_size_;
+
+  /**
+   * Number of entries each page of entries holds.
+   */
+  std::size_t entries_per_page_;
+
+  /**
+   * Number of pages of entries as last read from the header.  Another
+   * instance may have added more since.
+   */
+  std::uint32_t num_pages_;
+};
+
+}
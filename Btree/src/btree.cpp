@@ -32,7 +32,8 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		std::string & outIndexName,
 		BufMgr *bufMgrIn,
 		const int attrByteOffset,
-		const Datatype attrType)
+		const Datatype attrType,
+		const bool compressed)
 {
 		// Initialize class variables
 		this->bufMgr = bufMgrIn;
@@ -50,7 +51,14 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 		if (! BlobFile::exists(outIndexName))
 		{
 			// Create index file
-			this->file =  new BlobFile(outIndexName,true);
+			if (compressed)
+			{
+				this->file = new BlobFile(BlobFile::createCompressed(outIndexName));
+			}
+			else
+			{
+				this->file =  new BlobFile(outIndexName,true);
+			}
 			// Allocate page for metadata
 			Page *metaPage,*rootPage;
 			this->bufMgr->allocPage(this->file,this->headerPageNum,metaPage);
@@ -68,13 +76,13 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 			// Write root to disk
 			this->bufMgr->unPinPage(this->file,this->rootPageNum,true);
 			// Scanning File
-			FileScan records = FileScan(relationName,this->bufMgr);
+			FileScan records(relationName,this->bufMgr);
 			// Id of each record
 			RecordId recId;
-			// Record string returned for each RecordId
-			std::string recStr;
+			// Record returned for each RecordId, read in place on the pinned page
+			RecordView record;
 			// Key value
-			void* key;
+			const void* key;
 			// Begin Scanning File
 			try
 			{
@@ -84,8 +92,8 @@ BTreeIndex::BTreeIndex(const std::string & relationName,
 					// Get next record id
 					records.scanNext(recId);
 					// Get key
-					recStr = records.getRecord();
-					key = (int*)(recStr.c_str() + this->attrByteOffset);
+					record = records.getRecordView();
+					key = record.data + this->attrByteOffset;
 					this->insertEntry(key,recId);
 				}
 			}
@@ -224,9 +232,9 @@ const void BTreeIndex::splitLeaf(const PageId pid, const void* key, const Record
 	LeafNodeInt * leaf = (LeafNodeInt*) leafPage;
 	// Create a right Sibling Page holding the larger values
 	Page * sibPage;
-	// Obtain new page id
+	// Obtain new page id, next to the leaf so the leaf chain stays sequential on disk
 	PageId sibid ;
-	this->bufMgr->allocPage(this->file,sibid,sibPage);
+	this->bufMgr->allocPage(this->file,sibid,sibPage,pid);
 	LeafNodeInt * sib = (LeafNodeInt*) sibPage;
 	// Marking entries filled
 	sib->entries = 0;
@@ -281,6 +289,10 @@ const void BTreeIndex::splitLeaf(const PageId pid, const void* key, const Record
 		leaf->entries --;
 		j++;
 	}
+	// Clear the moved entries, so the unused half of the leaf is all zeros and
+	// compresses to almost nothing
+	memset(&leaf->keyArray[thresh], 0, (this->leafOccupancy - thresh) * sizeof(int));
+	memset(&leaf->ridArray[thresh], 0, (this->leafOccupancy - thresh) * sizeof(RecordId));
 	// Set rightSibPageNo
 	sib->rightSibPageNo = leaf->rightSibPageNo;
 	leaf->rightSibPageNo = sibid;
@@ -820,4 +832,51 @@ void BTreeIndex::endScan()
 	this->currentPageData = NULL;
 }
 
+// -----------------------------------------------------------------------------
+// BTreeIndex::leafContiguity
+// -----------------------------------------------------------------------------
+//
+double BTreeIndex::leafContiguity()
+{
+	// Walk down the leftmost path to the first leaf
+	PageId pid = this->rootPageNum;
+	if(this->isRootLeaf == false)
+	{
+		while(1)
+		{
+			Page * nodePage;
+			this->bufMgr->readPage(this->file,pid,nodePage);
+			NonLeafNodeInt * node = (NonLeafNodeInt*) nodePage;
+			PageId child = node->pageNoArray[0];
+			int level = node->level;
+			this->bufMgr->unPinPage(this->file,pid,false);
+			pid = child;
+			// Children of a level 1 node are leaves
+			if(level == 1)
+				break;
+		}
+	}
+	// Follow the leaf chain, counting links to the physically next page
+	int links = 0;
+	int contiguous = 0;
+	while(pid != Page::INVALID_NUMBER)
+	{
+		Page * leafPage;
+		this->bufMgr->readPage(this->file,pid,leafPage);
+		PageId nextid = ((LeafNodeInt*) leafPage)->rightSibPageNo;
+		this->bufMgr->unPinPage(this->file,pid,false);
+		if(nextid != Page::INVALID_NUMBER)
+		{
+			links++;
+			if(nextid == pid + 1)
+				contiguous++;
+		}
+		pid = nextid;
+	}
+	// A single leaf is trivially contiguous
+	if(links == 0)
+		return 1.0;
+	return (double) contiguous / links;
+}
+
 }
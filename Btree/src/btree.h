@@ -389,9 +389,11 @@ const void searchKey(PageId pid,int key, PageId &cid);
    * @param bufMgrIn						Buffer Manager Instance
    * @param attrByteOffset			Offset of attribute, over which index is to be built, in the record
    * @param attrType						Datatype of attribute over which index is built
+   * @param compressed					Whether a new index file stores its pages compressed
    */
 	BTreeIndex(const std::string & relationName, std::string & outIndexName,
-						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType);
+						BufMgr *bufMgrIn,	const int attrByteOffset,	const Datatype attrType,
+						const bool compressed = false);
 
 
   /**
@@ -449,6 +451,14 @@ const void searchKey(PageId pid,int key, PageId &cid);
 	**/
 	void endScan();
 
+
+  /**
+	 * Leaf chain physical contiguity: the fraction of links in the leaf chain that point at the very next
+	 * page of the index file. A value of 1 means a full index scan reads the file sequentially.
+	 * @return Fraction of leaf links between consecutive pages, between 0 and 1.
+	**/
+	double leafContiguity();
+
 };
 
 }
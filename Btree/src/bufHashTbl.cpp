@@ -15,11 +15,11 @@
 
 namespace badgerdb {
 
-int BufHashTbl::hash(const File* file, const PageId pageNo)
+int BufHashTbl::hash(const FileId fileId, const PageId pageNo)
 {
-  int tmp, value;
-  tmp = (long)file;  // cast of pointer to the file object to an integer
-  value = (tmp + pageNo) % HTSIZE;
+  // Ids are small and consecutive, so spread them apart before adding the page number.
+  std::uint32_t value;
+  value = (fileId * 2654435761U + pageNo) % HTSIZE;
   return value;
 }
 
@@ -45,14 +45,14 @@ BufHashTbl::~BufHashTbl()
   delete [] ht;
 }
 
-void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId frameNo)
+void BufHashTbl::insert(const FileId fileId, const PageId pageNo, const FrameId frameNo)
 {
-  int index = hash(file, pageNo);
+  int index = hash(fileId, pageNo);
 
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
-  		throw HashAlreadyPresentException(tmpBuc->file->filename(), tmpBuc->pageNo, tmpBuc->frameNo);
+    if (tmpBuc->fileId == fileId && tmpBuc->pageNo == pageNo)
+  		throw HashAlreadyPresentException(FileCatalog::filename(fileId), tmpBuc->pageNo, tmpBuc->frameNo);
     tmpBuc = tmpBuc->next;
   }
 
@@ -60,19 +60,19 @@ void BufHashTbl::insert(const File* file, const PageId pageNo, const FrameId fra
   if (!tmpBuc)
   	throw HashTableException();
 
-  tmpBuc->file = (File*) file;
+  tmpBuc->fileId = fileId;
   tmpBuc->pageNo = pageNo;
   tmpBuc->frameNo = frameNo;
   tmpBuc->next = ht[index];
   ht[index] = tmpBuc;
 }
 
-void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo) 
+void BufHashTbl::lookup(const FileId fileId, const PageId pageNo, FrameId &frameNo) 
 {
-  int index = hash(file, pageNo);
+  int index = hash(fileId, pageNo);
   hashBucket* tmpBuc = ht[index];
   while (tmpBuc) {
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == fileId && tmpBuc->pageNo == pageNo)
     {
       frameNo = tmpBuc->frameNo; // return frameNo by reference
       return;
@@ -80,18 +80,18 @@ void BufHashTbl::lookup(const File* file, const PageId pageNo, FrameId &frameNo)
     tmpBuc = tmpBuc->next;
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  throw HashNotFoundException(FileCatalog::filename(fileId), pageNo);
 }
 
-void BufHashTbl::remove(const File* file, const PageId pageNo) {
+void BufHashTbl::remove(const FileId fileId, const PageId pageNo) {
 
-  int index = hash(file, pageNo);
+  int index = hash(fileId, pageNo);
   hashBucket* tmpBuc = ht[index];
   hashBucket* prevBuc = NULL;
 
   while (tmpBuc)
 	{
-    if (tmpBuc->file == file && tmpBuc->pageNo == pageNo)
+    if (tmpBuc->fileId == fileId && tmpBuc->pageNo == pageNo)
 		{
       if(prevBuc) 
 				prevBuc->next = tmpBuc->next;
@@ -108,7 +108,7 @@ void BufHashTbl::remove(const File* file, const PageId pageNo) {
     }
   }
 
-  throw HashNotFoundException(file->filename(), pageNo);
+  throw HashNotFoundException(FileCatalog::filename(fileId), pageNo);
 }
 
 }
@@ -16,9 +16,9 @@ namespace badgerdb {
 */
 struct hashBucket {
 	/**
-	 * pointer a file object (more on this below)
+	 * FileCatalog id of the file, the same for every File object on it
 	 */
-	File *file;
+	FileId fileId;
 
 	/**
 	 * page number within a file
@@ -55,13 +55,13 @@ class BufHashTbl
   hashBucket**  ht;
 
 	/**
-	 * returns hash value between 0 and HTSIZE-1 computed using file and pageNo
+	 * returns hash value between 0 and HTSIZE-1 computed using fileId and pageNo
 	 *
-	 * @param file   	File object
+	 * @param fileId 	FileCatalog id of the file
 	 * @param pageNo  Page number in the file
 	 * @return  			Hash value.
 	 */
-  int	 hash(const File* file, const PageId pageNo);
+  int	 hash(const FileId fileId, const PageId pageNo);
 
  public:
 	/**
@@ -75,35 +75,35 @@ class BufHashTbl
   ~BufHashTbl(); // destructor
 	
 	/**
-   * Insert entry into hash table mapping (file, pageNo) to frameNo.
+   * Insert entry into hash table mapping (fileId, pageNo) to frameNo.
 	 *
-	 * @param file   	File object
+	 * @param fileId 	FileCatalog id of the file
 	 * @param pageNo 	Page number in the file
 	 * @param frameNo Frame number assigned to that page of the file
    * @throws  HashAlreadyPresentException	if the corresponding page already exists in the hash table
    * @throws  HashTableException (optional) if could not create a new bucket as running of memory
 	 */
-  void insert(const File* file, const PageId pageNo, const FrameId frameNo);
+  void insert(const FileId fileId, const PageId pageNo, const FrameId frameNo);
 
 	/**
-   * Check if (file, pageNo) is currently in the buffer pool (ie. in
+   * Check if (fileId, pageNo) is currently in the buffer pool (ie. in
    * the hash table).
 	 *
-	 * @param file  	File object
+	 * @param fileId 	FileCatalog id of the file
 	 * @param pageNo	Page number in the file
 	 * @param frameNo Frame number reference
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
-  void lookup(const File* file, const PageId pageNo, FrameId &frameNo);
+  void lookup(const FileId fileId, const PageId pageNo, FrameId &frameNo);
 
 	/**
-   * Delete entry (file,pageNo) from hash table.
+   * Delete entry (fileId,pageNo) from hash table.
 	 *
-	 * @param file   	File object
+	 * @param fileId 	FileCatalog id of the file
 	 * @param pageNo  Page number in the file
    * @throws HashNotFoundException if the page entry is not found in the hash table 
 	 */
-  void remove(const File* file, const PageId pageNo);  
+  void remove(const FileId fileId, const PageId pageNo);  
 };
 
 }
@@ -7,12 +7,14 @@
 
 #include <memory>
 #include <iostream>
+#include <algorithm>
 #include "buffer.h"
 #include "exceptions/buffer_exceeded_exception.h"
 #include "exceptions/page_not_pinned_exception.h"
 #include "exceptions/page_pinned_exception.h"
 #include "exceptions/bad_buffer_exception.h"
 #include "exceptions/hash_not_found_exception.h"
+#include "exceptions/file_io_exception.h"
 
 namespace badgerdb { 
 
@@ -21,7 +23,13 @@ namespace badgerdb {
 //----------------------------------------
 
 BufMgr::BufMgr(std::uint32_t bufs)
-	: numBufs(bufs) {
+	: numBufs(bufs),
+	  durability(DURABILITY_NONE),
+	  syncInterval(1000),
+	  lastSync(std::chrono::steady_clock::now()),
+	  log(NULL),
+	  logImages(NULL),
+	  filesChanged(false) {
 	bufDescTable = new BufDesc[bufs];
 
   for (FrameId i = 0; i < bufs; i++) 
@@ -40,26 +48,46 @@ BufMgr::BufMgr(std::uint32_t bufs)
 
 
 BufMgr::~BufMgr() {
+  try
+  {
+  	close();
+  }
+  catch(...)
+  {
+  }
+
+	delete hashTable;
+  delete [] bufDescTable;
+  delete [] bufPool;
+  delete [] logImages;
+}
+
+void BufMgr::close()
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
   //Flush out all unwritten pages
   for (std::uint32_t i = 0; i < numBufs; i++) 
   {
   	BufDesc* tmpbuf = &(bufDescTable[i]);
   	if (tmpbuf->valid == true && tmpbuf->dirty == true)
 		{
-			tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
+			writeBack(i);
   	}
   }
-
-	delete hashTable;
-  delete [] bufDescTable;
-  delete [] bufPool;
+  if (durability != DURABILITY_NONE || log != NULL)
+  {
+  	File::syncAll();
+  	bufStats.syncs++;
+  }
+  // Everything is on disk, so the log can start over.
+  checkpoint();
 }
 
 void BufMgr::allocBuf(FrameId & frame) 
 {
   // perform first part of clock algorithm to search for 
   // open buffer frame
-  // Assumes non-concurrent access to buffer manager
+  // Callers hold the latch
   std::uint32_t numScanned = 0;
   bool found = 0;
 
@@ -83,7 +111,7 @@ void BufMgr::allocBuf(FrameId & frame)
       {
         // hasn't been referenced and is not pinned, use it
         // remove previous entry from hash table
-        hashTable->remove(bufDescTable[clockHand].file, bufDescTable[clockHand].pageNo);
+        hashTable->remove(bufDescTable[clockHand].fileId, bufDescTable[clockHand].pageNo);
         found = true;
         break;
       }
@@ -106,8 +134,8 @@ void BufMgr::allocBuf(FrameId & frame)
   if (bufDescTable[clockHand].dirty)
   {
     bufStats.diskwrites++;
-    //status = bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo,
-    bufDescTable[clockHand].file->writePage(bufDescTable[clockHand].pageNo, bufPool[clockHand]);
+    writeBack(clockHand);
+    syncIfDue();
   }
 
 	//Reset all the BufDesc entry for the frame before returning the frame
@@ -120,14 +148,16 @@ void BufMgr::allocBuf(FrameId & frame)
 	
 void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
   // check to see if it is already in the buffer pool
   // std::cout << "readPage called on file.page " << file << "." << pageNo << endl;
   FrameId frameNo = 0;
 	try
 	{
-  	hashTable->lookup(file, pageNo, frameNo);
+  	hashTable->lookup(file->id(), pageNo, frameNo);
 
-    // set the referenced bit
+    // set the referenced bit, and write the page back through a File object that is in use
+    bufDescTable[frameNo].file = file;
     bufDescTable[frameNo].refbit = true;
     bufDescTable[frameNo].pinCnt++;
     page = &bufPool[frameNo];
@@ -147,18 +177,37 @@ void BufMgr::readPage(File* file, const PageId pageNo, Page*& page)
     page = &bufPool[frameNo];
 
     // insert in the hash table
-    hashTable->insert(file, pageNo, frameNo);
+    hashTable->insert(file->id(), pageNo, frameNo);
   }
 }
 
 
+void BufMgr::readMappedPage(File* file, const PageId pageNo, const Page*& page)
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+  // Read-only files never have dirty frames, so the mapping is up to date.
+  page = file->mappedPage(pageNo);
+  bufStats.accesses++;
+}
+
+
 void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty) 
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
   // lookup in hashtable
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  hashTable->lookup(file->id(), pageNo, frameNo);
+  bufDescTable[frameNo].file = file;
 
-  if (dirty == true) bufDescTable[frameNo].dirty = dirty;
+  if (dirty == true)
+  {
+  	bufDescTable[frameNo].dirty = dirty;
+  	if (log != NULL)
+  	{
+  		logChanges(frameNo);
+  	}
+  	syncIfDue();
+  }
 
   // make sure the page is actually pinned
   if (bufDescTable[frameNo].pinCnt == 0)
@@ -168,8 +217,9 @@ void BufMgr::unPinPage(File* file, const PageId pageNo, const bool dirty)
   else bufDescTable[frameNo].pinCnt--;
 }
 
-void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page) 
+void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page, const PageId nearPageNo) 
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
   FrameId frameNo;
 
   // alloc a new frame
@@ -177,59 +227,217 @@ void BufMgr::allocPage(File* file, PageId &pageNo, Page*& page)
 
   // allocate a new page in the file
 	//std::cerr << "buffer data size:" << bufPool[frameNo].data_.length() << "\n";
-  bufPool[frameNo] = file->allocatePage(pageNo);
+  bufPool[frameNo] = file->allocatePage(pageNo, nearPageNo);
   page = &bufPool[frameNo];
 
   // set up the entry properly
   bufDescTable[frameNo].Set(file, pageNo);
 
   // insert in the hash table
-  hashTable->insert(file, pageNo, frameNo);
+  hashTable->insert(file->id(), pageNo, frameNo);
+
+  // The file wrote the new page straight to disk.  Log it too, so that recovery doesn't
+  // bring back what the page held before it was last deleted.
+  if (log != NULL)
+  {
+  	logChanges(frameNo);
+  }
+  filesChanged = true;
 }
 
 void BufMgr::flushFile(const File* file) 
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
   for (std::uint32_t i = 0; i < numBufs; i++)
 	{
   	BufDesc* tmpbuf = &(bufDescTable[i]);
-  	if(tmpbuf->file && tmpbuf->valid == true && tmpbuf->file == file)
+  	if(tmpbuf->valid == true && tmpbuf->fileId == file->id())
 		{
 	    if (tmpbuf->pinCnt > 0)
   			throw PagePinnedException(file->filename(), tmpbuf->pageNo, tmpbuf->frameNo);
 
 	    if (tmpbuf->dirty == true)
 			{
-				//if ((status = tmpbuf->file->writePage(tmpbuf->pageNo, &(bufPool[i]))) != OK)
-				tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[i]);
-				tmpbuf->dirty = false;
+				// The frame may have been loaded through another File object for the same file.
+				tmpbuf->file = const_cast<File*>(file);
+				writeBack(i);
     	}
 
-    	hashTable->remove(file,tmpbuf->pageNo);
+    	hashTable->remove(file->id(),tmpbuf->pageNo);
     	tmpbuf->Clear();
   	}
-		else if (tmpbuf->valid == false && tmpbuf->file == file)
+		else if (tmpbuf->valid == false && tmpbuf->fileId == file->id())
   		throw BadBufferException(tmpbuf->frameNo, tmpbuf->dirty, tmpbuf->valid, tmpbuf->refbit);
   }
 }
 
+void BufMgr::syncAll()
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+  for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+  	BufDesc* tmpbuf = &(bufDescTable[i]);
+  	if (tmpbuf->valid == true && tmpbuf->dirty == true)
+		{
+			bufStats.diskwrites++;
+			writeBack(i);
+  	}
+  }
+	File::syncAll();
+	bufStats.syncs++;
+	lastSync = std::chrono::steady_clock::now();
+	checkpoint();
+}
+
+void BufMgr::writeBack(const FrameId frame)
+{
+	BufDesc* tmpbuf = &(bufDescTable[frame]);
+	if (log != NULL && tmpbuf->lastLsn != 0)
+	{
+		// Write-ahead: the page's records have to be durable before the page is written.
+		log->flush(tmpbuf->lastLsn);
+		if (!log->isDurable(tmpbuf->lastLsn))
+		{
+			throw FileIOException(log->filename(), "sync", 0);
+		}
+	}
+	tmpbuf->file->writePage(tmpbuf->pageNo, bufPool[frame]);
+	tmpbuf->dirty = false;
+	tmpbuf->firstLsn = tmpbuf->lastLsn = 0;
+}
+
+void BufMgr::logChanges(const FrameId frame)
+{
+	// Until the page is written back, recovery rebuilds it from the image in its first record.
+	BufDesc* tmpbuf = &(bufDescTable[frame]);
+	const Page* before = tmpbuf->firstLsn == 0 ? NULL : &logImages[frame];
+	const LogSequenceNumber lsn = log->logPage(tmpbuf->file, tmpbuf->pageNo, before, bufPool[frame]);
+	if (lsn != 0)
+	{
+		if (tmpbuf->firstLsn == 0)
+		{
+			tmpbuf->firstLsn = lsn;
+		}
+		tmpbuf->lastLsn = lsn;
+		logImages[frame] = bufPool[frame];
+	}
+}
+
+void BufMgr::setLog(LogMgr* logMgr)
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+	// Nothing logged the changes made so far.
+	for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+		if (bufDescTable[i].valid == true && bufDescTable[i].dirty == true)
+		{
+			bufStats.diskwrites++;
+			writeBack(i);
+		}
+		bufDescTable[i].firstLsn = bufDescTable[i].lastLsn = 0;
+	}
+	File::syncAll();
+	checkpoint();
+
+	log = logMgr;
+	if (log != NULL && logImages == NULL)
+	{
+		logImages = new Page[numBufs];
+	}
+}
+
+void BufMgr::checkpoint()
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+	if (log == NULL)
+	{
+		return;
+	}
+	// Pages written back so far have to be on disk before the log stops covering them.
+	File::syncAll();
+	LogSequenceNumber redoLsn = log->endLsn();
+	for (std::uint32_t i = 0; i < numBufs; i++)
+	{
+		BufDesc* tmpbuf = &(bufDescTable[i]);
+		if (tmpbuf->valid == true && tmpbuf->dirty == true && tmpbuf->firstLsn != 0)
+		{
+			redoLsn = std::min(redoLsn, tmpbuf->firstLsn);
+		}
+		else
+		{
+			// A clean page that was logged, e.g. a new one, is now synced as it is.
+			tmpbuf->firstLsn = tmpbuf->lastLsn = 0;
+		}
+	}
+	log->checkpoint(redoLsn);
+}
+
+void BufMgr::commit()
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+	if (log != NULL)
+	{
+		log->flush();
+		if (filesChanged)
+		{
+			File::syncAll();
+			bufStats.syncs++;
+			filesChanged = false;
+		}
+		if (log->checkpointDue())
+		{
+			checkpoint();
+		}
+	}
+	else if (durability == DURABILITY_COMMIT)
+	{
+		syncAll();
+	}
+	else
+	{
+		syncIfDue();
+	}
+}
+
+void BufMgr::setDurability(const DurabilityLevel level,
+                           const std::chrono::milliseconds interval)
+{
+  std::lock_guard<std::recursive_mutex> guard(latch);
+	durability = level;
+	syncInterval = interval;
+	lastSync = std::chrono::steady_clock::now();
+}
+
+void BufMgr::syncIfDue()
+{
+	if (log == NULL && durability == DURABILITY_PERIODIC &&
+	    std::chrono::steady_clock::now() - lastSync >= syncInterval)
+	{
+		syncAll();
+	}
+}
+
 void BufMgr::disposePage(File* file, const PageId pageNo)
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
 	//Deallocate from file altogether
   //See if it is in the buffer pool
   FrameId frameNo = 0;
-  hashTable->lookup(file, pageNo, frameNo);
+  hashTable->lookup(file->id(), pageNo, frameNo);
 
 	// clear the page
 	bufDescTable[frameNo].Clear();
 
-	hashTable->remove(file, pageNo);
+	hashTable->remove(file->id(), pageNo);
 
   // deallocate it in the file	
   file->deletePage(pageNo);
+  filesChanged = true;
 }
 
 void BufMgr::printSelf(void) 
 {
+  std::lock_guard<std::recursive_mutex> guard(latch);
   BufDesc* tmpbuf;
 	int validFrames = 0;
   
@@ -9,10 +9,23 @@
 
 #include "file.h"
 #include "bufHashTbl.h"
+#include "log.h"
+#include <chrono>
+#include <mutex>
 #include <iostream>
 
 namespace badgerdb {
 
+/**
+* @brief How hard the buffer manager works to make written pages durable.
+*/
+enum DurabilityLevel
+{
+	DURABILITY_NONE,			/* Pages reach the OS when written back; never synced */
+	DURABILITY_PERIODIC,	/* All written files are synced once per sync interval */
+	DURABILITY_COMMIT			/* All dirty pages are written and synced on every commit() */
+};
+
 /**
 * forward declaration of BufMgr class 
 */
@@ -27,10 +40,16 @@ class BufDesc {
 
  private:
 	/**
-   * Pointer to file to which corresponding frame is assigned
+   * Pointer to file to which corresponding frame is assigned.  This is the File object the page
+   * was last used through; any other File object for the same file may have loaded it
 	 */
   File* file;
 
+	/**
+   * FileCatalog id of the file, which identifies the page no matter which File object is used
+	 */
+  FileId fileId;
+
 	/**
    * Page within file to which corresponding frame is assigned
 	 */
@@ -61,6 +80,16 @@ class BufDesc {
 	 */
   bool refbit;
 
+	/**
+   * Log record of the first change to the page since it was read or written back, or 0
+	 */
+  LogSequenceNumber firstLsn;
+
+	/**
+   * Log record of the last change to the page, or 0.  It must be durable before the page is written back
+	 */
+  LogSequenceNumber lastLsn;
+
 	/**
    * Initialize buffer frame for a new user
 	 */
@@ -68,10 +97,12 @@ class BufDesc {
 	{
     pinCnt = 0;
 		file = NULL;
+		fileId = FileCatalog::INVALID_ID;
 		pageNo = Page::INVALID_NUMBER;
     dirty = false;
     refbit = false;
 		valid = false;
+		firstLsn = lastLsn = 0;
   };
 
 	/**
@@ -84,18 +115,20 @@ class BufDesc {
   void Set(File* filePtr, PageId pageNum)
 	{ 
 		file = filePtr;
+		fileId = filePtr->id();
     pageNo = pageNum;
     pinCnt = 1;
     dirty = false;
     valid = true;
     refbit = true;
+		firstLsn = lastLsn = 0;
   }
 
   void Print()
 	{
 		if(file != NULL)
 		{
-			std::cout << "file:" << file->filename() << " ";
+			std::cout << "file:" << FileCatalog::filename(fileId) << " ";
 			std::cout << "pageNo:" << pageNo << " ";
 		}
 		else
@@ -137,12 +170,17 @@ struct BufStats
 	 */
   int diskwrites;
 
+	/**
+   * Number of times dirty pages were synced to stable storage
+	 */
+  int syncs;
+
 	/**
    * Clear all values 
 	 */
   void clear()
   {
-		accesses = diskreads = diskwrites = 0;
+		accesses = diskreads = diskwrites = syncs = 0;
   }
       
 	/**
@@ -186,6 +224,49 @@ class BufMgr
 	 */
   BufStats bufStats;
 
+	/**
+   * Durability level requested through setDurability()
+	 */
+  DurabilityLevel durability;
+
+	/**
+   * Time between syncs when durability is DURABILITY_PERIODIC
+	 */
+  std::chrono::milliseconds syncInterval;
+
+	/**
+   * Time of the last call to syncAll()
+	 */
+  std::chrono::steady_clock::time_point lastSync;
+
+	/**
+   * Log that changes to pages are written to, or NULL
+	 */
+  LogMgr* log;
+
+	/**
+   * Each frame's page as of its last log record, which the next record only holds the changes from
+	 */
+  Page* logImages;
+
+	/**
+   * Whether a page was allocated or deleted since the last commit.  These changes aren't logged,
+	 * so the files have to be synced on commit instead
+	 */
+  bool filesChanged;
+
+	/**
+   * Taken by every public method, so that threads can share the buffer pool.  It is held
+	 * during file I/O too, since File objects for the same file share one stream.  Recursive
+	 * because public methods call each other, e.g. commit() calls syncAll()
+	 */
+  std::recursive_mutex latch;
+
+	/**
+   * Calls syncAll() if durability is DURABILITY_PERIODIC and the sync interval has elapsed.
+	 */
+  void syncIfDue();
+
 	/**
    * Advance clock to next frame in the buffer pool
 	 */
@@ -202,6 +283,20 @@ class BufMgr
 	 */
   void allocBuf(FrameId & frame);
 
+	/**
+	 * Writes a dirty frame back to its file, making its log records durable first.
+	 *
+	 * @param frame   	Frame to write back
+	 */
+  void writeBack(const FrameId frame);
+
+	/**
+	 * Logs the changes made to a frame's page since its last log record.
+	 *
+	 * @param frame   	Frame whose page changed
+	 */
+  void logChanges(const FrameId frame);
+
  public:
 	/**
    * Actual buffer pool from which frames are allocated
@@ -214,10 +309,20 @@ class BufMgr
   BufMgr(std::uint32_t bufs);
 	
 	/**
-   * Destructor of BufMgr class
+   * Destructor of BufMgr class.  Calls close(), but can't report its errors; call close()
+   * first to find out whether the dirty pages reached the disk.
 	 */
   ~BufMgr();
 
+	/**
+	 * Writes out every dirty page in the buffer pool, syncs the written files unless durability
+	 * is DURABILITY_NONE and no log is in use, and takes a checkpoint, so the log can start over.
+	 * Pages stay resident, so the buffer manager can still be used afterwards.
+	 *
+	 * @throws FileIOException If a page, the log or a file can't be written or synced
+	 */
+  void close();
+
 	/**
 	 * Reads the given page from the file into a frame and returns the pointer to page.
 	 * If the requested page is already present in the buffer pool pointer to that frame is returned
@@ -229,6 +334,18 @@ class BufMgr
 	 */
   void readPage(File* file, const PageId PageNo, Page*& page);
 
+	/**
+	 * Returns a page of a memory-mapped file straight from the mapping.  The page is neither copied
+	 * into a frame nor pinned, so it must not be unpinned, and it stays valid while the file is open.
+	 * Once the OS has the file cached this costs no system calls.
+	 *
+	 * @param file   	File object, opened read-only
+	 * @param PageNo  Page number in the file to be read
+	 * @param page  	Reference to page pointer. Set to the page inside the mapping.
+	 * @throws  FileNotMappedException If the file isn't memory-mapped
+	 */
+  void readMappedPage(File* file, const PageId PageNo, const Page*& page);
+
 	/**
 	 * Unpin a page from memory since it is no longer required for it to remain in memory.
 	 *
@@ -246,11 +363,13 @@ class BufMgr
 	 * @param file   	File object
 	 * @param PageNo  Page number. The number assigned to the page in the file is returned via this reference.
 	 * @param page  	Reference to page pointer. The newly allocated in-memory Page object is returned via this reference.
+	 * @param nearPageNo  Page the new page should be placed close to in the file, if the file supports it.
 	 */
-  void allocPage(File* file, PageId &PageNo, Page*& page); 
+  void allocPage(File* file, PageId &PageNo, Page*& page, const PageId nearPageNo = Page::INVALID_NUMBER); 
 
 	/**
-	 * Writes out all dirty pages of the file to disk.
+	 * Writes out all dirty pages of the file to disk, whichever File object for the file they were
+	 * read through.
 	 * All the frames assigned to the file need to be unpinned from buffer pool before this function can be successfully called.
 	 * Otherwise Error returned.
 	 *
@@ -260,6 +379,52 @@ class BufMgr
 	 */
   void flushFile(const File* file);
 
+	/**
+	 * Writes out every dirty page in the buffer pool, leaving the pages resident, and then
+	 * syncs every file written to since the last sync.  Files are synced once each no matter
+	 * how many of their pages were written, so the cost of durability is batched.
+	 *
+	 * @throws FileIOException If a file can't be synced
+	 */
+  void syncAll();
+
+	/**
+	 * Marks a commit boundary.  With a log, or with DURABILITY_COMMIT, all changes made so far
+	 * are durable when this returns; with DURABILITY_PERIODIC they are synced if the sync
+	 * interval has elapsed.
+	 *
+	 * @throws FileIOException If the log or a file can't be made durable
+	 */
+  void commit();
+
+	/**
+	 * Starts logging every change to a page in the buffer pool to the given log.  Dirty pages
+	 * are then written back lazily: commit() only makes the log durable, and pages are written
+	 * back when their frames are needed, at checkpoints or when the file is flushed.  The
+	 * durability level is ignored while a log is in use.  Pages dirtied before are written back
+	 * and synced first.
+	 *
+	 * @param logMgr   	Log to use, or NULL to stop logging
+	 */
+  void setLog(LogMgr* logMgr);
+
+	/**
+	 * Takes a fuzzy checkpoint: syncs the files pages were written back to and records in the
+	 * log that recovery can start at the oldest change still only in the buffer pool.  No dirty
+	 * page is written back.  Does nothing without a log; commit() calls it once enough has
+	 * been logged.
+	 */
+  void checkpoint();
+
+	/**
+	 * Sets how the buffer manager makes written pages durable.  Defaults to DURABILITY_NONE.
+	 *
+	 * @param level   	Durability level
+	 * @param interval	Time between syncs for DURABILITY_PERIODIC
+	 */
+  void setDurability(const DurabilityLevel level,
+                     const std::chrono::milliseconds interval = std::chrono::milliseconds(1000));
+
 	/**
 	 * Delete page from file and also from buffer pool if present.
 	 * Since the page is entirely deleted from file, its unnecessary to see if the page is dirty.
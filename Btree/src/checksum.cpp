@@ -0,0 +1,242 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "checksum.h"
+
+#include <cassert>
+#include <cstring>
+#include "page.h"
+
+#if defined(__aarch64__) && defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Reflected CRC32C (Castagnoli) polynomial.
+ */
+const std::uint32_t POLYNOMIAL = 0x82F63B78;
+
+typedef std::uint32_t (*CrcFunction)(std::uint32_t, const unsigned char*,
+                                     std::size_t);
+
+/**
+ * Extends the raw (not inverted) checksum of each lane with length bytes.
+ */
+typedef void (*LanesFunction)(std::uint32_t*, const unsigned char**,
+                              std::size_t);
+
+std::uint32_t crc32cTable(std::uint32_t crc, const unsigned char* data,
+                          std::size_t length) {
+  static std::uint32_t table[256];
+  static bool table_built = false;
+  if (!table_built) {
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t entry = i;
+      for (int bit = 0; bit < 8; ++bit) {
+        entry = (entry >> 1) ^ (entry & 1 ? POLYNOMIAL : 0);
+      }
+      table[i] = entry;
+    }
+    table_built = true;
+  }
+  for (; length > 0; --length, ++data) {
+    crc = table[(crc ^ *data) & 0xFF] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+void crc32cLanesTable(std::uint32_t* crcs, const unsigned char** data,
+                      std::size_t length) {
+  for (std::size_t lane = 0; lane < Checksum::LANES; ++lane) {
+    crcs[lane] = crc32cTable(crcs[lane], data[lane], length);
+  }
+}
+
+#if defined(__x86_64__)
+
+__attribute__((target("sse4.2")))
+std::uint32_t crc32cHardware(std::uint32_t crc, const unsigned char* data,
+                             std::size_t length) {
+  std::uint64_t crc64 = crc;
+  for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc64 = __builtin_ia32_crc32di(crc64, word);
+    data += sizeof(word);
+  }
+  crc = static_cast<std::uint32_t>(crc64);
+  for (; length > 0; --length, ++data) {
+    crc = __builtin_ia32_crc32qi(crc, *data);
+  }
+  return crc;
+}
+
+// The build doesn't optimize, and this loop is nearly all the time spent
+// checksumming a page.
+__attribute__((target("sse4.2"), optimize("O2")))
+void crc32cLanesHardware(std::uint32_t* crcs, const unsigned char** data,
+                         std::size_t length) {
+  // Each instruction depends on the last one of its own lane only.
+  std::uint64_t crc0 = crcs[0], crc1 = crcs[1], crc2 = crcs[2], crc3 = crcs[3];
+  for (std::size_t i = 0; i + sizeof(std::uint64_t) <= length;
+       i += sizeof(std::uint64_t)) {
+    std::uint64_t words[Checksum::LANES];
+    memcpy(&words[0], data[0] + i, sizeof(std::uint64_t));
+    memcpy(&words[1], data[1] + i, sizeof(std::uint64_t));
+    memcpy(&words[2], data[2] + i, sizeof(std::uint64_t));
+    memcpy(&words[3], data[3] + i, sizeof(std::uint64_t));
+    crc0 = __builtin_ia32_crc32di(crc0, words[0]);
+    crc1 = __builtin_ia32_crc32di(crc1, words[1]);
+    crc2 = __builtin_ia32_crc32di(crc2, words[2]);
+    crc3 = __builtin_ia32_crc32di(crc3, words[3]);
+  }
+  crcs[0] = crc0;
+  crcs[1] = crc1;
+  crcs[2] = crc2;
+  crcs[3] = crc3;
+  const std::size_t done = length / sizeof(std::uint64_t) * sizeof(std::uint64_t);
+  for (std::size_t lane = 0; lane < Checksum::LANES; ++lane) {
+    crcs[lane] = crc32cHardware(crcs[lane], data[lane] + done, length - done);
+  }
+}
+
+bool hasHardwareCrc() {
+  return __builtin_cpu_supports("sse4.2");
+}
+
+#elif defined(__aarch64__) && defined(__linux__)
+
+__attribute__((target("+crc")))
+std::uint32_t crc32cHardware(std::uint32_t crc, const unsigned char* data,
+                             std::size_t length) {
+  for (; length >= sizeof(std::uint64_t); length -= sizeof(std::uint64_t)) {
+    std::uint64_t word;
+    memcpy(&word, data, sizeof(word));
+    crc = __builtin_aarch64_crc32cx(crc, word);
+    data += sizeof(word);
+  }
+  for (; length > 0; --length, ++data) {
+    crc = __builtin_aarch64_crc32cb(crc, *data);
+  }
+  return crc;
+}
+
+// The build doesn't optimize, and this loop is nearly all the time spent
+// checksumming a page.
+__attribute__((target("+crc"), optimize("O2")))
+void crc32cLanesHardware(std::uint32_t* crcs, const unsigned char** data,
+                         std::size_t length) {
+  // Each instruction depends on the last one of its own lane only.
+  std::uint32_t crc0 = crcs[0], crc1 = crcs[1], crc2 = crcs[2], crc3 = crcs[3];
+  for (std::size_t i = 0; i + sizeof(std::uint64_t) <= length;
+       i += sizeof(std::uint64_t)) {
+    std::uint64_t words[Checksum::LANES];
+    memcpy(&words[0], data[0] + i, sizeof(std::uint64_t));
+    memcpy(&words[1], data[1] + i, sizeof(std::uint64_t));
+    memcpy(&words[2], data[2] + i, sizeof(std::uint64_t));
+    memcpy(&words[3], data[3] + i, sizeof(std::uint64_t));
+    crc0 = __builtin_aarch64_crc32cx(crc0, words[0]);
+    crc1 = __builtin_aarch64_crc32cx(crc1, words[1]);
+    crc2 = __builtin_aarch64_crc32cx(crc2, words[2]);
+    crc3 = __builtin_aarch64_crc32cx(crc3, words[3]);
+  }
+  crcs[0] = crc0;
+  crcs[1] = crc1;
+  crcs[2] = crc2;
+  crcs[3] = crc3;
+  const std::size_t done = length / sizeof(std::uint64_t) * sizeof(std::uint64_t);
+  for (std::size_t lane = 0; lane < Checksum::LANES; ++lane) {
+    crcs[lane] = crc32cHardware(crcs[lane], data[lane] + done, length - done);
+  }
+}
+
+bool hasHardwareCrc() {
+  return (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+}
+
+#else
+
+std::uint32_t crc32cHardware(std::uint32_t crc, const unsigned char* data,
+                             std::size_t length) {
+  return crc32cTable(crc, data, length);
+}
+
+void crc32cLanesHardware(std::uint32_t* crcs, const unsigned char** data,
+                         std::size_t length) {
+  crc32cLanesTable(crcs, data, length);
+}
+
+bool hasHardwareCrc() {
+  return false;
+}
+
+#endif
+
+CrcFunction crcFunction() {
+  static const CrcFunction function =
+      hasHardwareCrc() ? crc32cHardware : crc32cTable;
+  return function;
+}
+
+LanesFunction lanesFunction() {
+  static const LanesFunction function =
+      hasHardwareCrc() ? crc32cLanesHardware : crc32cLanesTable;
+  return function;
+}
+
+}
+
+std::uint32_t Checksum::crc32c(const std::uint32_t crc, const void* data,
+                               const std::size_t length) {
+  return ~crcFunction()(~crc, static_cast<const unsigned char*>(data), length);
+}
+
+std::uint32_t Checksum::page(const void* page,
+                             const std::size_t ignore_offset,
+                             const std::size_t ignore_length) {
+  const std::size_t lane_size = Page::SIZE / LANES;
+  const unsigned char* bytes = static_cast<const unsigned char*>(page);
+  const unsigned char zeros[sizeof(std::uint64_t)] = {0};
+  assert(ignore_offset + ignore_length <= lane_size);
+  assert(ignore_length <= sizeof(zeros));
+
+  // The first lane starts with the bytes up to the end of the ignored range.
+  // The other lanes start at the same distance into their part and wrap
+  // around to those bytes at the end, so all lanes run in step.
+  const std::size_t skip = ignore_length > 0 ? ignore_offset + ignore_length : 0;
+  std::uint32_t first = 0;
+  if (ignore_length > 0) {
+    first = crc32c(crc32c(0, bytes, ignore_offset), zeros, ignore_length);
+  }
+
+  // Lanes hold raw checksums, which are the inverse of finished ones.
+  std::uint32_t crcs[LANES];
+  const unsigned char* data[LANES];
+  for (std::size_t lane = 0; lane < LANES; ++lane) {
+    crcs[lane] = lane == 0 ? ~first : ~0U;
+    data[lane] = bytes + lane * lane_size + skip;
+  }
+  lanesFunction()(crcs, data, lane_size - skip);
+  for (std::size_t lane = 0; lane < LANES; ++lane) {
+    if (lane > 0) {
+      crcs[lane] = crcFunction()(crcs[lane], bytes + lane * lane_size, skip);
+    }
+    crcs[lane] = ~crcs[lane];
+  }
+  return crc32c(0, crcs, sizeof(crcs));
+}
+
+bool Checksum::isHardwareAccelerated() {
+  return crcFunction() == crc32cHardware && hasHardwareCrc();
+}
+
+}
@@ -0,0 +1,65 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+namespace badgerdb {
+
+/**
+ * @brief Computes the CRC32C checksums that files keep for their pages.
+ *
+ * Uses the CRC32 instructions of SSE4.2 or ARMv8 when the processor has them,
+ * and a table otherwise.  The choice is made once, the first time a checksum
+ * is computed.
+ */
+class Checksum
+{
+ public:
+  /**
+   * Number of parts of a page that are checksummed side by side.
+   */
+  static const std::size_t LANES = 4;
+
+  /**
+   * Extends a CRC32C checksum with more bytes.  Start with a crc of 0;
+   * checksumming two ranges one after the other gives the same result as
+   * checksumming them together.
+   *
+   * @param crc     Checksum of the bytes so far.
+   * @param data    Bytes to add.
+   * @param length  Number of bytes to add.
+   * @return  Checksum of the bytes so far followed by data.
+   */
+  static std::uint32_t crc32c(const std::uint32_t crc, const void* data,
+                              const std::size_t length);
+
+  /**
+   * Returns the checksum of a page.  The page is split into LANES equal
+   * parts whose CRC32C checksums are computed side by side, which keeps the
+   * CRC32 instructions busy, and the result is the CRC32C of those.
+   *
+   * @param page            Page::SIZE bytes.
+   * @param ignore_offset   Start of a range of bytes to checksum as zeros,
+   *                        e.g. a field that is updated in place.  Must lie
+   *                        in the first part.
+   * @param ignore_length   Length of that range.
+   * @return  Checksum of the page.
+   */
+  static std::uint32_t page(const void* page,
+                            const std::size_t ignore_offset = 0,
+                            const std::size_t ignore_length = 0);
+
+  /**
+   * Returns whether checksums are computed with CRC32 instructions.
+   */
+  static bool isHardwareAccelerated();
+};
+
+}
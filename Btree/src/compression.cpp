@@ -0,0 +1,234 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "compression.h"
+
+#include <cstdint>
+#include <cstring>
+#include "page.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Shortest match worth encoding.
+ */
+const std::size_t MIN_MATCH = 4;
+
+/**
+ * Largest distance a match offset can express.
+ */
+const std::size_t MAX_OFFSET = 0xFFFF;
+
+/**
+ * Log2 of the number of failed match searches after which the search starts
+ * skipping ahead, so incompressible stretches are passed over quickly.
+ */
+const int SKIP_TRIGGER = 5;
+
+/**
+ * Number of bits of the hash of the next MIN_MATCH bytes.
+ */
+const int HASH_BITS = 12;
+
+std::uint32_t read32(const char* data) {
+  std::uint32_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::uint64_t read64(const char* data) {
+  std::uint64_t value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+std::uint32_t hash32(const std::uint32_t value) {
+  return (value * 2654435761U) >> (32 - HASH_BITS);
+}
+
+/**
+ * Appends the bytes of a length that didn't fit in its token nibble.
+ * Returns false if out is full.
+ */
+bool writeLength(std::size_t length, char* out, std::size_t& op,
+                 const std::size_t capacity) {
+  for (; length >= 255; length -= 255) {
+    if (op >= capacity) {
+      return false;
+    }
+    out[op++] = static_cast<char>(255);
+  }
+  if (op >= capacity) {
+    return false;
+  }
+  out[op++] = static_cast<char>(length);
+  return true;
+}
+
+/**
+ * Reads the rest of a length whose token nibble was 15.  Returns false if
+ * the image ends first.
+ */
+bool readLength(const unsigned char* image, std::size_t& ip,
+                const std::size_t length, std::size_t& value) {
+  unsigned char byte;
+  do {
+    if (ip >= length) {
+      return false;
+    }
+    byte = image[ip++];
+    value += byte;
+  } while (byte == 255);
+  return true;
+}
+
+/**
+ * Appends one sequence: literals from page[anchor, anchor + num_literals),
+ * then, if match_length is non-zero, a match.  Returns false if out is full.
+ */
+bool writeSequence(const char* page, const std::size_t anchor,
+                   const std::size_t num_literals, const std::size_t offset,
+                   const std::size_t match_length, char* out, std::size_t& op,
+                   const std::size_t capacity) {
+  if (op >= capacity) {
+    return false;
+  }
+  const std::size_t token = op++;
+  const std::size_t match_code = match_length > 0 ? match_length - MIN_MATCH : 0;
+  out[token] = static_cast<char>(
+      (num_literals < 15 ? num_literals : 15) << 4 |
+      (match_code < 15 ? match_code : 15));
+
+  if (num_literals >= 15 && !writeLength(num_literals - 15, out, op, capacity)) {
+    return false;
+  }
+  if (num_literals > capacity - op) {
+    return false;
+  }
+  memcpy(out + op, page + anchor, num_literals);
+  op += num_literals;
+
+  if (match_length == 0) {
+    return true;
+  }
+  if (capacity - op < 2) {
+    return false;
+  }
+  out[op++] = static_cast<char>(offset & 0xFF);
+  out[op++] = static_cast<char>(offset >> 8);
+  return match_code < 15 || writeLength(match_code - 15, out, op, capacity);
+}
+
+}
+
+std::size_t PageCompressor::compress(const char* page, char* out,
+                                     const std::size_t capacity) {
+  // Positions plus one of the last place each hash was seen; 0 means none.
+  std::uint16_t last_seen[1 << HASH_BITS];
+  memset(last_seen, 0, sizeof(last_seen));
+
+  std::size_t op = 0;
+  std::size_t anchor = 0;
+  std::size_t ip = 0;
+  std::size_t misses = 0;
+  while (ip + MIN_MATCH <= Page::SIZE) {
+    const std::uint32_t sequence = read32(page + ip);
+    const std::uint32_t hash = hash32(sequence);
+    const std::size_t candidate = last_seen[hash];
+    last_seen[hash] = static_cast<std::uint16_t>(ip + 1);
+    if (candidate == 0 || ip - (candidate - 1) > MAX_OFFSET ||
+        read32(page + candidate - 1) != sequence) {
+      ip += 1 + (misses++ >> SKIP_TRIGGER);
+      continue;
+    }
+    misses = 0;
+
+    const std::size_t match = candidate - 1;
+    // Compare a word at a time through long runs, then finish bytewise.
+    std::size_t match_length = MIN_MATCH;
+    while (ip + match_length + sizeof(std::uint64_t) <= Page::SIZE &&
+           read64(page + match + match_length) ==
+               read64(page + ip + match_length)) {
+      match_length += sizeof(std::uint64_t);
+    }
+    while (ip + match_length < Page::SIZE &&
+           page[match + match_length] == page[ip + match_length]) {
+      ++match_length;
+    }
+    if (!writeSequence(page, anchor, ip - anchor, ip - match, match_length,
+                       out, op, capacity)) {
+      return 0;
+    }
+    ip += match_length;
+    anchor = ip;
+  }
+
+  // The last sequence is literals only.
+  if (anchor < Page::SIZE &&
+      !writeSequence(page, anchor, Page::SIZE - anchor, 0 /* offset */,
+                     0 /* match_length */, out, op, capacity)) {
+    return 0;
+  }
+  return op;
+}
+
+bool PageCompressor::decompress(const char* image, const std::size_t length,
+                                char* page) {
+  const unsigned char* in = reinterpret_cast<const unsigned char*>(image);
+  std::size_t ip = 0;
+  std::size_t op = 0;
+  while (op < Page::SIZE) {
+    if (ip >= length) {
+      return false;
+    }
+    const unsigned char token = in[ip++];
+
+    std::size_t num_literals = token >> 4;
+    if (num_literals == 15 && !readLength(in, ip, length, num_literals)) {
+      return false;
+    }
+    if (num_literals > Page::SIZE - op || num_literals > length - ip) {
+      return false;
+    }
+    memcpy(page + op, image + ip, num_literals);
+    op += num_literals;
+    ip += num_literals;
+    if (op == Page::SIZE) {
+      break;
+    }
+
+    if (length - ip < 2) {
+      return false;
+    }
+    const std::size_t offset = in[ip] | in[ip + 1] << 8;
+    ip += 2;
+    std::size_t match_length = token & 0xF;
+    if (match_length == 15 && !readLength(in, ip, length, match_length)) {
+      return false;
+    }
+    match_length += MIN_MATCH;
+    if (offset == 0 || offset > op || match_length > Page::SIZE - op) {
+      return false;
+    }
+    // Matches may overlap the bytes they produce, e.g. a run of zeros.
+    if (offset >= match_length) {
+      memcpy(page + op, page + op - offset, match_length);
+    } else if (offset == 1) {
+      memset(page + op, page[op - 1], match_length);
+    } else {
+      for (std::size_t i = 0; i < match_length; ++i) {
+        page[op + i] = page[op + i - offset];
+      }
+    }
+    op += match_length;
+  }
+  return true;
+}
+
+}
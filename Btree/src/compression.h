@@ -0,0 +1,50 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstddef>
+
+namespace badgerdb {
+
+/**
+ * @brief Compresses whole pages for files that store them compressed.
+ *
+ * Uses a small LZ77 coder in the style of the LZ4 block format: each sequence
+ * is a token byte with literal and match lengths, the literals, and a 2 byte
+ * match offset.  It does well on the long runs of zeros in partly filled
+ * index pages and decodes with nothing but byte copies.
+ */
+class PageCompressor
+{
+ public:
+  /**
+   * Compresses a page.
+   *
+   * @param page      Page::SIZE bytes to compress.
+   * @param out       Buffer for the compressed image.
+   * @param capacity  Size of out.
+   * @return  Length of the compressed image, or 0 if it doesn't fit in
+   *          capacity bytes.
+   */
+  static std::size_t compress(const char* page, char* out,
+                              const std::size_t capacity);
+
+  /**
+   * Decompresses a page.  Decoding stops once a whole page has been produced,
+   * so the image may be followed by padding.
+   *
+   * @param image   Compressed image.
+   * @param length  Number of bytes available at image.
+   * @param page    Buffer of Page::SIZE bytes for the page.
+   * @return  False if the image is malformed.
+   */
+  static bool decompress(const char* image, const std::size_t length,
+                         char* page);
+};
+
+}
@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_not_mapped_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+FileNotMappedException::FileNotMappedException(const std::string& name)
+    : BadgerDbException(""), filename_(name) {
+  std::stringstream ss;
+  ss << "File is not memory-mapped: " << filename_;
+  message_.assign(ss.str());
+}
+
+}
@@ -0,0 +1,37 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when the columns given for a PAX page
+ *        don't describe a valid layout, a record doesn't match the layout, or
+ *        a page used as a PAX page isn't one.
+ */
+class InvalidPaxLayoutException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an exception with the given reason.
+   *
+   * @param reason  What is wrong with the layout.
+   */
+  explicit InvalidPaxLayoutException(const std::string& reason);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~InvalidPaxLayoutException() throw() {}
+};
+
+}
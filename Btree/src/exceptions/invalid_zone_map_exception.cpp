@@ -0,0 +1,22 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "invalid_zone_map_exception.h"
+
+#include <sstream>
+#include <string>
+
+namespace badgerdb {
+
+InvalidZoneMapException::InvalidZoneMapException(const std::string& reason)
+    : BadgerDbException("") {
+  std::stringstream ss;
+  ss << "Invalid zone map: " << reason;
+  message_.assign(ss.str());
+}
+
+}
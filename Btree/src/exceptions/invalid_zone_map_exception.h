@@ -0,0 +1,36 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <string>
+
+#include "badgerdb_exception.h"
+
+namespace badgerdb {
+
+/**
+ * @brief An exception that is thrown when a zone map can't be built
+ *        or read, e.g. because its sidecar file is corrupt.
+ */
+class InvalidZoneMapException : public BadgerDbException {
+ public:
+  /**
+   * Constructs an exception with the given reason.
+   *
+   * @param reason  What is wrong with the zone map.
+   */
+  explicit InvalidZoneMapException(const std::string& reason);
+
+  /**
+   * Destroys the exception.  Does nothing special; just included to make the
+   * compiler happy.
+   */
+  virtual ~InvalidZoneMapException() throw() {}
+};
+
+}
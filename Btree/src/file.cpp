@@ -11,20 +11,88 @@
 #include <iostream>
 #include <memory>
 #include <string>
+#include <vector>
+#include <algorithm>
 #include <cstdio>
+#include <cstring>
 #include <cassert>
+#include <cerrno>
+#include <cstddef>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "exceptions/file_exists_exception.h"
 #include "exceptions/file_not_found_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/file_read_only_exception.h"
+#include "exceptions/file_not_mapped_exception.h"
 #include "exceptions/invalid_page_exception.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/file_io_exception.h"
 #include "file_iterator.h"
 #include "page.h"
+#include "compression.h"
+#include "checksum.h"
 
 namespace badgerdb {
 
-File::StreamMap File::open_streams_;
-File::CountMap File::open_counts_;
+namespace {
+
+/**
+ * Copies a file byte for byte, replacing any file of the new name.
+ */
+void copyFile(const std::string& from, const std::string& to) {
+  std::ifstream in(from, std::ios::binary);
+  if (!in) {
+    throw FileNotFoundException(from);
+  }
+  std::ofstream out(to, std::ios::binary | std::ios::trunc);
+  std::vector<char> buffer(64 * Page::SIZE);
+  while (in) {
+    in.read(&buffer[0], buffer.size());
+    out.write(&buffer[0], in.gcount());
+  }
+  if (!out.flush()) {
+    throw FileIOException(to, "write", 0);
+  }
+}
+
+/**
+ * Syncs a file or directory, including its metadata, to disk.
+ */
+void syncPath(const std::string& path) {
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    throw FileIOException(path, "open", errno);
+  }
+  if (::fsync(fd) != 0) {
+    const int error = errno;
+    ::close(fd);
+    throw FileIOException(path, "sync", error);
+  }
+  ::close(fd);
+}
+
+/**
+ * Returns the directory holding a file.
+ */
+std::string directoryOf(const std::string& path) {
+  const std::string::size_type slash = path.rfind('/');
+  if (slash == std::string::npos) {
+    return ".";
+  }
+  return slash == 0 ? "/" : path.substr(0, slash);
+}
+
+}
+
+const PageId FileState::UNKNOWN_PAGE;
+
+File::StateTable File::open_files_;
+File::IdSet File::unsynced_files_;
+FileIOStats File::io_stats_;
 
 void File::remove(const std::string& filename) {
   if (!exists(filename)) {
@@ -33,17 +101,40 @@ void File::remove(const std::string& filename) {
   if (isOpen(filename)) {
     throw FileOpenException(filename);
   }
-  std::remove(filename.c_str());
+  std::string path, segment_name;
+  if (Tablespace::splitName(filename, path, segment_name)) {
+    std::shared_ptr<Tablespace> tablespace = Tablespace::open(path);
+    SegmentId segment;
+    tablespace->findSegment(segment_name, segment);
+    tablespace->dropSegment(segment);
+  } else {
+    std::remove(filename.c_str());
+  }
+  FileId id;
+  if (FileCatalog::find(filename, id)) {
+    unsynced_files_.erase(id);
+    FileCatalog::retire(filename);
+  }
 }
 
 bool File::isOpen(const std::string& filename) {
   if (!exists(filename)) {
     return false;
   }
-  return open_counts_.find(filename) != open_counts_.end();
+  FileId id;
+  return FileCatalog::find(filename, id) && id < open_files_.size() &&
+         open_files_[id];
 }
 
 bool File::exists(const std::string& filename) {
+	std::string path, segment_name;
+	if (Tablespace::splitName(filename, path, segment_name))
+	{
+		SegmentId segment;
+		return exists(path) &&
+		       Tablespace::open(path)->findSegment(segment_name, segment);
+	}
+
 	std::fstream file(filename);
 	if(file)
 	{
@@ -64,23 +155,63 @@ PageId File::getFirstPageNo() {
   return header.first_used_page;
 }
 
-File::File(const std::string& name, const bool create_new) : filename_(name) {
+File::File(const std::string& name, const bool create_new,
+           const bool read_only)
+: filename_(name), read_only_(read_only) {
+  assert(!(create_new && read_only));
   openIfNeeded(create_new);
 
   if (create_new) {
     // File starts with 1 page (the header).
     FileHeader header = {1 /* num_pages */, 0 /* first_used_page */,
-                         0 /* num_free_pages */, 0 /* first_free_page */};
+                         0 /* num_free_pages */, 0 /* first_free_page */,
+                         0 /* last_used_page */, FileHeader::MAGIC,
+                         FileHeader::VERSION, 0 /* flags */};
     writeHeader(header);
   }
 }
 
 void File::openIfNeeded(const bool create_new) {
-  if (open_counts_.find(filename_) != open_counts_.end()) {	//exists an entry already
-    ++open_counts_[filename_];
-    stream_ = open_streams_[filename_];
+  id_ = FileCatalog::idOf(filename_);
+  std::string path, segment_name;
+  if (id_ < open_files_.size() && open_files_[id_]) {	//exists an entry already
+    state_ = open_files_[id_];
+    ++state_->open_count;
+    stream_ = state_->stream;
+    if (state_->read_only && !read_only_ && state_->tablespace) {
+      // Tablespaces are always opened for writing.
+      state_->read_only = false;
+    } else if (state_->read_only && !read_only_) {
+      // Everyone so far only read the file; reopen the shared stream so that
+      // this object can write it too.
+      stream_->close();
+      stream_->open(filename_,
+                    std::fstream::in | std::fstream::out | std::fstream::binary);
+      state_->read_only = false;
+    }
+  } else if (Tablespace::splitName(filename_, path, segment_name)) {
+    if (!create_new && !exists(path)) {
+      throw FileNotFoundException(filename_);
+    }
+    // Every segment of the tablespace shares its descriptor.
+    std::shared_ptr<Tablespace> tablespace = Tablespace::open(path);
+    SegmentId segment;
+    const bool already_exists = tablespace->findSegment(segment_name, segment);
+    if (create_new && already_exists) {
+      throw FileExistsException(filename_);
+    } else if (!create_new && !already_exists) {
+      throw FileNotFoundException(filename_);
+    }
+    if (create_new) {
+      segment = tablespace->createSegment(segment_name);
+    }
+    state_.reset(new FileState());
+    state_->tablespace = tablespace;
+    state_->segment = segment;
+    openState(create_new);
   } else {
-    std::ios_base::openmode mode =
+    std::ios_base::openmode mode = read_only_ ?
+        std::fstream::in | std::fstream::binary :
         std::fstream::in | std::fstream::out | std::fstream::binary;
     const bool already_exists = exists(filename_);
     if (create_new) {
@@ -96,36 +227,575 @@ void File::openIfNeeded(const bool create_new) {
         throw FileNotFoundException(filename_);
       }
     }
-    stream_.reset(new std::fstream(filename_, mode));
-    open_streams_[filename_] = stream_;
-    open_counts_[filename_] = 1;
+    state_.reset(new FileState());
+    state_->stream.reset(new std::fstream(filename_, mode));
+    stream_ = state_->stream;
+    openState(create_new);
+  }
+  if (read_only_) {
+    mapIfNeeded();
+  }
+}
+
+void File::openState(const bool create_new) {
+  state_->open_count = 1;
+  state_->read_only = read_only_;
+  if (id_ >= open_files_.size()) {
+    open_files_.resize(FileCatalog::endId());
+  }
+  open_files_[id_] = state_;
+  if (!create_new) {
+    // Everything else is loaded the first time it is needed.
+    readBytes(0 /* pos */, &state_->header, sizeof(FileHeader));
+  }
+}
+
+void File::mapIfNeeded() {
+  // Segments of a tablespace are scattered over its extents, so they are
+  // always read through the tablespace.
+  if (state_->mapping != NULL || state_->tablespace) {
+    return;
+  }
+  // Anything another File object wrote has to reach the file first.
+  stream_->flush();
+  const int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) == 0 && file_stat.st_size > 0) {
+    void* mapping = ::mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED,
+                           fd, 0 /* offset */);
+    if (mapping != MAP_FAILED) {
+      state_->mapping = static_cast<const char*>(mapping);
+      state_->mapping_length = file_stat.st_size;
+      // Read-only files are mostly index files probed one page at a time.
+      state_->mapping_advice = MADV_RANDOM;
+      ::madvise(mapping, state_->mapping_length, state_->mapping_advice);
+    }
   }
+  // The mapping keeps its own reference to the file.
+  ::close(fd);
+}
+
+void File::extendMapping() const {
+  stream_->flush();
+  const int fd = ::open(filename_.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) == 0 &&
+      static_cast<std::size_t>(file_stat.st_size) > state_->mapping_length) {
+    void* mapping = ::mmap(NULL, file_stat.st_size, PROT_READ, MAP_SHARED,
+                           fd, 0 /* offset */);
+    if (mapping != MAP_FAILED) {
+      // Callers may still hold pages of the old mapping.
+      state_->old_mappings.push_back(
+          std::make_pair(state_->mapping, state_->mapping_length));
+      state_->mapping = static_cast<const char*>(mapping);
+      state_->mapping_length = file_stat.st_size;
+      ::madvise(mapping, state_->mapping_length, state_->mapping_advice);
+    }
+  }
+  ::close(fd);
+}
+
+void File::adviseAccess(const AccessPattern pattern) {
+  if (state_->mapping == NULL) {
+    return;
+  }
+  int advice = MADV_NORMAL;
+  if (pattern == ACCESS_RANDOM) {
+    advice = MADV_RANDOM;
+  } else if (pattern == ACCESS_SEQUENTIAL) {
+    advice = MADV_SEQUENTIAL;
+  }
+  state_->mapping_advice = advice;
+  ::madvise(const_cast<char*>(state_->mapping), state_->mapping_length,
+            advice);
 }
 
 void File::close() {
-	if(open_counts_[filename_] > 0)
-  	--open_counts_[filename_];
+  if (!state_) {
+    return;
+  }
+  --state_->open_count;
+  assert(state_->open_count >= 0);
 
+  if (state_->open_count == 0) {
+    if (state_->mapping != NULL) {
+      ::munmap(const_cast<char*>(state_->mapping), state_->mapping_length);
+    }
+    for (std::size_t i = 0; i < state_->old_mappings.size(); ++i) {
+      ::munmap(const_cast<char*>(state_->old_mappings[i].first),
+               state_->old_mappings[i].second);
+    }
+    open_files_[id_].reset();
+  }
+  state_.reset();
   stream_.reset();
-	assert(open_counts_[filename_] >= 0);
+}
 
-  if (open_counts_[filename_] == 0) {
-    open_streams_.erase(filename_);
-    open_counts_.erase(filename_);
+void File::writeHeader(const FileHeader& header) {
+  state_->header = header;
+  writeBytes(0 /* pos */, &header, sizeof(FileHeader));
+}
+
+void File::readBytes(const std::streampos position, void* data,
+                     const std::size_t length) const {
+  const std::streamoff offset = position;
+  if (state_->mapping != NULL &&
+      static_cast<std::size_t>(offset) + length <= state_->mapping_length) {
+    memcpy(data, state_->mapping + offset, length);
+    ++io_stats_.mappedreads;
+    return;
+  }
+  if (state_->tablespace) {
+    state_->tablespace->read(state_->segment, offset, data, length);
+    ++io_stats_.reads;
+    io_stats_.bytesread += length;
+    return;
+  }
+  stream_->seekg(position, std::ios::beg);
+  stream_->read(static_cast<char*>(data), length);
+  const std::size_t num_read = stream_->gcount();
+  if (num_read < length) {
+    // Reading past the end of the file, e.g. a legacy header or the metadata
+    // slot of a group that hasn't been written yet.
+    memset(static_cast<char*>(data) + num_read, 0, length - num_read);
+    stream_->clear();
   }
+  ++io_stats_.reads;
+  io_stats_.bytesread += length;
 }
 
-FileHeader File::readHeader() const {
-  FileHeader header;
-  stream_->seekg(0 /* pos */, std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(FileHeader));
-  return header;
+void File::writeBytes(const std::streampos position, const void* data,
+                      const std::size_t length) {
+  checkWritable();
+  if (state_->tablespace) {
+    state_->tablespace->write(state_->segment,
+                              static_cast<std::streamoff>(position), data,
+                              length);
+  } else {
+    stream_->seekp(position, std::ios::beg);
+    stream_->write(static_cast<const char*>(data), length);
+    if (!*stream_) {
+      // Later reads clear the stream's state, so report the failure now
+      // rather than at the next sync.
+      stream_->clear();
+      throw FileIOException(filename_, "write", 0);
+    }
+    if (state_->mapping != NULL) {
+      // Keep the mapping in step with the stream.
+      stream_->flush();
+    }
+  }
+  ++io_stats_.writes;
+  io_stats_.byteswritten += length;
+  markUnsynced();
 }
 
-void File::writeHeader(const FileHeader& header) {
-  stream_->seekp(0 /* pos */, std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(FileHeader));
-  stream_->flush();
+const Page* File::mappedPageAt(const std::streampos position,
+                               const PageId page_number) const {
+  if (state_->mapping == NULL) {
+    throw FileNotMappedException(filename_);
+  }
+  const std::streamoff offset = position;
+  if (static_cast<std::size_t>(offset) + Page::SIZE > state_->mapping_length) {
+    // Page was appended by a writer after the file was mapped.
+    extendMapping();
+    if (static_cast<std::size_t>(offset) + Page::SIZE >
+        state_->mapping_length) {
+      throw InvalidPageException(page_number, filename_);
+    }
+  }
+  const Page* page = reinterpret_cast<const Page*>(state_->mapping + offset);
+  if (hasChecksums()) {
+    // Later reads of the page cost nothing but the memory access.
+    std::vector<bool>& verified = state_->mapped_pages_verified;
+    if (page_number >= verified.size()) {
+      verified.resize(page_number + 1, false);
+    }
+    if (!verified[page_number] && isPageUsed(page_number)) {
+      verifyChecksum(page_number, page);
+      verified[page_number] = true;
+    }
+  }
+  return page;
+}
+
+void File::checkWritable() const {
+  if (read_only_) {
+    throw FileReadOnlyException(filename_);
+  }
+}
+
+PageGroupMap& File::groupMap(const PageId group) const {
+  if (group >= state_->group_maps.size()) {
+    state_->group_maps.resize(group + 1);
+    state_->group_maps_loaded.resize(group + 1, false);
+  }
+  if (!state_->group_maps_loaded[group]) {
+    // The slot of a brand new group may not have been written yet, in which
+    // case it reads as all free.
+    readBytes(groupPosition(group), &state_->group_maps[group],
+              sizeof(PageGroupMap));
+    state_->group_maps_loaded[group] = true;
+  }
+  return state_->group_maps[group];
+}
+
+PageGroupChecksums& File::groupChecksums(const PageId group) const {
+  if (group >= state_->group_checksums.size()) {
+    state_->group_checksums.resize(group + 1);
+    state_->group_checksums_loaded.resize(group + 1, false);
+  }
+  if (!state_->group_checksums_loaded[group]) {
+    readBytes(checksumPosition(group), &state_->group_checksums[group],
+              sizeof(PageGroupChecksums));
+    state_->group_checksums_loaded[group] = true;
+  }
+  return state_->group_checksums[group];
+}
+
+std::uint32_t File::pageChecksum(const void* page_data) const {
+  return Checksum::page(page_data);
+}
+
+void File::storeChecksum(const PageId page_number, const void* page_data) {
+  if (!hasChecksums()) {
+    return;
+  }
+  const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+  const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+  std::uint32_t& checksum = groupChecksums(group).checksums[index];
+  checksum = pageChecksum(page_data);
+  writeBytes(checksumPosition(group) +
+             static_cast<std::streamoff>(index * sizeof(std::uint32_t)),
+             &checksum, sizeof(std::uint32_t));
+}
+
+void File::verifyChecksum(const PageId page_number,
+                          const void* page_data) const {
+  if (!hasChecksums()) {
+    return;
+  }
+  const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+  const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+  if (pageChecksum(page_data) != groupChecksums(group).checksums[index]) {
+    ++io_stats_.checksumsfailed;
+    throw CorruptPageException(page_number, filename_);
+  }
+  ++io_stats_.checksumsverified;
+}
+
+void File::setChecksums(const bool enabled) {
+  checkWritable();
+  if (enabled == hasChecksums()) {
+    return;
+  }
+  FileHeader header = readHeader();
+  if (enabled) {
+    // Nothing kept the stored checksums up to date while they were off, so
+    // compute them all again and write each group's slot once.
+    for (PageId group = 0;
+         group * PageGroupMap::PAGES_PER_GROUP + 1 < header.num_pages;
+         ++group) {
+      PageGroupChecksums& checksums = groupChecksums(group);
+      for (PageId index = 0; index < PageGroupMap::PAGES_PER_GROUP; ++index) {
+        const PageId page_number =
+            group * PageGroupMap::PAGES_PER_GROUP + index + 1;
+        if (page_number >= header.num_pages) {
+          break;
+        }
+        if (isPageUsed(page_number)) {
+          const Page page = readPage(page_number);
+          checksums.checksums[index] = pageChecksum(&page);
+        }
+      }
+      writeBytes(checksumPosition(group), &checksums,
+                 sizeof(PageGroupChecksums));
+    }
+    header.flags |= FileHeader::CHECKSUMS;
+  } else {
+    header.flags &= ~FileHeader::CHECKSUMS;
+  }
+  writeHeader(header);
+}
+
+bool File::isPageUsed(const PageId page_number) const {
+  return groupMap((page_number - 1) / PageGroupMap::PAGES_PER_GROUP)
+      .isUsed((page_number - 1) % PageGroupMap::PAGES_PER_GROUP);
+}
+
+void File::setPageUsed(const PageId page_number, const bool used) {
+  const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+  const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+  PageGroupMap& map = groupMap(group);
+
+  if (used) {
+    map.used[index / 8] |= 1 << (index % 8);
+  } else {
+    map.used[index / 8] &= ~(1 << (index % 8));
+  }
+  writeBytes(groupPosition(group) + static_cast<std::streamoff>(index / 8),
+             &map.used[index / 8], 1);
+}
+
+void File::reserveSpace(const std::streampos position,
+                        const std::size_t length) {
+  checkWritable();
+  if (state_->tablespace) {
+    state_->tablespace->reserve(state_->segment,
+                                static_cast<std::streamoff>(position), length);
+    return;
+  }
+  const int fd = ::open(filename_.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return;
+  }
+  // Failing to reserve is harmless; the pages are still written normally.
+#ifdef __linux__
+  ::fallocate(fd, 0 /* mode */, static_cast<std::streamoff>(position), length);
+#else
+  ::posix_fallocate(fd, static_cast<std::streamoff>(position), length);
+#endif
+  ::close(fd);
+}
+
+std::uint32_t File::upgradeFormat() {
+  const FileHeader header = readHeader();
+  if (header.magic == FileHeader::MAGIC &&
+      header.version == FileHeader::VERSION) {
+    return FileHeader::VERSION;
+  }
+  checkWritable();
+  if (state_->tablespace) {
+    const std::uint32_t old_version = convertLayout(header);
+    upgradeContents(old_version);
+    return old_version;
+  }
+
+  // Pages move around and are rewritten, so a crash part way through would
+  // leave a file in neither format.  Work on a copy instead, and only put it
+  // in the file's place once it is complete and durable.
+  const std::string copy_name = upgradeName(filename_);
+  std::uint32_t old_version;
+  try {
+    copyFile(filename_, copy_name);
+    reopenStream(copy_name);
+    old_version = convertLayout(readHeader());
+    upgradeContents(old_version);
+    if (!stream_->flush()) {
+      stream_->clear();
+      throw FileIOException(copy_name, "write", 0);
+    }
+    syncPath(copy_name);
+    stream_->close();
+    if (::rename(copy_name.c_str(), filename_.c_str()) != 0) {
+      throw FileIOException(filename_, "rename", errno);
+    }
+  } catch (...) {
+    std::remove(copy_name.c_str());
+    reopenStream(filename_);
+    throw;
+  }
+  // The rename only survives a crash once the directory is synced too.
+  syncPath(directoryOf(filename_));
+  reopenStream(filename_);
+  return old_version;
+}
+
+void File::reopenStream(const std::string& filename) {
+  stream_->close();
+  stream_->clear();
+  stream_->open(filename,
+                std::fstream::in | std::fstream::out | std::fstream::binary);
+  if (!stream_->is_open()) {
+    throw FileNotFoundException(filename);
+  }
+  state_->group_maps.clear();
+  state_->group_maps_loaded.clear();
+  state_->next_page_numbers.clear();
+  state_->group_data_spaces.clear();
+  state_->group_checksums.clear();
+  state_->group_checksums_loaded.clear();
+  readBytes(0 /* pos */, &state_->header, sizeof(FileHeader));
+}
+
+std::uint32_t File::convertLayout(FileHeader header) {
+  const std::uint32_t old_version =
+      header.magic == FileHeader::MAGIC ? header.version : 0;
+  // A file that was created but never written has no header yet; the header
+  // slot still counts as a page.
+  if (header.num_pages == 0) {
+    header.num_pages = 1;
+  }
+  if (old_version >= 4) {
+    // Only the contents of slotted pages changed since, which PageFile
+    // converts itself.
+    header.version = FileHeader::VERSION;
+    writeHeader(header);
+    return old_version;
+  }
+  if (old_version >= 2) {
+    // Pages are already grouped; the groups only have to make room for their
+    // checksum slots.
+    addChecksumSlots(header);
+    header.version = FileHeader::VERSION;
+    writeHeader(header);
+    return old_version;
+  }
+  // Both older formats store the pages back to back, starting either right
+  // after a LegacyFileHeader or in the slot after the header.
+  std::streamoff first_page_position = Page::SIZE;
+  if (header.magic != FileHeader::MAGIC) {
+    LegacyFileHeader legacy;
+    readBytes(0 /* pos */, &legacy, sizeof(LegacyFileHeader));
+    header.num_pages = std::max<PageId>(legacy.num_pages, 1);
+    header.first_used_page = legacy.first_used_page;
+    header.num_free_pages = legacy.num_free_pages;
+    header.first_free_page = legacy.first_free_page;
+    // Subclasses that link their pages fix this up afterwards.
+    header.last_used_page =
+        legacy.num_pages > 1 ? legacy.num_pages - 1 : Page::INVALID_NUMBER;
+    first_page_position = sizeof(LegacyFileHeader);
+  }
+  // Neither older format had any storage options.
+  header.flags = 0;
+
+  // Every page moves towards the end of the file, so copy from the last page
+  // backwards to avoid overwriting pages that haven't been moved yet.
+  char page_data[Page::SIZE];
+  for (PageId page_number = header.num_pages - 1; page_number >= 1;
+       --page_number) {
+    readBytes(first_page_position +
+              static_cast<std::streamoff>(page_number - 1) * Page::SIZE,
+              page_data, Page::SIZE);
+    writeBytes(pagePosition(page_number), page_data, Page::SIZE);
+  }
+  // Group metadata slots now hold whatever old pages used to be there.
+  memset(page_data, 0, Page::SIZE);
+  for (PageId group = 0;
+       group * PageGroupMap::PAGES_PER_GROUP + 1 < header.num_pages; ++group) {
+    writeBytes(groupPosition(group), page_data, Page::SIZE);
+    writeBytes(checksumPosition(group), page_data, Page::SIZE);
+  }
+
+  header.magic = FileHeader::MAGIC;
+  header.version = FileHeader::VERSION;
+  writeHeader(header);
+  return old_version;
+}
+
+void File::addChecksumSlots(const FileHeader& header) {
+  // Before version 4 each group had a single metadata slot.
+  const std::streamoff old_group_size =
+      static_cast<std::streamoff>(PageGroupMap::PAGES_PER_GROUP + 1) *
+      Page::SIZE;
+  const PageId num_pages = std::max<PageId>(header.num_pages, 1);
+  const PageId num_groups = (num_pages - 1 +
+      PageGroupMap::PAGES_PER_GROUP - 1) / PageGroupMap::PAGES_PER_GROUP;
+
+  // Every group moves towards the end of the file, so start with the last
+  // one, and copy each data area from its end backwards.
+  std::vector<char> buffer(64 * Page::SIZE);
+  char slot[Page::SIZE];
+  for (PageId group = num_groups; group-- > 0; ) {
+    const std::streamoff old_position =
+        Page::SIZE + static_cast<std::streamoff>(group) * old_group_size;
+    const PageId first_page = group * PageGroupMap::PAGES_PER_GROUP + 1;
+    PageGroupMap map;
+    readBytes(old_position, &map, sizeof(PageGroupMap));
+
+    std::size_t remaining = groupDataLength(map,
+        std::min(PageId(PageGroupMap::PAGES_PER_GROUP),
+                 num_pages - first_page));
+    while (remaining > 0) {
+      const std::size_t length = std::min(remaining, buffer.size());
+      remaining -= length;
+      readBytes(old_position + Page::SIZE +
+                static_cast<std::streamoff>(remaining), &buffer[0], length);
+      writeBytes(pagePosition(first_page) +
+                 static_cast<std::streamoff>(remaining), &buffer[0], length);
+    }
+
+    memset(slot, 0, Page::SIZE);
+    memcpy(slot, &map, sizeof(PageGroupMap));
+    writeBytes(groupPosition(group), slot, Page::SIZE);
+    memset(slot, 0, Page::SIZE);
+    writeBytes(checksumPosition(group), slot, Page::SIZE);
+  }
+
+  // Anything cached was read from the old positions.
+  state_->group_maps.clear();
+  state_->group_maps_loaded.clear();
+  state_->group_data_spaces.clear();
+  state_->group_checksums.clear();
+  state_->group_checksums_loaded.clear();
+}
+
+std::size_t File::groupDataLength(const PageGroupMap& map,
+                                  const PageId num_pages) const {
+  return static_cast<std::size_t>(num_pages) * Page::SIZE;
+}
+
+Page File::allocatePage(PageId &new_page_number,
+                        const PageId near_page_number) {
+  return allocatePage(new_page_number);
+}
+
+void File::sync() {
+  syncFile(id_);
+  unsynced_files_.erase(id_);
+}
+
+int File::syncAll() {
+  int num_synced = 0;
+  // A file stays in the set until it has been synced, so a failed sync is
+  // retried by the next call.
+  while (!unsynced_files_.empty()) {
+    syncFile(*unsynced_files_.begin());
+    unsynced_files_.erase(unsynced_files_.begin());
+    ++num_synced;
+  }
+  return num_synced;
+}
+
+void File::syncFile(const FileId id) {
+  // Push anything still sitting in the stream buffer to the OS first.
+  if (id < open_files_.size() && open_files_[id]) {
+    if (open_files_[id]->tablespace) {
+      open_files_[id]->tablespace->sync();
+      return;
+    }
+    std::fstream& stream = *open_files_[id]->stream;
+    if (!stream.flush()) {
+      // Buffered writes that didn't reach the OS can't be made durable.
+      stream.clear();
+      throw FileIOException(FileCatalog::filename(id), "write", 0);
+    }
+  }
+  // Syncing any descriptor for the file flushes all of its dirty data, so the
+  // file may already have been closed by the time we get here.  A segment is
+  // synced through its tablespace file.
+  std::string path = FileCatalog::filename(id), segment_name;
+  Tablespace::splitName(FileCatalog::filename(id), path, segment_name);
+  const int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) {
+    if (errno == ENOENT) {
+      // File was removed before it was synced; nothing left to make durable.
+      return;
+    }
+    throw FileIOException(path, "open", errno);
+  }
+  if (::fdatasync(fd) != 0) {
+    const int error = errno;
+    ::close(fd);
+    throw FileIOException(path, "sync", error);
+  }
+  ::close(fd);
 }
 
 
@@ -140,16 +810,24 @@ PageFile PageFile::open(const std::string& filename) {
   return PageFile(filename, false /* create_new */);
 }
 
-PageFile::PageFile(const std::string& name, const bool create_new)
-: File(name, create_new)
+PageFile PageFile::openReadOnly(const std::string& filename) {
+  return PageFile(filename, false /* create_new */, true /* read_only */);
+}
+
+PageFile::PageFile(const std::string& name, const bool create_new,
+                   const bool read_only)
+: File(name, create_new, read_only)
 {
+  if (!create_new) {
+    upgradeFormat();
+  }
 }
 
 PageFile::~PageFile() {
 }
 
 PageFile::PageFile(const PageFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */, other.read_only_)
 {
 }
 
@@ -158,43 +836,36 @@ PageFile& PageFile::operator=(const PageFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  read_only_ = rhs.read_only_;
   openIfNeeded(false /* create_new */);
   return *this;
 }
 
 Page PageFile::allocatePage(PageId &new_page_number) {
+  checkWritable();
   FileHeader header = readHeader();
   Page new_page;
-  Page existing_page;
   if (header.num_free_pages > 0) {
-    new_page = readPage(header.first_free_page, true /* allow_free */);
-    new_page.set_page_number(header.first_free_page);
-		new_page_number = new_page.page_number();
-    header.first_free_page = new_page.next_page_number();
+    // Reuse the lowest numbered free page.
+    new_page_number = header.first_free_page;
+    new_page.set_page_number(new_page_number);
+    header.first_free_page = nextPageNumber(new_page_number);
     --header.num_free_pages;
 
-    if (header.first_used_page == Page::INVALID_NUMBER ||
-        header.first_used_page > new_page.page_number()) {
-      // Either have no pages used or the head of the used list is a page later
-      // than the one we just allocated, so add the new page to the head.
-      if (header.first_used_page > new_page.page_number()) {
-        new_page.set_next_page_number(header.first_used_page);
-      }
-      header.first_used_page = new_page.page_number();
+    // Since the free list is ordered, every page before the one we just took
+    // is in use, so the page right before it is its predecessor in the used
+    // list.
+    if (new_page_number == 1) {
+      new_page.set_next_page_number(header.first_used_page);
+      header.first_used_page = new_page_number;
     } else {
-      // New page is reused from somewhere after the beginning, so we need to
-      // find where in the used list to insert it.
-      PageId next_page_number = Page::INVALID_NUMBER;
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        next_page_number = (*iter).next_page_number();
-        if (next_page_number > new_page.page_number() ||
-            next_page_number == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      existing_page.set_next_page_number(new_page.page_number());
-      new_page.set_next_page_number(next_page_number);
+      const PageId previous_page_number = new_page_number - 1;
+      assert(isPageUsed(previous_page_number));
+      new_page.set_next_page_number(nextPageNumber(previous_page_number));
+      writeNextPageNumber(previous_page_number, new_page_number);
+    }
+    if (new_page.next_page_number() == Page::INVALID_NUMBER) {
+      header.last_used_page = new_page_number;
     }
 
     assert((header.num_free_pages == 0) ==
@@ -202,43 +873,31 @@ Page PageFile::allocatePage(PageId &new_page_number) {
   }
 	else
 	{
-    new_page.set_page_number(header.num_pages);
-		new_page_number = new_page.page_number();
+    new_page_number = header.num_pages;
+    new_page.set_page_number(new_page_number);
 
-    if (header.first_used_page == Page::INVALID_NUMBER)
+    if (header.last_used_page == Page::INVALID_NUMBER)
 		{
-      header.first_used_page = new_page.page_number();
+      header.first_used_page = new_page_number;
     }
 		else
 		{
-      // If we have pages allocated, we need to add the new page to the tail
-      // of the linked list.
-      for (FileIterator iter = begin(); iter != end(); ++iter) {
-        if ((*iter).next_page_number() == Page::INVALID_NUMBER) {
-          existing_page = *iter;
-          break;
-        }
-      }
-      assert(existing_page.isUsed());
-      existing_page.set_next_page_number(new_page.page_number());
+      // Link the new page in after the current tail of the used list.
+      writeNextPageNumber(header.last_used_page, new_page_number);
     }
+    header.last_used_page = new_page_number;
     ++header.num_pages;
   }
+  setPageUsed(new_page_number, true);
   writePage(new_page_number, new_page.header_, new_page);
-  if (existing_page.page_number() != Page::INVALID_NUMBER) {
-    // If we updated an existing page by inserting the new page into the
-    // used list, we need to write it out.
-    writePage(existing_page.page_number(), existing_page.header_, existing_page);
-  }
   writeHeader(header);
 
   return new_page;
 }
 
 Page PageFile::readPage(const PageId page_number) const {
-  FileHeader header = readHeader();
-
-	if (page_number >= header.num_pages)
+	if (page_number == Page::INVALID_NUMBER ||
+      page_number >= state_->header.num_pages)
 	{
 		throw InvalidPageException(page_number, filename_);
 	}
@@ -246,20 +905,25 @@ Page PageFile::readPage(const PageId page_number) const {
 }
 
 Page PageFile::readPage(const PageId page_number, const bool allow_free) const {
-  Page page;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&page.header_), sizeof(PageHeader));
-  stream_->read(&page.data_[0], Page::DATA_SIZE);
-  if (!allow_free && !page.isUsed()) {
+  if (!allow_free && !isPageUsed(page_number)) {
     throw InvalidPageException(page_number, filename_);
   }
+  Page page(Page::UNINITIALIZED);
+  readBytes(pagePosition(page_number), &page, Page::SIZE);
+  rememberNextPageNumber(page_number, page.next_page_number());
+  // Free pages only have their header written, so they have no checksum.
+  if (hasChecksums() && (!allow_free || isPageUsed(page_number))) {
+    verifyChecksum(page_number, &page);
+  }
 
   return page;
 }
 
 void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
-	PageHeader header = readPageHeader(new_page_number);
-	if (header.current_page_number == Page::INVALID_NUMBER)
+	checkWritable();
+	if (new_page_number == Page::INVALID_NUMBER ||
+      new_page_number >= state_->header.num_pages ||
+      !isPageUsed(new_page_number))
 	{
 		// Page has been deleted since it was read.
 		throw InvalidPageException(new_page_number, filename_);
@@ -267,43 +931,66 @@ void PageFile::writePage(const PageId new_page_number, const Page& new_page) {
 	// Page on disk may have had its next page pointer updated since it was read;
 	// we don't modify that, but we do keep all the other modifications to the
 	// page header.
-	const PageId next_page_number = header.next_page_number;
-	header = new_page.header_;
-	header.next_page_number = next_page_number;
+	PageHeader header = new_page.header_;
+	header.next_page_number = nextPageNumber(new_page_number);
 	writePage(new_page_number, header, new_page);
 }
 
 void PageFile::deletePage(const PageId page_number) {
+  checkWritable();
   FileHeader header = readHeader();
 
-  Page existing_page = readPage(page_number);
-  Page previous_page;
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= header.num_pages || !isPageUsed(page_number)) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  const PageId next_page_number = nextPageNumber(page_number);
   // If this page is the head of the used list, update the header to point to
-  // the next page in line.
+  // the next page in line.  Otherwise the used list is in page number order,
+  // so its predecessor is the closest used page before it in the bitmap.
+  PageId previous_page_number = Page::INVALID_NUMBER;
   if (page_number == header.first_used_page) {
-    header.first_used_page = existing_page.next_page_number();
+    header.first_used_page = next_page_number;
   } else {
-    // Walk the used list so we can update the page that points to this one.
-    for (FileIterator iter = begin(); iter != end(); ++iter) {
-      previous_page = *iter;
-      if (previous_page.next_page_number() == existing_page.page_number()) {
-        previous_page.set_next_page_number(existing_page.next_page_number());
-        break;
-      }
-    }
+    previous_page_number = findPreviousPage(page_number, true /* used */);
+    assert(nextPageNumber(previous_page_number) == page_number);
+    writeNextPageNumber(previous_page_number, next_page_number);
   }
-  // Clear the page and add it to the head of the free list.
-  existing_page.initialize();
-  existing_page.set_next_page_number(header.first_free_page);
-  header.first_free_page = page_number;
-  ++header.num_free_pages;
-  if (previous_page.isUsed()) {
-    writePage(previous_page.page_number(), previous_page.header_, previous_page);
+  if (header.last_used_page == page_number) {
+    header.last_used_page = previous_page_number;
+  }
+  setPageUsed(page_number, false);
+
+  // Insert the page into the free list, which is kept in ascending page
+  // number order.  Only the header is cleared; the data is overwritten when
+  // the page is allocated again.
+  PageHeader free_header = Page::emptyHeader();
+  if (header.first_free_page == Page::INVALID_NUMBER ||
+      page_number < header.first_free_page) {
+    free_header.next_page_number = header.first_free_page;
+    header.first_free_page = page_number;
+  } else {
+    const PageId previous_free_number =
+        findPreviousPage(page_number, false /* used */);
+    free_header.next_page_number = nextPageNumber(previous_free_number);
+    writeNextPageNumber(previous_free_number, page_number);
   }
-  writePage(page_number, existing_page.header_, existing_page);
+  ++header.num_free_pages;
+  writePageHeader(page_number, free_header);
   writeHeader(header);
 }
 
+const Page* PageFile::mappedPage(const PageId page_number) const {
+  if (!isMapped()) {
+    throw FileNotMappedException(filename_);
+  }
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= state_->header.num_pages || !isPageUsed(page_number)) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  return mappedPageAt(pagePosition(page_number), page_number);
+}
+
 FileIterator PageFile::begin() {
   const FileHeader& header = readHeader();
   return FileIterator(this, header.first_used_page);
@@ -315,21 +1002,149 @@ FileIterator PageFile::end() {
 
 void PageFile::writePage(const PageId page_number, const PageHeader& header,
                      const Page& new_page) {
-  stream_->seekp(pagePosition(page_number), std::ios::beg);
-  stream_->write(reinterpret_cast<const char*>(&header), sizeof(PageHeader));
-  stream_->write(&new_page.data_[0], Page::DATA_SIZE);
-  stream_->flush();
+  // Assemble the page so that it goes out in a single write.
+  char page_data[Page::SIZE];
+  memcpy(page_data, &header, sizeof(PageHeader));
+  memcpy(page_data + sizeof(PageHeader), &new_page.data_[0], Page::DATA_SIZE);
+  writeBytes(pagePosition(page_number), page_data, Page::SIZE);
+  rememberNextPageNumber(page_number, header.next_page_number);
+  storeChecksum(page_number, page_data);
 }
 
 PageHeader PageFile::readPageHeader(PageId page_number) const {
   PageHeader header;
-  stream_->seekg(pagePosition(page_number), std::ios::beg);
-  stream_->read(reinterpret_cast<char*>(&header), sizeof(PageHeader));
+  readBytes(pagePosition(page_number), &header, sizeof(PageHeader));
+  rememberNextPageNumber(page_number, header.next_page_number);
   return header;
 }
 
+void PageFile::writePageHeader(const PageId page_number,
+                               const PageHeader& header) {
+  writeBytes(pagePosition(page_number), &header, sizeof(PageHeader));
+  rememberNextPageNumber(page_number, header.next_page_number);
+}
+
+PageId PageFile::nextPageNumber(const PageId page_number) const {
+  const std::vector<PageId>& next_page_numbers = state_->next_page_numbers;
+  if (page_number < next_page_numbers.size() &&
+      next_page_numbers[page_number] != FileState::UNKNOWN_PAGE) {
+    return next_page_numbers[page_number];
+  }
+  return readPageHeader(page_number).next_page_number;
+}
+
+void PageFile::writeNextPageNumber(const PageId page_number,
+                                   const PageId next_page_number) {
+  writeBytes(pagePosition(page_number) +
+                 static_cast<std::streamoff>(
+                     offsetof(PageHeader, next_page_number)),
+             &next_page_number, sizeof(PageId));
+  rememberNextPageNumber(page_number, next_page_number);
+}
+
+void PageFile::rememberNextPageNumber(const PageId page_number,
+                                      const PageId next_page_number) const {
+  std::vector<PageId>& next_page_numbers = state_->next_page_numbers;
+  if (page_number >= next_page_numbers.size()) {
+    next_page_numbers.resize(page_number + 1, FileState::UNKNOWN_PAGE);
+  }
+  next_page_numbers[page_number] = next_page_number;
+}
+
+void PageFile::upgradeContents(const std::uint32_t old_version) {
+  if (old_version < 2) {
+    rebuildPageLists();
+  }
+  if (old_version < 5) {
+    upgradePageHeaders();
+  }
+}
+
+void PageFile::rebuildPageLists() {
+  FileHeader header = readHeader();
+
+  header.last_used_page = Page::INVALID_NUMBER;
+  for (PageId current = header.first_used_page;
+       current != Page::INVALID_NUMBER;
+       current = readPageHeader(current).next_page_number) {
+    setPageUsed(current, true);
+    header.last_used_page = current;
+  }
+
+  std::vector<PageId> free_pages;
+  for (PageId current = header.first_free_page;
+       current != Page::INVALID_NUMBER;
+       current = readPageHeader(current).next_page_number) {
+    free_pages.push_back(current);
+  }
+  std::sort(free_pages.begin(), free_pages.end());
+  for (std::size_t i = 0; i < free_pages.size(); ++i) {
+    PageHeader free_header = readPageHeader(free_pages[i]);
+    free_header.next_page_number = i + 1 < free_pages.size() ?
+        free_pages[i + 1] : Page::INVALID_NUMBER;
+    writePageHeader(free_pages[i], free_header);
+  }
+  header.first_free_page =
+      free_pages.empty() ? Page::INVALID_NUMBER : free_pages.front();
+
+  writeHeader(header);
+}
+
+void PageFile::upgradePageHeaders() {
+  const PageId num_pages = readHeader().num_pages;
+  for (PageId page_number = 1; page_number < num_pages; ++page_number) {
+    if (isPageUsed(page_number)) {
+      Page page = readPage(page_number, false /* allow_free */);
+      page.upgradeHeader();
+      writePage(page_number, page.header_, page);
+    }
+  }
+}
 
+std::uint32_t PageFile::pageChecksum(const void* page_data) const {
+  return Checksum::page(page_data, offsetof(PageHeader, next_page_number),
+                        sizeof(PageId));
+}
 
+PageId PageFile::nextUsedPage(const PageId page_number) const {
+  const PageId num_pages = state_->header.num_pages;
+  PageId candidate = page_number + 1;
+  while (candidate < num_pages) {
+    // Groups hold a whole number of bytes, so a byte never spans two groups.
+    const PageId index = (candidate - 1) % PageGroupMap::PAGES_PER_GROUP;
+    const std::uint8_t bits =
+        groupMap((candidate - 1) / PageGroupMap::PAGES_PER_GROUP)
+            .used[index / 8] >> (index % 8);
+    if (bits != 0) {
+      candidate += __builtin_ctz(bits);
+      break;
+    }
+    candidate += 8 - index % 8;
+  }
+  return candidate < num_pages ? candidate : Page::INVALID_NUMBER;
+}
+
+PageId PageFile::findPreviousPage(const PageId page_number,
+                                  const bool used) const {
+  assert(page_number > 1);
+  PageId group = (page_number - 2) / PageGroupMap::PAGES_PER_GROUP;
+  // Groups are only visited in decreasing order, so no group map is loaded
+  // past the ones already cached and the pointer stays valid.
+  const PageGroupMap* map = &groupMap(group);
+  for (PageId candidate = page_number - 1; ; --candidate) {
+    const PageId candidate_group =
+        (candidate - 1) / PageGroupMap::PAGES_PER_GROUP;
+    if (candidate_group != group) {
+      group = candidate_group;
+      map = &groupMap(group);
+    }
+    const PageId index = (candidate - 1) % PageGroupMap::PAGES_PER_GROUP;
+    if (map->isUsed(index) == used) {
+      return candidate;
+    }
+    assert(candidate > 1);
+  }
+}
 
 BlobFile BlobFile::create(const std::string& filename) {
   return BlobFile(filename, true /* create_new */);
@@ -339,15 +1154,31 @@ BlobFile BlobFile::open(const std::string& filename) {
   return BlobFile(filename, false /* create_new */);
 }
 
-BlobFile::BlobFile(const std::string& name, const bool create_new)
-: File(name, create_new) {
+BlobFile BlobFile::openReadOnly(const std::string& filename) {
+  return BlobFile(filename, false /* create_new */, true /* read_only */);
+}
+
+BlobFile BlobFile::createCompressed(const std::string& filename) {
+  BlobFile file(filename, true /* create_new */);
+  FileHeader header = file.readHeader();
+  header.flags |= FileHeader::COMPRESSED;
+  file.writeHeader(header);
+  return file;
+}
+
+BlobFile::BlobFile(const std::string& name, const bool create_new,
+                   const bool read_only)
+: File(name, create_new, read_only) {
+  if (!create_new) {
+    upgradeFormat();
+  }
 }
 
 BlobFile::~BlobFile() {
 }
 
 BlobFile::BlobFile(const BlobFile& other)
-: File(other.filename_, false /* create_new */)
+: File(other.filename_, false /* create_new */, other.read_only_)
 {
 }
 
@@ -356,44 +1187,422 @@ BlobFile& BlobFile::operator=(const BlobFile& rhs) {
   // same file.
   close();	//close my file and associate me with the new one
   filename_ = rhs.filename_;
+  read_only_ = rhs.read_only_;
   openIfNeeded(false /* create_new */);
   return *this;
 }
 
 Page BlobFile::allocatePage(PageId &new_page_number) {
-  FileHeader header = readHeader();
-	Page new_page;
-
-	new_page_number = header.num_pages;
+  return allocatePage(new_page_number, Page::INVALID_NUMBER);
+}
 
-	if (header.first_used_page == Page::INVALID_NUMBER) {
-		header.first_used_page = header.num_pages;
-	}
+Page BlobFile::allocatePage(PageId &new_page_number,
+                            const PageId near_page_number) {
+  checkWritable();
+  FileHeader header = readHeader();
 
-	++header.num_pages;
+  new_page_number = Page::INVALID_NUMBER;
+  if (near_page_number != Page::INVALID_NUMBER &&
+      near_page_number < header.num_pages) {
+    // Prefer the closest free page after the hint, then the closest before
+    // it, as long as it is in the same extent.
+    const PageId extent_start =
+        (near_page_number - 1) / EXTENT_PAGES * EXTENT_PAGES + 1;
+    const PageId extent_end =
+        std::min(extent_start + EXTENT_PAGES, header.num_pages);
+    new_page_number = firstFreePage(near_page_number + 1, extent_end);
+    if (new_page_number == Page::INVALID_NUMBER) {
+      new_page_number = lastFreePage(extent_start, near_page_number);
+    }
+  }
+  if (new_page_number == Page::INVALID_NUMBER && header.num_free_pages > 0) {
+    // Otherwise fill the last extent in order.  A page placed by hint keeps
+    // the page after it free, so that its own neighbour can follow it later.
+    const PageId extent_start =
+        (header.num_pages - 2) / EXTENT_PAGES * EXTENT_PAGES + 1;
+    new_page_number = firstFreePage(extent_start, header.num_pages,
+        near_page_number != Page::INVALID_NUMBER /* leave_gap */);
+    if (new_page_number == Page::INVALID_NUMBER) {
+      // Pages freed in earlier extents, and gaps left above, are still used
+      // before the file grows.
+      new_page_number = firstFreePage(1, header.num_pages);
+    }
+  }
+  if (new_page_number == Page::INVALID_NUMBER) {
+    new_page_number = reserveExtent(header);
+  }
 
-	writePage(new_page_number, new_page);
-	writeHeader(header);
+  --header.num_free_pages;
+  if (header.first_used_page == Page::INVALID_NUMBER) {
+    header.first_used_page = new_page_number;
+  }
+  if (header.last_used_page == Page::INVALID_NUMBER ||
+      new_page_number > header.last_used_page) {
+    header.last_used_page = new_page_number;
+  }
+  setPageUsed(new_page_number, true);
+  writeHeader(header);
+  if (hasChecksums()) {
+    // Until it is written, the page reads as zeros: its space was reserved
+    // along with its extent, and deletePage clears pages it frees.
+    char page_data[Page::SIZE];
+    memset(page_data, 0, Page::SIZE);
+    storeChecksum(new_page_number, page_data);
+  }
 
-	return new_page;
+  // The page isn't written here; callers write it once they have filled it
+  // in.
+  return Page();
 }
 
 Page BlobFile::readPage(const PageId page_number) const {
-	Page page;
-	stream_->seekg(pagePosition(page_number), std::ios::beg);
-	stream_->read(reinterpret_cast<char*>(&page), Page::SIZE);
+	Page page(Page::UNINITIALIZED);
+	if (isCompressed()) {
+		readCompressedPage(page_number, page);
+	} else {
+		readBytes(pagePosition(page_number), &page, Page::SIZE);
+	}
+	if (hasChecksums() && isPageUsed(page_number)) {
+		verifyChecksum(page_number, &page);
+	}
 	return page;
 }
 
 void BlobFile::writePage(const PageId new_page_number, const Page& new_page) {
-	stream_->seekp(pagePosition(new_page_number), std::ios::beg);
-	stream_->write(reinterpret_cast<const char*>(&new_page), Page::SIZE);
-	stream_->flush();
+	checkWritable();
+	if (isCompressed()) {
+		writeCompressedPage(new_page_number, new_page);
+	} else {
+		writeBytes(pagePosition(new_page_number), &new_page, Page::SIZE);
+	}
+	storeChecksum(new_page_number, &new_page);
+}
+
+const Page* BlobFile::mappedPage(const PageId page_number) const {
+	// Mapped bytes of a compressed file aren't pages.
+	if (!isMapped() || isCompressed()) {
+		throw FileNotMappedException(filename_);
+	}
+	if (page_number == Page::INVALID_NUMBER ||
+	    page_number >= state_->header.num_pages) {
+		throw InvalidPageException(page_number, filename_);
+	}
+	return mappedPageAt(pagePosition(page_number), page_number);
+}
+
+PageId BlobFile::firstFreePage(const PageId first, const PageId last,
+                               const bool leave_gap) const {
+  for (PageId page_number = first; page_number < last; ++page_number) {
+    // With leave_gap, the page right after a used page stays free.
+    if (!isPageUsed(page_number) &&
+        (!leave_gap || page_number == 1 || !isPageUsed(page_number - 1))) {
+      return page_number;
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+PageId BlobFile::lastFreePage(const PageId first, const PageId last) const {
+  for (PageId page_number = last; page_number > first; --page_number) {
+    if (!isPageUsed(page_number - 1)) {
+      return page_number - 1;
+    }
+  }
+  return Page::INVALID_NUMBER;
+}
+
+PageId BlobFile::reserveExtent(FileHeader& header) {
+  // Files from before extents may end part way into one; only the rest of
+  // that extent is reserved so later extents stay aligned.
+  const PageId first = header.num_pages;
+  const PageId end = (first - 1) / EXTENT_PAGES * EXTENT_PAGES +
+      EXTENT_PAGES + 1;
+  const bool starts_group = (first - 1) % PageGroupMap::PAGES_PER_GROUP == 0;
+  const std::streampos start_position = starts_group ?
+      groupPosition((first - 1) / PageGroupMap::PAGES_PER_GROUP) :
+      pagePosition(first);
+  const std::streampos end_position =
+      pagePosition(end - 1) + static_cast<std::streamoff>(Page::SIZE);
+  // Compressed files grow by their images instead.
+  if (!isCompressed()) {
+    reserveSpace(start_position, end_position - start_position);
+  }
+
+  header.num_pages = end;
+  header.num_free_pages += end - first;
+  return first;
+}
+
+void BlobFile::upgradeContents(const std::uint32_t old_version) {
+  if (old_version < 3) {
+    markAllPagesUsed();
+  }
+}
+
+void BlobFile::markAllPagesUsed() {
+  FileHeader header = readHeader();
+  for (PageId page_number = 1; page_number < header.num_pages; ++page_number) {
+    if (!isPageUsed(page_number)) {
+      setPageUsed(page_number, true);
+    }
+  }
+  header.num_free_pages = 0;
+  writeHeader(header);
+}
+
+void BlobFile::readCompressedPage(const PageId page_number, Page& page) const {
+  const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+  const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+  const std::uint32_t location = groupMap(group).locations[index];
+  const std::uint32_t units = imageUnits(location);
+  const std::streampos position = imagePosition(group, imageOffset(location));
+
+  if (units > Page::SIZE / IMAGE_UNIT) {
+    throw InvalidPageException(page_number, filename_);
+  } else if (units == 0) {
+    // Allocated but never written, like a page past the end of a plain file.
+    memset(static_cast<void*>(&page), 0, Page::SIZE);
+  } else if (location & RAW_IMAGE) {
+    readBytes(position, &page, Page::SIZE);
+  } else {
+    char image[Page::SIZE];
+    readBytes(position, image, units * IMAGE_UNIT);
+    if (!PageCompressor::decompress(image, units * IMAGE_UNIT,
+                                    reinterpret_cast<char*>(&page))) {
+      throw InvalidPageException(page_number, filename_);
+    }
+  }
+}
+
+void BlobFile::writeCompressedPage(const PageId page_number, const Page& page) {
+  const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+  const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+
+  // Store the page as is unless compressing saves at least one unit.
+  char image[Page::SIZE];
+  std::size_t length = PageCompressor::compress(
+      reinterpret_cast<const char*>(&page), image, Page::SIZE - IMAGE_UNIT);
+  const bool raw = length == 0;
+  if (raw) {
+    memcpy(image, &page, Page::SIZE);
+    length = Page::SIZE;
+  }
+  const std::uint32_t units = (length + IMAGE_UNIT - 1) / IMAGE_UNIT;
+
+  std::uint32_t& location = groupMap(group).locations[index];
+  std::uint32_t new_location;
+  if (imageUnits(location) >= units) {
+    new_location = (location & ~RAW_IMAGE) | (raw ? RAW_IMAGE : 0);
+  } else {
+    // Pages are rewritten as they fill up, so leave room for the next few
+    // records before the image has to move again.
+    const std::uint32_t space =
+        std::min<std::uint32_t>(units + units / 8, Page::SIZE / IMAGE_UNIT);
+    // The old image is about to be replaced, so its space can be reused
+    // straight away.
+    if (imageUnits(location) > 0) {
+      freeImage(group, location);
+      location = 0;
+    }
+    new_location = allocateImage(group, space) << LOCATION_SIZE_BITS | space |
+        (raw ? RAW_IMAGE : 0);
+  }
+
+  writeBytes(imagePosition(group, imageOffset(new_location)), image, length);
+  if (new_location != location) {
+    location = new_location;
+    writeBytes(groupPosition(group) +
+               static_cast<std::streamoff>(offsetof(PageGroupMap, locations) +
+                                           index * sizeof(std::uint32_t)),
+               &location, sizeof(std::uint32_t));
+  }
+}
+
+std::uint32_t BlobFile::allocateImage(const PageId group,
+                                      const std::uint32_t units) {
+  GroupDataSpace& space = groupDataSpace(group);
+  for (std::map<std::uint32_t, std::uint32_t>::iterator hole =
+           space.holes.begin();
+       hole != space.holes.end(); ++hole) {
+    if (hole->second >= units) {
+      const std::uint32_t offset = hole->first;
+      const std::uint32_t rest = hole->second - units;
+      space.holes.erase(hole);
+      if (rest > 0) {
+        space.holes[offset + units] = rest;
+      }
+      return offset;
+    }
+  }
+
+  if (space.end + units > GROUP_DATA_UNITS) {
+    compactGroup(group);
+  }
+  // Every page's image fits in the space it takes in a plain file, so after
+  // compacting there is always room.
+  assert(space.end + units <= GROUP_DATA_UNITS);
+  const std::uint32_t offset = space.end;
+  space.end += units;
+  return offset;
+}
+
+void BlobFile::freeImage(const PageId group, const std::uint32_t location) {
+  GroupDataSpace& space = groupDataSpace(group);
+  std::uint32_t offset = imageOffset(location);
+  std::uint32_t units = imageUnits(location);
+
+  // Merge with the holes on either side.
+  std::map<std::uint32_t, std::uint32_t>::iterator next =
+      space.holes.lower_bound(offset);
+  if (next != space.holes.end() && offset + units == next->first) {
+    units += next->second;
+    next = space.holes.erase(next);
+  }
+  if (next != space.holes.begin()) {
+    std::map<std::uint32_t, std::uint32_t>::iterator previous = next;
+    --previous;
+    if (previous->first + previous->second == offset) {
+      offset = previous->first;
+      units += previous->second;
+      space.holes.erase(previous);
+    }
+  }
+
+  if (offset + units == space.end) {
+    space.end = offset;
+  } else {
+    space.holes[offset] = units;
+  }
+}
+
+void BlobFile::compactGroup(const PageId group) {
+  PageGroupMap& map = groupMap(group);
+  std::vector<char> images;
+  for (PageId index = 0; index < PageGroupMap::PAGES_PER_GROUP; ++index) {
+    const std::uint32_t location = map.locations[index];
+    const std::uint32_t units = imageUnits(location);
+    if (units == 0) {
+      continue;
+    }
+    const std::size_t start = images.size();
+    images.resize(start + units * IMAGE_UNIT);
+    readBytes(imagePosition(group, imageOffset(location)), &images[start],
+              units * IMAGE_UNIT);
+    map.locations[index] = static_cast<std::uint32_t>(start / IMAGE_UNIT)
+        << LOCATION_SIZE_BITS | units | (location & RAW_IMAGE);
+  }
+  if (!images.empty()) {
+    writeBytes(imagePosition(group, 0 /* offset */), &images[0],
+               images.size());
+  }
+  writeBytes(groupPosition(group) +
+             static_cast<std::streamoff>(offsetof(PageGroupMap, locations)),
+             map.locations, sizeof(map.locations));
+
+  GroupDataSpace& space = groupDataSpace(group);
+  space.end = images.size() / IMAGE_UNIT;
+  space.holes.clear();
+}
+
+std::size_t BlobFile::groupDataLength(const PageGroupMap& map,
+                                      const PageId num_pages) const {
+  if (!isCompressed()) {
+    return File::groupDataLength(map, num_pages);
+  }
+  std::uint32_t end = 0;
+  for (PageId index = 0; index < PageGroupMap::PAGES_PER_GROUP; ++index) {
+    if (imageUnits(map.locations[index]) > 0) {
+      end = std::max(end, imageOffset(map.locations[index]) +
+                              imageUnits(map.locations[index]));
+    }
+  }
+  return static_cast<std::size_t>(end) * IMAGE_UNIT;
+}
+
+GroupDataSpace& BlobFile::groupDataSpace(const PageId group) {
+  if (group >= state_->group_data_spaces.size()) {
+    state_->group_data_spaces.resize(group + 1);
+  }
+  GroupDataSpace& space = state_->group_data_spaces[group];
+  if (!space.loaded) {
+    // Everything between the stored images is a hole.
+    const PageGroupMap& map = groupMap(group);
+    std::map<std::uint32_t, std::uint32_t> images;
+    for (PageId index = 0; index < PageGroupMap::PAGES_PER_GROUP; ++index) {
+      if (imageUnits(map.locations[index]) > 0) {
+        images[imageOffset(map.locations[index])] =
+            imageUnits(map.locations[index]);
+      }
+    }
+    space.end = 0;
+    for (std::map<std::uint32_t, std::uint32_t>::const_iterator image =
+             images.begin();
+         image != images.end(); ++image) {
+      if (image->first > space.end) {
+        space.holes[space.end] = image->first - space.end;
+      }
+      space.end = image->first + image->second;
+    }
+    space.loaded = true;
+  }
+  return space;
 }
 
-//delePage should not be called for a blob_file, not supported
 void BlobFile::deletePage(const PageId page_number) {
-	throw InvalidPageException(page_number, filename_);
+  checkWritable();
+  FileHeader header = readHeader();
+
+  if (page_number == Page::INVALID_NUMBER ||
+      page_number >= header.num_pages || !isPageUsed(page_number)) {
+    throw InvalidPageException(page_number, filename_);
+  }
+  setPageUsed(page_number, false);
+  ++header.num_free_pages;
+
+  // Pages aren't linked, so the bounds just move to the nearest used pages.
+  if (page_number == header.first_used_page) {
+    header.first_used_page = Page::INVALID_NUMBER;
+    for (PageId next = page_number + 1; next <= header.last_used_page;
+         ++next) {
+      if (isPageUsed(next)) {
+        header.first_used_page = next;
+        break;
+      }
+    }
+  }
+  if (page_number == header.last_used_page) {
+    header.last_used_page = Page::INVALID_NUMBER;
+    for (PageId previous = page_number - 1;
+         header.first_used_page != Page::INVALID_NUMBER &&
+         previous >= header.first_used_page;
+         --previous) {
+      if (isPageUsed(previous)) {
+        header.last_used_page = previous;
+        break;
+      }
+    }
+  }
+
+  if (isCompressed()) {
+    const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+    const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+    std::uint32_t& location = groupMap(group).locations[index];
+    if (imageUnits(location) > 0) {
+      freeImage(group, location);
+      location = 0;
+      writeBytes(groupPosition(group) +
+                 static_cast<std::streamoff>(offsetof(PageGroupMap, locations) +
+                                             index * sizeof(std::uint32_t)),
+                 &location, sizeof(std::uint32_t));
+    }
+  } else {
+    // Cleared so that the page reads as zeros when it is allocated again,
+    // like a page of a new extent, instead of with the old contents.
+    char page_data[Page::SIZE];
+    memset(page_data, 0, Page::SIZE);
+    writeBytes(pagePosition(page_number), page_data, Page::SIZE);
+  }
+  writeHeader(header);
 }
 
 }
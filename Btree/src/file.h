@@ -10,9 +10,13 @@
 #include <fstream>
 #include <string>
 #include <map>
+#include <set>
 #include <memory>
+#include <vector>
 
 #include "page.h"
+#include "file_catalog.h"
+#include "tablespace.h"
 
 namespace badgerdb {
 
@@ -20,8 +24,36 @@ class FileIterator;
 
 /**
  * @brief Header metadata for files on disk which contain pages.
+ *
+ * The header lives in its own page-sized slot at the start of the file, so
+ * fields can be added in the unused part of that slot without moving any
+ * pages.  Files written in an older format are upgraded to the current layout
+ * the first time they are opened.
  */
 struct FileHeader {
+  /**
+   * Identifies a file written in the current on-disk format.
+   */
+  static const std::uint32_t MAGIC = 0x46424442;
+
+  /**
+   * Version of the on-disk format written by this code.  Version 3 added the
+   * allocation bitmap to blob files, version 4 a checksum slot to every page
+   * group, and version 5 the free slot list and fragmented byte count to the
+   * header of slotted pages.
+   */
+  static const std::uint32_t VERSION = 5;
+
+  /**
+   * Set in flags if pages are stored compressed.
+   */
+  static const std::uint32_t COMPRESSED = 1;
+
+  /**
+   * Set in flags if page checksums are kept up to date and verified on read.
+   */
+  static const std::uint32_t CHECKSUMS = 2;
+
   /**
    * Number of pages allocated in the file.
    */
@@ -39,9 +71,33 @@ struct FileHeader {
 
   /**
    * Page number of the first free (allocated but unused) page in the file.
+   * Free pages are kept in ascending page number order, so this is also the
+   * lowest numbered free page.
    */
   PageId first_free_page;
 
+  /**
+   * Page number of the last used page in the file, i.e. the tail of the used
+   * page list.
+   */
+  PageId last_used_page;
+
+  /**
+   * Always MAGIC for files in the current format.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Version of the format the file was written in.
+   */
+  std::uint32_t version;
+
+  /**
+   * Storage options of the file, such as COMPRESSED.
+   * Zero in files written before there were any options.
+   */
+  std::uint32_t flags;
+
   /**
    * Returns true if this file header is equal to the other.
    *
@@ -52,10 +108,265 @@ struct FileHeader {
     return num_pages == rhs.num_pages &&
         num_free_pages == rhs.num_free_pages &&
         first_used_page == rhs.first_used_page &&
-        first_free_page == rhs.first_free_page;
+        first_free_page == rhs.first_free_page &&
+        last_used_page == rhs.last_used_page;
+  }
+};
+
+/**
+ * @brief Header of files written before FileHeader had a magic number.  These
+ *        files store the first page directly after the header.
+ */
+struct LegacyFileHeader {
+  PageId num_pages;
+  PageId first_used_page;
+  PageId num_free_pages;
+  PageId first_free_page;
+};
+
+/**
+ * @brief Allocation bitmap for one group of pages in a file.
+ *
+ * Pages are stored in groups of PAGES_PER_GROUP, and each group is preceded on
+ * disk by METADATA_SLOTS page-sized slots.  The first starts with this bitmap
+ * and the second holds the group's PageGroupChecksums.  A set bit means the
+ * page is in the used page list; a clear bit below FileHeader::num_pages
+ * means it is free.  Compressed files follow it with the location of each
+ * page's compressed image.
+ */
+struct PageGroupMap {
+  /**
+   * Number of pages described by one metadata slot.
+   */
+  static const PageId PAGES_PER_GROUP = 1984;
+
+  /**
+   * Number of page-sized slots in front of each group.
+   */
+  static const PageId METADATA_SLOTS = 2;
+
+  /**
+   * One bit per page in the group, lowest page number first.
+   */
+  std::uint8_t used[PAGES_PER_GROUP / 8];
+
+  /**
+   * Where each page of a compressed file is stored within the group's data
+   * area; see BlobFile.  Zero for pages that haven't been written, and
+   * unused in uncompressed files.
+   */
+  std::uint32_t locations[PAGES_PER_GROUP];
+
+  /**
+   * Returns whether the page at the given index within the group is used.
+   *
+   * @param index   Index of page within the group.
+   */
+  bool isUsed(const PageId index) const {
+    return (used[index / 8] >> (index % 8)) & 1;
   }
 };
 
+static_assert(sizeof(PageGroupMap) <= Page::SIZE,
+              "Group metadata must fit in one page-sized slot.");
+
+/**
+ * @brief Checksums of one group of pages in a file, stored in the slot after
+ *        the group's PageGroupMap.  See Checksum::page().
+ */
+struct PageGroupChecksums {
+  /**
+   * Checksum of each page in the group as it was last written, lowest page
+   * number first.  Only meaningful for used pages while the file has
+   * FileHeader::CHECKSUMS set.
+   */
+  std::uint32_t checksums[PageGroupMap::PAGES_PER_GROUP];
+};
+
+static_assert(sizeof(PageGroupChecksums) <= Page::SIZE,
+              "Group checksums must fit in one page-sized slot.");
+
+/**
+ * @brief Counts of physical I/O requests issued by File objects.
+ */
+struct FileIOStats {
+  /**
+   * Number of reads issued to the underlying files.
+   */
+  int reads;
+
+  /**
+   * Number of writes issued to the underlying files.
+   */
+  int writes;
+
+  /**
+   * Number of bytes read from the underlying files.
+   */
+  long bytesread;
+
+  /**
+   * Number of bytes written to the underlying files.
+   */
+  long byteswritten;
+
+  /**
+   * Number of reads served from a memory mapping without a system call.
+   */
+  int mappedreads;
+
+  /**
+   * Number of pages read whose checksum matched.
+   */
+  int checksumsverified;
+
+  /**
+   * Number of pages read whose checksum didn't match.
+   */
+  int checksumsfailed;
+
+  /**
+   * Clears all counts.
+   */
+  void clear() {
+    reads = writes = mappedreads = 0;
+    checksumsverified = checksumsfailed = 0;
+    bytesread = byteswritten = 0;
+  }
+
+  FileIOStats() {
+    clear();
+  }
+};
+
+/**
+ * @brief Space used by page images in the data area of one page group of a
+ *        compressed file.
+ */
+struct GroupDataSpace {
+  /**
+   * Whether the fields below have been worked out from the group's page
+   * locations.
+   */
+  bool loaded;
+
+  /**
+   * End of the last image in the data area, in BlobFile image units.
+   */
+  std::uint32_t end;
+
+  /**
+   * Unused ranges before end, from their offset to their length.
+   */
+  std::map<std::uint32_t, std::uint32_t> holes;
+
+  GroupDataSpace() : loaded(false), end(0) {}
+};
+
+/**
+ * @brief In-memory state shared by every File object open on the same file.
+ *
+ * Besides the stream, this caches the file header and the page metadata that
+ * File needs on every page access, so that reading or writing a page costs a
+ * single I/O.  Cached metadata is written through to disk whenever it changes.
+ */
+struct FileState {
+  /**
+   * Marks an entry of next_page_numbers whose value hasn't been seen yet.
+   */
+  static const PageId UNKNOWN_PAGE = 0xFFFFFFFF;
+
+  /**
+   * Stream for underlying filesystem object, or NULL if the file is a segment
+   * of a tablespace.
+   */
+  std::shared_ptr<std::fstream> stream;
+
+  /**
+   * Tablespace holding the file, or NULL if the file is a filesystem object
+   * of its own.
+   */
+  std::shared_ptr<Tablespace> tablespace;
+
+  /**
+   * Segment of the tablespace holding the file.
+   */
+  SegmentId segment;
+
+  /**
+   * Number of File objects using this state.
+   */
+  int open_count;
+
+  /**
+   * Whether the stream was opened for reading only.
+   */
+  bool read_only;
+
+  /**
+   * Read-only mapping of the file, or NULL if it isn't mapped.
+   */
+  const char* mapping;
+
+  /**
+   * Length in bytes of the mapping.
+   */
+  std::size_t mapping_length;
+
+  /**
+   * madvise() advice given for the mapping.
+   */
+  int mapping_advice;
+
+  /**
+   * Mappings replaced by a longer one after the file grew, with their
+   * lengths.  Pages handed out from them stay valid until the file is
+   * closed, so they are only unmapped then.
+   */
+  std::vector<std::pair<const char*, std::size_t> > old_mappings;
+
+  /**
+   * Copy of the file header on disk.
+   */
+  FileHeader header;
+
+  /**
+   * Allocation bitmaps of the page groups loaded so far.
+   */
+  std::vector<PageGroupMap> group_maps;
+
+  /**
+   * Whether each entry of group_maps has been loaded from disk.
+   */
+  std::vector<bool> group_maps_loaded;
+
+  /**
+   * Next page pointer of each page as it is on disk, or UNKNOWN_PAGE.
+   */
+  std::vector<PageId> next_page_numbers;
+
+  /**
+   * Space used in each group's data area of a compressed file.
+   */
+  std::vector<GroupDataSpace> group_data_spaces;
+
+  /**
+   * Page checksums of the groups loaded so far.
+   */
+  std::vector<PageGroupChecksums> group_checksums;
+
+  /**
+   * Whether each entry of group_checksums has been loaded from disk.
+   */
+  std::vector<bool> group_checksums_loaded;
+
+  /**
+   * Whether each page of the mapping has had its checksum verified.  Mapped
+   * pages are only verified the first time they are handed out.
+   */
+  std::vector<bool> mapped_pages_verified;
+};
+
 /**
  * @brief Class which represents a file in the filesystem containing database
  *        pages.
@@ -65,8 +376,10 @@ struct FileHeader {
  * deleted pages if possible).  If multiple File objects refer to the same
  * underlying file, they will share the stream in memory.
  * If a file that has already been opened (possibly by another query), then the File class
- * detects this (by looking in the open_streams_ map) and just returns a file object with
+ * detects this (by looking up its FileCatalog id in open_files_) and just returns a file object with
  * the already created stream for the file without actually opening the UNIX file again. 
+ * A file named "<tablespace path>:<name>" is a segment of a Tablespace rather than a file of
+ * its own; it behaves the same otherwise, except that it is never mapped into memory.
  *
  * @warning This class is not threadsafe.
  */
@@ -74,18 +387,29 @@ struct FileHeader {
 
 class File {
  public:
+  /**
+   * Expected order of page accesses, passed on to the kernel for mapped files.
+   */
+  enum AccessPattern {
+    ACCESS_NORMAL,
+    ACCESS_RANDOM,
+    ACCESS_SEQUENTIAL
+  };
 
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param read_only   Whether to open an existing file read-only and map it
+   *                    into memory.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  File(const std::string& name, const bool create_new);
+  File(const std::string& name, const bool create_new,
+       const bool read_only = false);
 
   /**
    * Deletes an existing file.
@@ -124,6 +448,18 @@ class File {
    */
   virtual Page allocatePage(PageId &new_page_number) = 0;
 
+  /**
+   * Allocates a new page in the file, placing it close to the given page if
+   * the file supports it.  By default the hint is ignored.
+   *
+   * @param new_page_number   Set to the number of the new page.
+   * @param near_page_number  Page the new page should be close to, or
+   *                          Page::INVALID_NUMBER for no preference.
+   * @return The new page.
+   */
+  virtual Page allocatePage(PageId &new_page_number,
+                            const PageId near_page_number);
+
   /**
    * Reads an existing page from the file.
    *
@@ -131,6 +467,8 @@ class File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the file keeps checksums and the page
+   *                                fails its checksum.
    */
   virtual Page readPage(const PageId page_number) const = 0;
 
@@ -150,6 +488,21 @@ class File {
    */
   virtual void deletePage(const PageId page_number) = 0;
 
+  /**
+   * Returns a pointer to an existing page inside the file's memory mapping.
+   * The page is not copied, and the pointer stays valid until the last File
+   * object for the file is closed.  Writes made through other File objects
+   * for the same file show up in the mapping.
+   *
+   * @param page_number   Number of page.
+   * @return  The mapped page.
+   * @throws  FileNotMappedException  If no File object opened the file
+   *                                  read-only.
+   * @throws  InvalidPageException    If the page doesn't exist in the file or
+   *                                  is not currently used.
+   */
+  virtual const Page* mappedPage(const PageId page_number) const = 0;
+
   /**
    * Returns the name of the file this object represents.
    *
@@ -157,6 +510,77 @@ class File {
    */
   const std::string& filename() const { return filename_; }
 
+  /**
+   * Returns the FileCatalog id of the file.  Every File object for the same
+   * file returns the same id.
+   */
+  FileId id() const { return id_; }
+
+  /**
+   * Returns true if this object was opened read-only.
+   */
+  bool isReadOnly() const { return read_only_; }
+
+  /**
+   * Returns true if the file is mapped into memory.
+   */
+  bool isMapped() const { return state_->mapping != NULL; }
+
+  /**
+   * Tells the kernel how the mapping of this file is going to be accessed, so
+   * it can tune read-ahead.  Mapped files start out as ACCESS_RANDOM.  Does
+   * nothing if the file isn't mapped.
+   *
+   * @param pattern   Expected access pattern.
+   */
+  void adviseAccess(const AccessPattern pattern);
+
+  /**
+   * Turns page checksums on or off for this file.  While they are on, every
+   * page written gets its checksum stored and every used page read is checked
+   * against it.  Turning them on computes the checksums of all used pages.
+   *
+   * @param enabled   Whether to keep and verify checksums.
+   */
+  void setChecksums(const bool enabled);
+
+  /**
+   * Returns whether the file keeps and verifies page checksums.
+   */
+  bool hasChecksums() const {
+    return (state_->header.flags & FileHeader::CHECKSUMS) != 0;
+  }
+
+  /**
+   * Forces every write made to this file so far out to stable storage.
+   * Writes are otherwise only handed to the operating system, so they survive
+   * a process crash but not a machine crash.
+   *
+   * @throws  FileIOException   If the writes couldn't be made durable.
+   */
+  void sync();
+
+  /**
+   * Forces every file written to since its last sync out to stable storage.
+   * This issues one fdatasync per file, no matter how many pages were
+   * written, so callers can batch the cost of durability at a commit boundary.
+   *
+   * @return  Number of files synced.
+   * @throws  FileIOException   If a file couldn't be synced.  That file and
+   *                            the ones not reached yet stay unsynced.
+   */
+  static int syncAll();
+
+  /**
+   * Returns counts of the physical I/O issued by all files.
+   */
+  static FileIOStats& getIOStats() { return io_stats_; }
+
+  /**
+   * Clears the physical I/O counts.
+   */
+  static void clearIOStats() { io_stats_.clear(); }
+
  	/**
    * Returns pageid of first page in the file.
    *
@@ -167,15 +591,206 @@ class File {
  protected:
   /**
    * Returns the position of the page with the given number in the file (as an
-   * offset from the beginning of the file).
+   * offset from the beginning of the file).  Slot 0 holds the file header and
+   * every group of pages is preceded by its metadata slots.
    *
    * @param page_number   Number of page.
    * @return  Position of page in file.
    */
   static std::streampos pagePosition(const PageId page_number) {
-    return sizeof(FileHeader) + ((page_number - 1) * Page::SIZE);
+    const PageId group = (page_number - 1) / PageGroupMap::PAGES_PER_GROUP;
+    const PageId index = (page_number - 1) % PageGroupMap::PAGES_PER_GROUP;
+    return groupPosition(group) + static_cast<std::streamoff>(
+        (index + PageGroupMap::METADATA_SLOTS) * Page::SIZE);
   }
 
+  /**
+   * Returns the position of the metadata slot of the given page group.
+   *
+   * @param group   Number of page group, starting at 0.
+   * @return  Position of the group's metadata slot in file.
+   */
+  static std::streampos groupPosition(const PageId group) {
+    return static_cast<std::streamoff>(group) *
+        static_cast<std::streamoff>(PageGroupMap::PAGES_PER_GROUP +
+                                    PageGroupMap::METADATA_SLOTS) *
+        static_cast<std::streamoff>(Page::SIZE) +
+        static_cast<std::streamoff>(Page::SIZE);
+  }
+
+  /**
+   * Returns the position of the checksum slot of the given page group.
+   *
+   * @param group   Number of page group, starting at 0.
+   * @return  Position of the group's PageGroupChecksums in file.
+   */
+  static std::streampos checksumPosition(const PageId group) {
+    return groupPosition(group) + static_cast<std::streamoff>(Page::SIZE);
+  }
+
+  /**
+   * Rewrites a file written in an older format into the current one, moving
+   * every page to its current position, clearing the group metadata slots
+   * that are new and letting the subclass convert its pages with
+   * upgradeContents.  Does nothing if the file is already in the current
+   * format.
+   *
+   * The upgrade is done on a copy of the file, named by upgradeName(), which
+   * is synced and renamed over the file once it is complete, so a crash
+   * leaves either the old file or the upgraded one.  Segments of a
+   * tablespace are always in the current format.
+   *
+   * @return  Version the file was in before, 0 for files from before there
+   *          were versions.  FileHeader::VERSION if nothing was done.
+   * @throws  FileReadOnlyException   If the file needs upgrading but was
+   *                                  opened read-only.
+   * @throws  FileIOException         If the copy can't be written, synced or
+   *                                  renamed; the file is then left as it was.
+   */
+  std::uint32_t upgradeFormat();
+
+  /**
+   * Returns the name of the copy of a file that upgradeFormat works on.
+   *
+   * @param filename  Name of file.
+   */
+  static std::string upgradeName(const std::string& filename) {
+    return filename + ".upgrade";
+  }
+
+  /**
+   * Moves the pages of a file in an older format to their current positions
+   * and writes the current header.  Used by upgradeFormat.
+   *
+   * @param header  Header as read from the file.
+   * @return  Version the file was in.
+   */
+  std::uint32_t convertLayout(FileHeader header);
+
+  /**
+   * Converts the pages of a file whose layout was just upgraded from an
+   * older format.  Does nothing by default.
+   *
+   * @param old_version   Version the file was in.
+   */
+  virtual void upgradeContents(const std::uint32_t old_version) {}
+
+  /**
+   * Points the stream at a file of a different name, dropping everything
+   * cached about the file it was pointed at before.
+   *
+   * @param filename  Name of file to open.
+   */
+  void reopenStream(const std::string& filename);
+
+  /**
+   * Moves the groups of a version 2 or 3 file apart to make room for the
+   * checksum slot in front of each group's pages.
+   *
+   * @param header  File header.
+   */
+  void addChecksumSlots(const FileHeader& header);
+
+  /**
+   * Returns the number of bytes of a group's data area that are in use.  By
+   * default that is the space of the group's pages.
+   *
+   * @param map         Metadata of the group.
+   * @param num_pages   Number of pages in the group.
+   */
+  virtual std::size_t groupDataLength(const PageGroupMap& map,
+                                      const PageId num_pages) const;
+
+  /**
+   * Returns the checksum to store for a page.  Subclasses whose pages have
+   * fields that are updated without rewriting the page leave them out.
+   *
+   * @param page_data   Page::SIZE bytes of the page as stored.
+   */
+  virtual std::uint32_t pageChecksum(const void* page_data) const;
+
+  /**
+   * Stores the checksum of a page that is being written, if the file keeps
+   * checksums.
+   *
+   * @param page_number   Number of page.
+   * @param page_data     Page::SIZE bytes of the page.
+   */
+  void storeChecksum(const PageId page_number, const void* page_data);
+
+  /**
+   * Checks a used page that was just read against its stored checksum, if the
+   * file keeps checksums.
+   *
+   * @param page_number   Number of page.
+   * @param page_data     Page::SIZE bytes of the page.
+   * @throws  CorruptPageException  If the checksum doesn't match.
+   */
+  void verifyChecksum(const PageId page_number, const void* page_data) const;
+
+  /**
+   * Returns the page checksums of the given page group, reading them from
+   * disk the first time they are needed.
+   *
+   * @param group   Number of page group.
+   */
+  PageGroupChecksums& groupChecksums(const PageId group) const;
+
+  /**
+   * Returns the mapped bytes of the page at the given position.
+   *
+   * @param position  Position of page in file.
+   * @param page_number   Number of page, for error reporting.
+   * @return  The mapped page.
+   * @throws  FileNotMappedException  If the file isn't mapped.
+   * @throws  InvalidPageException    If the page lies past the end of the
+   *                                  file.
+   * @throws  CorruptPageException    If the page is used and fails its
+   *                                  checksum the first time it is mapped.
+   */
+  const Page* mappedPageAt(const std::streampos position,
+                           const PageId page_number) const;
+
+  /**
+   * Throws FileReadOnlyException if this object was opened read-only.
+   */
+  void checkWritable() const;
+
+  /**
+   * Returns the allocation bitmap of the given page group, reading it from
+   * disk the first time it is needed.
+   *
+   * @param group   Number of page group.
+   * @return  The group's bitmap.
+   */
+  PageGroupMap& groupMap(const PageId group) const;
+
+  /**
+   * Returns whether the given page is in use.
+   *
+   * @param page_number   Number of page.
+   */
+  bool isPageUsed(const PageId page_number) const;
+
+  /**
+   * Sets or clears the allocation bit of the given page.
+   *
+   * @param page_number   Number of page.
+   * @param used          Whether the page is now in use.
+   */
+  void setPageUsed(const PageId page_number, const bool used);
+
+  /**
+   * Asks the filesystem to reserve space for the given byte range, so that
+   * pages written there later are laid out contiguously on disk.  Uses
+   * fallocate where available; elsewhere the space is claimed when the pages
+   * are written.
+   *
+   * @param position  Position in file where the range starts.
+   * @param length    Length of range in bytes.
+   */
+  void reserveSpace(const std::streampos position, const std::size_t length);
+
   /**
    * Opens the underlying file named in filename_.
    * This method only opens the file if no other File objects exist that access
@@ -189,6 +804,26 @@ class File {
    */
   void openIfNeeded(const bool create_new);
 
+  /**
+   * Registers the newly created state_ of the file and reads the header if
+   * the file already existed.
+   *
+   * @param create_new  Whether the file was just created.
+   */
+  void openState(const bool create_new);
+
+  /**
+   * Maps the file into memory if it isn't mapped yet.  A file that can't be
+   * mapped is left unmapped and read through its stream.
+   */
+  void mapIfNeeded();
+
+  /**
+   * Maps the file again if another File object made it longer than the
+   * mapping, keeping the old mapping until the file is closed.
+   */
+  void extendMapping() const;
+
   /**
    * Closes the underlying file stream in <stream_>.
    * This method only closes the file if no other File objects exist that access
@@ -197,11 +832,12 @@ class File {
   void close();
 
   /**
-   * Reads the header for this file from disk.
+   * Returns the header for this file.  The header is read from disk once when
+   * the file is opened and kept in memory after that.
    *
    * @return  The file header.
    */
-  FileHeader readHeader() const;
+  FileHeader readHeader() const { return state_->header; }
 
   /**
    * Writes the given header to the disk as the header for this file.
@@ -210,30 +846,89 @@ class File {
    */
   void writeHeader(const FileHeader& header);
 
-  typedef std::map<std::string, std::shared_ptr<std::fstream> > StreamMap;
-  typedef std::map<std::string, int> CountMap;
+  /**
+   * Reads bytes from the given position of the underlying file.  Bytes past
+   * the end of the file read as zero.
+   *
+   * @param position  Position in file to read from.
+   * @param data      Buffer to read into.
+   * @param length    Number of bytes to read.
+   */
+  void readBytes(const std::streampos position, void* data,
+                 const std::size_t length) const;
 
   /**
-   * Streams for opened files.
+   * Writes bytes to the given position of the underlying file.
+   *
+   * @param position  Position in file to write to.
+   * @param data      Bytes to write.
+   * @param length    Number of bytes to write.
+   * @throws  FileIOException   If the bytes can't be written.
    */
-  static StreamMap open_streams_;
+  void writeBytes(const std::streampos position, const void* data,
+                  const std::size_t length);
 
   /**
-   * Counts for opened files.
+   * Records that this file has writes which have not been synced yet.
    */
-  static CountMap open_counts_;
+  void markUnsynced() { unsynced_files_.insert(id_); }
+
+  /**
+   * Flushes the stream of the given file, if it is open, and syncs the file's
+   * data to disk.
+   *
+   * @param id  FileCatalog id of the file.
+   * @throws  FileIOException   If the stream can't be flushed or the file
+   *                            can't be synced.
+   */
+  static void syncFile(const FileId id);
+
+  typedef std::vector<std::shared_ptr<FileState> > StateTable;
+  typedef std::set<FileId> IdSet;
+
+  /**
+   * Shared state of opened files, indexed by FileCatalog id.  Entries of
+   * files that aren't open are empty.
+   */
+  static StateTable open_files_;
+
+  /**
+   * Ids of files written to since they were last synced.
+   */
+  static IdSet unsynced_files_;
+
+  /**
+   * Physical I/O counts of all files.
+   */
+  static FileIOStats io_stats_;
 
   /**
    * Name of the file this object represents.
    */
   std::string filename_;
 
+  /**
+   * FileCatalog id of the file.
+   */
+  FileId id_;
+
+  /**
+   * Whether this object may only read the file.
+   */
+  bool read_only_;
+
+  /**
+   * State shared with other File objects for the same file.
+   */
+  std::shared_ptr<FileState> state_;
+
   /**
    * Stream for underlying filesystem object.
    */
   std::shared_ptr<std::fstream> stream_;
 
   friend class FileIterator;
+  friend class LogMgr;
 };
 
 class PageFile : public File {
@@ -250,26 +945,40 @@ class PageFile : public File {
   /**
    * Opens the file named fileName and returns the corresponding File object.
 	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * that already open file. Reference count (kept in the open_files_ static table inside the File object) is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened. The stream associated with this File object is stored in the
+	 * open_files_ table under the file's FileCatalog id.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
   static PageFile open(const std::string& filename);
 
+  /**
+   * Opens the file named fileName read-only and maps it into memory.  Pages
+   * can then be read through mappedPage() without a copy or a system call.
+   * A file in an older format has to be opened for writing once first.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileReadOnlyException   If the file needs to be upgraded to the
+   *                                  current format.
+   */
+  static PageFile openReadOnly(const std::string& filename);
+
   /**
    * Constructs a file object representing a file on the filesystem.
    *
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param read_only   Whether to open the file read-only and map it.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  PageFile(const std::string& name, const bool create_new);
+  PageFile(const std::string& name, const bool create_new,
+           const bool read_only = false);
 
   /**
    * Copy constructor.
@@ -300,6 +1009,8 @@ class PageFile : public File {
    */
   Page allocatePage(PageId &new_page_number) override;
 
+  using File::allocatePage;
+
   /**
    * Reads an existing page from the file.
    *
@@ -307,6 +1018,8 @@ class PageFile : public File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the file keeps checksums and the page
+   *                                fails its checksum.
    */
   Page readPage(const PageId page_number) const override;
 
@@ -326,6 +1039,18 @@ class PageFile : public File {
    */
   void deletePage(const PageId page_number) override;
 
+  /**
+   * Returns a pointer to an existing page inside the file's memory mapping.
+   *
+   * @param page_number   Number of page.
+   * @return  The mapped page.
+   * @throws  FileNotMappedException  If no File object opened the file
+   *                                  read-only.
+   * @throws  InvalidPageException    If the page doesn't exist in the file or
+   *                                  is not currently used.
+   */
+  const Page* mappedPage(const PageId page_number) const override;
+
   /**
    * Returns an iterator at the first page in the file.
    *
@@ -355,6 +1080,7 @@ class PageFile : public File {
    * @return  The page.
    * @throws  InvalidPageException  If the page is free (unused) and
    *                                allow_free is false.
+   * @throws  CorruptPageException  If the page is used and fails its checksum.
    */
   Page readPage(const PageId page_number, const bool allow_free) const;
 
@@ -379,6 +1105,93 @@ class PageFile : public File {
    */
   PageHeader readPageHeader(const PageId page_number) const;
 
+  /**
+   * Writes only the header of the given page to disk, leaving the record data
+   * and slot table untouched.  No bounds checking is performed.
+   *
+   * @param page_number   Number of page whose header is to be written.
+   * @param header        Header to write.
+   */
+  void writePageHeader(const PageId page_number, const PageHeader& header);
+
+  /**
+   * Returns the next page pointer of the given page as it is on disk.  Only
+   * reads the page header if the pointer hasn't been seen before.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of the page after it in its list.
+   */
+  PageId nextPageNumber(const PageId page_number) const;
+
+  /**
+   * Writes only the next page pointer of the given page to disk.
+   *
+   * @param page_number       Number of page to update.
+   * @param next_page_number  New next page pointer.
+   */
+  void writeNextPageNumber(const PageId page_number,
+                           const PageId next_page_number);
+
+  /**
+   * Remembers the next page pointer a page has on disk.
+   *
+   * @param page_number       Number of page.
+   * @param next_page_number  Next page pointer on disk.
+   */
+  void rememberNextPageNumber(const PageId page_number,
+                              const PageId next_page_number) const;
+
+  /**
+   * Rebuilds the page lists of a file that was in version 1 or older and
+   * converts the page headers of one that was in version 4 or older.
+   *
+   * @param old_version   Version the file was in.
+   */
+  void upgradeContents(const std::uint32_t old_version) override;
+
+  /**
+   * Recomputes the tail of the used list, sorts the free list and fills in
+   * the allocation bitmap of a file that was just upgraded from an older
+   * format.
+   */
+  void rebuildPageLists();
+
+  /**
+   * Converts the header of every used page of a file that was just upgraded
+   * from version 4 or older.
+   */
+  void upgradePageHeaders();
+
+
+  /**
+   * Returns the used page that follows the given page in the used list.
+   * Since the used list is kept in page number order, this is the next set
+   * bit in the allocation bitmaps and no page has to be read.
+   *
+   * @param page_number   Number of page.
+   * @return  Number of next used page, or Page::INVALID_NUMBER if none.
+   */
+  PageId nextUsedPage(const PageId page_number) const;
+
+  /**
+   * Returns the highest numbered page below the given page whose allocation
+   * bit matches <used>, found by scanning the allocation bitmap backwards.
+   * Callers must know such a page exists.
+   *
+   * @param page_number   Number of page to search back from.
+   * @param used          Whether to look for a used or a free page.
+   * @return  Number of the previous used or free page.
+   */
+  PageId findPreviousPage(const PageId page_number, const bool used) const;
+
+  /**
+   * Returns the checksum of a page, leaving out its next page pointer, which
+   * is updated in place as pages are linked and unlinked.
+   *
+   * @param page_data   Page::SIZE bytes of the page as stored.
+   */
+  std::uint32_t pageChecksum(const void* page_data) const override;
+
   friend class FileIterator;
 };
 
@@ -396,15 +1209,36 @@ class BlobFile : public File {
   /**
    * Opens the file named fileName and returns the corresponding File object.
 	 * It first checks if the file is already open. If so, then the new File object created uses the same input-output stream to read to or write fom
-	 * that already open file. Reference count (open_counts_ static variable inside the File object) is incremented whenever an already open file is
-	 * opened again. Otherwise the UNIX file is actually opened. The fileName and the stream associated with this File object are inserted into the
-	 * open_streams_ map.
+	 * that already open file. Reference count (kept in the open_files_ static table inside the File object) is incremented whenever an already open file is
+	 * opened again. Otherwise the UNIX file is actually opened. The stream associated with this File object is stored in the
+	 * open_files_ table under the file's FileCatalog id.
    *
    * @param filename  Name of the file.
    * @throws  FileNotFoundException   If the requested file doesn't exist.
    */
   static BlobFile open(const std::string& filename);
 
+  /**
+   * Opens the file named fileName read-only and maps it into memory.
+   *
+   * @see PageFile::openReadOnly()
+   * @param filename  Name of the file.
+   * @throws  FileNotFoundException   If the requested file doesn't exist.
+   * @throws  FileReadOnlyException   If the file needs to be upgraded to the
+   *                                  current format.
+   */
+  static BlobFile openReadOnly(const std::string& filename);
+
+  /**
+   * Creates a new BlobFile that stores its pages compressed.  Pages are
+   * compressed as they are written and decompressed as they are read, so
+   * callers see the same pages as with any other BlobFile.
+   *
+   * @param filename  Name of the file.
+   * @throws  FileExistsException     If the requested file already exists.
+   */
+  static BlobFile createCompressed(const std::string& filename);
+
   /**
    * Constructs a file object representing a file on the filesystem.
    *
@@ -412,12 +1246,14 @@ class BlobFile : public File {
    * @see File::open()
    * @param name        Name of file.
    * @param create_new  Whether to create a new file.
+   * @param read_only   Whether to open the file read-only and map it.
    * @throws  FileExistsException     If the underlying file exists and
    *                                  create_new is true.
    * @throws  FileNotFoundException   If the underlying file doesn't exist and
    *                                  create_new is false.
    */
-  BlobFile(const std::string& name, const bool create_new);
+  BlobFile(const std::string& name, const bool create_new,
+           const bool read_only = false);
 
   /**
    * Copy constructor.
@@ -441,6 +1277,13 @@ class BlobFile : public File {
    */
   ~BlobFile();
 
+  /**
+   * Number of pages reserved at a time when the file grows.  It divides
+   * PageGroupMap::PAGES_PER_GROUP, so an extent never straddles a group's
+   * metadata slot and its pages are contiguous on disk.
+   */
+  static const PageId EXTENT_PAGES = 248;
+
   /**
    * Allocates a new page in the file.
    *
@@ -448,6 +1291,21 @@ class BlobFile : public File {
    */
   Page allocatePage(PageId &new_page_number) override;
 
+  /**
+   * Allocates a new page in the file, as close after the given page as its
+   * extent allows.  If that extent is full, the page goes to the last extent
+   * with a free page left after it, where its own neighbour can go later,
+   * or else to the first free page of the file.  The file only grows once
+   * it has no free page left.
+   *
+   * @param new_page_number   Set to the number of the new page.
+   * @param near_page_number  Page the new page should follow, or
+   *                          Page::INVALID_NUMBER for no preference.
+   * @return The new page.
+   */
+  Page allocatePage(PageId &new_page_number,
+                    const PageId near_page_number) override;
+
   /**
    * Reads an existing page from the file.
    *
@@ -455,6 +1313,8 @@ class BlobFile : public File {
    * @return  The page.
    * @throws  InvalidPageException  If the page doesn't exist in the file or is
    *                                not currently used.
+   * @throws  CorruptPageException  If the file keeps checksums and the page
+   *                                fails its checksum.
    */
   Page readPage(const PageId page_number) const override;
 
@@ -468,11 +1328,200 @@ class BlobFile : public File {
   void writePage(const PageId page_number, const Page& new_page) override;
 
   /**
-   * Deletes a page from the file.
+   * Deletes a page from the file.  The page is free to be allocated again,
+   * and reads as zeros once it is; in a compressed file, the space of its
+   * image is reused as well.
    *
    * @param page_number   Number of page to delete.
+   * @throws  InvalidPageException  If the page doesn't exist in the file or is
+   *                                not currently used.
    */
   void deletePage(const PageId page_number) override;
+
+  /**
+   * Returns a pointer to an existing page inside the file's memory mapping.
+   *
+   * @param page_number   Number of page.
+   * @return  The mapped page.
+   * @throws  FileNotMappedException  If no File object opened the file
+   *                                  read-only, or the file is compressed.
+   * @throws  InvalidPageException    If the page lies past the end of the file.
+   */
+  const Page* mappedPage(const PageId page_number) const override;
+
+  /**
+   * Returns whether the file stores its pages compressed.
+   */
+  bool isCompressed() const {
+    return (state_->header.flags & FileHeader::COMPRESSED) != 0;
+  }
+
+ private:
+  /**
+   * Size in bytes of the units that images are placed and sized in within a
+   * group's data area.
+   */
+  static const std::uint32_t IMAGE_UNIT = 16;
+
+  /**
+   * Number of low bits of a page location that hold the size of the space
+   * reserved for its image, in IMAGE_UNITs.  The bits above hold the image's
+   * offset from the start of the group's data area, in IMAGE_UNITs.
+   */
+  static const std::uint32_t LOCATION_SIZE_BITS = 10;
+
+  /**
+   * Set in a page location if the image is the page itself, uncompressed.
+   */
+  static const std::uint32_t RAW_IMAGE = 1U << 30;
+
+  /**
+   * Size of a group's data area in IMAGE_UNITs; the same as the space its
+   * pages take up in an uncompressed file.
+   */
+  static const std::uint32_t GROUP_DATA_UNITS =
+      PageGroupMap::PAGES_PER_GROUP * (Page::SIZE / IMAGE_UNIT);
+
+  /**
+   * Returns the offset of an image within its group's data area, in
+   * IMAGE_UNITs.
+   *
+   * @param location  Location of the image.
+   */
+  static std::uint32_t imageOffset(const std::uint32_t location) {
+    return (location & ~RAW_IMAGE) >> LOCATION_SIZE_BITS;
+  }
+
+  /**
+   * Returns the size of the space reserved for an image, in IMAGE_UNITs.
+   *
+   * @param location  Location of the image.
+   */
+  static std::uint32_t imageUnits(const std::uint32_t location) {
+    return location & ((1U << LOCATION_SIZE_BITS) - 1);
+  }
+
+  /**
+   * Reads and decompresses a page of a compressed file.
+   *
+   * @param page_number   Number of page.
+   * @param page          Set to the page.
+   * @throws  InvalidPageException  If the stored image is damaged.
+   */
+  void readCompressedPage(const PageId page_number, Page& page) const;
+
+  /**
+   * Compresses a page and writes it to a compressed file.  The image is
+   * written over the page's previous one if it fits there; otherwise it moves
+   * to new space in the group's data area, with some room to grow.
+   *
+   * @param page_number   Number of page.
+   * @param page          Page to write.
+   */
+  void writeCompressedPage(const PageId page_number, const Page& page);
+
+  /**
+   * Reserves space for an image in a group's data area: the first hole left
+   * by an image that moved which is large enough, or else the end of the
+   * area.  The group's images are packed together first if the area is full.
+   *
+   * @param group   Number of page group.
+   * @param units   Size of image in IMAGE_UNITs.
+   * @return  Offset of the space in IMAGE_UNITs.
+   */
+  std::uint32_t allocateImage(const PageId group, const std::uint32_t units);
+
+  /**
+   * Returns the space of an image that is no longer needed to its group's
+   * data area.
+   *
+   * @param group     Number of page group.
+   * @param location  Location of the image.
+   */
+  void freeImage(const PageId group, const std::uint32_t location);
+
+  /**
+   * Moves the images of a group's pages to the start of its data area, one
+   * after the other, dropping the space left behind by images that moved.
+   *
+   * @param group   Number of page group.
+   */
+  void compactGroup(const PageId group);
+
+  /**
+   * Returns the space used in a group's data area, working it out from the
+   * group's locations the first time.
+   *
+   * @param group   Number of page group.
+   */
+  GroupDataSpace& groupDataSpace(const PageId group);
+
+  /**
+   * Returns the position in the file of the given offset within a group's
+   * data area.  The data area takes the place of the group's pages.
+   *
+   * @param group   Number of page group.
+   * @param offset  Offset within data area in IMAGE_UNITs.
+   */
+  static std::streampos imagePosition(const PageId group,
+                                      const std::uint32_t offset) {
+    return groupPosition(group) + static_cast<std::streamoff>(
+        PageGroupMap::METADATA_SLOTS * Page::SIZE) +
+        static_cast<std::streamoff>(offset) * IMAGE_UNIT;
+  }
+
+  /**
+   * Returns the number of bytes of a group's data area that are in use; in a
+   * compressed file, up to the end of the last image.
+   *
+   * @param map         Metadata of the group.
+   * @param num_pages   Number of pages in the group.
+   */
+  std::size_t groupDataLength(const PageGroupMap& map,
+                              const PageId num_pages) const override;
+
+  /**
+   * Returns the lowest numbered free page in the given range.
+   *
+   * @param first     First page of range.
+   * @param last      Page past the end of range.
+   * @param leave_gap Whether to skip free pages that directly follow a used
+   *                  page.
+   * @return  Number of free page, or Page::INVALID_NUMBER if none.
+   */
+  PageId firstFreePage(const PageId first, const PageId last,
+                       const bool leave_gap = false) const;
+
+  /**
+   * Returns the highest numbered free page in the given range.
+   *
+   * @param first   First page of range.
+   * @param last    Page past the end of range.
+   * @return  Number of free page, or Page::INVALID_NUMBER if none.
+   */
+  PageId lastFreePage(const PageId first, const PageId last) const;
+
+  /**
+   * Grows the file up to the end of the next extent and reserves space for
+   * it on disk.  The new pages are free.
+   *
+   * @param header  File header, updated to cover the new pages.
+   * @return  Number of the first new page.
+   */
+  PageId reserveExtent(FileHeader& header);
+
+  /**
+   * Marks every page of a file that was in version 2 or older as used.
+   *
+   * @param old_version   Version the file was in.
+   */
+  void upgradeContents(const std::uint32_t old_version) override;
+
+  /**
+   * Marks every page in the file as used.  Files written before blob files
+   * had an allocation bitmap have no free pages.
+   */
+  void markAllPagesUsed();
 };
 
 }
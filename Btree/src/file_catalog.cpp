@@ -0,0 +1,41 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "file_catalog.h"
+
+namespace badgerdb {
+
+const FileId FileCatalog::INVALID_ID;
+
+FileCatalog::IdMap FileCatalog::ids_;
+std::vector<std::string> FileCatalog::names_(1 /* INVALID_ID */);
+
+FileId FileCatalog::idOf(const std::string& filename) {
+  IdMap::const_iterator entry = ids_.find(filename);
+  if (entry != ids_.end()) {
+    return entry->second;
+  }
+  const FileId id = endId();
+  names_.push_back(filename);
+  ids_[filename] = id;
+  return id;
+}
+
+bool FileCatalog::find(const std::string& filename, FileId& id) {
+  IdMap::const_iterator entry = ids_.find(filename);
+  if (entry == ids_.end()) {
+    return false;
+  }
+  id = entry->second;
+  return true;
+}
+
+void FileCatalog::retire(const std::string& filename) {
+  ids_.erase(filename);
+}
+
+}
@@ -0,0 +1,93 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "types.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Catalog of the files known to the process, which gives each of them
+ *        a small integer id.
+ *
+ * A file keeps its id for as long as it exists, however many File objects
+ * are opened and closed on it, so the registry of open files and the buffer
+ * pool can key on the id instead of comparing names or File pointers.  Ids
+ * are handed out in increasing order and never reused: a file that is removed
+ * and created again gets a new id, so nothing cached for the old file can be
+ * mistaken for the new one.
+ *
+ * @warning This class is not threadsafe.
+ */
+class FileCatalog {
+ public:
+  /**
+   * Id that no file has.
+   */
+  static const FileId INVALID_ID = 0;
+
+  /**
+   * Returns the id of the named file, giving it one if it has none yet.
+   *
+   * @param filename  Name of the file.
+   * @return  Id of the file.
+   */
+  static FileId idOf(const std::string& filename);
+
+  /**
+   * Looks up the id of the named file without giving it one.
+   *
+   * @param filename  Name of the file.
+   * @param id        Set to the id of the file if it has one.
+   * @return  Whether the file has an id.
+   */
+  static bool find(const std::string& filename, FileId& id);
+
+  /**
+   * Returns the name of the file with the given id.  Ids of removed files
+   * keep their name.
+   *
+   * @param id  Id of the file.
+   * @return  Name of the file.
+   */
+  static const std::string& filename(const FileId id) { return names_[id]; }
+
+  /**
+   * Returns one more than the largest id handed out so far, so that tables
+   * indexed by id can be sized.
+   */
+  static FileId endId() { return static_cast<FileId>(names_.size()); }
+
+  /**
+   * Forgets the id of the named file, which has been removed.  The next file
+   * created under the name gets a new id.
+   *
+   * @param filename  Name of the file.
+   */
+  static void retire(const std::string& filename);
+
+ private:
+  typedef std::unordered_map<std::string, FileId> IdMap;
+
+  /**
+   * Ids of the files that currently have one.
+   */
+  static IdMap ids_;
+
+  /**
+   * Name of each id handed out, indexed by id.  Entry INVALID_ID is empty.
+   */
+  static std::vector<std::string> names_;
+};
+
+}
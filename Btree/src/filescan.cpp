@@ -6,38 +6,102 @@
  */
 
 #include "filescan.h"
+
+#include <cstring>
+#include "heapfile.h"
+#include "parallel_filescan.h"
 #include "exceptions/end_of_file_exception.h"
+#include "exceptions/invalid_pax_layout_exception.h"
+#include "exceptions/invalid_record_exception.h"
 
 namespace badgerdb { 
 
-FileScan::FileScan(const std::string &name, BufMgr *bufferMgr)
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   const Predicate &scanPredicate)
+: overflow(name, bufferMgr), predicate(scanPredicate)
 {
   file = new PageFile(name, false);	//dont create new file
 	bufMgr = bufferMgr;
 	curDirtyFlag = false;
   curPage = NULL;
+  paxSlot = Page::INVALID_SLOT;
+  morsels = NULL;
+  morselPages = NULL;
+  morselLength = morselPos = 0;
+  holdPages = pageInBatch = false;
 	filePageIter = file->begin();
+  openSummaries(name);
+}
+
+FileScan::FileScan(const std::string &name, BufMgr *bufferMgr,
+                   MorselQueue *morselQueue, const Predicate &scanPredicate)
+: overflow(name, bufferMgr), predicate(scanPredicate)
+{
+  file = new PageFile(name, false);	//dont create new file
+	bufMgr = bufferMgr;
+	curDirtyFlag = false;
+  curPage = NULL;
+  paxSlot = Page::INVALID_SLOT;
+  morsels = morselQueue;
+  morselPages = NULL;
+  morselLength = morselPos = 0;
+  holdPages = pageInBatch = false;
+  openSummaries(name);
+}
+
+void FileScan::openSummaries(const std::string &name)
+{
+  zoneMap = NULL;
+  bloomFilters = NULL;
+  if (predicate.matchesAll())
+  {
+    return;
+  }
+  if (File::exists(ZoneMap::nameFor(name)))
+  {
+    zoneMap = new ZoneMap(name, bufMgr);
+  }
+  if (File::exists(BloomFilterFile::nameFor(name)))
+  {
+    bloomFilters = new BloomFilterFile(name, bufMgr);
+  }
 }
 
 FileScan::~FileScan()
 {
+  releaseHeldPages();
   // generally must unpin last page of the scan
   if (curPage != NULL)
   {
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    bufMgr->unPinPage(file, pageNo(), curDirtyFlag);
     curPage = NULL;
 		curDirtyFlag = false;
-    filePageIter = file->begin();
   }
-  bufMgr->flushFile(file);
+  if (morsels == NULL)
+  {
+    bufMgr->flushFile(file);
+  }
+  delete zoneMap;
+  delete bloomFilters;
   delete file;
 }
 
 void FileScan::scanNext(RecordId& outRid)
 {
-  std::string rec;
+	// Loop, looking for a record that satisfies the predicate.
+  do
+  {
+    nextRecord();
+  }
+  while (!predicate.matchesAll() && !currentMatches());
+
+	// return rid of the record
+	outRid = homeRecordId();
+}
 
-  if (filePageIter == file->end())
+void FileScan::nextRecord()
+{
+  if (!morePages())
 	{
 		throw EndOfFileException();
 	}
@@ -46,69 +110,349 @@ void FileScan::scanNext(RecordId& outRid)
   if (curPage == NULL)
   {
     // need to get the first page of the file
-		filePageIter = file->begin();
-    if(filePageIter == file->end())
+		firstPage();
+    skipPages();
+    if(!morePages())
 		{
 			throw EndOfFileException();
 		}
 	 
 		// read the first page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage); 
+    bufMgr->readPage(file, pageNo(), curPage); 
+    scanStats.pagesRead++;
 		curDirtyFlag = false;
 
 		// get the first record off the page
-    pageRecordIter = curPage->begin(); 
+    startPage();
 
-		if(pageRecordIter != curPage->end()) 
+		if(!atPageEnd())
 		{
-		  // get pointer to record
-		  rec = *pageRecordIter;
-
-			outRid = pageRecordIter.getCurrentRecord();
 			return;
 		}
   }
 
-	// Loop, looking for a record that satisfied the predicate.
-	// First try and get the next record off the current page
-	pageRecordIter++;
+	// First try and get the next record off the current page.  A batch may
+	// have left the scan past the last one already.
+	if (!atPageEnd())
+	{
+		nextOnPage();
+	}
 
-  while (pageRecordIter == curPage->end())
+  while (atPageEnd())
   {
     // unpin the current page
-    bufMgr->unPinPage(file, (*filePageIter).page_number(), curDirtyFlag);
+    releasePage();
     curPage = NULL;
     curDirtyFlag = false;
 
-    filePageIter++;
-    if (filePageIter == file->end())
+    advancePage();
+    skipPages();
+    if (!morePages())
     {
       curPage = NULL;
 			throw EndOfFileException();
     }
 
     // read the next page of the file
-    bufMgr->readPage(file, (*filePageIter).page_number(), curPage);
+    bufMgr->readPage(file, pageNo(), curPage);
+    scanStats.pagesRead++;
 
     // get the first record off the page
-    pageRecordIter = curPage->begin(); 
+    startPage();
   }
 
   // curRec points at a valid record
-  // see if the record satisfies the scan's predicate 
-  // get a pointer to the record
-  rec = *pageRecordIter;
+}
 
-	// return rid of the record
-	outRid = pageRecordIter.getCurrentRecord();
-	return;
+bool FileScan::scanNextBatch(RecordBatch& batch)
+{
+  releaseHeldPages();
+  batch.clear();
+  holdPages = batch.hasRecordViews();
+  pageInBatch = false;
+  try
+  {
+    // Only pages with records in the batch are held, so moving to the next
+    // record holds at most one more.
+    while (!batch.full() && heldPages.size() + 1 < RecordBatch::MAX_PAGES)
+    {
+      RecordId rid;
+      scanNext(rid);
+      // Records of PAX pages are assembled in a buffer of the scan.
+      batch.append(rid, getRecordView(), onPaxPage());
+      pageInBatch = true;
+
+      // Take the rest of the page's records without going through scanNext.
+      // The scan stays on the last record appended, or past the last one of
+      // the page, so that scanNext carries on after it.
+      while (!batch.full())
+      {
+        nextOnPage();
+        if (atPageEnd())
+        {
+          break;
+        }
+        if (predicate.matchesAll() || currentMatches())
+        {
+          batch.append(homeRecordId(), getRecordView(), onPaxPage());
+        }
+      }
+    }
+  }
+  catch(const EndOfFileException &e)
+  {
+  }
+  holdPages = false;
+  batch.finish();
+  return !batch.empty();
+}
+
+void FileScan::releasePage()
+{
+  if (holdPages && pageInBatch)
+  {
+    heldPages.push_back(std::make_pair(pageNo(), curDirtyFlag));
+  }
+  else
+  {
+    bufMgr->unPinPage(file, pageNo(), curDirtyFlag);
+  }
+  pageInBatch = false;
+}
+
+void FileScan::releaseHeldPages()
+{
+  for (std::size_t i = 0; i < heldPages.size(); i++)
+  {
+    bufMgr->unPinPage(file, heldPages[i].first, heldPages[i].second);
+  }
+  heldPages.clear();
+}
+
+bool FileScan::currentMatches()
+{
+  const RecordView view = getRecordView();
+  if (view.length < predicate.extent() && hasOverflow())
+  {
+    // The predicate reads part of the overflow chain.
+    const std::string record = getRecord();
+    return predicate.matches(record.data(), record.length());
+  }
+  return predicate.matches(view);
+}
+
+bool FileScan::morePages()
+{
+  if (morsels == NULL)
+  {
+    return filePageIter != file->end();
+  }
+  if (morselPos == morselLength)
+  {
+    morselPos = 0;
+    if (!morsels->next(morselPages, morselLength))
+    {
+      morselLength = 0;
+      return false;
+    }
+  }
+  return true;
+}
+
+void FileScan::firstPage()
+{
+  if (morsels == NULL)
+  {
+    filePageIter = file->begin();
+  }
+}
+
+void FileScan::advancePage()
+{
+  if (morsels == NULL)
+  {
+    filePageIter++;
+  }
+  else
+  {
+    morselPos++;
+  }
+}
+
+PageId FileScan::pageNo() const
+{
+  if (morsels == NULL)
+  {
+    return filePageIter.page_number();
+  }
+  return morselPages[morselPos];
+}
+
+void FileScan::skipPages()
+{
+  if (zoneMap == NULL && bloomFilters == NULL)
+  {
+    return;
+  }
+  while (morePages())
+  {
+    if (zoneMap != NULL && !zoneMap->mayMatch(pageNo(), predicate))
+    {
+      scanStats.zoneMapSkips++;
+    }
+    else if (bloomFilters != NULL && !bloomFilters->mayMatch(pageNo(), predicate))
+    {
+      scanStats.bloomFilterSkips++;
+    }
+    else
+    {
+      return;
+    }
+    advancePage();
+  }
+}
+
+void FileScan::startPage()
+{
+  if (PaxPage::isPaxPage(*curPage))
+  {
+    curPaxPage = PaxPage(curPage);
+    paxSlot = curPaxPage.nextUsedSlot(Page::INVALID_SLOT);
+  }
+  else
+  {
+    curPaxPage = PaxPage();
+    pageRecordIter = curPage->begin();
+    skipForwardingStubs();
+  }
+}
+
+void FileScan::nextOnPage()
+{
+  if (onPaxPage())
+  {
+    paxSlot = curPaxPage.nextUsedSlot(paxSlot);
+  }
+  else
+  {
+    pageRecordIter++;
+    skipForwardingStubs();
+  }
+}
+
+void FileScan::skipForwardingStubs()
+{
+  // The record a stub points at is returned where it is stored instead.
+  while (pageRecordIter != curPage->end() &&
+         (curPage->getRecordFlags(pageRecordIter.getCurrentRecord()) &
+          Page::RECORD_FORWARDED))
+  {
+    pageRecordIter++;
+  }
+}
+
+bool FileScan::atPageEnd()
+{
+  if (onPaxPage())
+  {
+    return paxSlot == Page::INVALID_SLOT;
+  }
+  return pageRecordIter == curPage->end();
+}
+
+RecordId FileScan::currentRecordId()
+{
+  if (onPaxPage())
+  {
+    const RecordId rid = {curPage->page_number(), paxSlot, 0};
+    return rid;
+  }
+  return pageRecordIter.getCurrentRecord();
+}
+
+RecordId FileScan::homeRecordId()
+{
+  if (onPaxPage())
+  {
+    return currentRecordId();
+  }
+  const RecordId rid = pageRecordIter.getCurrentRecord();
+  if (curPage->getRecordFlags(rid) & Page::RECORD_MOVED)
+  {
+    RecordId homeRid;
+    memcpy(&homeRid, curPage->getRecordView(rid).data, sizeof(RecordId));
+    return homeRid;
+  }
+  return rid;
 }
 
 // returns pointer to the current record.  page is left pinned
 // and the scan logic is required to unpin the page 
 std::string FileScan::getRecord()
 {
-  return *pageRecordIter;
+  if (onPaxPage())
+  {
+    return curPaxPage.getRecord(currentRecordId());
+  }
+  std::uint8_t flags;
+  const RecordView bytes = HeapFile::storedBytes(*curPage, currentRecordId(), flags);
+  if (flags & Page::RECORD_OVERFLOW)
+  {
+    const OverflowStub stub = HeapFile::overflowStub(bytes);
+    std::string record(HeapFile::INLINE_PREFIX_LENGTH + stub.length, '\0');
+    memcpy(&record[0], bytes.data, HeapFile::INLINE_PREFIX_LENGTH);
+    overflow.read(stub, &record[HeapFile::INLINE_PREFIX_LENGTH]);
+    return record;
+  }
+  return bytes.toString();
+}
+
+RecordView FileScan::getRecordView()
+{
+  if (onPaxPage())
+  {
+    // The buffer keeps its capacity, so this allocates once per scan.
+    paxRecord.resize(curPaxPage.recordLength());
+    curPaxPage.getRecord(currentRecordId(), &paxRecord[0]);
+    const RecordView view = {paxRecord.data(), paxRecord.size()};
+    return view;
+  }
+  std::uint8_t flags;
+  RecordView bytes = HeapFile::storedBytes(*curPage, currentRecordId(), flags);
+  if (flags & Page::RECORD_OVERFLOW)
+  {
+    bytes.length = HeapFile::INLINE_PREFIX_LENGTH;
+  }
+  return bytes;
+}
+
+bool FileScan::hasOverflow()
+{
+  if (onPaxPage())
+  {
+    return false;
+  }
+  return (curPage->getRecordFlags(currentRecordId()) & Page::RECORD_OVERFLOW) != 0;
+}
+
+OverflowStub FileScan::getOverflowStub()
+{
+  const RecordId rid = currentRecordId();
+  if (!hasOverflow())
+  {
+    throw InvalidRecordException(rid, rid.page_number);
+  }
+  std::uint8_t flags;
+  return HeapFile::overflowStub(HeapFile::storedBytes(*curPage, rid, flags));
+}
+
+const PaxPage& FileScan::getPaxPage() const
+{
+  if (!onPaxPage())
+  {
+    throw InvalidPaxLayoutException("the current page of the scan is not a PAX page");
+  }
+  return curPaxPage;
 }
 
 // mark current page of scan dirty
@@ -9,34 +9,182 @@
 #pragma once
 
 #include <string>
+#include <utility>
+#include <vector>
 #include "types.h"
 #include "page.h"
 #include "buffer.h"
 #include "file_iterator.h"
 #include "page_iterator.h"
+#include "pax_page.h"
+#include "overflow.h"
+#include "predicate.h"
+#include "record_batch.h"
+#include "zone_map.h"
+#include "bloom_filter.h"
 
 namespace badgerdb {
 
+class MorselQueue;
+
+/**
+ * @brief Statistics about the pages a scan went through.
+ */
+struct ScanStats
+{
+  /**
+   * Number of pages read
+   */
+  int pagesRead;
+
+  /**
+   * Number of pages skipped without being read, because the zone map showed
+   * none of their records could match the predicate
+   */
+  int zoneMapSkips;
+
+  /**
+   * Number of pages skipped without being read, because the Bloom filters
+   * showed none of their records could match the predicate
+   */
+  int bloomFilterSkips;
+
+  /**
+   * Returns the number of pages skipped without being read
+   */
+  int pagesSkipped() const
+  {
+    return zoneMapSkips + bloomFilterSkips;
+  }
+
+  /**
+   * Returns the fraction of the pages scanned that were skipped
+   */
+  double skipRate() const
+  {
+    const int pages = pagesRead + pagesSkipped();
+    return pages == 0 ? 0 : static_cast<double>(pagesSkipped()) / pages;
+  }
+
+  /**
+   * Clear all values
+   */
+  void clear()
+  {
+    pagesRead = zoneMapSkips = bloomFilterSkips = 0;
+  }
+
+  /**
+   * Constructor of ScanStats class
+   */
+  ScanStats()
+  {
+    clear();
+  }
+};
+
 /**
  * @brief This class is used to sequentially scan records in a relation.
+ *
+ * Pages may be slotted pages or PAX pages.  Records of PAX pages are assembled
+ * from their columns when read as a whole; getColumnValue reads a single
+ * column instead, touching only that column's bytes.
+ *
+ * Records with an overflow chain (see HeapFile) are returned whole by
+ * getRecord, but getRecordView returns only the part on the page, so a scan
+ * that doesn't need the tail never reads the overflow chains.  The tail can
+ * be streamed with an OverflowReader:
+ *
+ * @code
+ * OverflowReader reader(scan.getOverflowFile(), scan.getOverflowStub());
+ * RecordView chunk;
+ * while (reader.nextChunk(chunk)) { ... }
+ * @endcode
+ *
+ * A record moved to another page by HeapFile::updateRecord is returned where
+ * it is stored, under its original RecordId, and its forwarding stub is
+ * skipped, so the scan reads no extra pages for it.
+ *
+ * A scan may be given a Predicate, which scanNext evaluates on the bytes of
+ * each record in place on the pinned page, returning only the records that
+ * match, so the others are never copied.  Records of PAX pages are assembled
+ * in a buffer of the scan first, and the overflow chain of a record is only
+ * read if the predicate reaches past the part on the page.
+ *
+ * scanNextBatch returns up to a batch of records per call instead, with
+ * views of their bytes on pages kept pinned until the next call and chosen
+ * attributes projected into arrays (see RecordBatch).
+ *
+ * If the relation has a ZoneMap or Bloom filters (see HeapFile::createZoneMap
+ * and HeapFile::createBloomFilters), a scan with a predicate looks up each
+ * page's ranges and filters before reading it and skips pages none of whose
+ * records can match, counting them in its ScanStats.  Filters are only used
+ * by equality terms, such as those of an anyOf list of wanted values.
+ *
+ * A scan given a MorselQueue only scans the pages of the morsels it takes
+ * from the queue; ParallelFileScan runs several such scans of one relation
+ * on different threads.
  */
 class FileScan
 {
  public:
 
-  FileScan(const std::string &name, BufMgr *bufMgr);
+  FileScan(const std::string &name, BufMgr *bufMgr,
+           const Predicate &predicate = Predicate());
+
+  //scans only the pages of morsels taken from the queue, which must outlive the scan
+  //the file is not flushed when the scan is destroyed, since other scans may have its pages pinned
+  FileScan(const std::string &name, BufMgr *bufMgr, MorselQueue *morsels,
+           const Predicate &predicate = Predicate());
 
   ~FileScan();
 
-  //return RecordId of next record that satisfies the scan 
+  //return RecordId of next record that satisfies the scan predicate
   void scanNext(RecordId& outRid);
 
-  //read current record, returning pointer and length
+  //fill the batch with the next records that satisfy the scan predicate; returns false if there are none left
+  //the views of the previous batch are invalid once this is called, and the scan has no current record after it
+  bool scanNextBatch(RecordBatch& batch);
+
+  //read current record, returning a copy, including any part in an overflow chain
   std::string getRecord();
 
+  //read current record in place, returning pointer and length; valid until the next scanNext
+  //records of PAX pages are assembled in a buffer of the scan instead
+  //for a record with an overflow chain, only the part on the page, without the stub
+  RecordView getRecordView();
+
+  //whether the current record has a tail in an overflow chain
+  bool hasOverflow();
+
+  //stub of the overflow chain of the current record; throws InvalidRecordException if it has none
+  OverflowStub getOverflowStub();
+
+  //overflow chains of the relation
+  OverflowFile& getOverflowFile() { return overflow; }
+
+  //whether the current record is on a PAX page
+  bool onPaxPage() const { return curPaxPage.page() != NULL; }
+
+  //current page as a PAX page; throws InvalidPaxLayoutException if it isn't one
+  const PaxPage& getPaxPage() const;
+
+  //read one column of the current record of a PAX page; T must be as wide as the column
+  template <typename T>
+  T getColumnValue(const std::uint16_t column) const
+  {
+    return getPaxPage().getValue<T>(paxSlot, column);
+  }
+
   //marks current page of scan dirty
   void markDirty();
 
+  //statistics about the pages read and skipped
+  ScanStats & getScanStats() { return scanStats; }
+
+  //clears the statistics about the pages read and skipped
+  void clearScanStats() { scanStats.clear(); }
+
  private:
   /**
    * File which is being scanned.
@@ -56,10 +204,168 @@ class FileScan
   FileIterator  filePageIter;
   PageIterator  pageRecordIter;
 
+  /**
+   * Queue the pages to scan are taken from, or NULL to scan the whole file.
+   */
+  MorselQueue   *morsels;
+
+  /**
+   * Pages of the current morsel, their number, and the position of the
+   * current page among them.
+   */
+  const PageId  *morselPages;
+  std::size_t   morselLength;
+  std::size_t   morselPos;
+
+  /**
+   * Current page if it is a PAX page, else a view of no page.
+   */
+  PaxPage       curPaxPage;
+
+  /**
+   * Slot of the current record if the current page is a PAX page.
+   */
+  SlotId        paxSlot;
+
+  /**
+   * Buffer records of PAX pages are assembled in by getRecordView.
+   */
+  std::string   paxRecord;
+
+  /**
+   * Overflow chains of the relation.
+   */
+  OverflowFile  overflow;
+
+  /**
+   * Pages left pinned for the views of the current batch, with whether they
+   * are dirty.
+   */
+  std::vector<std::pair<PageId, bool> > heldPages;
+
+  /**
+   * Whether pages the current batch has records on are kept pinned when the
+   * scan moves past them.
+   */
+  bool          holdPages;
+
+  /**
+   * Whether the current batch has records on the current page.
+   */
+  bool          pageInBatch;
+
+  /**
+   * Condition records returned by scanNext satisfy.
+   */
+  Predicate     predicate;
+
+  /**
+   * Zone map of the relation, or NULL if it has none or the scan has no
+   * predicate.
+   */
+  ZoneMap       *zoneMap;
+
+  /**
+   * Bloom filters of the relation, or NULL if it has none or the scan has no
+   * predicate.
+   */
+  BloomFilterFile *bloomFilters;
+
+  /**
+   * Statistics about the pages read and skipped.
+   */
+  ScanStats     scanStats;
+
   /**
    * True if page has been updated
    */
   bool  	      curDirtyFlag;
+
+  /**
+   * Opens the zone map and Bloom filters of the relation if it has them and
+   * the predicate can use them.
+   */
+  void openSummaries(const std::string &name);
+
+  /**
+   * Moves the scan past pages the zone map or Bloom filters show have no
+   * matching records.
+   */
+  void skipPages();
+
+  /**
+   * Returns whether the scan has a page left to read, taking the next morsel
+   * from the queue if the current one is used up.
+   */
+  bool morePages();
+
+  /**
+   * Moves the scan to its first page.
+   */
+  void firstPage();
+
+  /**
+   * Moves the scan to its next page.
+   */
+  void advancePage();
+
+  /**
+   * Returns the number of the page the scan is at.
+   */
+  PageId pageNo() const;
+
+  /**
+   * Unpins the current page, or keeps it pinned for the current batch.
+   */
+  void releasePage();
+
+  /**
+   * Unpins the pages kept pinned for the previous batch.
+   */
+  void releaseHeldPages();
+
+  /**
+   * Moves the scan to the next record of the file, whether it matches the
+   * predicate or not.
+   */
+  void nextRecord();
+
+  /**
+   * Returns whether the current record matches the predicate.
+   */
+  bool currentMatches();
+
+  /**
+   * Positions the scan at the first record of the current page.
+   */
+  void startPage();
+
+  /**
+   * Moves the scan to the next record of the current page.
+   */
+  void nextOnPage();
+
+  /**
+   * Returns whether the scan is past the last record of the current page.
+   */
+  bool atPageEnd();
+
+  /**
+   * Moves the scan past forwarding stubs on the current page.
+   */
+  void skipForwardingStubs();
+
+  /**
+   * Returns the RecordId of the current record, i.e. of the slot it is
+   * stored in.
+   */
+  RecordId currentRecordId();
+
+  /**
+   * Returns the RecordId the current record is known by, which for a moved
+   * record is that of its forwarding stub.
+   */
+  RecordId homeRecordId();
 };
 
 }
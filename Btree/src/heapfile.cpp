@@ -0,0 +1,855 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "heapfile.h"
+
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include "file_iterator.h"
+#include "page_iterator.h"
+#include "pax_page.h"
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_record_exception.h"
+
+namespace badgerdb {
+
+const std::uint32_t FreeSpaceMap::NUM_BUCKETS;
+const std::uint32_t FreeSpaceMap::BUCKET_BYTES;
+const std::uint8_t FreeSpaceMap::NO_BUCKET;
+const std::size_t HeapFile::MAX_INLINE_LENGTH;
+const std::size_t HeapFile::INLINE_PREFIX_LENGTH;
+const std::size_t HeapFile::MAP_BATCH_PAGES;
+
+FreeSpaceMap::FreeSpaceMap()
+: nonEmptyBuckets(0)
+{
+}
+
+void FreeSpaceMap::update(const PageId pageNo, const std::size_t freeSpace)
+{
+  remove(pageNo);
+
+  // Pages in bucket 0 can't be handed out for any record, so they aren't kept.
+  const std::uint32_t bucket =
+      std::min<std::size_t>(freeSpace / BUCKET_BYTES, NUM_BUCKETS - 1);
+  if (bucket == 0)
+  {
+    return;
+  }
+  if (pageNo >= pageBuckets.size())
+  {
+    pageBuckets.resize(pageNo + 1, NO_BUCKET);
+    pagePositions.resize(pageNo + 1);
+  }
+  pageBuckets[pageNo] = bucket;
+  pagePositions[pageNo] = buckets[bucket].size();
+  buckets[bucket].push_back(pageNo);
+  nonEmptyBuckets |= std::uint64_t(1) << bucket;
+}
+
+void FreeSpaceMap::remove(const PageId pageNo)
+{
+  if (pageNo >= pageBuckets.size() || pageBuckets[pageNo] == NO_BUCKET)
+  {
+    return;
+  }
+  const std::uint32_t bucket = pageBuckets[pageNo];
+  std::vector<PageId>& pages = buckets[bucket];
+
+  // Move the last page of the bucket into the hole.
+  const PageId lastPageNo = pages.back();
+  pages[pagePositions[pageNo]] = lastPageNo;
+  pagePositions[lastPageNo] = pagePositions[pageNo];
+  pages.pop_back();
+  pageBuckets[pageNo] = NO_BUCKET;
+
+  if (pages.empty())
+  {
+    nonEmptyBuckets &= ~(std::uint64_t(1) << bucket);
+  }
+}
+
+PageId FreeSpaceMap::find(const std::size_t recordSize) const
+{
+  // Every page in this bucket or above has room for the record.
+  const std::size_t firstBucket = (recordSize + BUCKET_BYTES - 1) / BUCKET_BYTES;
+  if (firstBucket >= NUM_BUCKETS)
+  {
+    return Page::INVALID_NUMBER;
+  }
+  const std::uint64_t candidates =
+      nonEmptyBuckets & (~std::uint64_t(0) << firstBucket);
+  if (candidates == 0)
+  {
+    return Page::INVALID_NUMBER;
+  }
+  return buckets[__builtin_ctzll(candidates)].back();
+}
+
+HeapFile::HeapFile(const std::string &name, BufMgr *bufMgr, const bool create_new)
+: file(new PageFile(name, create_new)), bufMgr(bufMgr), overflow(name, bufMgr),
+  zoneMap(NULL), bloomFilters(NULL)
+{
+  try
+  {
+    // Chains left by an earlier relation of the same name belong to no record.
+    const std::string overflowName = OverflowFile::nameFor(name);
+    if (create_new && File::exists(overflowName))
+    {
+      File::remove(overflowName);
+    }
+    const std::string zoneMapName = ZoneMap::nameFor(name);
+    if (create_new && File::exists(zoneMapName))
+    {
+      File::remove(zoneMapName);
+    }
+    else if (File::exists(zoneMapName))
+    {
+      zoneMap = new ZoneMap(name, bufMgr);
+    }
+    const std::string bloomName = BloomFilterFile::nameFor(name);
+    if (create_new && File::exists(bloomName))
+    {
+      File::remove(bloomName);
+    }
+    else if (File::exists(bloomName))
+    {
+      bloomFilters = new BloomFilterFile(name, bufMgr);
+    }
+    unmappedPage = file->begin();
+  }
+  catch(...)
+  {
+    // The destructor doesn't run for a relation that failed to open.
+    delete zoneMap;
+    delete bloomFilters;
+    delete file;
+    throw;
+  }
+}
+
+HeapFile::~HeapFile()
+{
+  try
+  {
+    close();
+  }
+  catch(...)
+  {
+  }
+}
+
+void HeapFile::close()
+{
+  if (file == NULL)
+  {
+    return;
+  }
+  // Each file is only closed once its pages are out of the buffer pool.
+  if (zoneMap != NULL)
+  {
+    zoneMap->flush();
+    delete zoneMap;
+    zoneMap = NULL;
+  }
+  if (bloomFilters != NULL)
+  {
+    bloomFilters->flush();
+    delete bloomFilters;
+    bloomFilters = NULL;
+  }
+  overflow.flush();
+  bufMgr->flushFile(file);
+  delete file;
+  file = NULL;
+}
+
+RecordId HeapFile::insertRecord(const std::string &record, const std::size_t target)
+{
+  return insertRecord(record.data(), record.length(), target);
+}
+
+RecordId HeapFile::insertRecord(const char *record, const std::size_t length,
+                                const std::size_t target)
+{
+  if (length > MAX_INLINE_LENGTH)
+  {
+    return insertOverflowRecord(record, length, target);
+  }
+  if (length < sizeof(RecordId))
+  {
+    char padded[sizeof(RecordId)];
+    padRecord(record, length, padded);
+    Page* page;
+    const PageId pageNo = pinPageForRecord(sizeof(RecordId), target, page);
+    const RecordId rid = page->insertRecord(padded, sizeof(RecordId));
+    page->setRecordFlags(rid, Page::RECORD_PADDED);
+    updateSummaries(pageNo, record, length);
+    bufMgr->unPinPage(file, pageNo, true);
+    return rid;
+  }
+  Page* page;
+  const PageId pageNo = pinPageForRecord(length, target, page);
+  const RecordId rid = page->insertRecord(record, length);
+  updateSummaries(pageNo, record, length);
+  bufMgr->unPinPage(file, pageNo, true);
+  return rid;
+}
+
+void HeapFile::insertRecords(const RecordView *records, const std::size_t numRecords,
+                             RecordId *rids, const std::size_t target)
+{
+  std::size_t numInserted = 0;
+  while (numInserted < numRecords)
+  {
+    const RecordView &record = records[numInserted];
+    if (!isStoredAsIs(record.length))
+    {
+      const RecordId rid = insertRecord(record.data, record.length, target);
+      if (rids != NULL)
+      {
+        rids[numInserted] = rid;
+      }
+      numInserted++;
+      continue;
+    }
+
+    // Hand the page the run of records up to the next one that isn't stored
+    // as is.
+    std::size_t runEnd = numInserted + 1;
+    while (runEnd < numRecords && isStoredAsIs(records[runEnd].length))
+    {
+      runEnd++;
+    }
+    Page* page;
+    const PageId pageNo = pinPageForRecord(record.length, target, page);
+    const std::size_t numOnPage =
+        page->insertRecords(records + numInserted, runEnd - numInserted,
+                            rids == NULL ? NULL : rids + numInserted);
+    for (std::size_t i = numInserted; i < numInserted + numOnPage; i++)
+    {
+      updateSummaries(pageNo, records[i].data, records[i].length);
+    }
+    numInserted += numOnPage;
+    bufMgr->unPinPage(file, pageNo, true);
+  }
+}
+
+RecordId HeapFile::insertOverflowRecord(const char *record, const std::size_t length,
+                                        const std::size_t target)
+{
+  const OverflowStub stub = overflow.write(record + INLINE_PREFIX_LENGTH,
+                                           length - INLINE_PREFIX_LENGTH);
+  char inlinePart[MAX_INLINE_LENGTH];
+  memcpy(inlinePart, record, INLINE_PREFIX_LENGTH);
+  memcpy(inlinePart + INLINE_PREFIX_LENGTH, &stub, sizeof(OverflowStub));
+
+  Page* page;
+  const PageId pageNo = pinPageForRecord(MAX_INLINE_LENGTH, target, page);
+  const RecordId rid = page->insertRecord(inlinePart, MAX_INLINE_LENGTH);
+  page->setRecordFlags(rid, Page::RECORD_OVERFLOW);
+  updateSummaries(pageNo, record, length);
+  bufMgr->unPinPage(file, pageNo, true);
+  return rid;
+}
+
+std::string HeapFile::getRecord(const RecordId &rid)
+{
+  Page* page;
+  RecordId storedRid;
+  pinRecord(rid, page, storedRid);
+  std::uint8_t flags;
+  const RecordView bytes = storedBytes(*page, storedRid, flags);
+  std::string record;
+  OverflowStub stub;
+  const bool hasOverflow = (flags & Page::RECORD_OVERFLOW) != 0;
+  if (hasOverflow)
+  {
+    stub = overflowStub(bytes);
+    record.reserve(INLINE_PREFIX_LENGTH + stub.length);
+    record.assign(bytes.data, INLINE_PREFIX_LENGTH);
+  }
+  else
+  {
+    record.assign(bytes.data, bytes.length);
+  }
+  bufMgr->unPinPage(file, storedRid.page_number, false);
+
+  if (hasOverflow)
+  {
+    record.resize(INLINE_PREFIX_LENGTH + stub.length);
+    overflow.read(stub, &record[INLINE_PREFIX_LENGTH]);
+  }
+  return record;
+}
+
+void HeapFile::updateRecord(const RecordId &rid, const std::string &record)
+{
+  updateRecord(rid, record.data(), record.length());
+}
+
+void HeapFile::updateRecord(const RecordId &rid, const char *record,
+                            const std::size_t length)
+{
+  Page* page;
+  RecordId storedRid;
+  pinRecord(rid, page, storedRid);
+  std::uint8_t oldFlags;
+  const RecordView oldBytes = storedBytes(*page, storedRid, oldFlags);
+  const bool hadOverflow = (oldFlags & Page::RECORD_OVERFLOW) != 0;
+  const OverflowStub oldStub = hadOverflow ? overflowStub(oldBytes) : OverflowStub();
+  const bool moved = (oldFlags & Page::RECORD_MOVED) != 0;
+
+  // Build the new bytes behind room for the home RecordId, which is only
+  // stored if the record ends up away from home.
+  char buffer[sizeof(RecordId) + MAX_INLINE_LENGTH];
+  const RecordId homeRid = {rid.page_number, rid.slot_number, 0};
+  memcpy(buffer, &homeRid, sizeof(RecordId));
+  char *bytes = buffer + sizeof(RecordId);
+  std::size_t bytesLength = length;
+  std::uint8_t flags = 0;
+  OverflowStub stub;
+  if (length > MAX_INLINE_LENGTH)
+  {
+    try
+    {
+      stub = overflow.write(record + INLINE_PREFIX_LENGTH, length - INLINE_PREFIX_LENGTH);
+    }
+    catch(...)
+    {
+      bufMgr->unPinPage(file, storedRid.page_number, false);
+      throw;
+    }
+    memcpy(bytes, record, INLINE_PREFIX_LENGTH);
+    memcpy(bytes + INLINE_PREFIX_LENGTH, &stub, sizeof(OverflowStub));
+    bytesLength = MAX_INLINE_LENGTH;
+    flags = Page::RECORD_OVERFLOW;
+  }
+  else if (length < sizeof(RecordId))
+  {
+    padRecord(record, length, bytes);
+    bytesLength = sizeof(RecordId);
+    flags = Page::RECORD_PADDED;
+  }
+  else
+  {
+    memcpy(bytes, record, length);
+  }
+
+  // Replace the bytes where they are if they still fit.  Page::updateRecord
+  // leaves the page alone if they don't.
+  bool updated = false;
+  try
+  {
+    if (moved)
+    {
+      page->updateRecord(storedRid, buffer, sizeof(RecordId) + bytesLength);
+      page->setRecordFlags(storedRid, flags | Page::RECORD_MOVED);
+    }
+    else
+    {
+      page->updateRecord(storedRid, bytes, bytesLength);
+      page->setRecordFlags(storedRid, flags);
+    }
+    updated = true;
+  }
+  catch (InsufficientSpaceException&)
+  {
+  }
+  if (updated)
+  {
+    pageChanged(storedRid.page_number, *page);
+    updateSummaries(storedRid.page_number, record, length);
+  }
+  bufMgr->unPinPage(file, storedRid.page_number, updated);
+
+  if (!updated)
+  {
+    try
+    {
+      relocateRecord(homeRid, storedRid, buffer, bytesLength, flags);
+    }
+    catch(...)
+    {
+      if (flags & Page::RECORD_OVERFLOW)
+      {
+        overflow.remove(stub);
+      }
+      throw;
+    }
+  }
+  if (hadOverflow)
+  {
+    overflow.remove(oldStub);
+  }
+}
+
+void HeapFile::relocateRecord(const RecordId &rid, const RecordId &storedRid,
+                              const char *moved, const std::size_t length,
+                              const std::uint8_t flags)
+{
+  const char *bytes = moved + sizeof(RecordId);
+  RecordId forwardedRid;
+  OverflowStub stub;
+  Page* page;
+
+  // A record that was moved before may fit back at home by now.
+  if (storedRid != rid)
+  {
+    bufMgr->readPage(file, rid.page_number, page);
+    bool updated = false;
+    try
+    {
+      page->updateRecord(rid, bytes, length);
+      page->setRecordFlags(rid, flags);
+      updated = true;
+    }
+    catch (InsufficientSpaceException&)
+    {
+    }
+    if (updated)
+    {
+      pageChanged(rid.page_number, *page);
+      updateSummaries(*page, rid);
+    }
+    bufMgr->unPinPage(file, rid.page_number, updated);
+    if (updated)
+    {
+      eraseRecord(storedRid, true, forwardedRid, stub);
+      return;
+    }
+  }
+
+  const std::size_t movedLength = sizeof(RecordId) + length;
+  const PageId pageNo = pinPageForRecord(movedLength, 0, page);
+  const RecordId newRid = page->insertRecord(moved, movedLength);
+  page->setRecordFlags(newRid, flags | Page::RECORD_MOVED);
+  updateSummaries(*page, newRid);
+  bufMgr->unPinPage(file, pageNo, true);
+
+  // Point the home slot at the new location.  No record is shorter than the
+  // stub, so it always fits.
+  bufMgr->readPage(file, rid.page_number, page);
+  try
+  {
+    page->updateRecord(rid, reinterpret_cast<const char*>(&newRid), sizeof(RecordId));
+    page->setRecordFlags(rid, Page::RECORD_FORWARDED);
+  }
+  catch(...)
+  {
+    bufMgr->unPinPage(file, rid.page_number, false);
+    eraseRecord(newRid, true, forwardedRid, stub);
+    throw;
+  }
+  pageChanged(rid.page_number, *page);
+  bufMgr->unPinPage(file, rid.page_number, true);
+
+  if (storedRid != rid)
+  {
+    eraseRecord(storedRid, true, forwardedRid, stub);
+  }
+  heapStats.relocations++;
+}
+
+std::size_t HeapFile::collapseForwarding()
+{
+  std::size_t collapsed = 0;
+  for (FileIterator iter = file->begin(); iter != file->end(); ++iter)
+  {
+    const PageId pageNo = iter.page_number();
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    std::vector<RecordId> stubs;
+    for (PageIterator recordIter = page->begin(); recordIter != page->end(); ++recordIter)
+    {
+      const RecordId rid = recordIter.getCurrentRecord();
+      if (page->getRecordFlags(rid) & Page::RECORD_FORWARDED)
+      {
+        stubs.push_back(rid);
+      }
+    }
+
+    bool dirty = false;
+    for (std::size_t i = 0; i < stubs.size(); i++)
+    {
+      RecordId movedRid;
+      memcpy(&movedRid, page->getRecordView(stubs[i]).data, sizeof(RecordId));
+
+      // Copy the record out first; it may be on this very page, whose records
+      // move when the stub grows.
+      Page* movedPage;
+      bufMgr->readPage(file, movedRid.page_number, movedPage);
+      const std::uint8_t flags = movedPage->getRecordFlags(movedRid);
+      const RecordView moved = movedPage->getRecordView(movedRid);
+      char buffer[MAX_INLINE_LENGTH];
+      const std::size_t length = moved.length - sizeof(RecordId);
+      memcpy(buffer, moved.data + sizeof(RecordId), length);
+      bufMgr->unPinPage(file, movedRid.page_number, false);
+
+      // The record takes the place of the stub.
+      if (page->getFreeSpace() + sizeof(RecordId) < length)
+      {
+        continue;
+      }
+      page->updateRecord(stubs[i], buffer, length);
+      page->setRecordFlags(stubs[i], flags & ~Page::RECORD_MOVED);
+      updateSummaries(*page, stubs[i]);
+      dirty = true;
+
+      RecordId forwardedRid;
+      OverflowStub stub;
+      eraseRecord(movedRid, true, forwardedRid, stub);
+      collapsed++;
+    }
+    if (dirty)
+    {
+      pageChanged(pageNo, *page);
+    }
+    bufMgr->unPinPage(file, pageNo, dirty);
+  }
+  heapStats.collapses += collapsed;
+  return collapsed;
+}
+
+RecordView HeapFile::storedBytes(const Page &page, const RecordId &rid,
+                                 std::uint8_t &flags)
+{
+  flags = page.getRecordFlags(rid);
+  RecordView bytes = page.getRecordView(rid);
+  if (flags & Page::RECORD_MOVED)
+  {
+    bytes.data += sizeof(RecordId);
+    bytes.length -= sizeof(RecordId);
+  }
+  if (flags & Page::RECORD_PADDED)
+  {
+    bytes.length = static_cast<std::uint8_t>(bytes.data[sizeof(RecordId) - 1]);
+  }
+  return bytes;
+}
+
+void HeapFile::padRecord(const char *record, const std::size_t length, char *padded)
+{
+  memcpy(padded, record, length);
+  memset(padded + length, '\0', sizeof(RecordId) - length);
+  padded[sizeof(RecordId) - 1] = length;
+}
+
+OverflowStub HeapFile::overflowStub(const RecordView &bytes)
+{
+  OverflowStub stub;
+  memcpy(&stub, bytes.data + INLINE_PREFIX_LENGTH, sizeof(OverflowStub));
+  return stub;
+}
+
+void HeapFile::pinRecord(const RecordId &rid, Page* &page, RecordId &storedRid)
+{
+  bufMgr->readPage(file, rid.page_number, page);
+  try
+  {
+    // Moved records are only reachable through their stubs.
+    const std::uint8_t flags = page->getRecordFlags(rid);
+    if (flags & Page::RECORD_MOVED)
+    {
+      throw InvalidRecordException(rid, rid.page_number);
+    }
+    if (!(flags & Page::RECORD_FORWARDED))
+    {
+      storedRid = rid;
+      return;
+    }
+    memcpy(&storedRid, page->getRecordView(rid).data, sizeof(RecordId));
+  }
+  catch(...)
+  {
+    bufMgr->unPinPage(file, rid.page_number, false);
+    throw;
+  }
+  bufMgr->unPinPage(file, rid.page_number, false);
+  heapStats.forwardedFetches++;
+  bufMgr->readPage(file, storedRid.page_number, page);
+}
+
+PageId HeapFile::pinPageForRecord(const std::size_t length, const std::size_t target,
+                                  Page* &page)
+{
+  if (target >= targetPages.size())
+  {
+    targetPages.resize(target + 1, PageId(Page::INVALID_NUMBER));
+  }
+
+  PageId pageNo = targetPages[target];
+  if (pageNo != Page::INVALID_NUMBER)
+  {
+    bufMgr->readPage(file, pageNo, page);
+    if (page->hasSpaceForRecord(length))
+    {
+      return pageNo;
+    }
+    // The target's page is full; hand it back and move on to another one.
+    freeSpace.update(pageNo, recordSpace(*page));
+    bufMgr->unPinPage(file, pageNo, false);
+    targetPages[target] = Page::INVALID_NUMBER;
+  }
+
+  pageNo = freeSpace.find(length);
+  while (pageNo == Page::INVALID_NUMBER && unmappedPage != file->end())
+  {
+    // Look through pages of the file not seen yet before growing it.
+    mapPages(MAP_BATCH_PAGES);
+    pageNo = freeSpace.find(length);
+  }
+  if (pageNo != Page::INVALID_NUMBER)
+  {
+    freeSpace.remove(pageNo);
+    bufMgr->readPage(file, pageNo, page);
+    assert(page->hasSpaceForRecord(length));
+  }
+  else
+  {
+    bufMgr->allocPage(file, pageNo, page);
+    if (!page->hasSpaceForRecord(length))
+    {
+      // Too large for any page; keep the empty page for later records.
+      const std::uint16_t available = page->getFreeSpace();
+      freeSpace.update(pageNo, recordSpace(*page));
+      bufMgr->unPinPage(file, pageNo, true);
+      throw InsufficientSpaceException(pageNo, length, available);
+    }
+  }
+
+  targetPages[target] = pageNo;
+  return pageNo;
+}
+
+void HeapFile::deleteRecord(const RecordId &rid)
+{
+  RecordId forwardedRid;
+  OverflowStub stub;
+  std::uint8_t flags = eraseRecord(rid, false, forwardedRid, stub);
+  if (flags & Page::RECORD_FORWARDED)
+  {
+    flags = eraseRecord(forwardedRid, true, forwardedRid, stub);
+  }
+  if (flags & Page::RECORD_OVERFLOW)
+  {
+    overflow.remove(stub);
+  }
+}
+
+std::uint8_t HeapFile::eraseRecord(const RecordId &rid, const bool moved,
+                                   RecordId &forwardedRid, OverflowStub &stub)
+{
+  Page* page;
+  bufMgr->readPage(file, rid.page_number, page);
+  std::uint8_t flags;
+  try
+  {
+    const RecordView bytes = storedBytes(*page, rid, flags);
+    if (((flags & Page::RECORD_MOVED) != 0) != moved)
+    {
+      throw InvalidRecordException(rid, rid.page_number);
+    }
+    if (flags & Page::RECORD_FORWARDED)
+    {
+      memcpy(&forwardedRid, bytes.data, sizeof(RecordId));
+    }
+    else if (flags & Page::RECORD_OVERFLOW)
+    {
+      stub = overflowStub(bytes);
+    }
+    page->deleteRecord(rid);
+  }
+  catch(...)
+  {
+    bufMgr->unPinPage(file, rid.page_number, false);
+    throw;
+  }
+  pageChanged(rid.page_number, *page);
+  bufMgr->unPinPage(file, rid.page_number, true);
+  return flags;
+}
+
+void HeapFile::createZoneMap(const std::vector<ZoneAttribute> &attributes)
+{
+  // The new zone map takes the place of the old one's file.
+  delete zoneMap;
+  zoneMap = NULL;
+  try
+  {
+    zoneMap = new ZoneMap(file->filename(), bufMgr, attributes);
+  }
+  catch(...)
+  {
+    if (File::exists(ZoneMap::nameFor(file->filename())))
+    {
+      zoneMap = new ZoneMap(file->filename(), bufMgr);
+    }
+    throw;
+  }
+
+  summarizePages(zoneMap, NULL);
+}
+
+void HeapFile::createBloomFilters(const std::vector<FilterAttribute> &attributes,
+                                  const double falsePositiveRate,
+                                  std::size_t recordsPerPage)
+{
+  if (recordsPerPage == 0)
+  {
+    for (FileIterator iter = file->begin(); iter != file->end(); ++iter)
+    {
+      Page* page;
+      bufMgr->readPage(file, iter.page_number(), page);
+      if (!PaxPage::isPaxPage(*page))
+      {
+        std::size_t numRecords = 0;
+        for (PageIterator recordIter = page->begin(); recordIter != page->end(); ++recordIter)
+        {
+          numRecords++;
+        }
+        recordsPerPage = std::max(recordsPerPage, numRecords);
+      }
+      bufMgr->unPinPage(file, iter.page_number(), false);
+    }
+    if (recordsPerPage == 0)
+    {
+      recordsPerPage = Page::DATA_SIZE / 64;
+    }
+  }
+
+  // The new filters take the place of the old ones' file.
+  delete bloomFilters;
+  bloomFilters = NULL;
+  try
+  {
+    bloomFilters = new BloomFilterFile(file->filename(), bufMgr, attributes,
+                                       falsePositiveRate, recordsPerPage);
+  }
+  catch(...)
+  {
+    if (File::exists(BloomFilterFile::nameFor(file->filename())))
+    {
+      bloomFilters = new BloomFilterFile(file->filename(), bufMgr);
+    }
+    throw;
+  }
+  summarizePages(NULL, bloomFilters);
+}
+
+void HeapFile::summarizePages(ZoneMap *zones, BloomFilterFile *filters)
+{
+  for (FileIterator iter = file->begin(); iter != file->end(); ++iter)
+  {
+    const PageId pageNo = iter.page_number();
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    if (!PaxPage::isPaxPage(*page))
+    {
+      if (zones != NULL)
+      {
+        zones->clearPage(pageNo);
+      }
+      if (filters != NULL)
+      {
+        filters->clearPage(pageNo);
+      }
+      for (PageIterator recordIter = page->begin(); recordIter != page->end(); ++recordIter)
+      {
+        const RecordId rid = recordIter.getCurrentRecord();
+        if (!(page->getRecordFlags(rid) & Page::RECORD_FORWARDED))
+        {
+          summarizeRecord(*page, rid, zones, filters);
+        }
+      }
+    }
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+}
+
+void HeapFile::updateSummaries(const PageId pageNo, const char *record,
+                               const std::size_t length)
+{
+  if (zoneMap != NULL)
+  {
+    zoneMap->include(pageNo, record, length);
+  }
+  if (bloomFilters != NULL)
+  {
+    bloomFilters->include(pageNo, record, length);
+  }
+}
+
+void HeapFile::summarizeRecord(const Page &page, const RecordId &rid,
+                               ZoneMap *zones, BloomFilterFile *filters)
+{
+  if (zones == NULL && filters == NULL)
+  {
+    return;
+  }
+  std::uint8_t flags;
+  RecordView bytes = storedBytes(page, rid, flags);
+  const bool truncated = (flags & Page::RECORD_OVERFLOW) != 0;
+  if (truncated)
+  {
+    bytes.length = INLINE_PREFIX_LENGTH;
+  }
+  if (zones != NULL)
+  {
+    zones->include(rid.page_number, bytes.data, bytes.length, truncated);
+  }
+  if (filters != NULL)
+  {
+    filters->include(rid.page_number, bytes.data, bytes.length, truncated);
+  }
+}
+
+void HeapFile::pageChanged(const PageId pageNo, const Page &page)
+{
+  if (!isTargetPage(pageNo))
+  {
+    freeSpace.update(pageNo, recordSpace(page));
+  }
+}
+
+std::size_t HeapFile::recordSpace(const Page &page)
+{
+  // Assume the record needs a new slot; reusing a free one only helps.
+  const std::size_t freeSpace = page.getFreeSpace();
+  return freeSpace > sizeof(PageSlot) ? freeSpace - sizeof(PageSlot) : 0;
+}
+
+void HeapFile::mapPages(const std::size_t numPages)
+{
+  for (std::size_t i = 0; i < numPages && unmappedPage != file->end(); i++, ++unmappedPage)
+  {
+    const PageId pageNo = unmappedPage.page_number();
+    if (isTargetPage(pageNo))
+    {
+      continue;
+    }
+    Page* page;
+    bufMgr->readPage(file, pageNo, page);
+    freeSpace.update(pageNo, recordSpace(*page));
+    bufMgr->unPinPage(file, pageNo, false);
+  }
+}
+
+bool HeapFile::isTargetPage(const PageId pageNo) const
+{
+  for (std::size_t i = 0; i < targetPages.size(); i++)
+  {
+    if (targetPages[i] == pageNo)
+    {
+      return true;
+    }
+  }
+  return false;
+}
+
+}
@@ -0,0 +1,598 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "file_iterator.h"
+#include "overflow.h"
+#include "zone_map.h"
+#include "bloom_filter.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Remembers how much room each page of a file has for new records.
+ *
+ * Pages are kept in buckets by free space, so finding a page that can hold a
+ * record of a given size takes constant time.
+ */
+class FreeSpaceMap
+{
+ public:
+  /**
+   * Number of free space buckets; one bit of a 64 bit mask per bucket.
+   */
+  static const std::uint32_t NUM_BUCKETS = 64;
+
+  /**
+   * Free bytes covered by each bucket.  Pages in bucket b can hold a record
+   * of at least b * BUCKET_BYTES bytes.
+   */
+  static const std::uint32_t BUCKET_BYTES =
+      (Page::DATA_SIZE + NUM_BUCKETS - 1) / NUM_BUCKETS;
+
+  FreeSpaceMap();
+
+  /**
+   * Records that a page can now hold a record of the given size, adding the
+   * page if it isn't in the map yet.
+   *
+   * @param pageNo      Number of page.
+   * @param freeSpace   Largest record the page can hold.
+   */
+  void update(const PageId pageNo, const std::size_t freeSpace);
+
+  /**
+   * Removes a page from the map.  Does nothing if the page isn't in it.
+   *
+   * @param pageNo  Number of page.
+   */
+  void remove(const PageId pageNo);
+
+  /**
+   * Returns a page that can hold a record of the given size.
+   *
+   * @param recordSize  Size of record in bytes.
+   * @return  Number of page, or Page::INVALID_NUMBER if no page has room.
+   */
+  PageId find(const std::size_t recordSize) const;
+
+ private:
+  /**
+   * Marks a page that isn't in any bucket.
+   */
+  static const std::uint8_t NO_BUCKET = 0xFF;
+
+  /**
+   * Pages in each bucket, in no particular order.
+   */
+  std::vector<PageId> buckets[NUM_BUCKETS];
+
+  /**
+   * Bit b is set if bucket b is not empty.
+   */
+  std::uint64_t nonEmptyBuckets;
+
+  /**
+   * Bucket each page is in, indexed by page number, or NO_BUCKET.
+   */
+  std::vector<std::uint8_t> pageBuckets;
+
+  /**
+   * Position of each page within its bucket, indexed by page number.
+   */
+  std::vector<std::uint32_t> pagePositions;
+};
+
+/**
+ * @brief Statistics about forwarded records of a heap file.
+ */
+struct HeapStats
+{
+  /**
+   * Number of records moved to another page because they grew
+   */
+  int relocations;
+
+  /**
+   * Number of fetches that went through a forwarding stub
+   */
+  int forwardedFetches;
+
+  /**
+   * Number of moved records brought back to their home pages
+   */
+  int collapses;
+
+  /**
+   * Clear all values
+   */
+  void clear()
+  {
+    relocations = forwardedFetches = collapses = 0;
+  }
+
+  /**
+   * Constructor of HeapStats class
+   */
+  HeapStats()
+  {
+    clear();
+  }
+};
+
+/**
+ * @brief Inserts and deletes records of a relation through the buffer pool.
+ *
+ * A free space map finds a page with room for each new record, so callers
+ * don't have to allocate pages or handle InsufficientSpaceException
+ * themselves.  Every insertion target has its own current page, so records
+ * inserted under different targets, e.g. rows of two interleaved sources,
+ * never share a page.  The map isn't stored: pages of an opened relation
+ * are added to it a few at a time, only when the pages it has are too full
+ * for a record, so opening a relation reads none of them.
+ *
+ * Records longer than MAX_INLINE_LENGTH keep their first bytes on a page and
+ * the rest in an overflow chain, so records of any size can be stored.  The
+ * bytes on the page end with an OverflowStub and the slot is flagged with
+ * Page::RECORD_OVERFLOW.  Fixed-width attributes placed at the start of a
+ * record therefore stay on the page, and a scan that only reads those never
+ * touches the overflow chains.
+ *
+ * A record that grows past the free space of its page is moved to another
+ * page, leaving a forwarding stub in its home slot, so its RecordId and the
+ * index entries pointing at it stay valid.  The moved record starts with its
+ * home RecordId, which lets scans return it under that ID and skip the stub.
+ * A stub always points straight at the current location, so a fetch follows
+ * at most one hop, and collapseForwarding moves records back home once their
+ * pages have room again.  Records shorter than a RecordId are padded to its
+ * length, so a stub always fits in their place.
+ *
+ * A relation may have a ZoneMap of chosen numeric attributes, built by
+ * createZoneMap, and Bloom filters of chosen attributes, built by
+ * createBloomFilters.  Every record inserted or updated through HeapFile is
+ * added to those of the page it is stored on, so scans can rely on them to
+ * skip pages.
+ *
+ * @warning This class is not threadsafe, not even for callers using
+ *          different insertion targets.
+ */
+class HeapFile
+{
+ public:
+  /**
+   * Longest record stored entirely on a page.  Longer records keep their
+   * first INLINE_PREFIX_LENGTH bytes on the page.
+   */
+  static const std::size_t MAX_INLINE_LENGTH = Page::DATA_SIZE / 4;
+
+  /**
+   * Number of bytes of a longer record kept on the page, which leaves room
+   * for the OverflowStub.
+   */
+  static const std::size_t INLINE_PREFIX_LENGTH =
+      MAX_INLINE_LENGTH - sizeof(OverflowStub);
+
+  /**
+   * Number of pages added to the free space map at a time when the pages it
+   * has are too full for a record.
+   */
+  static const std::size_t MAP_BATCH_PAGES = 32;
+
+  /**
+   * Opens a relation, or creates a new one.
+   *
+   * @param name        Name of relation file.
+   * @param bufMgr      Buffer Manager instance used to read and write pages.
+   * @param create_new  Whether to create a new file.
+   * @throws  FileExistsException     If the file exists and create_new is true.
+   * @throws  FileNotFoundException   If the file doesn't exist and create_new
+   *                                  is false.
+   */
+  HeapFile(const std::string &name, BufMgr *bufMgr, const bool create_new = false);
+
+  /**
+   * Closes the relation.  If its pages can't be written, the files they
+   * belong to are left open, since frames of the buffer pool still refer to
+   * them; call close first to find out.
+   */
+  ~HeapFile();
+
+  /**
+   * Flushes the pages of the relation, its overflow chains, zone map and
+   * Bloom filters out of the buffer pool and closes their files.  Nothing
+   * but the destructor may be called afterwards.
+   *
+   * @throws  PagePinnedException   If a page of the relation is pinned.
+   * @throws  FileIOException       If a page can't be written.
+   */
+  void close();
+
+  /**
+   * Inserts a record into a page with enough room for it.
+   *
+   * @param record  Record to insert.
+   * @param target  Insertion target.  Records with the same target go to the
+   *                same page until it is full.
+   * @return  RecordId of the new record.
+   */
+  RecordId insertRecord(const std::string &record, const std::size_t target = 0);
+
+  /**
+   * Inserts a record straight from the caller's buffer, so loading a relation
+   * from structs allocates nothing per record.
+   *
+   * @param record  First byte of record to insert.
+   * @param length  Length of record in bytes.
+   * @param target  Insertion target, as for the std::string version.
+   * @return  RecordId of the new record.
+   */
+  RecordId insertRecord(const char *record, const std::size_t length,
+                        const std::size_t target = 0);
+
+  /**
+   * Inserts records in order, filling each page with as many of them as fit
+   * before pinning the next one.
+   *
+   * @param records     Records to insert.
+   * @param numRecords  Number of records.
+   * @param rids        If not NULL, set to the RecordIds of the new records.
+   * @param target      Insertion target, as for insertRecord.
+   */
+  void insertRecords(const RecordView *records, const std::size_t numRecords,
+                     RecordId *rids = NULL, const std::size_t target = 0);
+
+  /**
+   * Returns a copy of a record, including any part of it stored in an
+   * overflow chain, following its forwarding stub if it was moved.
+   *
+   * @param rid   RecordId of record.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  std::string getRecord(const RecordId &rid);
+
+  /**
+   * Replaces a record with a new version, keeping its RecordId.  If the new
+   * version doesn't fit on the page that holds the record, it is moved to
+   * another page and a forwarding stub takes its place.
+   *
+   * @param rid     RecordId of record.
+   * @param record  New version of record.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  void updateRecord(const RecordId &rid, const std::string &record);
+
+  /**
+   * Replaces a record with a new version from the caller's buffer.
+   *
+   * @param rid     RecordId of record.
+   * @param record  First byte of new version.
+   * @param length  Length of new version in bytes.
+   * @see updateRecord(const RecordId&, const std::string&)
+   */
+  void updateRecord(const RecordId &rid, const char *record, const std::size_t length);
+
+  /**
+   * Moves records that were moved away from their home pages back home
+   * where those pages have room for them again, removing the forwarding
+   * stubs.  Meant to be run periodically, e.g. when the relation is idle.
+   *
+   * @return  Number of records moved back.
+   */
+  std::size_t collapseForwarding();
+
+  /**
+   * Returns the bytes of a record as stored on a page by HeapFile: without
+   * the home RecordId of a moved record or the padding of a short one, and
+   * ending with an OverflowStub if the record has an overflow chain.
+   *
+   * @param page    Page holding the record.
+   * @param rid     RecordId of the record on the page.
+   * @param flags   Set to the flags of the record.
+   * @return  View of the bytes on the page.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  static RecordView storedBytes(const Page &page, const RecordId &rid,
+                                std::uint8_t &flags);
+
+  /**
+   * Returns the stub of the overflow chain of a record.
+   *
+   * @param bytes   Bytes of the record, as returned by storedBytes, which
+   *                must be flagged with Page::RECORD_OVERFLOW.
+   */
+  static OverflowStub overflowStub(const RecordView &bytes);
+
+  /**
+   * Builds a zone map of the given attributes from the records of every
+   * slotted page, replacing any zone map the relation has, and keeps it up
+   * to date from then on.
+   *
+   * @param attributes  Attributes to keep ranges of.
+   * @throws  InvalidZoneMapException   If the attributes can't be mapped.
+   */
+  void createZoneMap(const std::vector<ZoneAttribute> &attributes);
+
+  /**
+   * Returns whether the relation has a zone map.
+   */
+  bool hasZoneMap() const
+  {
+    return zoneMap != NULL;
+  }
+
+  /**
+   * Builds Bloom filters of the given attributes from the records of every
+   * slotted page, replacing any the relation has, and keeps them up to date
+   * from then on.
+   *
+   * @param attributes          Attributes to keep filters of.
+   * @param falsePositiveRate   Rate at which a filter of a full page claims a
+   *                            value it doesn't hold.
+   * @param recordsPerPage      Number of records a page is expected to hold,
+   *                            or 0 to size the filters for the fullest page
+   *                            of the relation, or for records of 64 bytes
+   *                            if it is empty.
+   * @throws  InvalidBloomFilterException   If the attributes can't be
+   *                                        filtered.
+   */
+  void createBloomFilters(const std::vector<FilterAttribute> &attributes,
+                          const double falsePositiveRate =
+                              BloomFilterFile::DEFAULT_FALSE_POSITIVE_RATE,
+                          std::size_t recordsPerPage = 0);
+
+  /**
+   * Returns whether the relation has Bloom filters.
+   */
+  bool hasBloomFilters() const
+  {
+    return bloomFilters != NULL;
+  }
+
+  /**
+   * Returns the statistics about forwarded records.
+   */
+  HeapStats & getHeapStats()
+  {
+    return heapStats;
+  }
+
+  /**
+   * Clears the statistics about forwarded records.
+   */
+  void clearHeapStats()
+  {
+    heapStats.clear();
+  }
+
+  /**
+   * Deletes a record and its overflow chain, if any, making their space
+   * available to later insertions.
+   *
+   * @param rid   RecordId of record to delete.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  void deleteRecord(const RecordId &rid);
+
+ private:
+  /**
+   * Returns the largest record the given page can hold.
+   *
+   * @param page  Page to check.
+   */
+  static std::size_t recordSpace(const Page &page);
+
+  /**
+   * Reads and pins the page the next record of a target goes to, choosing a
+   * new one if the target's page has no room for it.
+   *
+   * @param length  Length of record in bytes.
+   * @param target  Insertion target.
+   * @param page    Set to the pinned page.
+   * @return  Number of the page.
+   * @throws  InsufficientSpaceException  If the record doesn't fit on an empty
+   *                                      page.
+   */
+  PageId pinPageForRecord(const std::size_t length, const std::size_t target, Page* &page);
+
+  /**
+   * Inserts a record longer than MAX_INLINE_LENGTH, moving its tail to a new
+   * overflow chain.
+   *
+   * @param record  First byte of record to insert.
+   * @param length  Length of record in bytes.
+   * @param target  Insertion target.
+   * @return  RecordId of the new record.
+   */
+  RecordId insertOverflowRecord(const char *record, const std::size_t length,
+                                const std::size_t target);
+
+  /**
+   * Returns whether a record is stored on a page just as it is, rather than
+   * split into an overflow chain or padded.
+   *
+   * @param length  Length of record in bytes.
+   */
+  static bool isStoredAsIs(const std::size_t length)
+  {
+    return length >= sizeof(RecordId) && length <= MAX_INLINE_LENGTH;
+  }
+
+  /**
+   * Pads a record shorter than a RecordId to the length of one.
+   *
+   * @param record  First byte of record.
+   * @param length  Length of record in bytes.
+   * @param padded  Buffer of sizeof(RecordId) bytes to store it in.
+   */
+  static void padRecord(const char *record, const std::size_t length, char *padded);
+
+  /**
+   * Reads and pins the page that holds the bytes of a record, following its
+   * forwarding stub if it was moved.
+   *
+   * @param rid       RecordId of record.
+   * @param page      Set to the pinned page.
+   * @param storedRid Set to the location of the record's bytes.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  void pinRecord(const RecordId &rid, Page* &page, RecordId &storedRid);
+
+  /**
+   * Moves a record that no longer fits where it is stored: back home if its
+   * home page has room, or else to another page, pointing its forwarding
+   * stub there.
+   *
+   * @param rid           RecordId of record.
+   * @param storedRid     Current location of the record's bytes.
+   * @param moved         Data to store for a moved record: the home RecordId
+   *                      followed by the new bytes of the record.
+   * @param length        Length of the new bytes, without the RecordId.
+   * @param flags         Flags of the new bytes.
+   */
+  void relocateRecord(const RecordId &rid, const RecordId &storedRid,
+                      const char *moved, const std::size_t length,
+                      const std::uint8_t flags);
+
+  /**
+   * Deletes the bytes stored in one slot, without following forwarding stubs
+   * or freeing overflow chains.
+   *
+   * @param rid           Location of the bytes.
+   * @param moved         Whether the slot must hold a moved record, or else
+   *                      must not.
+   * @param forwardedRid  Set to the location a forwarding stub points at.
+   * @param stub          Set to the overflow stub of a record with a chain.
+   * @return  Flags of the deleted bytes.
+   * @throws  InvalidRecordException  If the slot holds no such record.
+   */
+  std::uint8_t eraseRecord(const RecordId &rid, const bool moved,
+                           RecordId &forwardedRid, OverflowStub &stub);
+
+  /**
+   * Updates the free space map after records of a page changed.
+   *
+   * @param pageNo  Number of page.
+   * @param page    The page.
+   */
+  void pageChanged(const PageId pageNo, const Page &page);
+
+  /**
+   * Adds a whole record to the zone map and Bloom filters of a page, if the
+   * relation has them.
+   *
+   * @param pageNo  Number of page the record is stored on.
+   * @param record  First byte of record.
+   * @param length  Length of record in bytes.
+   */
+  void updateSummaries(const PageId pageNo, const char *record, const std::size_t length);
+
+  /**
+   * Adds a record as stored on a page to the zone map and Bloom filters of
+   * the page, if the relation has them.
+   *
+   * @param page  Page holding the record.
+   * @param rid   RecordId of the record on the page.
+   */
+  void updateSummaries(const Page &page, const RecordId &rid)
+  {
+    summarizeRecord(page, rid, zoneMap, bloomFilters);
+  }
+
+  /**
+   * Adds a record as stored on a page to a zone map and Bloom filters.
+   * Attributes in the record's overflow chain count as unknown.
+   *
+   * @param page      Page holding the record.
+   * @param rid       RecordId of the record on the page.
+   * @param zones     Zone map to widen, or NULL.
+   * @param filters   Bloom filters to add to, or NULL.
+   */
+  static void summarizeRecord(const Page &page, const RecordId &rid,
+                              ZoneMap *zones, BloomFilterFile *filters);
+
+  /**
+   * Builds a new zone map or new Bloom filters from the records of every
+   * slotted page.  PAX pages aren't written through HeapFile, so they get no
+   * entry and are never skipped.
+   *
+   * @param zones     Zone map to build, or NULL.
+   * @param filters   Bloom filters to build, or NULL.
+   */
+  void summarizePages(ZoneMap *zones, BloomFilterFile *filters);
+
+  /**
+   * Adds pages the free space map hasn't seen yet to it, in file order.
+   *
+   * @param numPages  Most pages to add.
+   */
+  void mapPages(const std::size_t numPages);
+
+  /**
+   * Returns whether the page is the current page of an insertion target.
+   * Those pages are kept out of the free space map.
+   *
+   * @param pageNo  Number of page.
+   */
+  bool isTargetPage(const PageId pageNo) const;
+
+  /**
+   * File which holds the relation.
+   */
+  PageFile      *file;
+
+  /**
+   * Buffer Manager instance used to read/write pages into/from buffer pool.
+   */
+  BufMgr        *bufMgr;
+
+  /**
+   * Room left on every page seen so far that isn't an insertion target's
+   * current page.
+   */
+  FreeSpaceMap  freeSpace;
+
+  /**
+   * Next page the free space map hasn't seen yet.  Pages before it were
+   * added when they were reached, or whenever they changed since.
+   */
+  FileIterator  unmappedPage;
+
+  /**
+   * Overflow chains holding the tails of long records.
+   */
+  OverflowFile  overflow;
+
+  /**
+   * Zone map of the relation, or NULL if it has none.
+   */
+  ZoneMap       *zoneMap;
+
+  /**
+   * Bloom filters of the relation, or NULL if it has none.
+   */
+  BloomFilterFile *bloomFilters;
+
+  /**
+   * Statistics about forwarded records.
+   */
+  HeapStats     heapStats;
+
+  /**
+   * Current page of each insertion target, or Page::INVALID_NUMBER.
+   */
+  std::vector<PageId> targetPages;
+};
+
+}
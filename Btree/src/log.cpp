@@ -0,0 +1,398 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "log.h"
+
+#include <map>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "file.h"
+#include "checksum.h"
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_log_exception.h"
+
+namespace badgerdb {
+
+const std::uint32_t LogMgr::HEADER_SIZE;
+const std::uint64_t LogMgr::CHECKPOINT_BYTES;
+const std::size_t LogMgr::BUFFER_BYTES;
+const std::size_t LogMgr::EXTENT_BYTES;
+
+LogMgr::LogMgr(const std::string& filename)
+: filename_(filename),
+  end_lsn_(HEADER_SIZE),
+  written_lsn_(HEADER_SIZE),
+  durable_lsn_(HEADER_SIZE),
+  checkpoint_lsn_(HEADER_SIZE),
+  allocated_lsn_(HEADER_SIZE) {
+  fd_ = ::open(filename_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    throw FileNotFoundException(filename_);
+  }
+  struct stat log_stat;
+  try {
+    if (::fstat(fd_, &log_stat) == 0 && log_stat.st_size == 0) {
+      writeHeader();
+      sync();
+      return;
+    }
+    recover();
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+LogMgr::~LogMgr() {
+  try {
+    writeBuffer();
+  } catch (...) {
+    // Records nobody flushed needn't survive; no page depending on them was
+    // written back.
+  }
+  ::close(fd_);
+}
+
+LogSequenceNumber LogMgr::logPage(const File* file, const PageId page_number,
+                                  const Page* before, const Page& after) {
+  LogRecordHeader header;
+  memset(&header, 0, sizeof(LogRecordHeader));
+  header.blob_file = dynamic_cast<const BlobFile*>(file) != NULL;
+  header.page_number = page_number;
+
+  LogSequenceNumber lsn;
+  if (before == NULL) {
+    header.type = LogRecordHeader::PAGE_IMAGE;
+    lsn = append(header, file->filename(), &after, Page::SIZE);
+    ++stats_.pageimages;
+  } else {
+    delta_.clear();
+    appendDelta(*before, after, delta_);
+    if (delta_.empty()) {
+      return 0;
+    }
+    header.type = LogRecordHeader::PAGE_DELTA;
+    lsn = append(header, file->filename(), &delta_[0], delta_.size());
+  }
+  ++stats_.records;
+  return lsn;
+}
+
+void LogMgr::flush(const LogSequenceNumber lsn) {
+  if (isDurable(lsn)) {
+    return;
+  }
+  writeBuffer();
+  sync();
+  durable_lsn_ = written_lsn_;
+  ++stats_.syncs;
+}
+
+void LogMgr::checkpoint(const LogSequenceNumber redo_lsn) {
+  if (redo_lsn >= end_lsn_) {
+    // Nothing left to redo, so start the log over.  The header goes first:
+    // if we crash before the truncation, recovery just redoes pages that are
+    // already on disk.  Until the header is durable, new records keep
+    // following the old ones.
+    checkpoint_lsn_ = HEADER_SIZE;
+    writeHeader();
+    sync();
+    buffer_.clear();
+    end_lsn_ = written_lsn_ = durable_lsn_ = allocated_lsn_ = HEADER_SIZE;
+    ++stats_.checkpoints;
+    // Should the truncation fail, the old records are overwritten with zeros
+    // before new ones go after them, like any space the log grows into.
+    if (::ftruncate(fd_, HEADER_SIZE) != 0) {
+      throw FileIOException(filename_, "truncate", errno);
+    }
+    return;
+  }
+
+  LogRecordHeader header;
+  memset(&header, 0, sizeof(LogRecordHeader));
+  header.type = LogRecordHeader::CHECKPOINT;
+  const LogSequenceNumber lsn =
+      append(header, "" /* name */, &redo_lsn, sizeof(LogSequenceNumber));
+  flush();
+  checkpoint_lsn_ = lsn;
+  writeHeader();
+  sync();
+#ifdef __linux__
+  // Give back the space of the records recovery will never read again.
+  const LogSequenceNumber release_end = redo_lsn / HEADER_SIZE * HEADER_SIZE;
+  if (release_end > HEADER_SIZE) {
+    ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE, HEADER_SIZE,
+                release_end - HEADER_SIZE);
+  }
+#endif
+  ++stats_.checkpoints;
+}
+
+void LogMgr::recover() {
+  LogFileHeader log_header;
+  if (::pread(fd_, &log_header, sizeof(LogFileHeader), 0 /* offset */) !=
+          static_cast<ssize_t>(sizeof(LogFileHeader)) ||
+      log_header.magic != MAGIC) {
+    throw InvalidLogException(filename_);
+  }
+
+  std::vector<char> record;
+  LogSequenceNumber lsn = HEADER_SIZE;
+  if (log_header.checkpoint_lsn != 0) {
+    // The header is only written once its checkpoint record is durable.
+    LogSequenceNumber redo_lsn;
+    if (!readRecord(log_header.checkpoint_lsn, record) ||
+        record.size() != sizeof(LogRecordHeader) + sizeof(LogSequenceNumber)) {
+      throw InvalidLogException(filename_);
+    }
+    memcpy(&redo_lsn, &record[sizeof(LogRecordHeader)],
+           sizeof(LogSequenceNumber));
+    lsn = redo_lsn;
+  }
+
+  // Every page's records since the redo point start with its image, so the
+  // pages can be rebuilt in memory without reading them.
+  typedef std::pair<std::string, PageId> PageKey;
+  std::map<PageKey, Page> pages;
+  std::map<std::string, bool> blob_files;
+  while (readRecord(lsn, record)) {
+    LogRecordHeader header;
+    memcpy(&header, &record[0], sizeof(LogRecordHeader));
+    lsn += header.length;
+    if (header.type == LogRecordHeader::CHECKPOINT) {
+      continue;
+    }
+    const char* body = &record[sizeof(LogRecordHeader)] + header.name_length;
+    const std::size_t body_length =
+        header.length - sizeof(LogRecordHeader) - header.name_length;
+    const PageKey key(std::string(&record[sizeof(LogRecordHeader)],
+                                  header.name_length),
+                      header.page_number);
+    blob_files[key.first] = header.blob_file;
+
+    if (header.type == LogRecordHeader::PAGE_IMAGE &&
+        body_length == Page::SIZE) {
+      memcpy(static_cast<void*>(&pages[key]), body, Page::SIZE);
+    } else if (header.type == LogRecordHeader::PAGE_DELTA) {
+      std::map<PageKey, Page>::iterator page = pages.find(key);
+      if (page == pages.end() || !applyDelta(body, body_length, page->second)) {
+        throw InvalidLogException(filename_);
+      }
+    }
+  }
+  // Anything after the last complete record was torn by the crash.
+  end_lsn_ = written_lsn_ = durable_lsn_ = lsn;
+  if (::ftruncate(fd_, lsn) != 0) {
+    throw FileIOException(filename_, "truncate", errno);
+  }
+  allocated_lsn_ = lsn;
+
+  std::map<std::string, File*> files;
+  try {
+    for (std::map<PageKey, Page>::const_iterator page = pages.begin();
+         page != pages.end(); ++page) {
+      const std::string& name = page->first.first;
+      const PageId page_number = page->first.second;
+      if (files.find(name) == files.end()) {
+        files[name] = NULL;
+        try {
+          if (blob_files[name]) {
+            files[name] = new BlobFile(name, false /* create_new */);
+          } else {
+            files[name] = new PageFile(name, false /* create_new */);
+          }
+        } catch (const FileNotFoundException& e) {
+          // The file was removed after the page was logged.
+        }
+      }
+      File* file = files[name];
+      if (file != NULL && page_number < file->readHeader().num_pages &&
+          file->isPageUsed(page_number)) {
+        file->writePage(page_number, page->second);
+        ++stats_.redonepages;
+      }
+    }
+    // The log is only emptied once every redone page is durable.
+    for (std::map<std::string, File*>::iterator file = files.begin();
+         file != files.end(); ++file) {
+      if (file->second != NULL) {
+        file->second->sync();
+      }
+    }
+  } catch (...) {
+    for (std::map<std::string, File*>::iterator file = files.begin();
+         file != files.end(); ++file) {
+      delete file->second;
+    }
+    throw;
+  }
+  for (std::map<std::string, File*>::iterator file = files.begin();
+       file != files.end(); ++file) {
+    delete file->second;
+  }
+
+  checkpoint(end_lsn_);
+}
+
+bool LogMgr::readRecord(const LogSequenceNumber lsn,
+                        std::vector<char>& record) const {
+  LogRecordHeader header;
+  if (::pread(fd_, &header, sizeof(LogRecordHeader), lsn) !=
+          static_cast<ssize_t>(sizeof(LogRecordHeader)) ||
+      header.lsn != lsn || header.length < sizeof(LogRecordHeader) ||
+      header.length > sizeof(LogRecordHeader) + header.name_length +
+                          2 * Page::SIZE) {
+    return false;
+  }
+  record.resize(header.length);
+  if (::pread(fd_, &record[0], header.length, lsn) !=
+      static_cast<ssize_t>(header.length)) {
+    return false;
+  }
+  memset(&record[0], 0, sizeof(std::uint32_t));
+  return Checksum::crc32c(0, &record[0], header.length) == header.checksum;
+}
+
+bool LogMgr::applyDelta(const char* data, const std::size_t length,
+                        Page& page) {
+  char* page_data = reinterpret_cast<char*>(&page);
+  std::size_t position = 0;
+  while (position < length) {
+    std::uint16_t range[2];
+    if (length - position < sizeof(range)) {
+      return false;
+    }
+    memcpy(range, data + position, sizeof(range));
+    position += sizeof(range);
+    if (range[0] + range[1] > Page::SIZE || length - position < range[1]) {
+      return false;
+    }
+    memcpy(page_data + range[0], data + position, range[1]);
+    position += range[1];
+  }
+  return true;
+}
+
+void LogMgr::appendDelta(const Page& before, const Page& after,
+                         std::vector<char>& out) {
+  // Pages are compared a word at a time, skipping unchanged blocks whole.
+  // Each range costs a 4 byte header, less than an unchanged word, so ranges
+  // are never merged across one.
+  const std::size_t WORD = sizeof(std::uint64_t);
+  const std::size_t BLOCK = 32 * WORD;
+  const char* old_data = reinterpret_cast<const char*>(&before);
+  const char* new_data = reinterpret_cast<const char*>(&after);
+  std::size_t offset = 0;
+  while (offset < Page::SIZE) {
+    if (offset % BLOCK == 0 &&
+        memcmp(old_data + offset, new_data + offset, BLOCK) == 0) {
+      offset += BLOCK;
+      continue;
+    }
+    if (memcmp(old_data + offset, new_data + offset, WORD) == 0) {
+      offset += WORD;
+      continue;
+    }
+    std::size_t end = offset + WORD;
+    while (end < Page::SIZE &&
+           memcmp(old_data + end, new_data + end, WORD) != 0) {
+      end += WORD;
+    }
+    const std::uint16_t range[2] = {static_cast<std::uint16_t>(offset),
+                                    static_cast<std::uint16_t>(end - offset)};
+    out.insert(out.end(), reinterpret_cast<const char*>(range),
+               reinterpret_cast<const char*>(range) + sizeof(range));
+    out.insert(out.end(), new_data + offset, new_data + end);
+    offset = end;
+  }
+}
+
+LogSequenceNumber LogMgr::append(LogRecordHeader& header,
+                                 const std::string& name, const void* body,
+                                 const std::size_t length) {
+  if (buffer_.size() >= BUFFER_BYTES) {
+    writeBuffer();
+  }
+  header.checksum = 0;
+  header.length = sizeof(LogRecordHeader) + name.size() + length;
+  header.lsn = end_lsn_;
+  header.name_length = name.size();
+  std::uint32_t checksum = Checksum::crc32c(0, &header, sizeof(LogRecordHeader));
+  checksum = Checksum::crc32c(checksum, name.data(), name.size());
+  header.checksum = Checksum::crc32c(checksum, body, length);
+
+  const char* header_data = reinterpret_cast<const char*>(&header);
+  buffer_.insert(buffer_.end(), header_data,
+                 header_data + sizeof(LogRecordHeader));
+  buffer_.insert(buffer_.end(), name.begin(), name.end());
+  buffer_.insert(buffer_.end(), static_cast<const char*>(body),
+                 static_cast<const char*>(body) + length);
+
+  const LogSequenceNumber lsn = end_lsn_;
+  end_lsn_ += header.length;
+  stats_.bytes += header.length;
+  return lsn;
+}
+
+void LogMgr::writeBuffer() {
+  if (written_lsn_ + buffer_.size() > allocated_lsn_) {
+    // Syncing a write that grows the file also has to sync its new size, so
+    // the file is grown ahead of the records with zeros, which recovery stops
+    // at like at any record that wasn't written.
+    const std::vector<char> zeros(EXTENT_BYTES, 0);
+    while (written_lsn_ + buffer_.size() > allocated_lsn_) {
+      writeAt(&zeros[0], EXTENT_BYTES, allocated_lsn_);
+      allocated_lsn_ += EXTENT_BYTES;
+    }
+  }
+  // The records stay buffered until all of them are written, so a failed
+  // write is simply repeated by the next flush.
+  writeAt(buffer_.data(), buffer_.size(), written_lsn_);
+  written_lsn_ += buffer_.size();
+  buffer_.clear();
+}
+
+void LogMgr::writeHeader() {
+  char slot[HEADER_SIZE];
+  memset(slot, 0, HEADER_SIZE);
+  LogFileHeader header;
+  header.magic = MAGIC;
+  header.checkpoint_lsn =
+      checkpoint_lsn_ == HEADER_SIZE ? 0 : checkpoint_lsn_;
+  memcpy(slot, &header, sizeof(LogFileHeader));
+  writeAt(slot, HEADER_SIZE, 0 /* position */);
+}
+
+void LogMgr::writeAt(const void* data, const std::size_t length,
+                     const LogSequenceNumber position) {
+  std::size_t written = 0;
+  while (written < length) {
+    const ssize_t result =
+        ::pwrite(fd_, static_cast<const char*>(data) + written,
+                 length - written, position + written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      throw FileIOException(filename_, "write", result < 0 ? errno : 0);
+    }
+    written += result;
+  }
+}
+
+void LogMgr::sync() {
+  if (::fdatasync(fd_) != 0) {
+    throw FileIOException(filename_, "sync", errno);
+  }
+}
+
+}
@@ -0,0 +1,415 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+class File;
+
+/**
+ * @brief Position of a record in the log.  Records are identified by the byte
+ *        offset at which they start in the log file.
+ */
+typedef std::uint64_t LogSequenceNumber;
+
+/**
+ * @brief Counts of the work done by a LogMgr.
+ */
+struct LogStats {
+  /**
+   * Number of page updates logged.
+   */
+  int records;
+
+  /**
+   * Number of those that carried a full page image.
+   */
+  int pageimages;
+
+  /**
+   * Number of bytes appended to the log.
+   */
+  long bytes;
+
+  /**
+   * Number of times the log was synced to stable storage.
+   */
+  int syncs;
+
+  /**
+   * Number of checkpoints taken.
+   */
+  int checkpoints;
+
+  /**
+   * Number of pages written back by recovery.
+   */
+  int redonepages;
+
+  /**
+   * Clears all counts.
+   */
+  void clear() {
+    records = pageimages = syncs = checkpoints = redonepages = 0;
+    bytes = 0;
+  }
+
+  LogStats() {
+    clear();
+  }
+};
+
+/**
+ * @brief Header of every record in the log.
+ */
+struct LogRecordHeader {
+  /**
+   * Kinds of record.
+   */
+  enum Type {
+    PAGE_IMAGE = 1,   /* The whole page */
+    PAGE_DELTA = 2,   /* Changed ranges of the page */
+    CHECKPOINT = 3    /* Where recovery has to start */
+  };
+
+  /**
+   * CRC32C of the whole record, computed with this field set to 0.  A record
+   * that was only partly written when the system crashed doesn't match it.
+   */
+  std::uint32_t checksum;
+
+  /**
+   * Length of the record in bytes, including this header.
+   */
+  std::uint32_t length;
+
+  /**
+   * Position of the record, which it must be read back from.
+   */
+  LogSequenceNumber lsn;
+
+  /**
+   * One of Type.
+   */
+  std::uint8_t type;
+
+  /**
+   * Whether the page belongs to a BlobFile rather than a PageFile.
+   */
+  std::uint8_t blob_file;
+
+  /**
+   * Length of the file name that follows the header.
+   */
+  std::uint16_t name_length;
+
+  /**
+   * Number of the page updated.
+   */
+  PageId page_number;
+};
+
+/**
+ * @brief Write-ahead log of the changes made to pages in the buffer pool.
+ *
+ * The buffer manager logs every change to a page when the page is unpinned
+ * dirty: the whole page the first time the page is dirtied after it was
+ * read or written back, and only the byte ranges that changed after that.
+ * A page is only written back once its records are durable, so pages can
+ * stay dirty in the buffer pool after a commit and be written back lazily,
+ * and committing costs one sequential write and sync of the log.
+ *
+ * Records are appended to a buffer and written out together, so a commit
+ * syncs the records of every change made since the last one at once.
+ * Checkpoints record where recovery has to start without writing back any
+ * page.  Opening a log replays the changes the last run logged but didn't
+ * write back, so a crash loses nothing that was committed.
+ *
+ * Allocating and deleting pages changes the file directly and isn't logged;
+ * pages recovery finds no longer in use are left alone.
+ *
+ * @warning This class is not threadsafe.
+ */
+class LogMgr {
+ public:
+  /**
+   * Size of the slot at the start of the log file that holds the position of
+   * the last checkpoint.  Records start after it.
+   */
+  static const std::uint32_t HEADER_SIZE = 4096;
+
+  /**
+   * Number of bytes logged after which the buffer manager takes a checkpoint
+   * at the next commit.
+   */
+  static const std::uint64_t CHECKPOINT_BYTES = 64 * 1024 * 1024;
+
+  /**
+   * Number of buffered bytes after which records are written to the file
+   * even though nobody asked for them to be durable yet.
+   */
+  static const std::size_t BUFFER_BYTES = 1024 * 1024;
+
+  /**
+   * Number of bytes the log file is grown by at a time.
+   */
+  static const std::size_t EXTENT_BYTES = 1024 * 1024;
+
+  /**
+   * Opens a log, creating it if it doesn't exist, and redoes the changes it
+   * holds that may not have reached their files.
+   *
+   * @param filename  Name of the log file.
+   * @throws  InvalidLogException   If the file exists but isn't a log.
+   * @throws  FileIOException       If the log or a redone page can't be
+   *                                written or synced.
+   */
+  explicit LogMgr(const std::string& filename);
+
+  /**
+   * Writes out any buffered records and closes the log.
+   */
+  ~LogMgr();
+
+  /**
+   * Logs a change to a page.
+   *
+   * @param file        File the page belongs to.
+   * @param page_number Number of page.
+   * @param before      The page as of its last record, or NULL to log the
+   *                    whole page.
+   * @param after       The page as it is now.
+   * @return  Position of the record, or 0 if the page didn't change.
+   */
+  LogSequenceNumber logPage(const File* file, const PageId page_number,
+                            const Page* before, const Page& after);
+
+  /**
+   * Makes every record up to the given one durable.  All records appended so
+   * far are written and synced together, so records appended since the last
+   * flush share a single sync.
+   *
+   * @param lsn   Position of the last record that must be durable.
+   * @throws  FileIOException   If the records can't be written or synced.
+   *                            They stay buffered, and the next flush tries
+   *                            again.
+   */
+  void flush(const LogSequenceNumber lsn);
+
+  /**
+   * Makes every record appended so far durable.
+   *
+   * @throws  FileIOException   If the records can't be written or synced.
+   */
+  void flush() { flush(end_lsn_); }
+
+  /**
+   * Returns whether the record at the given position is durable.
+   *
+   * @param lsn   Position of record.
+   */
+  bool isDurable(const LogSequenceNumber lsn) const {
+    return lsn < durable_lsn_ || durable_lsn_ == end_lsn_;
+  }
+
+  /**
+   * Records that recovery can start at the given position, because every
+   * change logged before it has been written back and synced.  Log space
+   * before that position is released.  If recovery wouldn't have anything to
+   * redo, the log is emptied instead.
+   *
+   * @param redo_lsn  Position of the oldest record whose change may not be
+   *                  on disk yet.
+   * @throws  FileIOException   If the log can't be written, synced or
+   *                            truncated.
+   */
+  void checkpoint(const LogSequenceNumber redo_lsn);
+
+  /**
+   * Returns the position the next record will be written at.
+   */
+  LogSequenceNumber endLsn() const { return end_lsn_; }
+
+  /**
+   * Returns whether enough has been logged since the last checkpoint that
+   * another one is worthwhile.
+   */
+  bool checkpointDue() const {
+    return end_lsn_ - checkpoint_lsn_ >= CHECKPOINT_BYTES;
+  }
+
+  /**
+   * Returns the name of the log file.
+   */
+  const std::string& filename() const { return filename_; }
+
+  /**
+   * Returns counts of the work done by this log.
+   */
+  LogStats& getLogStats() { return stats_; }
+
+ private:
+  /**
+   * Identifies a log file.
+   */
+  static const std::uint32_t MAGIC = 0x474C4442;
+
+  /**
+   * Contents of the header slot.
+   */
+  struct LogFileHeader {
+    std::uint32_t magic;
+
+    /**
+     * Position of the last checkpoint record, or 0 if there is none.
+     */
+    LogSequenceNumber checkpoint_lsn;
+  };
+
+  /**
+   * Reads the log from the last checkpoint on, writes the last logged image
+   * of every page back to its file and syncs the files.  The log ends at
+   * the first record that wasn't completely written.
+   */
+  void recover();
+
+  /**
+   * Reads the record at the given position, checking that it was written
+   * completely.
+   *
+   * @param lsn     Position of record.
+   * @param record  Set to the bytes of the record.
+   * @return  False if there is no complete record at lsn.
+   */
+  bool readRecord(const LogSequenceNumber lsn,
+                  std::vector<char>& record) const;
+
+  /**
+   * Applies the changed ranges in a PAGE_DELTA record to a page.
+   *
+   * @param data    Ranges as logged.
+   * @param length  Length of data.
+   * @param page    Page to change.
+   * @return  False if the ranges don't fit in a page.
+   */
+  static bool applyDelta(const char* data, const std::size_t length,
+                         Page& page);
+
+  /**
+   * Appends the ranges in which two pages differ, each as a 2 byte offset, a
+   * 2 byte length and the new bytes.
+   *
+   * @param before  Old page.
+   * @param after   New page.
+   * @param out     Buffer to append to.
+   */
+  static void appendDelta(const Page& before, const Page& after,
+                          std::vector<char>& out);
+
+  /**
+   * Appends a record to the buffer.
+   *
+   * @param header  Header of record; checksum, length and lsn are filled in.
+   * @param name    File name to follow the header.
+   * @param body    Rest of the record.
+   * @param length  Length of body.
+   * @return  Position of the record.
+   */
+  LogSequenceNumber append(LogRecordHeader& header, const std::string& name,
+                           const void* body, const std::size_t length);
+
+  /**
+   * Writes the buffered records to the log file without syncing it.
+   *
+   * @throws  FileIOException   If they can't all be written.  They stay
+   *                            buffered then.
+   */
+  void writeBuffer();
+
+  /**
+   * Writes the header slot.
+   *
+   * @throws  FileIOException   If it can't be written.
+   */
+  void writeHeader();
+
+  /**
+   * Writes bytes at a position of the log file, retrying short writes.
+   *
+   * @throws  FileIOException   If they can't all be written.
+   */
+  void writeAt(const void* data, const std::size_t length,
+               const LogSequenceNumber position);
+
+  /**
+   * Syncs the log file.
+   *
+   * @throws  FileIOException   If it can't be synced.
+   */
+  void sync();
+
+  /**
+   * Name of the log file.
+   */
+  std::string filename_;
+
+  /**
+   * Descriptor of the log file.
+   */
+  int fd_;
+
+  /**
+   * Records appended but not written to the file yet.  They start at
+   * written_lsn_.
+   */
+  std::vector<char> buffer_;
+
+  /**
+   * Changed ranges of the page being logged, kept to save reallocating them.
+   */
+  std::vector<char> delta_;
+
+  /**
+   * Position the next record will be written at.
+   */
+  LogSequenceNumber end_lsn_;
+
+  /**
+   * Position up to which records have been written to the file.
+   */
+  LogSequenceNumber written_lsn_;
+
+  /**
+   * Position up to which records are durable.
+   */
+  LogSequenceNumber durable_lsn_;
+
+  /**
+   * Position of the last checkpoint record, or HEADER_SIZE if there is none.
+   */
+  LogSequenceNumber checkpoint_lsn_;
+
+  /**
+   * Length of the log file, which may run past the last record.
+   */
+  LogSequenceNumber allocated_lsn_;
+
+  /**
+   * Work done by this log.
+   */
+  LogStats stats_;
+};
+
+}
@@ -9,11 +9,19 @@
  */
 
 #include <vector>
+#include <algorithm>
+#include <map>
+#include <fstream>
+#include <limits>
 #include "btree.h"
 #include "page.h"
 #include "filescan.h"
+#include "parallel_filescan.h"
+#include "heapfile.h"
+#include "log.h"
 #include "page_iterator.h"
 #include "file_iterator.h"
+#include "tablespace.h"
 #include "exceptions/insufficient_space_exception.h"
 #include "exceptions/index_scan_completed_exception.h"
 #include "exceptions/file_not_found_exception.h"
@@ -23,6 +31,10 @@
 #include "exceptions/scan_not_initialized_exception.h"
 #include "exceptions/end_of_file_exception.h"
 #include "exceptions/file_open_exception.h"
+#include "exceptions/corrupt_page_exception.h"
+#include "exceptions/invalid_record_exception.h"
+#include "exceptions/file_read_only_exception.h"
+#include "exceptions/invalid_pax_layout_exception.h"
 
 
 // checks if tests pass or fail
@@ -106,6 +118,24 @@ void sparseTest();
 void sparseIndexTests();
 void sparseIntTests();
 void reopenIndexTests();
+void formatUpgradeTests();
+void heapFileTests();
+void logRecoveryTests();
+void blobFileTests();
+void checksumTests();
+void overflowTests();
+void forwardingTests();
+void parallelScanTests();
+void batchScanTests();
+void zoneMapTests();
+void bloomFilterTests();
+void durabilityTests();
+void mappedFileTests();
+void tablespaceTests();
+void paxTests();
+void sharedFileTests();
+void iterationTests();
+void pushdownTests();
 
 
 int main(int argc, char **argv)
@@ -173,11 +203,30 @@ int main(int argc, char **argv)
 	reopenIndexTests();
   errorTests();
   sparseTest();
+	formatUpgradeTests();
+	heapFileTests();
+	logRecoveryTests();
+	blobFileTests();
+	checksumTests();
+	overflowTests();
+	forwardingTests();
+	parallelScanTests();
+	batchScanTests();
+	zoneMapTests();
+	bloomFilterTests();
+	durabilityTests();
+	mappedFileTests();
+	tablespaceTests();
+	paxTests();
+	sharedFileTests();
+	iterationTests();
+	pushdownTests();
   //createRelationForwardStressTest();
   //createRelationBackwardStressTest();
  	//createRelationRandomStressTest();
 
 
+	bufMgr->close();
 	delete bufMgr;
 
   return 1;
@@ -365,37 +414,23 @@ void createRelationForward(int relationSize)
 	{
 	}
 
-  file1 = new PageFile(relationName, true);
-
-  // initialize all of record1.s to keep purify happy
-  memset(record1.s, ' ', sizeof(record1.s));
-	PageId new_page_number;
-  Page new_page = file1->allocatePage(new_page_number);
-
-  // Insert a bunch of tuples into the relation.
-  for(int i = 0; i < relationSize; i++ )
-	{
-    sprintf(record1.s, "%05d string record", i);
-    record1.i = i;
-    record1.d = (double)i;
-    std::string new_data(reinterpret_cast<char*>(&record1), sizeof(record1));
-
-		while(1)
-		{
-			try
-			{
-    		new_page.insertRecord(new_data);
-				break;
-			}
-			catch(const InsufficientSpaceException &e)
-			{
-				file1->writePage(new_page_number, new_page);
-  			new_page = file1->allocatePage(new_page_number);
-			}
-		}
+  {
+    HeapFile heapFile(relationName, bufMgr, true);
+
+    // initialize all of record1.s to keep purify happy
+    memset(record1.s, ' ', sizeof(record1.s));
+
+    // Insert a bunch of tuples into the relation.
+    for(int i = 0; i < relationSize; i++ )
+    {
+      sprintf(record1.s, "%05d string record", i);
+      record1.i = i;
+      record1.d = (double)i;
+      heapFile.insertRecord(reinterpret_cast<char*>(&record1), sizeof(record1));
+    }
   }
 
-	file1->writePage(new_page_number, new_page);
+  file1 = new PageFile(relationName, false);
 }
 
 // -----------------------------------------------------------------------------
@@ -810,3 +845,1862 @@ void deleteRelation()
 	{
 	}
 }
+
+// -----------------------------------------------------------------------------
+// heapFileTests
+// -----------------------------------------------------------------------------
+
+const std::string heapFileName = "relA.heap";
+
+void removeHeapFile()
+{
+	const std::string names[] = {heapFileName, OverflowFile::nameFor(heapFileName),
+	                             ZoneMap::nameFor(heapFileName), BloomFilterFile::nameFor(heapFileName)};
+	for (int i = 0; i < 4; i++)
+	{
+		try
+		{
+			File::remove(names[i]);
+		}
+		catch(const FileNotFoundException &e)
+		{
+		}
+	}
+}
+
+// Returns the size of a file in bytes.
+std::streamoff fileSize(const std::string &name)
+{
+	std::ifstream in(name, std::ifstream::binary | std::ifstream::ate);
+	return in.tellg();
+}
+
+typedef std::map<std::pair<PageId, SlotId>, std::string> RecordMap;
+
+// Returns the key of a record in a RecordMap.
+std::pair<PageId, SlotId> recordKey(const RecordId &rid)
+{
+	return std::make_pair(rid.page_number, rid.slot_number);
+}
+
+// Returns whether a scan of the relation returns every expected record exactly once, under
+// the RecordId it was inserted with.
+bool scanMatches(const std::string &name, const RecordMap &expected)
+{
+	RecordMap found;
+	FileScan scan(name, bufMgr);
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			if (!found.insert(std::make_pair(recordKey(rid), scan.getRecord())).second)
+			{
+				return false;
+			}
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return found == expected;
+}
+
+// Returns a record of the given length whose bytes depend on the seed.
+std::string longRecord(std::size_t length, int seed)
+{
+	std::string record(length, ' ');
+	for (std::size_t i = 0; i < length; i++)
+	{
+		record[i] = 'a' + (i * 7 + seed) % 26;
+	}
+	return record;
+}
+
+void heapFileTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "heapFileTests" << std::endl;
+	removeHeapFile();
+	memset(record1.s, ' ', sizeof(record1.s));
+
+	std::cout << "Reuse space of a reopened relation" << std::endl;
+	std::vector<RecordId> rids;
+	PageId lastPage = Page::INVALID_NUMBER;
+	int numDeleted = 0;
+	{
+		HeapFile heapFile(heapFileName, bufMgr, true);
+		for (int i = 0; i < 1000; i++)
+		{
+			sprintf(record1.s, "%05d string record", i);
+			record1.i = i;
+			record1.d = (double)i;
+			rids.push_back(heapFile.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))));
+			lastPage = std::max(lastPage, rids.back().page_number);
+		}
+		// Empty the first page, whose free space the reopened relation only learns of by looking.
+		for (int i = 0; i < 1000 && rids[i].page_number == rids[0].page_number; i++)
+		{
+			heapFile.deleteRecord(rids[i]);
+			numDeleted++;
+		}
+		heapFile.close();
+	}
+	{
+		// Opening the relation reads none of its pages.
+		bufMgr->clearBufStats();
+		HeapFile heapFile(heapFileName, bufMgr);
+		checkPassFail(bufMgr->getBufStats().accesses, 0)
+		PageId newLastPage = Page::INVALID_NUMBER;
+		for (int i = 0; i < numDeleted; i++)
+		{
+			record1.i = 1000 + i;
+			newLastPage = std::max(newLastPage, heapFile.insertRecord(std::string(reinterpret_cast<char*>(&record1), sizeof(record1))).page_number);
+		}
+		checkPassFail(newLastPage, lastPage)
+	}
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// blobFileTests
+// -----------------------------------------------------------------------------
+
+const std::string blobFileName = "relA.blob";
+
+// Returns whether every byte of a page is the given one.
+bool pageFilledWith(const Page &page, char fill)
+{
+	const char *bytes = reinterpret_cast<const char*>(&page);
+	for (std::size_t i = 0; i < Page::SIZE; i++)
+	{
+		if (bytes[i] != fill)
+		{
+			return false;
+		}
+	}
+	return true;
+}
+
+void removeBlobFile()
+{
+	try
+	{
+		File::remove(blobFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+void blobFileTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "blobFileTests" << std::endl;
+	removeBlobFile();
+
+	std::cout << "Reuse a deleted page" << std::endl;
+	{
+		BlobFile file = BlobFile::create(blobFileName);
+		Page page(Page::UNINITIALIZED);
+		memset(static_cast<void*>(&page), 'x', Page::SIZE);
+		PageId first;
+		PageId second;
+		file.allocatePage(first);
+		file.writePage(first, page);
+		file.allocatePage(second);
+		file.writePage(second, page);
+		file.deletePage(first);
+
+		// The page comes back as zeros that match its checksum, not with its old bytes.
+		PageId reused;
+		file.allocatePage(reused);
+		checkPassFail(reused, first)
+		checkPassFail(pageFilledWith(file.readPage(reused), 0), true)
+		checkPassFail(pageFilledWith(file.readPage(second), 'x'), true)
+	}
+	removeBlobFile();
+
+	std::cout << "Reuse pages freed in an earlier extent" << std::endl;
+	{
+		BlobFile file = BlobFile::create(blobFileName);
+		PageId pageNo;
+		for (PageId i = 0; i < BlobFile::EXTENT_PAGES + 10; i++)
+		{
+			file.allocatePage(pageNo);
+		}
+		file.deletePage(5);
+		file.deletePage(6);
+		// Fill the tail extent, so the freed pages are the only free ones left.
+		while (pageNo < 2 * BlobFile::EXTENT_PAGES)
+		{
+			file.allocatePage(pageNo);
+		}
+		const std::streamoff size = fileSize(blobFileName);
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, 5)
+		// A hint in a full extent doesn't keep the last free page from being used.
+		file.allocatePage(pageNo, 2 * BlobFile::EXTENT_PAGES);
+		checkPassFail(pageNo, 6)
+		checkPassFail(fileSize(blobFileName), size)
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, 2 * BlobFile::EXTENT_PAGES + 1)
+	}
+	removeBlobFile();
+
+	std::cout << "Round trip pages of a compressed file" << std::endl;
+	{
+		// Pages of repeated bytes compress well; pages of noise are stored raw.
+		Page pages[8];
+		for (int p = 0; p < 8; p++)
+		{
+			char *bytes = reinterpret_cast<char*>(&pages[p]);
+			for (std::size_t i = 0; i < Page::SIZE; i++)
+			{
+				bytes[i] = p % 2 == 0 ? (char)('a' + p) : (char)((i * 2654435761u + p) >> 13);
+			}
+		}
+		{
+			BlobFile file = BlobFile::createCompressed(blobFileName);
+			checkPassFail(file.isCompressed(), true)
+			for (int p = 0; p < 8; p++)
+			{
+				PageId pageNo;
+				file.allocatePage(pageNo);
+				file.writePage(pageNo, pages[p]);
+			}
+			// Replace a small image with a large one and the other way round.
+			std::swap(pages[2], pages[3]);
+			file.writePage(3, pages[2]);
+			file.writePage(4, pages[3]);
+			file.deletePage(8);
+		}
+		BlobFile file = BlobFile::open(blobFileName);
+		checkPassFail(file.isCompressed(), true)
+		int numMatching = 0;
+		for (int p = 0; p < 7; p++)
+		{
+			const Page page = file.readPage(p + 1);
+			numMatching += memcmp(&page, &pages[p], Page::SIZE) == 0;
+		}
+		checkPassFail(numMatching, 7)
+		// The deleted page is handed out again and reads as zeros.
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, 8)
+		checkPassFail(pageFilledWith(file.readPage(pageNo), 0), true)
+	}
+	removeBlobFile();
+}
+
+// -----------------------------------------------------------------------------
+// checksumTests
+// -----------------------------------------------------------------------------
+
+const std::string checksumFileName = "relA.sum";
+
+void removeChecksumFile()
+{
+	try
+	{
+		File::remove(checksumFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+void checksumTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "checksumTests" << std::endl;
+	removeChecksumFile();
+	{
+		PageFile file = PageFile::create(checksumFileName);
+		file.setChecksums(true);
+		for (int i = 0; i < 2; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			page.insertRecord("checksummed record");
+			file.writePage(pageNo, page);
+		}
+	}
+	{
+		// Page 1 follows the header slot and the two metadata slots of its group.
+		std::fstream out(checksumFileName, std::fstream::in | std::fstream::out | std::fstream::binary);
+		const char flipped = 0x7f;
+		out.seekp(3 * Page::SIZE + Page::SIZE / 2);
+		out.write(&flipped, 1);
+	}
+
+	std::cout << "Read a corrupt page" << std::endl;
+	{
+		PageFile file = PageFile::open(checksumFileName);
+		bool corrupt = false;
+		try
+		{
+			file.readPage(1);
+		}
+		catch(const CorruptPageException &e)
+		{
+			corrupt = e.page_number() == 1;
+		}
+		checkPassFail(corrupt, true)
+
+		corrupt = false;
+		try
+		{
+			Page* page;
+			bufMgr->readPage(&file, 1, page);
+			bufMgr->unPinPage(&file, 1, false);
+		}
+		catch(const CorruptPageException &e)
+		{
+			corrupt = true;
+		}
+		checkPassFail(corrupt, true)
+
+		// Other pages are still read as usual.
+		Page page = file.readPage(2);
+		checkPassFail(*page.begin(), std::string("checksummed record"))
+		bufMgr->flushFile(&file);
+	}
+	removeChecksumFile();
+}
+
+// -----------------------------------------------------------------------------
+// overflowTests
+// -----------------------------------------------------------------------------
+
+void overflowTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "overflowTests" << std::endl;
+	removeHeapFile();
+	{
+		HeapFile heapFile(heapFileName, bufMgr, true);
+
+		std::cout << "Store records longer than a page" << std::endl;
+		const std::string shortRecord = longRecord(100, 0);
+		const std::string record = longRecord(50000, 1);
+		const RecordId shortRid = heapFile.insertRecord(shortRecord);
+		const RecordId rid = heapFile.insertRecord(record);
+		checkPassFail((heapFile.getRecord(rid) == record), true)
+		checkPassFail((heapFile.getRecord(shortRid) == shortRecord), true)
+
+		std::cout << "Update a long record" << std::endl;
+		const std::string shorter = longRecord(HeapFile::MAX_INLINE_LENGTH + 1, 2);
+		heapFile.updateRecord(rid, shorter);
+		checkPassFail((heapFile.getRecord(rid) == shorter), true)
+		const std::string longer = longRecord(80000, 3);
+		heapFile.updateRecord(rid, longer);
+		checkPassFail((heapFile.getRecord(rid) == longer), true)
+
+		std::cout << "Delete a long record" << std::endl;
+		heapFile.deleteRecord(rid);
+		bool deleted = false;
+		try
+		{
+			heapFile.getRecord(rid);
+		}
+		catch(const InvalidRecordException &e)
+		{
+			deleted = true;
+		}
+		checkPassFail(deleted, true)
+		checkPassFail((heapFile.getRecord(shortRid) == shortRecord), true)
+
+		// Pages of deleted chains are reused, so storing and deleting long records over and over
+		// takes less room than the records together.
+		for (int i = 0; i < 100; i++)
+		{
+			heapFile.deleteRecord(heapFile.insertRecord(record));
+		}
+		heapFile.close();
+		checkPassFail((fileSize(OverflowFile::nameFor(heapFileName)) < 100 * 50000), true)
+	}
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// forwardingTests
+// -----------------------------------------------------------------------------
+
+void forwardingTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "forwardingTests" << std::endl;
+	removeHeapFile();
+	std::vector<RecordId> rids;
+	RecordMap expected;
+	{
+		HeapFile heapFile(heapFileName, bufMgr, true);
+		for (int i = 0; i < 400; i++)
+		{
+			const std::string record = longRecord(100, i);
+			rids.push_back(heapFile.insertRecord(record));
+			expected[recordKey(rids.back())] = record;
+		}
+
+		std::cout << "Grow records past the room on their pages" << std::endl;
+		for (int i = 0; i < 400; i += 40)
+		{
+			const std::string record = longRecord(1500, i);
+			heapFile.updateRecord(rids[i], record);
+			expected[recordKey(rids[i])] = record;
+		}
+		checkPassFail((heapFile.getHeapStats().relocations > 0), true)
+		int numMatching = 0;
+		for (int i = 0; i < 400; i++)
+		{
+			numMatching += heapFile.getRecord(rids[i]) == expected[recordKey(rids[i])];
+		}
+		checkPassFail(numMatching, 400)
+
+		// A moved record that grows again moves once more, still under its own RecordId.
+		const std::string record = longRecord(1800, 1);
+		heapFile.updateRecord(rids[0], record);
+		expected[recordKey(rids[0])] = record;
+		checkPassFail((heapFile.getRecord(rids[0]) == record), true)
+	}
+	checkPassFail(scanMatches(heapFileName, expected), true)
+
+	std::cout << "Collapse forwarding once home pages have room" << std::endl;
+	{
+		HeapFile heapFile(heapFileName, bufMgr);
+		for (int i = 1; i < 400; i++)
+		{
+			if (i % 40 >= 20)
+			{
+				heapFile.deleteRecord(rids[i]);
+				expected.erase(recordKey(rids[i]));
+			}
+		}
+		heapFile.clearHeapStats();
+		const std::size_t numCollapsed = heapFile.collapseForwarding();
+		checkPassFail((numCollapsed > 0), true)
+		checkPassFail(heapFile.getHeapStats().collapses, (int)numCollapsed)
+		int numMatching = 0;
+		for (RecordMap::const_iterator iter = expected.begin(); iter != expected.end(); ++iter)
+		{
+			RecordId rid;
+			rid.page_number = iter->first.first;
+			rid.slot_number = iter->first.second;
+			numMatching += heapFile.getRecord(rid) == iter->second;
+		}
+		checkPassFail(numMatching, (int)expected.size())
+		// Collapsed records are fetched without following a stub.
+		heapFile.clearHeapStats();
+		heapFile.getRecord(rids[40]);
+		checkPassFail(heapFile.getHeapStats().forwardedFetches, 0)
+	}
+	checkPassFail(scanMatches(heapFileName, expected), true)
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// parallelScanTests
+// -----------------------------------------------------------------------------
+
+// Creates a relation of RECORDs numbered from 0, returning their RecordIds.
+std::vector<RecordId> createScanRelation(int numRecords)
+{
+	removeHeapFile();
+	std::vector<RecordId> rids;
+	HeapFile heapFile(heapFileName, bufMgr, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	for (int i = 0; i < numRecords; i++)
+	{
+		sprintf(record1.s, "%05d string record", i);
+		record1.i = i;
+		record1.d = (double)i;
+		rids.push_back(heapFile.insertRecord(reinterpret_cast<char*>(&record1), sizeof(record1)));
+	}
+	return rids;
+}
+
+// Returns the number of records of a ParallelFileScan; sets duplicate if any was returned twice.
+int parallelScanCount(const Predicate &predicate, std::size_t numStreams, bool &duplicate)
+{
+	ParallelFileScan scan(heapFileName, bufMgr, numStreams, predicate, 4 /* morsel_pages */);
+	std::vector<std::vector<RecordId> > found(numStreams);
+	scan.run([&](FileScan& stream, std::size_t thread)
+	{
+		RecordId rid;
+		try
+		{
+			while (true)
+			{
+				stream.scanNext(rid);
+				found[thread].push_back(rid);
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	});
+
+	RecordMap all;
+	int numFound = 0;
+	duplicate = false;
+	for (std::size_t i = 0; i < numStreams; i++)
+	{
+		for (std::size_t j = 0; j < found[i].size(); j++)
+		{
+			duplicate = duplicate || !all.insert(std::make_pair(recordKey(found[i][j]), std::string())).second;
+			numFound++;
+		}
+	}
+	return numFound;
+}
+
+void parallelScanTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "parallelScanTests" << std::endl;
+	createScanRelation(5000);
+
+	std::cout << "Return every record once across streams" << std::endl;
+	bool duplicate;
+	checkPassFail(parallelScanCount(Predicate(), 4, duplicate), 5000)
+	checkPassFail(duplicate, false)
+	checkPassFail(parallelScanCount(Predicate(), 1, duplicate), 5000)
+	checkPassFail(duplicate, false)
+
+	std::cout << "Return every matching record once across streams" << std::endl;
+	const Predicate predicate = Predicate::intAt(offsetof(RECORD, i), LESS, 1000);
+	checkPassFail(parallelScanCount(predicate, 4, duplicate), 1000)
+	checkPassFail(duplicate, false)
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// batchScanTests
+// -----------------------------------------------------------------------------
+
+// Returns whether scanNextBatch returns the same records in the same order as scanNext.
+bool batchMatchesScan(const Predicate &predicate, std::size_t capacity, bool recordViews)
+{
+	std::vector<RecordId> rids;
+	std::vector<std::string> records;
+	{
+		FileScan scan(heapFileName, bufMgr, predicate);
+		try
+		{
+			RecordId rid;
+			while (true)
+			{
+				scan.scanNext(rid);
+				rids.push_back(rid);
+				records.push_back(scan.getRecord());
+			}
+		}
+		catch(const EndOfFileException &e)
+		{
+		}
+	}
+
+	FileScan scan(heapFileName, bufMgr, predicate);
+	RecordBatch batch(capacity, recordViews);
+	const std::size_t keys = batch.addColumn(offsetof(RECORD, i), sizeof(int));
+	std::size_t numFound = 0;
+	while (scan.scanNextBatch(batch))
+	{
+		for (std::size_t i = 0; i < batch.size(); i++, numFound++)
+		{
+			if (numFound >= rids.size() || !(batch.recordIds()[i] == rids[numFound]) ||
+			    batch.column<int>(keys)[i] != reinterpret_cast<const RECORD*>(records[numFound].data())->i)
+			{
+				return false;
+			}
+			// Views of records with overflow chains only cover the part on the page.
+			if (recordViews && records[numFound].length() <= HeapFile::MAX_INLINE_LENGTH &&
+			    std::string(batch.records()[i].data, batch.records()[i].length) != records[numFound])
+			{
+				return false;
+			}
+		}
+	}
+	return numFound == rids.size() && !rids.empty();
+}
+
+void batchScanTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "batchScanTests" << std::endl;
+	const std::vector<RecordId> rids = createScanRelation(5000);
+	{
+		// Moved records and records with overflow chains are returned like any other.
+		HeapFile heapFile(heapFileName, bufMgr);
+		for (int i = 0; i < 5000; i += 250)
+		{
+			std::string record = heapFile.getRecord(rids[i]);
+			record.resize(i % 500 == 0 ? 20000 : 1500, 'x');
+			heapFile.updateRecord(rids[i], record);
+		}
+	}
+
+	std::cout << "Return the records of scanNext in batches" << std::endl;
+	checkPassFail(batchMatchesScan(Predicate(), RecordBatch::DEFAULT_CAPACITY, true), true)
+	checkPassFail(batchMatchesScan(Predicate(), 7, true), true)
+	checkPassFail(batchMatchesScan(Predicate(), 100, false), true)
+
+	std::cout << "Return the matching records of scanNext in batches" << std::endl;
+	const Predicate predicate = Predicate::anyOf(
+	    Predicate::intAt(offsetof(RECORD, i), LESS, 300),
+	    Predicate::intAt(offsetof(RECORD, i), GREATER_EQUAL, 4500));
+	checkPassFail(batchMatchesScan(predicate, 64, true), true)
+	checkPassFail(batchMatchesScan(predicate, 64, false), true)
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// zoneMapTests
+// -----------------------------------------------------------------------------
+
+// Returns the number of records a scan with the predicate returns, adding the pages it skipped.
+int predicateScanCount(const Predicate &predicate, int &pagesSkipped)
+{
+	FileScan scan(heapFileName, bufMgr, predicate);
+	int numFound = 0;
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			numFound++;
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	pagesSkipped += scan.getScanStats().pagesSkipped();
+	return numFound;
+}
+
+// Returns the number of records matching the predicate, checking every record.
+int bruteForceCount(const Predicate &predicate)
+{
+	FileScan scan(heapFileName, bufMgr);
+	int numFound = 0;
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			const std::string record = scan.getRecord();
+			numFound += predicate.matches(record.data(), record.length());
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return numFound;
+}
+
+// Changes records of a relation with summaries so that pages get values the summaries were
+// built without: new pages, a record moved to the end of the relation, and values outside the
+// range of their page.
+void changeSummarizedRelation(const std::vector<RecordId> &rids)
+{
+	HeapFile heapFile(heapFileName, bufMgr);
+	for (int i = 0; i < 200; i++)
+	{
+		sprintf(record1.s, "%05d string record", 10000 + i);
+		record1.i = 10000 + i;
+		record1.d = (double)record1.i;
+		heapFile.insertRecord(reinterpret_cast<char*>(&record1), sizeof(record1));
+	}
+	std::string record = heapFile.getRecord(rids[100]);
+	reinterpret_cast<RECORD*>(&record[0])->i = 99999;
+	heapFile.updateRecord(rids[100], record);
+	record = heapFile.getRecord(rids[200]);
+	reinterpret_cast<RECORD*>(&record[0])->d = std::numeric_limits<double>::quiet_NaN();
+	heapFile.updateRecord(rids[200], record);
+	record = heapFile.getRecord(rids[300]);
+	reinterpret_cast<RECORD*>(&record[0])->i = -5;
+	record.resize(3000, 'x');
+	heapFile.updateRecord(rids[300], record);
+	heapFile.deleteRecord(rids[400]);
+}
+
+// Returns the number of predicates a scan returns other than every matching record for, and
+// adds the pages the scans skipped.
+int summaryScanMismatches(const std::vector<Predicate> &predicates, int &pagesSkipped)
+{
+	int numMismatches = 0;
+	for (std::size_t i = 0; i < predicates.size(); i++)
+	{
+		numMismatches += predicateScanCount(predicates[i], pagesSkipped) != bruteForceCount(predicates[i]);
+	}
+	return numMismatches;
+}
+
+void zoneMapTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "zoneMapTests" << std::endl;
+	const std::vector<RecordId> rids = createScanRelation(5000);
+	{
+		HeapFile heapFile(heapFileName, bufMgr);
+		std::vector<ZoneAttribute> attributes;
+		const ZoneAttribute key = {offsetof(RECORD, i), INT_ATTRIBUTE};
+		const ZoneAttribute value = {offsetof(RECORD, d), DOUBLE_ATTRIBUTE};
+		attributes.push_back(key);
+		attributes.push_back(value);
+		heapFile.createZoneMap(attributes);
+	}
+	changeSummarizedRelation(rids);
+
+	std::cout << "Skip only pages without matches" << std::endl;
+	std::vector<Predicate> predicates;
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), EQUAL, 99999));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), LESS, 0));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), LESS, 50));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), GREATER_EQUAL, 10100));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), NOT_EQUAL, 3));
+	predicates.push_back(Predicate::doubleAt(offsetof(RECORD, d), LESS_EQUAL, 10.0));
+	predicates.push_back(Predicate::doubleAt(offsetof(RECORD, d), NOT_EQUAL, 200.0));
+	predicates.push_back(Predicate::allOf(Predicate::intAt(offsetof(RECORD, i), GREATER, 1000),
+	                                      Predicate::intAt(offsetof(RECORD, i), LESS, 1100)));
+	predicates.push_back(Predicate::anyOf(Predicate::intAt(offsetof(RECORD, i), EQUAL, 4321),
+	                                      Predicate::doubleAt(offsetof(RECORD, d), EQUAL, 10150.0)));
+	int pagesSkipped = 0;
+	checkPassFail(summaryScanMismatches(predicates, pagesSkipped), 0)
+	checkPassFail((pagesSkipped > 0), true)
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// bloomFilterTests
+// -----------------------------------------------------------------------------
+
+void bloomFilterTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "bloomFilterTests" << std::endl;
+	const std::vector<RecordId> rids = createScanRelation(5000);
+	{
+		HeapFile heapFile(heapFileName, bufMgr);
+		std::vector<FilterAttribute> attributes;
+		const FilterAttribute key = {offsetof(RECORD, i), sizeof(int), INT_ATTRIBUTE};
+		const FilterAttribute value = {offsetof(RECORD, d), sizeof(double), DOUBLE_ATTRIBUTE};
+		const FilterAttribute name = {offsetof(RECORD, s), sizeof(record1.s), STRING_ATTRIBUTE};
+		attributes.push_back(key);
+		attributes.push_back(value);
+		attributes.push_back(name);
+		heapFile.createBloomFilters(attributes);
+	}
+	changeSummarizedRelation(rids);
+
+	std::cout << "Skip only pages without matches" << std::endl;
+	std::vector<Predicate> predicates;
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), EQUAL, 99999));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), EQUAL, -5));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), EQUAL, 10150));
+	predicates.push_back(Predicate::intAt(offsetof(RECORD, i), EQUAL, 400));
+	// Both zeros of a double are equal.
+	predicates.push_back(Predicate::doubleAt(offsetof(RECORD, d), EQUAL, -0.0));
+	predicates.push_back(Predicate::doubleAt(offsetof(RECORD, d), EQUAL, 2500.0));
+	predicates.push_back(Predicate::stringAt(offsetof(RECORD, s), sizeof(record1.s), EQUAL, "04321 string record"));
+	predicates.push_back(Predicate::stringAt(offsetof(RECORD, s), sizeof(record1.s), EQUAL, "00300 string record"));
+	predicates.push_back(Predicate::anyOf(Predicate::intAt(offsetof(RECORD, i), EQUAL, 17),
+	                                      Predicate::intAt(offsetof(RECORD, i), EQUAL, 4999)));
+	predicates.push_back(Predicate::allOf(Predicate::intAt(offsetof(RECORD, i), EQUAL, 1234),
+	                                      Predicate::doubleAt(offsetof(RECORD, d), EQUAL, 1234.0)));
+	int pagesSkipped = 0;
+	checkPassFail(summaryScanMismatches(predicates, pagesSkipped), 0)
+	checkPassFail((pagesSkipped > 0), true)
+	removeHeapFile();
+}
+
+// -----------------------------------------------------------------------------
+// formatUpgradeTests
+// -----------------------------------------------------------------------------
+
+const std::string oldFileName = "relA.old";
+
+void removeOldFile()
+{
+	try
+	{
+		File::remove(oldFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+// Writes bytes of a hand-built file in an older format.
+void writeOldBytes(std::fstream &out, std::streamoff position, const void *data, std::size_t length)
+{
+	out.seekp(position);
+	out.write(reinterpret_cast<const char*>(data), length);
+}
+
+// Writes a relation the way a file of the given format version stored it: pages 1 and 3 hold
+// ten records each and page 2 is free.  Slotted pages from before version 5 kept the end of
+// their slot array where the fragmented byte count is now.  Returns the free space of page 1.
+std::uint16_t writeOldPageFile(std::uint32_t version)
+{
+	removeOldFile();
+	Page pages[3];
+	for (int p = 0; p < 3; p += 2)
+	{
+		for (int i = 0; i < 10; i++)
+		{
+			sprintf(record1.s, "%05d string record", p * 5 + i);
+			record1.i = p * 5 + i;
+			record1.d = (double)record1.i;
+			pages[p].insertRecord(reinterpret_cast<char*>(&record1), sizeof(record1));
+		}
+	}
+	const std::uint16_t freeSpace = pages[0].getFreeSpace();
+	char data[3][Page::SIZE];
+	for (int p = 0; p < 3; p++)
+	{
+		memcpy(data[p], &pages[p], Page::SIZE);
+		PageHeader *header = reinterpret_cast<PageHeader*>(data[p]);
+		header->current_page_number = p + 1;
+		header->next_page_number = p == 0 ? 3 : Page::INVALID_NUMBER;
+		header->fragmented_bytes = p == 1 ? 0 : header->num_slots * sizeof(PageSlot);
+	}
+
+	std::fstream out(oldFileName, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+	std::streamoff firstPage = Page::SIZE;
+	if (version == 0)
+	{
+		LegacyFileHeader header = {4, 1, 1, 2};
+		writeOldBytes(out, 0, &header, sizeof(header));
+		firstPage = sizeof(LegacyFileHeader);
+	}
+	else
+	{
+		FileHeader header = {4, 1, 1, 2, 3, FileHeader::MAGIC, version, 0};
+		char slot[Page::SIZE];
+		memset(slot, 0, Page::SIZE);
+		memcpy(slot, &header, sizeof(header));
+		writeOldBytes(out, 0, slot, Page::SIZE);
+	}
+	if (version >= 2)
+	{
+		// Groups start with their bitmap, and since version 4 with a checksum slot after it.
+		char slot[Page::SIZE];
+		memset(slot, 0, Page::SIZE);
+		slot[0] = 5;
+		writeOldBytes(out, Page::SIZE, slot, Page::SIZE);
+		firstPage = 2 * Page::SIZE;
+		if (version >= 4)
+		{
+			memset(slot, 0, Page::SIZE);
+			writeOldBytes(out, 2 * Page::SIZE, slot, Page::SIZE);
+			firstPage = 3 * Page::SIZE;
+		}
+	}
+	for (int p = 0; p < 3; p++)
+	{
+		writeOldBytes(out, firstPage + p * Page::SIZE, data[p], Page::SIZE);
+	}
+	return freeSpace;
+}
+
+// Reads the version of the format a file is stored in from its header.
+std::uint32_t storedVersion(const std::string &name)
+{
+	FileHeader header;
+	std::ifstream in(name, std::ifstream::binary);
+	in.read(reinterpret_cast<char*>(&header), sizeof(header));
+	return header.magic == FileHeader::MAGIC ? header.version : 0;
+}
+
+void formatUpgradeTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "formatUpgradeTests" << std::endl;
+	std::uint32_t versions[] = {0, 1, 2, 3, 4};
+	for (int v = 0; v < 5; v++)
+	{
+		std::cout << "Upgrade a page file from version " << versions[v] << std::endl;
+		const std::uint16_t freeSpace = writeOldPageFile(versions[v]);
+		{
+			// A copy left behind by an upgrade that crashed is simply replaced.
+			std::ofstream stale(oldFileName + ".upgrade");
+			stale << "torn";
+		}
+		{
+			PageFile file = PageFile::open(oldFileName);
+			int numPages = 0;
+			int numRecords = 0;
+			int sum = 0;
+			for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+			{
+				Page page = *iter;
+				numPages++;
+				for (PageIterator recordIter = page.begin(); recordIter != page.end(); ++recordIter)
+				{
+					const std::string record = *recordIter;
+					sum += reinterpret_cast<const RECORD*>(record.data())->i;
+					numRecords++;
+				}
+				if (iter.page_number() == 1)
+				{
+					checkPassFail(page.getFreeSpace(), freeSpace)
+				}
+			}
+			checkPassFail(numPages, 2)
+			checkPassFail(numRecords, 20)
+			checkPassFail(sum, 190)
+
+			// Page 2 is still free, and pages after it are new.
+			PageId pageNo;
+			file.allocatePage(pageNo);
+			checkPassFail(pageNo, 2)
+			file.allocatePage(pageNo);
+			checkPassFail(pageNo, 4)
+		}
+		checkPassFail(storedVersion(oldFileName), FileHeader::VERSION)
+		checkPassFail(File::exists(oldFileName + ".upgrade"), false)
+		{
+			// The upgraded file opens as it is.
+			PageFile file = PageFile::open(oldFileName);
+			int numPages = 0;
+			for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+			{
+				numPages++;
+			}
+			checkPassFail(numPages, 4)
+		}
+	}
+
+	std::cout << "Upgrade a blob file from version 2" << std::endl;
+	{
+		removeOldFile();
+		std::fstream out(oldFileName, std::fstream::out | std::fstream::binary | std::fstream::trunc);
+		FileHeader header = {4, 1, 0, 0, 3, FileHeader::MAGIC, 2, 0};
+		char slot[Page::SIZE];
+		memset(slot, 0, Page::SIZE);
+		memcpy(slot, &header, sizeof(header));
+		writeOldBytes(out, 0, slot, Page::SIZE);
+		// Blob files had no bitmap before version 3.
+		memset(slot, 0, Page::SIZE);
+		writeOldBytes(out, Page::SIZE, slot, Page::SIZE);
+		for (int p = 1; p <= 3; p++)
+		{
+			memset(slot, p, Page::SIZE);
+			writeOldBytes(out, Page::SIZE + p * Page::SIZE, slot, Page::SIZE);
+		}
+	}
+	{
+		BlobFile file = BlobFile::open(oldFileName);
+		int numMatching = 0;
+		for (PageId p = 1; p <= 3; p++)
+		{
+			Page page = file.readPage(p);
+			const char *bytes = reinterpret_cast<const char*>(&page);
+			numMatching += bytes[0] == (char)p && bytes[Page::SIZE - 1] == (char)p;
+		}
+		checkPassFail(numMatching, 3)
+		// Every old page is in use, so the next one is new.
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, 4)
+	}
+	checkPassFail(storedVersion(oldFileName), FileHeader::VERSION)
+
+	std::cout << "Open an empty file" << std::endl;
+	{
+		removeOldFile();
+		std::ofstream empty(oldFileName);
+	}
+	{
+		PageFile file = PageFile::open(oldFileName);
+		checkPassFail((file.begin() == file.end()), true)
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		checkPassFail(pageNo, 1)
+	}
+	removeOldFile();
+}
+
+// -----------------------------------------------------------------------------
+// logRecoveryTests
+// -----------------------------------------------------------------------------
+
+const std::string loggedFileName = "relA.logged";
+const std::string logFileName = "relA.log";
+
+void removeLoggedFiles()
+{
+	try
+	{
+		File::remove(loggedFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+	try
+	{
+		File::remove(logFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+void logRecoveryTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "logRecoveryTests" << std::endl;
+	removeLoggedFiles();
+
+	std::cout << "Redo committed changes and drop a torn record" << std::endl;
+	{
+		// The page is allocated, then changed three times without ever being written back.
+		PageFile file = PageFile::create(loggedFileName);
+		PageId pageNo;
+		file.allocatePage(pageNo);
+		Page first;
+		first.insertRecord("one");
+		Page second = first;
+		second.insertRecord("two");
+		Page third = second;
+		third.insertRecord("three");
+
+		LogMgr log(logFileName);
+		log.logPage(&file, pageNo, NULL, first);
+		log.logPage(&file, pageNo, &first, second);
+		log.flush();
+		const LogSequenceNumber tornLsn = log.logPage(&file, pageNo, &second, third);
+		log.flush();
+		const LogSequenceNumber endLsn = log.endLsn();
+		checkPassFail(log.isDurable(tornLsn), true)
+
+		// Crash part way through writing the last record.
+		std::fstream out(logFileName, std::fstream::in | std::fstream::out | std::fstream::binary);
+		const char torn = 0x5a;
+		writeOldBytes(out, endLsn - 1, &torn, 1);
+	}
+	{
+		LogMgr log(logFileName);
+		checkPassFail(log.getLogStats().redonepages, 1)
+		// Everything redone is on disk, so the log starts over.
+		checkPassFail(log.endLsn(), LogMgr::HEADER_SIZE)
+	}
+	{
+		PageFile file = PageFile::open(loggedFileName);
+		Page page = file.readPage(1);
+		std::string records;
+		for (PageIterator iter = page.begin(); iter != page.end(); ++iter)
+		{
+			records += *iter;
+			records += " ";
+		}
+		checkPassFail(records, std::string("one two "))
+	}
+
+	std::cout << "Open a log with nothing to redo" << std::endl;
+	{
+		LogMgr log(logFileName);
+		checkPassFail(log.getLogStats().redonepages, 0)
+	}
+	removeLoggedFiles();
+}
+
+// -----------------------------------------------------------------------------
+// durabilityTests
+// -----------------------------------------------------------------------------
+
+const std::string durableFileName = "relA.durable";
+
+void removeDurableFile()
+{
+	try
+	{
+		File::remove(durableFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+// Returns the number of records on a page, read through a new handle for the file.
+int recordsOnDisk(PageId pageNo)
+{
+	PageFile file = PageFile::open(durableFileName);
+	Page page = file.readPage(pageNo);
+	int numRecords = 0;
+	for (PageIterator iter = page.begin(); iter != page.end(); ++iter)
+	{
+		numRecords++;
+	}
+	return numRecords;
+}
+
+void durabilityTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "durabilityTests" << std::endl;
+	removeDurableFile();
+
+	std::cout << "Sync pages written back by close" << std::endl;
+	{
+		BufMgr durableBufMgr(10);
+		durableBufMgr.setDurability(DURABILITY_PERIODIC, std::chrono::hours(1));
+		PageFile file = PageFile::create(durableFileName);
+		// Files written by earlier tests aren't this test's to sync.
+		File::syncAll();
+		for (int i = 0; i < 3; i++)
+		{
+			PageId pageNo;
+			Page* page;
+			durableBufMgr.allocPage(&file, pageNo, page);
+			page->insertRecord("durable record");
+			durableBufMgr.unPinPage(&file, pageNo, true);
+		}
+		durableBufMgr.close();
+		checkPassFail(durableBufMgr.getBufStats().syncs, 1)
+		// Nothing written is left unsynced.
+		checkPassFail(File::syncAll(), 0)
+		checkPassFail(recordsOnDisk(3), 1)
+	}
+
+	std::cout << "Leave syncing to the OS with DURABILITY_NONE" << std::endl;
+	{
+		BufMgr durableBufMgr(10);
+		PageFile file = PageFile::open(durableFileName);
+		File::syncAll();
+		Page* page;
+		durableBufMgr.readPage(&file, 1, page);
+		page->insertRecord("undurable record");
+		durableBufMgr.unPinPage(&file, 1, true);
+		durableBufMgr.close();
+		checkPassFail(durableBufMgr.getBufStats().syncs, 0)
+		// The page was written back, but its file is still waiting for a sync.
+		checkPassFail(File::syncAll(), 1)
+		checkPassFail(recordsOnDisk(1), 2)
+	}
+	removeDurableFile();
+}
+
+// -----------------------------------------------------------------------------
+// mappedFileTests
+// -----------------------------------------------------------------------------
+
+const std::string mappedFileName = "relA.mapped";
+
+void removeMappedFile()
+{
+	try
+	{
+		File::remove(mappedFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+// Returns the number of pages from first to last whose mapped bytes equal those readPage returns.
+int mappedPagesMatching(File &file, PageId first, PageId last)
+{
+	int numMatching = 0;
+	for (PageId pageNo = first; pageNo <= last; pageNo++)
+	{
+		const Page* mapped;
+		bufMgr->readMappedPage(&file, pageNo, mapped);
+		const Page page = file.readPage(pageNo);
+		numMatching += memcmp(mapped, &page, Page::SIZE) == 0;
+	}
+	return numMatching;
+}
+
+// Returns whether writing a page of the file throws FileReadOnlyException.
+bool writeRejected(File &file, PageId pageNo)
+{
+	try
+	{
+		file.writePage(pageNo, Page());
+	}
+	catch(const FileReadOnlyException &e)
+	{
+		return true;
+	}
+	return false;
+}
+
+void mappedFileTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "mappedFileTests" << std::endl;
+	removeMappedFile();
+
+	std::cout << "Read a mapped PageFile" << std::endl;
+	{
+		PageFile writer = PageFile::create(mappedFileName);
+		for (int i = 0; i < 3; i++)
+		{
+			PageId pageNo;
+			Page page = writer.allocatePage(pageNo);
+			page.insertRecord("mapped record");
+			writer.writePage(pageNo, page);
+		}
+		PageFile reader = PageFile::openReadOnly(mappedFileName);
+		checkPassFail(reader.isMapped(), true)
+		checkPassFail(mappedPagesMatching(reader, 1, 3), 3)
+		const Page* first;
+		bufMgr->readMappedPage(&reader, 1, first);
+
+		// The writer appends a page past the end of the mapping.
+		PageId pageNo;
+		Page page = writer.allocatePage(pageNo);
+		page.insertRecord("appended record");
+		writer.writePage(pageNo, page);
+		checkPassFail(mappedPagesMatching(reader, 1, pageNo), 4)
+		// Pages handed out before the file grew stay valid.
+		const Page firstPage = reader.readPage(1);
+		checkPassFail(memcmp(first, &firstPage, Page::SIZE), 0)
+		checkPassFail(writeRejected(reader, 1), true)
+	}
+	removeMappedFile();
+
+	std::cout << "Read a mapped BlobFile" << std::endl;
+	{
+		BlobFile writer = BlobFile::create(mappedFileName);
+		Page page(Page::UNINITIALIZED);
+		PageId pageNo;
+		for (int i = 0; i < 3; i++)
+		{
+			memset(static_cast<void*>(&page), 'a' + i, Page::SIZE);
+			writer.allocatePage(pageNo);
+			writer.writePage(pageNo, page);
+		}
+		BlobFile reader = BlobFile::openReadOnly(mappedFileName);
+		checkPassFail(reader.isMapped(), true)
+		checkPassFail(mappedPagesMatching(reader, 1, 3), 3)
+
+		// Growing past the first extent makes the file longer than the mapping.
+		while (pageNo <= BlobFile::EXTENT_PAGES)
+		{
+			writer.allocatePage(pageNo);
+		}
+		memset(static_cast<void*>(&page), 'z', Page::SIZE);
+		writer.writePage(pageNo, page);
+		checkPassFail(mappedPagesMatching(reader, pageNo, pageNo), 1)
+		const Page* mapped;
+		bufMgr->readMappedPage(&reader, pageNo, mapped);
+		checkPassFail(pageFilledWith(*mapped, 'z'), true)
+		checkPassFail(writeRejected(reader, 1), true)
+	}
+	removeMappedFile();
+}
+
+
+// -----------------------------------------------------------------------------
+// tablespaceTests
+// -----------------------------------------------------------------------------
+
+const std::string tablespaceFileName = "relA.ts";
+
+// Creates a segment of RECORDs numbered from first to first + numRecords - 1.
+void createSegmentRelation(const std::string &segmentName, int first, int numRecords)
+{
+	HeapFile heapFile(segmentName, bufMgr, true);
+	memset(record1.s, ' ', sizeof(record1.s));
+	for (int i = first; i < first + numRecords; i++)
+	{
+		sprintf(record1.s, "%05d string record", i);
+		record1.i = i;
+		record1.d = (double)i;
+		heapFile.insertRecord(reinterpret_cast<char*>(&record1), sizeof(record1));
+	}
+	heapFile.close();
+}
+
+// Returns the number of records of a segment; sets foreign if any is not numbered from first to last.
+int segmentRecordCount(const std::string &segmentName, int first, int last, bool &foreign)
+{
+	FileScan scan(segmentName, bufMgr);
+	RecordId rid;
+	int numRecords = 0;
+	foreign = false;
+	try
+	{
+		while (true)
+		{
+			scan.scanNext(rid);
+			const std::string record = scan.getRecord();
+			const int key = reinterpret_cast<const RECORD*>(record.data())->i;
+			foreign = foreign || key < first || key > last;
+			numRecords++;
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return numRecords;
+}
+
+// Returns the number of index entries from low to high whose records carry their key.
+int segmentIndexCount(const std::string &segmentName, const std::string &indexName, int low, int high)
+{
+	HeapFile heapFile(segmentName, bufMgr);
+	std::string outIndexName;
+	BTreeIndex index(segmentName, outIndexName, bufMgr, offsetof(RECORD, i), INTEGER);
+	checkPassFail((outIndexName == indexName), true)
+	index.startScan(&low, GTE, &high, LTE);
+	RecordId rid;
+	int numMatching = 0;
+	try
+	{
+		while (true)
+		{
+			index.scanNext(rid);
+			const std::string record = heapFile.getRecord(rid);
+			const int key = reinterpret_cast<const RECORD*>(record.data())->i;
+			numMatching += key >= low && key <= high;
+		}
+	}
+	catch(const IndexScanCompletedException &e)
+	{
+	}
+	index.endScan();
+	return numMatching;
+}
+
+void tablespaceTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "tablespaceTests" << std::endl;
+	std::remove(tablespaceFileName.c_str());
+	const std::string relation1 = tablespaceFileName + ":rel1";
+	const std::string relation2 = tablespaceFileName + ":rel2";
+
+	std::cout << "Create two relations and an index in one tablespace" << std::endl;
+	createSegmentRelation(relation1, 0, 3000);
+	createSegmentRelation(relation2, 10000, 2000);
+	std::string indexName;
+	{
+		BTreeIndex index(relation1, indexName, bufMgr, offsetof(RECORD, i), INTEGER);
+	}
+	checkPassFail((indexName.compare(0, relation1.size(), relation1) == 0), true)
+	checkPassFail(File::exists(indexName), true)
+	// Segments live inside the tablespace, not in files of their own.
+	checkPassFail(std::ifstream(relation1.c_str()).good(), false)
+	checkPassFail(std::ifstream(indexName.c_str()).good(), false)
+
+	std::cout << "Keep the pages of each segment apart" << std::endl;
+	bool foreign;
+	checkPassFail(segmentRecordCount(relation1, 0, 2999, foreign), 3000)
+	checkPassFail(foreign, false)
+	checkPassFail(segmentRecordCount(relation2, 10000, 11999, foreign), 2000)
+	checkPassFail(foreign, false)
+
+	std::cout << "Reopen the segments after closing them" << std::endl;
+	bufMgr->close();
+	checkPassFail(File::isOpen(relation1), false)
+	checkPassFail(File::isOpen(indexName), false)
+	checkPassFail(segmentRecordCount(relation2, 10000, 11999, foreign), 2000)
+	checkPassFail(foreign, false)
+	checkPassFail(segmentIndexCount(relation1, indexName, 100, 199), 100)
+
+	std::cout << "Remove one segment" << std::endl;
+	const std::size_t numFreeExtents = Tablespace::open(tablespaceFileName)->numFreeExtents();
+	File::remove(relation2);
+	checkPassFail(File::exists(relation2), false)
+	checkPassFail((Tablespace::open(tablespaceFileName)->numFreeExtents() > numFreeExtents), true)
+	checkPassFail(segmentRecordCount(relation1, 0, 2999, foreign), 3000)
+	checkPassFail(foreign, false)
+	checkPassFail(segmentIndexCount(relation1, indexName, 2900, 3100), 100)
+	// A new segment takes the freed extents instead of growing the tablespace.
+	const std::uint32_t numExtents = Tablespace::open(tablespaceFileName)->numExtents();
+	createSegmentRelation(relation2, 20000, 2000);
+	checkPassFail(Tablespace::open(tablespaceFileName)->numExtents(), numExtents)
+	checkPassFail(segmentRecordCount(relation1, 0, 2999, foreign), 3000)
+	checkPassFail(foreign, false)
+
+	File::remove(relation2);
+	File::remove(indexName);
+	File::remove(relation1);
+	std::remove(tablespaceFileName.c_str());
+}
+
+
+// -----------------------------------------------------------------------------
+// paxTests
+// -----------------------------------------------------------------------------
+
+const std::string paxFileName = "relA.pax";
+
+void removePaxFile()
+{
+	try
+	{
+		File::remove(paxFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+// Returns the records of a relation in the order FileScan returns them.
+std::vector<std::string> scanRecords(const std::string &name)
+{
+	std::vector<std::string> records;
+	FileScan scan(name, bufMgr);
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			records.push_back(scan.getRecord());
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return records;
+}
+
+// Returns whether formatting a page for RECORDs with the given columns throws InvalidPaxLayoutException.
+bool paxLayoutRejected(const std::vector<PaxColumn> &columns)
+{
+	Page page;
+	try
+	{
+		PaxPage::format(page, columns, sizeof(RECORD));
+	}
+	catch(const InvalidPaxLayoutException &e)
+	{
+		return true;
+	}
+	return false;
+}
+
+void paxTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "paxTests" << std::endl;
+	removePaxFile();
+	std::vector<PaxColumn> columns;
+	const PaxColumn iColumn = {offsetof(RECORD, i), sizeof(int)};
+	const PaxColumn dColumn = {offsetof(RECORD, d), sizeof(double)};
+	const PaxColumn sColumn = {offsetof(RECORD, s), sizeof(record1.s)};
+	columns.push_back(iColumn);
+	columns.push_back(dColumn);
+	columns.push_back(sColumn);
+
+	std::cout << "Scan a relation loaded into PAX pages" << std::endl;
+	createScanRelation(5000);
+	const std::vector<std::string> slotted = scanRecords(heapFileName);
+	int numPages = 0;
+	int numFull = 0;
+	{
+		PageFile file = PageFile::create(paxFileName);
+		Page* page = NULL;
+		PageId pageNo = Page::INVALID_NUMBER;
+		PaxPage paxPage;
+		for (std::size_t i = 0; i < slotted.size(); i++)
+		{
+			if (page == NULL || !paxPage.hasSpaceForRecord())
+			{
+				if (page != NULL)
+				{
+					numFull += paxPage.numRecords() == PaxPage::capacityFor(columns);
+					bufMgr->unPinPage(&file, pageNo, true);
+				}
+				bufMgr->allocPage(&file, pageNo, page);
+				PaxPage::format(*page, columns, sizeof(RECORD));
+				paxPage = PaxPage(page);
+				numPages++;
+			}
+			paxPage.insertRecord(slotted[i]);
+		}
+		bufMgr->unPinPage(&file, pageNo, true);
+		bufMgr->flushFile(&file);
+	}
+	checkPassFail((numPages > 1), true)
+	checkPassFail(numFull, numPages - 1)
+	const std::vector<std::string> pax = scanRecords(paxFileName);
+	checkPassFail(pax.size(), slotted.size())
+	checkPassFail((pax == slotted), true)
+
+	std::cout << "Fill a PAX page" << std::endl;
+	{
+		Page page;
+		PaxPage::format(page, columns, sizeof(RECORD));
+		PaxPage paxPage(&page);
+		for (std::size_t i = 0; paxPage.hasSpaceForRecord(); i++)
+		{
+			paxPage.insertRecord(slotted[i]);
+		}
+		checkPassFail(paxPage.numRecords(), paxPage.capacity())
+		bool full = false;
+		try
+		{
+			paxPage.insertRecord(slotted[0]);
+		}
+		catch(const InsufficientSpaceException &e)
+		{
+			full = true;
+		}
+		checkPassFail(full, true)
+		// The last row holds the last record inserted.
+		RecordId lastRid;
+		lastRid.page_number = page.page_number();
+		lastRid.slot_number = paxPage.capacity();
+		checkPassFail((paxPage.getRecord(lastRid) == slotted[paxPage.capacity() - 1]), true)
+	}
+
+	std::cout << "Reject columns that don't match the record" << std::endl;
+	{
+		std::vector<PaxColumn> wide(columns);
+		wide[2].width = sizeof(record1.s) + 1;
+		checkPassFail(paxLayoutRejected(wide), true)
+		std::vector<PaxColumn> overlapping(columns);
+		overlapping[0].width = sizeof(double) + 1;
+		checkPassFail(paxLayoutRejected(overlapping), true)
+
+		Page page;
+		PaxPage::format(page, columns, sizeof(RECORD));
+		PaxPage paxPage(&page);
+		bool rejected = false;
+		try
+		{
+			paxPage.insertRecord(slotted[0].substr(0, sizeof(RECORD) - 1));
+		}
+		catch(const InvalidPaxLayoutException &e)
+		{
+			rejected = true;
+		}
+		checkPassFail(rejected, true)
+		checkPassFail(paxPage.numRecords(), 0)
+	}
+
+	removePaxFile();
+	removeHeapFile();
+}
+
+
+// -----------------------------------------------------------------------------
+// sharedFileTests
+// -----------------------------------------------------------------------------
+
+const std::string sharedFileName = "relA.shared";
+
+void removeSharedFile()
+{
+	try
+	{
+		File::remove(sharedFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+void sharedFileTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "sharedFileTests" << std::endl;
+	removeSharedFile();
+
+	std::cout << "Read a page dirtied through another handle of the file" << std::endl;
+	{
+		PageFile writer = PageFile::create(sharedFileName);
+		PageId pageNo;
+		Page* page;
+		bufMgr->allocPage(&writer, pageNo, page);
+		page->insertRecord("flushed record");
+		bufMgr->unPinPage(&writer, pageNo, true);
+		bufMgr->flushFile(&writer);
+
+		PageFile reader = PageFile::open(sharedFileName);
+		checkPassFail((reader.id() == writer.id()), true)
+		bufMgr->readPage(&writer, pageNo, page);
+		const RecordId dirtyRid = page->insertRecord("dirty record");
+		bufMgr->unPinPage(&writer, pageNo, true);
+
+		bufMgr->clearBufStats();
+		Page* shared;
+		bufMgr->readPage(&reader, pageNo, shared);
+		// The page comes from the frame the writer filled, not from disk.
+		checkPassFail((shared == page), true)
+		checkPassFail(bufMgr->getBufStats().diskreads, 0)
+		checkPassFail((shared->getRecord(dirtyRid) == "dirty record"), true)
+		// Nothing was flushed, so the file still holds the page without the record.
+		checkPassFail((reader.readPage(pageNo).getFreeSpace() > shared->getFreeSpace()), true)
+		bufMgr->unPinPage(&reader, pageNo, false);
+
+		// Either handle writes the shared frame back.
+		bufMgr->flushFile(&reader);
+		checkPassFail((writer.readPage(pageNo).getRecord(dirtyRid) == "dirty record"), true)
+	}
+	removeSharedFile();
+}
+
+
+// -----------------------------------------------------------------------------
+// iterationTests
+// -----------------------------------------------------------------------------
+
+const std::string iterationFileName = "relA.iter";
+
+void removeIterationFile()
+{
+	try
+	{
+		File::remove(iterationFileName);
+	}
+	catch(const FileNotFoundException &e)
+	{
+	}
+}
+
+// Returns the pages FileIterator visits, in order.
+std::vector<PageId> iteratedPages(PageFile &file)
+{
+	std::vector<PageId> pages;
+	for (FileIterator iter = file.begin(); iter != file.end(); ++iter)
+	{
+		pages.push_back(iter.page_number());
+	}
+	return pages;
+}
+
+// Returns the pages FileScan returns records from, in order; sets misplaced if a record isn't on the page it names.
+std::vector<PageId> scannedPages(bool &misplaced)
+{
+	std::vector<PageId> pages;
+	FileScan scan(iterationFileName, bufMgr);
+	misplaced = false;
+	try
+	{
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			pages.push_back(rid.page_number);
+			misplaced = misplaced || atoi(scan.getRecord().c_str()) != static_cast<int>(rid.page_number);
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	return pages;
+}
+
+// Deletes the pages from first to last, removing them from the expected pages.
+void deleteIteratedPages(PageFile &file, PageId first, PageId last, std::vector<PageId> &expected)
+{
+	for (PageId pageNo = first; pageNo <= last; pageNo++)
+	{
+		file.deletePage(pageNo);
+		expected.erase(std::find(expected.begin(), expected.end(), pageNo));
+	}
+}
+
+void iterationTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "iterationTests" << std::endl;
+	removeIterationFile();
+
+	{
+		// Three groups of pages, the last one partly used.
+		const PageId numPages = 2 * PageGroupMap::PAGES_PER_GROUP + 500;
+		PageFile file = PageFile::create(iterationFileName);
+		std::vector<PageId> expected;
+		for (PageId i = 0; i < numPages; i++)
+		{
+			PageId pageNo;
+			Page page = file.allocatePage(pageNo);
+			char record[16];
+			sprintf(record, "%u", pageNo);
+			page.insertRecord(record);
+			file.writePage(pageNo, page);
+			expected.push_back(pageNo);
+		}
+		bool misplaced;
+		checkPassFail((iteratedPages(file) == expected), true)
+		checkPassFail((scannedPages(misplaced) == expected), true)
+		checkPassFail(misplaced, false)
+
+		std::cout << "Skip pages deleted in the middle and at group boundaries" << std::endl;
+		deleteIteratedPages(file, 1, 1, expected);
+		deleteIteratedPages(file, 1000, 1000, expected);
+		deleteIteratedPages(file, PageGroupMap::PAGES_PER_GROUP, PageGroupMap::PAGES_PER_GROUP + 1, expected);
+		deleteIteratedPages(file, numPages, numPages, expected);
+		checkPassFail(expected.size(), numPages - 5)
+		checkPassFail((iteratedPages(file) == expected), true)
+		checkPassFail((scannedPages(misplaced) == expected), true)
+		checkPassFail(misplaced, false)
+
+		std::cout << "Skip a group without used pages" << std::endl;
+		bufMgr->flushFile(&file);
+		deleteIteratedPages(file, PageGroupMap::PAGES_PER_GROUP + 2, 2 * PageGroupMap::PAGES_PER_GROUP, expected);
+		checkPassFail(expected.front(), 2)
+		checkPassFail(expected[PageGroupMap::PAGES_PER_GROUP - 3], 2 * PageGroupMap::PAGES_PER_GROUP + 1)
+		checkPassFail((iteratedPages(file) == expected), true)
+		checkPassFail((scannedPages(misplaced) == expected), true)
+		checkPassFail(misplaced, false)
+
+		std::cout << "Iterate over a file without used pages" << std::endl;
+		bufMgr->flushFile(&file);
+		deleteIteratedPages(file, 2, 999, expected);
+		deleteIteratedPages(file, 1001, PageGroupMap::PAGES_PER_GROUP - 1, expected);
+		deleteIteratedPages(file, 2 * PageGroupMap::PAGES_PER_GROUP + 1, numPages - 1, expected);
+		checkPassFail(expected.size(), 0)
+		checkPassFail((file.begin() == file.end()), true)
+		checkPassFail(scannedPages(misplaced).size(), 0)
+	}
+	removeIterationFile();
+}
+
+
+// -----------------------------------------------------------------------------
+// pushdownTests
+// -----------------------------------------------------------------------------
+
+// Creates a relation of RECORDs numbered from 0 whose strings are short names padded with NULs.
+// Every tenth record is cut off after the first eight bytes of its string.
+void createPushdownRelation(int numRecords)
+{
+	static const char* const names[] = {"", "apple", "apples", "banana", "b"};
+	removeHeapFile();
+	HeapFile heapFile(heapFileName, bufMgr, true);
+	for (int i = 0; i < numRecords; i++)
+	{
+		RECORD record;
+		memset(&record, 0, sizeof(record));
+		record.i = i;
+		record.d = (double)i;
+		strcpy(record.s, names[i % 5]);
+		const std::size_t length = i % 10 == 6 ? offsetof(RECORD, s) + 8 : sizeof(record);
+		heapFile.insertRecord(reinterpret_cast<const char*>(&record), length);
+	}
+}
+
+// Returns the number of records FileScan returns with the predicate pushed down; sets mismatch
+// unless they are exactly the records the filter accepts, in the same order.
+template <typename Filter>
+int pushdownCount(const Predicate &predicate, Filter filter, bool &mismatch)
+{
+	std::vector<RecordId> pushed;
+	std::vector<RecordId> filtered;
+	try
+	{
+		FileScan scan(heapFileName, bufMgr, predicate);
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			pushed.push_back(rid);
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+	try
+	{
+		FileScan scan(heapFileName, bufMgr);
+		RecordId rid;
+		while (true)
+		{
+			scan.scanNext(rid);
+			const std::string data = scan.getRecord();
+			RECORD record;
+			memset(&record, 0, sizeof(record));
+			memcpy(&record, data.data(), std::min(data.length(), sizeof(record)));
+			if (filter(record, data.length()))
+			{
+				filtered.push_back(rid);
+			}
+		}
+	}
+	catch(const EndOfFileException &e)
+	{
+	}
+
+	mismatch = pushed.size() != filtered.size();
+	for (std::size_t i = 0; !mismatch && i < pushed.size(); i++)
+	{
+		mismatch = recordKey(pushed[i]) != recordKey(filtered[i]);
+	}
+	return pushed.size();
+}
+
+void pushdownTests()
+{
+	std::cout << "---------------------" << std::endl;
+	std::cout << "pushdownTests" << std::endl;
+	createPushdownRelation(1000);
+	const std::size_t sOffset = offsetof(RECORD, s);
+	const std::size_t sWidth = sizeof(record1.s);
+	bool mismatch;
+
+	std::cout << "Compare strings shorter than their attribute" << std::endl;
+	checkPassFail(pushdownCount(Predicate::stringAt(sOffset, sWidth, EQUAL, "apple"),
+			[&](const RECORD &r, std::size_t length) { return length == sizeof(RECORD) && strcmp(r.s, "apple") == 0; },
+			mismatch), 100)
+	checkPassFail(mismatch, false)
+	checkPassFail(pushdownCount(Predicate::stringAt(sOffset, 8, EQUAL, "apple"),
+			[&](const RECORD &r, std::size_t length) { return strcmp(r.s, "apple") == 0; },
+			mismatch), 200)
+	checkPassFail(mismatch, false)
+	checkPassFail(pushdownCount(Predicate::stringAt(sOffset, sWidth, LESS, "b"),
+			[&](const RECORD &r, std::size_t length) { return length == sizeof(RECORD) && strcmp(r.s, "b") < 0; },
+			mismatch), 500)
+	checkPassFail(mismatch, false)
+	// "apples" is longer than "apple", not equal to it.
+	checkPassFail(pushdownCount(Predicate::stringAt(sOffset, sWidth, GREATER, "apple"),
+			[&](const RECORD &r, std::size_t length) { return length == sizeof(RECORD) && strcmp(r.s, "apple") > 0; },
+			mismatch), 600)
+	checkPassFail(mismatch, false)
+	checkPassFail(pushdownCount(Predicate::stringAt(sOffset, sWidth, EQUAL, ""),
+			[&](const RECORD &r, std::size_t length) { return length == sizeof(RECORD) && r.s[0] == '\0'; },
+			mismatch), 200)
+	checkPassFail(mismatch, false)
+
+	std::cout << "Reject terms past the end of a record" << std::endl;
+	checkPassFail(pushdownCount(Predicate::intAt(sizeof(RECORD), NOT_EQUAL, 0),
+			[&](const RECORD &r, std::size_t length) { return false; },
+			mismatch), 0)
+	checkPassFail(mismatch, false)
+	// Bytes 8 to 11 of every string are padding, but short records end before them.
+	checkPassFail(pushdownCount(Predicate::intAt(sOffset + 8, EQUAL, 0),
+			[&](const RECORD &r, std::size_t length) { return length >= sOffset + 12; },
+			mismatch), 900)
+	checkPassFail(mismatch, false)
+
+	std::cout << "Nest anyOf and allOf" << std::endl;
+	const Predicate early = Predicate::allOf(Predicate::intAt(offsetof(RECORD, i), LESS, 100),
+			Predicate::stringAt(sOffset, sWidth, NOT_EQUAL, "banana"));
+	const Predicate late = Predicate::allOf(Predicate::doubleAt(offsetof(RECORD, d), GREATER_EQUAL, 900.0),
+			Predicate::anyOf(Predicate::stringAt(sOffset, 8, EQUAL, "b"), Predicate::intAt(sizeof(RECORD), EQUAL, 0)));
+	checkPassFail(pushdownCount(Predicate::anyOf(early, late),
+			[&](const RECORD &r, std::size_t length)
+			{
+				return (r.i < 100 && length == sizeof(RECORD) && strcmp(r.s, "banana") != 0) ||
+						(r.d >= 900.0 && strcmp(r.s, "b") == 0);
+			},
+			mismatch), 70 + 20)
+	checkPassFail(mismatch, false)
+	checkPassFail(pushdownCount(Predicate::allOf(Predicate::anyOf(early, late), Predicate::intAt(offsetof(RECORD, i), GREATER_EQUAL, 50)),
+			[&](const RECORD &r, std::size_t length)
+			{
+				return r.i >= 50 && ((r.i < 100 && length == sizeof(RECORD) && strcmp(r.s, "banana") != 0) ||
+						(r.d >= 900.0 && strcmp(r.s, "b") == 0));
+			},
+			mismatch), 35 + 20)
+	checkPassFail(mismatch, false)
+	checkPassFail(pushdownCount(Predicate::anyOf(Predicate::allOf(early, late), Predicate::intAt(sizeof(RECORD), EQUAL, 0)),
+			[&](const RECORD &r, std::size_t length) { return false; },
+			mismatch), 0)
+	checkPassFail(mismatch, false)
+
+	removeHeapFile();
+}
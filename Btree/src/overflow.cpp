@@ -0,0 +1,145 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "overflow.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace badgerdb {
+
+namespace {
+
+OverflowPageHeader* pageHeader(Page* page) {
+  return reinterpret_cast<OverflowPageHeader*>(page);
+}
+
+char* pageData(Page* page) {
+  return reinterpret_cast<char*>(page) + sizeof(OverflowPageHeader);
+}
+
+}
+
+const std::size_t OverflowFile::CHUNK_SIZE;
+
+std::string OverflowFile::nameFor(const std::string& relation_name) {
+  return relation_name + ".overflow";
+}
+
+OverflowFile::OverflowFile(const std::string& relation_name, BufMgr* buf_mgr)
+    : name_(nameFor(relation_name)),
+      buf_mgr_(buf_mgr),
+      file_(NULL) {
+}
+
+OverflowFile::~OverflowFile() {
+  try {
+    flush();
+  } catch (...) {
+    return;
+  }
+  delete file_;
+}
+
+void OverflowFile::flush() {
+  if (file_ != NULL) {
+    buf_mgr_->flushFile(file_);
+  }
+}
+
+File* OverflowFile::file() {
+  if (file_ == NULL) {
+    file_ = new BlobFile(name_, !File::exists(name_));
+  }
+  return file_;
+}
+
+OverflowStub OverflowFile::write(const char* data, const std::size_t length) {
+  OverflowStub stub = {Page::INVALID_NUMBER,
+                       static_cast<std::uint32_t>(length)};
+  PageId previous_page_number = Page::INVALID_NUMBER;
+  Page* previous_page = NULL;
+  std::size_t offset = 0;
+  do {
+    PageId page_number;
+    Page* page;
+    buf_mgr_->allocPage(file(), page_number, page, previous_page_number);
+    const std::size_t chunk_length = std::min(CHUNK_SIZE, length - offset);
+    pageHeader(page)->next_page = Page::INVALID_NUMBER;
+    pageHeader(page)->length = chunk_length;
+    memcpy(pageData(page), data + offset, chunk_length);
+    memset(pageData(page) + chunk_length, '\0', CHUNK_SIZE - chunk_length);
+    offset += chunk_length;
+
+    // Link the page in once its number is known.
+    if (previous_page == NULL) {
+      stub.first_page = page_number;
+    } else {
+      pageHeader(previous_page)->next_page = page_number;
+      buf_mgr_->unPinPage(file_, previous_page_number, true);
+    }
+    previous_page_number = page_number;
+    previous_page = page;
+  } while (offset < length);
+  buf_mgr_->unPinPage(file_, previous_page_number, true);
+  return stub;
+}
+
+void OverflowFile::read(const OverflowStub& stub, char* data) {
+  OverflowReader reader(*this, stub);
+  RecordView chunk;
+  while (reader.nextChunk(chunk)) {
+    memcpy(data, chunk.data, chunk.length);
+    data += chunk.length;
+  }
+}
+
+void OverflowFile::remove(const OverflowStub& stub) {
+  PageId page_number = stub.first_page;
+  while (page_number != Page::INVALID_NUMBER) {
+    Page* page;
+    buf_mgr_->readPage(file(), page_number, page);
+    const PageId next_page = pageHeader(page)->next_page;
+    buf_mgr_->unPinPage(file_, page_number, false);
+    buf_mgr_->disposePage(file_, page_number);
+    page_number = next_page;
+  }
+}
+
+OverflowReader::OverflowReader(OverflowFile& file, const OverflowStub& stub)
+    : file_(file),
+      length_(stub.length),
+      next_page_(stub.first_page),
+      page_number_(Page::INVALID_NUMBER) {
+}
+
+OverflowReader::~OverflowReader() {
+  release();
+}
+
+bool OverflowReader::nextChunk(RecordView& chunk) {
+  release();
+  if (next_page_ == Page::INVALID_NUMBER) {
+    return false;
+  }
+  Page* page;
+  file_.bufMgr()->readPage(file_.file(), next_page_, page);
+  page_number_ = next_page_;
+  next_page_ = pageHeader(page)->next_page;
+  chunk.data = pageData(page);
+  chunk.length = pageHeader(page)->length;
+  return true;
+}
+
+void OverflowReader::release() {
+  if (page_number_ != Page::INVALID_NUMBER) {
+    file_.bufMgr()->unPinPage(file_.file(), page_number_, false);
+    page_number_ = Page::INVALID_NUMBER;
+  }
+}
+
+}
@@ -0,0 +1,229 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Reference to the out-of-line part of a record, stored at the end of
+ * the part kept on the record's page.
+ */
+struct OverflowStub {
+  /**
+   * First page of the overflow chain.
+   */
+  PageId first_page;
+
+  /**
+   * Number of bytes stored in the chain.
+   */
+  std::uint32_t length;
+};
+
+/**
+ * @brief Header at the start of each page of an overflow chain.
+ */
+struct OverflowPageHeader {
+  /**
+   * Next page of the chain, or Page::INVALID_NUMBER for the last one.
+   */
+  PageId next_page;
+
+  /**
+   * Number of bytes of the value stored on this page.
+   */
+  std::uint32_t length;
+};
+
+/**
+ * @brief Overflow chains of the records of one relation.
+ *
+ * A value too large to keep on a slotted page is split into chunks stored in
+ * a linked chain of pages.  Chains live in a BlobFile of their own next to the
+ * relation, named by nameFor(), so scanning the relation never reads them.
+ * The file is created when the first chain is written.  Pages of a chain are
+ * allocated next to each other whenever possible, so reading one back is
+ * mostly sequential.
+ *
+ * @warning This class is not threadsafe.
+ */
+class OverflowFile {
+ public:
+  /**
+   * Bytes of a value each overflow page holds.
+   */
+  static const std::size_t CHUNK_SIZE = Page::SIZE - sizeof(OverflowPageHeader);
+
+  /**
+   * Returns the name of the file holding the overflow chains of a relation.
+   *
+   * @param relation_name   Name of the relation's file.
+   */
+  static std::string nameFor(const std::string& relation_name);
+
+  /**
+   * Constructs the overflow chains of a relation.  Opens nothing until a
+   * chain is read or written.
+   *
+   * @param relation_name   Name of the relation's file.
+   * @param buf_mgr         Buffer Manager instance used to read and write
+   *                        pages of chains.
+   */
+  OverflowFile(const std::string& relation_name, BufMgr* buf_mgr);
+
+  /**
+   * Flushes the pages of chains out of the buffer pool and closes the file.
+   * If they can't be written, the file is left open, since frames of the
+   * buffer pool still refer to it; call flush first to find out.
+   */
+  ~OverflowFile();
+
+  /**
+   * Writes the pages of chains out of the buffer pool, if the file is open.
+   *
+   * @throws  PagePinnedException   If a page of a chain is pinned.
+   * @throws  FileIOException       If a page can't be written.
+   */
+  void flush();
+
+  /**
+   * Stores a value in a new chain.
+   *
+   * @param data    First byte of the value.
+   * @param length  Length of the value in bytes.
+   * @return  Stub referencing the chain.
+   */
+  OverflowStub write(const char* data, const std::size_t length);
+
+  /**
+   * Copies a value stored in a chain into a buffer.
+   *
+   * @param stub    Stub referencing the chain.
+   * @param data    Buffer of stub.length bytes.
+   */
+  void read(const OverflowStub& stub, char* data);
+
+  /**
+   * Frees the pages of a chain.
+   *
+   * @param stub    Stub referencing the chain.
+   */
+  void remove(const OverflowStub& stub);
+
+  /**
+   * Returns the file holding the chains, opening or creating it if needed.
+   */
+  File* file();
+
+  /**
+   * Returns the Buffer Manager instance chains are read through.
+   */
+  BufMgr* bufMgr() const { return buf_mgr_; }
+
+ private:
+  /**
+   * Not copyable; the file is closed when this is destroyed.
+   */
+  OverflowFile(const OverflowFile&);
+  OverflowFile& operator=(const OverflowFile&);
+
+  /**
+   * Name of the file holding the chains.
+   */
+  std::string name_;
+
+  /**
+   * Buffer Manager instance used to read and write pages of chains.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File holding the chains, or NULL until it is first needed.
+   */
+  BlobFile* file_;
+};
+
+/**
+ * @brief Reads a value stored in an overflow chain one page at a time.
+ *
+ * Each chunk is read in place on its page, which stays pinned until the next
+ * chunk is read or the reader is destroyed, so a value of any size is
+ * streamed without being copied or held in memory as a whole.
+ *
+ * @warning This class is not threadsafe.
+ */
+class OverflowReader {
+ public:
+  /**
+   * Constructs a reader positioned before the first chunk of a chain.
+   *
+   * @param file    Overflow chains of the relation.
+   * @param stub    Stub referencing the chain.
+   */
+  OverflowReader(OverflowFile& file, const OverflowStub& stub);
+
+  /**
+   * Unpins the page of the current chunk.
+   */
+  ~OverflowReader();
+
+  /**
+   * Reads the next chunk of the value.
+   *
+   * @param chunk   Set to the bytes of the chunk, valid until the next call.
+   * @return  False if the whole value has been read.
+   */
+  bool nextChunk(RecordView& chunk);
+
+  /**
+   * Returns the length of the whole value in bytes.
+   */
+  std::size_t length() const { return length_; }
+
+ private:
+  /**
+   * Not copyable; the current page is unpinned when this is destroyed.
+   */
+  OverflowReader(const OverflowReader&);
+  OverflowReader& operator=(const OverflowReader&);
+
+  /**
+   * Unpins the page of the current chunk, if any.
+   */
+  void release();
+
+  /**
+   * Overflow chains of the relation.
+   */
+  OverflowFile& file_;
+
+  /**
+   * Length of the value in bytes.
+   */
+  std::size_t length_;
+
+  /**
+   * Page holding the next chunk, or Page::INVALID_NUMBER at the end.
+   */
+  PageId next_page_;
+
+  /**
+   * Number of the pinned page of the current chunk, or Page::INVALID_NUMBER.
+   */
+  PageId page_number_;
+};
+
+}
@@ -23,121 +23,141 @@ Page::Page() {
 }
 
 void Page::initialize() {
-  header_.free_space_lower_bound = 0;
-  header_.free_space_upper_bound = DATA_SIZE;
-  header_.num_slots = 0;
-  header_.num_free_slots = 0;
-  header_.current_page_number = INVALID_NUMBER;
-  header_.next_page_number = INVALID_NUMBER;
+  header_ = emptyHeader();
   //data_.assign(DATA_SIZE, char());
 	memset(data_, '\0', DATA_SIZE);
 }
 
+PageHeader Page::emptyHeader() {
+  PageHeader header;
+  header.fragmented_bytes = 0;
+  header.free_space_upper_bound = DATA_SIZE;
+  header.num_slots = 0;
+  header.first_free_slot = INVALID_SLOT;
+  header.current_page_number = INVALID_NUMBER;
+  header.next_page_number = INVALID_NUMBER;
+  return header;
+}
+
 RecordId Page::insertRecord(const std::string& record_data) {
-  if (!hasSpaceForRecord(record_data)) {
+  return insertRecord(record_data.data(), record_data.length());
+}
+
+RecordId Page::insertRecord(const char* record_data,
+                            const std::size_t record_length) {
+  if (!hasSpaceForRecord(record_length)) {
     throw InsufficientSpaceException(
-        page_number(), record_data.length(), getFreeSpace());
+        page_number(), record_length, getFreeSpace());
   }
+  makeContiguousSpace(record_length + (header_.first_free_slot == INVALID_SLOT
+                                       ? sizeof(PageSlot) : 0));
   const SlotId slot_number = getAvailableSlot();
-  insertRecordInSlot(slot_number, record_data);
+  insertRecordInSlot(slot_number, record_data, record_length);
   return {page_number(), slot_number};
 }
 
+std::size_t Page::insertRecords(const RecordView* records,
+                                const std::size_t num_records,
+                                RecordId* record_ids) {
+  std::size_t num_inserted = 0;
+  for (; num_inserted < num_records; ++num_inserted) {
+    const RecordView& record = records[num_inserted];
+    if (!hasSpaceForRecord(record.length)) {
+      break;
+    }
+    makeContiguousSpace(record.length + (header_.first_free_slot == INVALID_SLOT
+                                         ? sizeof(PageSlot) : 0));
+    const SlotId slot_number = getAvailableSlot();
+    insertRecordInSlot(slot_number, record.data, record.length);
+    if (record_ids != NULL) {
+      const RecordId record_id = {page_number(), slot_number, 0};
+      record_ids[num_inserted] = record_id;
+    }
+  }
+  return num_inserted;
+}
+
 std::string Page::getRecord(const RecordId& record_id) const {
+  return getRecordView(record_id).toString();
+}
+
+RecordView Page::getRecordView(const RecordId& record_id) const {
   validateRecordId(record_id);
   const PageSlot& slot = getSlot(record_id.slot_number);
-	std::string retStr = std::string(data_, DATA_SIZE).substr(slot.item_offset, slot.item_length);
-
-	return retStr;
+  const RecordView view = {&data_[slot.item_offset], slot.item_length};
+  return view;
 }
 
 void Page::updateRecord(const RecordId& record_id,
                         const std::string& record_data) {
+  updateRecord(record_id, record_data.data(), record_data.length());
+}
+
+void Page::updateRecord(const RecordId& record_id, const char* record_data,
+                        const std::size_t record_length) {
   validateRecordId(record_id);
-  const PageSlot* slot = getSlot(record_id.slot_number);
+  PageSlot* slot = getSlot(record_id.slot_number);
+  if (record_length <= slot->item_length) {
+    // Overwrite the record in place, keeping it against the records after it,
+    // and give back what it doesn't need any more.
+    const std::uint16_t old_offset = slot->item_offset;
+    const std::uint16_t unused_length = slot->item_length - record_length;
+    slot->item_offset += unused_length;
+    slot->item_length = record_length;
+    memcpy(&data_[slot->item_offset], record_data, record_length);
+    releaseSpace(old_offset, unused_length);
+    return;
+  }
   const std::size_t free_space_after_delete =
       getFreeSpace() + slot->item_length;
-  if (record_data.length() > free_space_after_delete) {
+  if (record_length > free_space_after_delete) {
     throw InsufficientSpaceException(
-        page_number(), record_data.length(), free_space_after_delete);
+        page_number(), record_length, free_space_after_delete);
   }
-  // We have to disallow slot compaction here because we're going to place the
-  // record data in the same slot, and compaction might delete the slot if we
-  // permit it.
-  deleteRecord(record_id, false /* allow_slot_compaction */);
-  insertRecordInSlot(record_id.slot_number, record_data);
+  // Give up the old bytes but keep the slot off the free list, since the new
+  // version goes right back into it.
+  releaseSpace(slot->item_offset, slot->item_length);
+  slot->used = false;
+  makeContiguousSpace(record_length);
+  insertRecordInSlot(record_id.slot_number, record_data, record_length);
 }
 
 void Page::deleteRecord(const RecordId& record_id) {
-  deleteRecord(record_id, true /* allow_slot_compaction */);
-}
-
-void Page::deleteRecord(const RecordId& record_id,
-                        const bool allow_slot_compaction) {
   validateRecordId(record_id);
   PageSlot* slot = getSlot(record_id.slot_number);
+  releaseSpace(slot->item_offset, slot->item_length);
+  pushFreeSlot(record_id.slot_number);
 
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = '\0';
-
-  //data_.replace(slot->item_offset, slot->item_length, slot->item_length, '\0');
-
-  // Compact the data by removing the hole left by this record (if necessary).
-  std::uint16_t move_offset = slot->item_offset; 
-  std::size_t move_bytes = 0;
-  for (SlotId i = 1; i <= header_.num_slots; ++i) {
-    PageSlot* other_slot = getSlot(i);
-    if (other_slot->used && other_slot->item_offset < slot->item_offset) {
-      if (other_slot->item_offset < move_offset) {
-        move_offset = other_slot->item_offset;
-      }
-      move_bytes += other_slot->item_length;
-      // Update the slot for the other data to reflect the soon-to-be-new
-      // location.
-      other_slot->item_offset += slot->item_length;
+  if (record_id.slot_number == header_.num_slots) {
+    // Last slot in the list, so we need to free any unused slots that are at
+    // the end of the slot list.  Each slot is only removed once, so this costs
+    // O(1) per deletion on average.
+    while (header_.num_slots > 0 && !getSlot(header_.num_slots)->used) {
+      unlinkFreeSlot(header_.num_slots);
+      memset(getSlot(header_.num_slots), '\0', sizeof(PageSlot));
+      --header_.num_slots;
     }
   }
-  // If we have data to move, shift it to the right.
-  if (move_bytes > 0) {
-    const std::string& data_to_move = std::string(data_, DATA_SIZE).substr(move_offset, move_bytes);
-
-		for(std::uint16_t i = 0; i < move_bytes; i++)
-			data_[i + move_offset + slot->item_length] = data_to_move[i];
-
-    //data_.replace(move_offset + slot->item_length, move_bytes, data_to_move);
-  }
-  header_.free_space_upper_bound += slot->item_length;
+}
 
-  // Mark slot as unused.
-  slot->used = false;
-  slot->item_offset = 0;
-  slot->item_length = 0;
-  ++header_.num_free_slots;
+std::uint8_t Page::getRecordFlags(const RecordId& record_id) const {
+  validateRecordId(record_id);
+  return getSlot(record_id.slot_number).flags;
+}
 
-  if (allow_slot_compaction && record_id.slot_number == header_.num_slots) {
-    // Last slot in the list, so we need to free any unused slots that are at
-    // the end of the slot list.
-    int num_slots_to_delete = 1;
-    for (SlotId i = 1; i < header_.num_slots; ++i) {
-      // Traverse list backwards, looking for unused slots.
-      const PageSlot* other_slot = getSlot(header_.num_slots - i);
-      if (!other_slot->used) {
-        ++num_slots_to_delete;
-      } else {
-        // Stop at the first used slot we find, since we can't move used slots
-        // without affecting record IDs.
-        break;
-      }
-    }
-    header_.num_slots -= num_slots_to_delete;
-    header_.num_free_slots -= num_slots_to_delete;
-    header_.free_space_lower_bound -= sizeof(PageSlot) * num_slots_to_delete;
-  }
+void Page::setRecordFlags(const RecordId& record_id,
+                          const std::uint8_t flags) {
+  validateRecordId(record_id);
+  getSlot(record_id.slot_number)->flags = flags;
 }
 
 bool Page::hasSpaceForRecord(const std::string& record_data) const {
-  std::size_t record_size = record_data.length();
-  if (header_.num_free_slots == 0) {
+  return hasSpaceForRecord(record_data.length());
+}
+
+bool Page::hasSpaceForRecord(const std::size_t record_length) const {
+  std::size_t record_size = record_length;
+  if (header_.first_free_slot == INVALID_SLOT) {
     record_size += sizeof(PageSlot);
   }
   return record_size <= getFreeSpace();
@@ -152,31 +172,110 @@ const PageSlot& Page::getSlot(const SlotId slot_number) const {
 }
 
 SlotId Page::getAvailableSlot() {
-  SlotId slot_number = INVALID_SLOT;
-  if (header_.num_free_slots > 0) {
-    // Have an allocated but unused slot that we can reuse.
-    for (SlotId i = 1; i <= header_.num_slots; ++i) {
-      const PageSlot* slot = getSlot(i);
-      if (!slot->used) {
-        // We don't decrement the number of free slots until someone actually
-        // puts data in the slot.
-        slot_number = i;
-        break;
-      }
-    }
-  } else {
+  if (header_.first_free_slot == INVALID_SLOT) {
     // Have to allocate a new slot.
-    slot_number = header_.num_slots + 1;
     ++header_.num_slots;
-    ++header_.num_free_slots;
-    header_.free_space_lower_bound = sizeof(PageSlot) * header_.num_slots;
+    PageSlot* slot = getSlot(header_.num_slots);
+    slot->used = false;
+    slot->flags = 0;
+    return header_.num_slots;
   }
-  assert(slot_number != INVALID_SLOT);
+  const SlotId slot_number = header_.first_free_slot;
+  unlinkFreeSlot(slot_number);
   return slot_number;
 }
 
+void Page::pushFreeSlot(const SlotId slot_number) {
+  PageSlot* slot = getSlot(slot_number);
+  slot->used = false;
+  slot->flags = 0;
+  slot->item_offset = INVALID_SLOT;
+  slot->item_length = header_.first_free_slot;
+  if (header_.first_free_slot != INVALID_SLOT) {
+    getSlot(header_.first_free_slot)->item_offset = slot_number;
+  }
+  header_.first_free_slot = slot_number;
+}
+
+void Page::unlinkFreeSlot(const SlotId slot_number) {
+  const PageSlot* slot = getSlot(slot_number);
+  const SlotId previous = slot->item_offset;
+  const SlotId next = slot->item_length;
+  if (previous != INVALID_SLOT) {
+    getSlot(previous)->item_length = next;
+  } else {
+    header_.first_free_slot = next;
+  }
+  if (next != INVALID_SLOT) {
+    getSlot(next)->item_offset = previous;
+  }
+}
+
+void Page::releaseSpace(const std::uint16_t offset,
+                        const std::uint16_t length) {
+  memset(&data_[offset], '\0', length);
+  if (offset == header_.free_space_upper_bound) {
+    header_.free_space_upper_bound += length;
+  } else {
+    header_.fragmented_bytes += length;
+  }
+}
+
+void Page::makeContiguousSpace(const std::size_t length) {
+  const std::size_t contiguous_space =
+      header_.free_space_upper_bound - slotArrayEnd();
+  if (contiguous_space < length &&
+      header_.fragmented_bytes > 0) {
+    compact();
+  }
+}
+
+void Page::compact() {
+  // Pack the records into a copy from the end backwards, then copy them back
+  // in one piece.
+  char compacted[DATA_SIZE];
+  std::uint16_t upper_bound = DATA_SIZE;
+  for (SlotId i = 1; i <= header_.num_slots; ++i) {
+    PageSlot* slot = getSlot(i);
+    if (slot->used) {
+      upper_bound -= slot->item_length;
+      memcpy(&compacted[upper_bound], &data_[slot->item_offset],
+             slot->item_length);
+      slot->item_offset = upper_bound;
+    }
+  }
+  const std::uint16_t lower_bound = slotArrayEnd();
+  memset(&data_[lower_bound], '\0', upper_bound - lower_bound);
+  memcpy(&data_[upper_bound], &compacted[upper_bound],
+         DATA_SIZE - upper_bound);
+  header_.free_space_upper_bound = upper_bound;
+  header_.fragmented_bytes = 0;
+}
+
+void Page::upgradeHeader() {
+  // The old lower bound field now holds the fragmented bytes.  PAX pages
+  // marked themselves with a lower bound at the end of the page; they now
+  // leave no free space at all.
+  const bool pax_page = header_.num_slots == 0 &&
+                        header_.fragmented_bytes == DATA_SIZE;
+  header_.fragmented_bytes = 0;
+  header_.first_free_slot = INVALID_SLOT;
+  if (pax_page) {
+    header_.free_space_upper_bound = 0;
+    return;
+  }
+  for (SlotId i = header_.num_slots; i >= 1; --i) {
+    PageSlot* slot = getSlot(i);
+    slot->flags = 0;
+    if (!slot->used) {
+      pushFreeSlot(i);
+    }
+  }
+}
+
 void Page::insertRecordInSlot(const SlotId slot_number,
-                              const std::string& record_data) {
+                              const char* record_data,
+                              const std::size_t record_length) {
   if (slot_number > header_.num_slots ||
       slot_number == INVALID_SLOT) {
     throw InvalidSlotException(page_number(), slot_number);
@@ -185,21 +284,17 @@ void Page::insertRecordInSlot(const SlotId slot_number,
   if (slot->used) {
     throw SlotInUseException(page_number(), slot_number);
   }
-  const int record_length = record_data.length();
   slot->used = true;
   slot->item_length = record_length;
   slot->item_offset = header_.free_space_upper_bound - record_length;
   header_.free_space_upper_bound = slot->item_offset;
-  --header_.num_free_slots;
-
-	for(int i = 0; i < slot->item_length; i++)
-		data_[i + slot->item_offset] = record_data[i];
-
-  //data_.replace(slot->item_offset, slot->item_length, record_data);
+  memcpy(&data_[slot->item_offset], record_data, record_length);
 }
 
 void Page::validateRecordId(const RecordId& record_id) const {
-  if (record_id.page_number != page_number()) {
+  if (record_id.page_number != page_number() ||
+      record_id.slot_number == INVALID_SLOT ||
+      record_id.slot_number > header_.num_slots) {
     throw InvalidRecordException(record_id, page_number());
   }
   const PageSlot& slot = getSlot(record_id.slot_number);
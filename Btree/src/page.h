@@ -21,14 +21,16 @@ namespace badgerdb {
  * @brief Header metadata in a page.
  *
  * Header metadata in each page which tracks where space has been used and
- * contains a pointer to the next page in the file.
+ * contains a pointer to the next page in the file.  The free space starts
+ * right after the slot array, so its lower bound follows from num_slots.
  */
 struct PageHeader {
   /**
-   * Lower bound of the free space.  This is the offset of the first unused byte
-   * after the slot array.
+   * Number of bytes held by deleted records that haven't been reclaimed yet.
+   * Deleting a record leaves a hole, which is only closed when an insertion
+   * needs the space.
    */
-  std::uint16_t free_space_lower_bound;
+  std::uint16_t fragmented_bytes;
 
   /**
    * Upper bound of the free space.  This is the offset of the last unused byte
@@ -44,9 +46,10 @@ struct PageHeader {
   SlotId num_slots;
 
   /**
-   * Number of slots allocated but not in use.
+   * First slot of the list of slots that are allocated but not in use, or
+   * Page::INVALID_SLOT if every slot is in use.
    */
-  SlotId num_free_slots;
+  SlotId first_free_slot;
 
   /**
    * Number of the page within the file.
@@ -66,7 +69,7 @@ struct PageHeader {
    */
   bool operator==(const PageHeader& rhs) const {
     return num_slots == rhs.num_slots &&
-        num_free_slots == rhs.num_free_slots &&
+        first_free_slot == rhs.first_free_slot &&
         current_page_number == rhs.current_page_number &&
         next_page_number == rhs.next_page_number;
   }
@@ -74,6 +77,11 @@ struct PageHeader {
 
 /**
  * @brief Slot metadata that tracks where a record is in the data space.
+ *
+ * Slots that aren't in use form a doubly linked list starting at
+ * PageHeader::first_free_slot, so a free slot is found, taken and given back
+ * without searching the slot array.  The links are kept in item_offset and
+ * item_length, which a free slot doesn't need.
  */
 struct PageSlot {
   /**
@@ -83,16 +91,48 @@ struct PageSlot {
   bool used;
 
   /**
-   * Offset of the data item in the page.
+   * What kind of record the slot holds, as a combination of Page::RECORD_*
+   * flags; 0 for an ordinary record.  Always 0 for a free slot.
+   */
+  std::uint8_t flags;
+
+  /**
+   * Offset of the data item in the page.  For a free slot, the previous free
+   * slot, or Page::INVALID_SLOT.
    */
   std::uint16_t item_offset;
 
   /**
-   * Length of the data item in this slot.
+   * Length of the data item in this slot.  For a free slot, the next free
+   * slot, or Page::INVALID_SLOT.
    */
   std::uint16_t item_length;
 };
 
+/**
+ * @brief Bytes of a record, read in place on the page that holds it.
+ *
+ * A view copies nothing, so it is only valid while the page stays in memory
+ * and isn't changed, since inserting a record may move the others; for a page
+ * in the buffer pool, that is while the page is pinned.
+ */
+struct RecordView {
+  /**
+   * First byte of the record.
+   */
+  const char* data;
+
+  /**
+   * Length of the record in bytes.
+   */
+  std::size_t length;
+
+  /**
+   * Returns a copy of the record.
+   */
+  std::string toString() const { return std::string(data, length); }
+};
+
 class PageIterator;
 
 /**
@@ -129,10 +169,46 @@ class Page {
   static const SlotId INVALID_SLOT = 0;
 
   /**
-   * Constructs a new, uninitialized page.
+   * Record flag marking a record whose tail is stored out of line in overflow
+   * pages; the bytes on the page end with an OverflowStub.
+   */
+  static const std::uint8_t RECORD_OVERFLOW = 0x01;
+
+  /**
+   * Record flag marking a forwarding stub: the record was moved to another
+   * page and the bytes on this page are the RecordId of its new location.
+   */
+  static const std::uint8_t RECORD_FORWARDED = 0x02;
+
+  /**
+   * Record flag marking a record moved away from its home slot; the bytes on
+   * the page start with the RecordId of the forwarding stub in its home slot.
+   */
+  static const std::uint8_t RECORD_MOVED = 0x04;
+
+  /**
+   * Record flag marking a record shorter than a RecordId, padded so that a
+   * forwarding stub can take its place; its last byte holds its length.
+   */
+  static const std::uint8_t RECORD_PADDED = 0x08;
+
+  /**
+   * Selects the constructor that leaves a page uninitialized.
+   */
+  enum Uninitialized { UNINITIALIZED };
+
+  /**
+   * Constructs a new, empty page.
    */
   Page();
 
+  /**
+   * Constructs a page without initializing it, for callers that overwrite all
+   * SIZE bytes right away, such as reads from a file.  This skips zeroing the
+   * data area, which costs as much as the read itself.
+   */
+  explicit Page(Uninitialized) {}
+
   /**
    * Inserts a new record into the page.
    *
@@ -141,6 +217,30 @@ class Page {
    */
   RecordId insertRecord(const std::string& record_data);
 
+  /**
+   * Inserts a new record into the page, copying it straight from the caller's
+   * buffer, e.g. a struct, without building a std::string first.
+   *
+   * @param record_data   First byte of the record.
+   * @param record_length Length of the record in bytes.
+   * @return  ID of the newly inserted record.
+   */
+  RecordId insertRecord(const char* record_data,
+                        const std::size_t record_length);
+
+  /**
+   * Inserts records in order until one doesn't fit, filling the page in a
+   * single pass over its slots.
+   *
+   * @param records     Records to insert.
+   * @param num_records Number of records.
+   * @param record_ids  If not NULL, set to the IDs of the inserted records.
+   * @return  Number of records inserted, which are the first ones given.
+   */
+  std::size_t insertRecords(const RecordView* records,
+                            const std::size_t num_records,
+                            RecordId* record_ids = NULL);
+
   /**
    * Returns the record with the given ID.  Returned data is a copy of what is
    * stored on the page; use updateRecord to change it.
@@ -151,6 +251,15 @@ class Page {
    */
   std::string getRecord(const RecordId& record_id) const;
 
+  /**
+   * Returns the record with the given ID without copying it.
+   *
+   * @see RecordView
+   * @param record_id  ID of the record to return.
+   * @return  View of the record's bytes on this page.
+   */
+  RecordView getRecordView(const RecordId& record_id) const;
+
   /**
    * Updates the record with the given ID, replacing its data with a new
    * version.  This is equivalent to deleting the old record and inserting a
@@ -162,14 +271,42 @@ class Page {
   void updateRecord(const RecordId& record_id, const std::string& record_data);
 
   /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array.
+   * Updates the record with the given ID from the caller's buffer.
+   *
+   * @param record_id     ID of record to update.
+   * @param record_data   First byte of the updated record.
+   * @param record_length Length of the updated record in bytes.
+   */
+  void updateRecord(const RecordId& record_id, const char* record_data,
+                    const std::size_t record_length);
+
+  /**
+   * Deletes the record with the given ID.  The space the record held is
+   * reclaimed right away if it borders the free space, and otherwise when an
+   * insertion needs it, by compacting the page once.  Slot array is compacted
+   * if the slot deleted is at the end of the slot array.
    *
    * @param record_id   ID of the record to delete.
    */
   void deleteRecord(const RecordId& record_id);
 
+  /**
+   * Returns the flags of the record with the given ID.
+   *
+   * @param record_id   ID of the record.
+   * @return  Combination of RECORD_* flags.
+   */
+  std::uint8_t getRecordFlags(const RecordId& record_id) const;
+
+  /**
+   * Sets the flags of the record with the given ID.  Flags are kept when the
+   * record is updated and cleared when it is deleted.
+   *
+   * @param record_id   ID of the record.
+   * @param flags       Combination of RECORD_* flags.
+   */
+  void setRecordFlags(const RecordId& record_id, const std::uint8_t flags);
+
   /**
    * Returns true if the page has enough free space to hold the given data.
    *
@@ -179,12 +316,23 @@ class Page {
   bool hasSpaceForRecord(const std::string& record_data) const;
 
   /**
-   * Returns this page's free space in bytes.
+   * Returns true if the page has enough free space to hold a record of the
+   * given length.
+   *
+   * @param record_length Length of the record in bytes.
+   * @return  Whether the page can hold the record.
+   */
+  bool hasSpaceForRecord(const std::size_t record_length) const;
+
+  /**
+   * Returns this page's free space in bytes, including space left by deleted
+   * records that hasn't been reclaimed yet.
    *
    * @return  Free space in bytes.
    */
   std::uint16_t getFreeSpace() const { return header_.free_space_upper_bound -
-                                              header_.free_space_lower_bound; }
+                                              slotArrayEnd() +
+                                              header_.fragmented_bytes; }
 
   /**
    * Returns this page's number in its file.
@@ -221,6 +369,11 @@ class Page {
    */
   void initialize();
 
+  /**
+   * Returns the header of a new page with no records.
+   */
+  static PageHeader emptyHeader();
+
   /**
    * Sets this page's number in its file.
    *
@@ -239,19 +392,6 @@ class Page {
     header_.next_page_number = new_next_page_number;
   }
 
-  /**
-   * Deletes the record with the given ID.  Page is compacted upon delete to
-   * ensure that data of all records is contiguous.  Slot array is compacted if
-   * the slot deleted is at the end of the slot array and
-   * <allow_slot_compaction> is set.
-   *
-   * @param record_id             ID of the record to delete.
-   * @param allow_slot_compaction If true, the slot array will be compacted if
-   *                              possible.
-   */
-  void deleteRecord(const RecordId& record_id,
-                    const bool allow_slot_compaction);
-
   /**
    * Returns the slot with the given number.  This method will return
    * unallocated slots if requested; it is up to the caller to ensure they
@@ -273,36 +413,91 @@ class Page {
   const PageSlot& getSlot(const SlotId slot_number) const;
 
   /**
-   * Returns the slot number of an available slot.  If no slots are available
-   * to be reused, allocates a new slot.  Updates available slot count in the
-   * header metadata, but does not mark returned slot as used.  If a new slot is
-   * allocated, updates the free space lower bound.
+   * Returns the slot number of an available slot, taking it off the free slot
+   * list.  If no slots are available to be reused, allocates a new slot.  Does
+   * not mark returned slot as used.
    *
-   * Callers are responsible for making sure there is enough space to allocate a
-   * new slot before calling this method.
+   * Callers are responsible for making sure there is enough contiguous space
+   * to allocate a new slot before calling this method.
    *
-   * Since the returned slot is not marked as used, callers must take care to
-   * fill the slot or mark it used before someone else calls this method.
+   * Since the returned slot is neither used nor on the free slot list, callers
+   * must fill it right away.
    *
    * @return  Slot number of an unused slot.
    */
   SlotId getAvailableSlot();
 
+  /**
+   * Returns the offset of the end of the slot array, where the free space
+   * starts.
+   */
+  std::uint16_t slotArrayEnd() const {
+    return header_.num_slots * sizeof(PageSlot);
+  }
+
+  /**
+   * Adds a slot to the front of the free slot list and marks it unused.
+   *
+   * @param slot_number   Number of slot.
+   */
+  void pushFreeSlot(const SlotId slot_number);
+
+  /**
+   * Removes a slot from the free slot list.
+   *
+   * @param slot_number   Number of slot, which must be in the list.
+   */
+  void unlinkFreeSlot(const SlotId slot_number);
+
+  /**
+   * Zeroes bytes no record uses any more, and returns them to the free space
+   * if they border it or counts them as fragmented otherwise.
+   *
+   * @param offset  Offset of the bytes.
+   * @param length  Number of bytes.
+   */
+  void releaseSpace(const std::uint16_t offset, const std::uint16_t length);
+
+  /**
+   * Compacts the page if the free space between the slot array and the
+   * records is smaller than the given length, so that it holds all free bytes.
+   *
+   * @param length  Number of contiguous bytes needed.
+   */
+  void makeContiguousSpace(const std::size_t length);
+
+  /**
+   * Moves the records next to each other at the end of the page, reclaiming
+   * all fragmented bytes.
+   */
+  void compact();
+
+  /**
+   * Converts the header of a page written by version 4 or older of the file
+   * format, which stored the free space lower bound and a count of free slots
+   * instead of the fragmented bytes and the free slot list, and left the byte
+   * now holding the record flags unset.
+   */
+  void upgradeHeader();
+
   /**
    * Inserts record data into the given slot.  The slot should not be currently
-   * in use.  <slot_number> must be less than <header_.num_slots>.
+   * in use nor on the free slot list.  <slot_number> must be less than
+   * <header_.num_slots>.
    *
-   * Callers are responsible for making sure there is enough space to hold the
-   * record before calling this method.
+   * Callers are responsible for making sure there is enough contiguous space
+   * to hold the record before calling this method.
    *
    * @param slot_number   Number of slot to insert record into.
-   * @param record_data   Bytes that compose the record.
+   * @param record_data   First byte of the record.
+   * @param record_length Length of the record in bytes.
    * @throws  InvalidSlotException  Thrown when given slot number refers to an
    *                                unallocated slot.
    * @throws  SlotInUseException  Thrown when given slot is in use.
    */
   void insertRecordInSlot(const SlotId slot_number,
-                          const std::string& record_data);
+                          const char* record_data,
+                          const std::size_t record_length);
 
   /**
    * Throws an exception if the given record ID is not valid for this page
@@ -337,6 +532,7 @@ class Page {
   friend class PageFile;
   friend class BlobFile;
   friend class PageIterator;
+  friend class PaxPage;
 };
 
 static_assert(Page::SIZE > sizeof(PageHeader),
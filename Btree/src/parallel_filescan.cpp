@@ -0,0 +1,88 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "parallel_filescan.h"
+
+#include <algorithm>
+#include <exception>
+#include <thread>
+
+#include "file_iterator.h"
+#include "overflow.h"
+
+namespace badgerdb {
+
+const std::size_t ParallelFileScan::MORSEL_PAGES;
+
+MorselQueue::MorselQueue(PageFile* file, const std::size_t morsel_pages)
+    : morsel_pages_(std::max<std::size_t>(morsel_pages, 1)),
+      next_morsel_(0) {
+  for (FileIterator iter = file->begin(); iter != file->end(); ++iter) {
+    pages_.push_back(iter.page_number());
+  }
+}
+
+bool MorselQueue::next(const PageId*& pages, std::size_t& num_pages) {
+  const std::size_t morsel = next_morsel_++;
+  if (morsel >= numMorsels()) {
+    return false;
+  }
+  const std::size_t first = morsel * morsel_pages_;
+  pages = &pages_[first];
+  num_pages = std::min(morsel_pages_, pages_.size() - first);
+  return true;
+}
+
+ParallelFileScan::ParallelFileScan(const std::string& name, BufMgr* buf_mgr,
+                                   const std::size_t num_streams,
+                                   const Predicate& predicate,
+                                   const std::size_t morsel_pages)
+    : buf_mgr_(buf_mgr),
+      file_(name, false),
+      morsels_(&file_, morsel_pages) {
+  // Opening files isn't threadsafe, so the overflow chains are opened here
+  // rather than by whichever stream first meets a long record.
+  const bool has_overflow = File::exists(OverflowFile::nameFor(name));
+  for (std::size_t i = 0; i < std::max<std::size_t>(num_streams, 1); ++i) {
+    streams_.push_back(new FileScan(name, buf_mgr_, &morsels_, predicate));
+    if (has_overflow) {
+      streams_.back()->getOverflowFile().file();
+    }
+  }
+}
+
+ParallelFileScan::~ParallelFileScan() {
+  for (std::size_t i = 0; i < streams_.size(); ++i) {
+    delete streams_[i];
+  }
+  buf_mgr_->flushFile(&file_);
+}
+
+void ParallelFileScan::run(
+    const std::function<void(FileScan&, std::size_t)>& worker) {
+  std::vector<std::exception_ptr> errors(streams_.size());
+  std::vector<std::thread> threads;
+  for (std::size_t i = 0; i < streams_.size(); ++i) {
+    threads.push_back(std::thread([this, &worker, &errors, i]() {
+      try {
+        worker(*streams_[i], i);
+      } catch (...) {
+        errors[i] = std::current_exception();
+      }
+    }));
+  }
+  for (std::size_t i = 0; i < threads.size(); ++i) {
+    threads[i].join();
+  }
+  for (std::size_t i = 0; i < errors.size(); ++i) {
+    if (errors[i]) {
+      std::rethrow_exception(errors[i]);
+    }
+  }
+}
+
+}
@@ -0,0 +1,187 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "file.h"
+#include "buffer.h"
+#include "filescan.h"
+#include "predicate.h"
+
+namespace badgerdb {
+
+/**
+ * @brief The used pages of a relation, split into morsels of consecutive
+ * pages that scans take one at a time.
+ *
+ * The pages are listed once from the allocation bitmaps when the queue is
+ * built, so taking a morsel reads nothing and only costs an atomic increment.
+ * The list takes 4 bytes per page.
+ */
+class MorselQueue {
+ public:
+  /**
+   * Lists the used pages of a file.
+   *
+   * @param file          File to split.
+   * @param morsel_pages  Number of pages of each morsel but the last.
+   */
+  MorselQueue(PageFile* file, const std::size_t morsel_pages);
+
+  /**
+   * Takes the next morsel.  May be called from any thread.
+   *
+   * @param pages         Set to the numbers of the morsel's pages, in
+   *                      increasing order.
+   * @param num_pages     Set to the number of pages of the morsel.
+   * @return  False if every morsel has been taken.
+   */
+  bool next(const PageId*& pages, std::size_t& num_pages);
+
+  /**
+   * Returns the number of morsels.
+   */
+  std::size_t numMorsels() const {
+    return (pages_.size() + morsel_pages_ - 1) / morsel_pages_;
+  }
+
+  /**
+   * Returns the number of pages of all morsels.
+   */
+  std::size_t numPages() const { return pages_.size(); }
+
+ private:
+  /**
+   * Numbers of the used pages.
+   */
+  std::vector<PageId> pages_;
+
+  /**
+   * Number of pages of each morsel but the last.
+   */
+  std::size_t morsel_pages_;
+
+  /**
+   * Index of the next morsel to take.
+   */
+  std::atomic<std::size_t> next_morsel_;
+};
+
+/**
+ * @brief Scans a relation on several threads at once.
+ *
+ * The relation's pages are split into morsels of about MORSEL_PAGES pages.
+ * The scan has one stream per worker thread, each a FileScan that takes the
+ * next morsel from a shared MorselQueue whenever it runs out of pages, so
+ * threads that get cheap morsels simply take more of them.  Each record of
+ * the relation is returned by exactly one stream, in no particular order
+ * across streams.  Streams share the buffer manager, which serializes its
+ * own work and file I/O; records are read and predicates evaluated on the
+ * pinned pages in parallel.
+ *
+ * @code
+ * ParallelFileScan scan(relationName, bufMgr, numThreads, predicate);
+ * scan.run([&](FileScan& stream, std::size_t thread) {
+ *   RecordId rid;
+ *   try {
+ *     while (true) { stream.scanNext(rid); ... }
+ *   } catch (const EndOfFileException& e) {
+ *   }
+ * });
+ * @endcode
+ *
+ * The buffer pool needs at least one frame per stream, and one more per
+ * stream reading an overflow chain.  Nothing else may change the relation
+ * while it is being scanned.
+ */
+class ParallelFileScan {
+ public:
+  /**
+   * Default number of pages of a morsel.
+   */
+  static const std::size_t MORSEL_PAGES = 64;
+
+  /**
+   * Splits a relation into morsels and opens a stream for each thread.
+   *
+   * @param name          Name of the relation's file.
+   * @param buf_mgr       Buffer Manager instance shared by the streams.
+   * @param num_streams   Number of streams, i.e. of worker threads.
+   * @param predicate     Condition records returned by the streams satisfy.
+   * @param morsel_pages  Number of pages of a morsel.
+   */
+  ParallelFileScan(const std::string& name, BufMgr* buf_mgr,
+                   const std::size_t num_streams,
+                   const Predicate& predicate = Predicate(),
+                   const std::size_t morsel_pages = MORSEL_PAGES);
+
+  /**
+   * Closes the streams and flushes the relation's pages out of the buffer
+   * pool.
+   */
+  ~ParallelFileScan();
+
+  /**
+   * Returns the number of streams.
+   */
+  std::size_t numStreams() const { return streams_.size(); }
+
+  /**
+   * Returns a stream.  A stream may only be used by one thread at a time.
+   *
+   * @param index   Index of the stream, below numStreams().
+   */
+  FileScan& stream(const std::size_t index) { return *streams_[index]; }
+
+  /**
+   * Returns the morsels the relation is split into.
+   */
+  const MorselQueue& morsels() const { return morsels_; }
+
+  /**
+   * Runs a function on one thread per stream and waits for them all.  If a
+   * thread throws, the exception is rethrown here once all have finished.
+   *
+   * @param worker  Called with a stream and its index.
+   */
+  void run(const std::function<void(FileScan&, std::size_t)>& worker);
+
+ private:
+  /**
+   * Not copyable; the streams are closed when this is destroyed.
+   */
+  ParallelFileScan(const ParallelFileScan&);
+  ParallelFileScan& operator=(const ParallelFileScan&);
+
+  /**
+   * Buffer Manager instance shared by the streams.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File of the relation, open while the streams are.
+   */
+  PageFile file_;
+
+  /**
+   * Morsels of the relation.
+   */
+  MorselQueue morsels_;
+
+  /**
+   * One scan per thread.
+   */
+  std::vector<FileScan*> streams_;
+};
+
+}
@@ -0,0 +1,255 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "pax_page.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "exceptions/insufficient_space_exception.h"
+#include "exceptions/invalid_pax_layout_exception.h"
+#include "exceptions/invalid_record_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Minipages start at multiples of this in the data area.  The page header is
+ * a multiple of it too, so minipages are aligned for vector loads.
+ */
+const std::size_t MINIPAGE_ALIGNMENT = 16;
+
+static_assert(sizeof(PageHeader) % MINIPAGE_ALIGNMENT == 0,
+              "Minipages must be aligned within the page");
+
+std::size_t align(const std::size_t offset) {
+  return (offset + MINIPAGE_ALIGNMENT - 1) / MINIPAGE_ALIGNMENT *
+         MINIPAGE_ALIGNMENT;
+}
+
+/**
+ * Lays out the minipages of a page holding the given number of records.
+ *
+ * @param columns       Columns of the records.
+ * @param bitmap_offset Offset of the used row bitmap.
+ * @param capacity      Number of records.
+ * @param offsets       If not NULL, set to the offset of each minipage.
+ * @return  Offset of the end of the last minipage.
+ */
+std::size_t layOut(const std::vector<PaxColumn>& columns,
+                   const std::size_t bitmap_offset,
+                   const std::size_t capacity, std::uint16_t* offsets) {
+  std::size_t offset = bitmap_offset + (capacity + 7) / 8;
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    offset = align(offset);
+    if (offsets != NULL) {
+      offsets[i] = offset;
+    }
+    offset += columns[i].width * capacity;
+  }
+  return offset;
+}
+
+}
+
+bool PaxPage::isPaxPage(const Page& page) {
+  // A slotted page without slots has no records, so its free space always
+  // reaches the end of the page.
+  return page.header_.num_slots == 0 &&
+         page.header_.free_space_upper_bound == 0 &&
+         reinterpret_cast<const PaxHeader*>(page.data_)->magic == MAGIC;
+}
+
+std::uint16_t PaxPage::capacityFor(const std::vector<PaxColumn>& columns) {
+  std::size_t record_width = 0;
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    record_width += columns[i].width;
+  }
+  const std::size_t bitmap_offset = bitmapOffset(columns.size());
+  if (record_width == 0 || bitmap_offset >= Page::DATA_SIZE) {
+    return 0;
+  }
+  // Each record takes its width plus a bit of the bitmap; alignment of the
+  // minipages may cost a few records more.
+  std::size_t capacity =
+      (Page::DATA_SIZE - bitmap_offset) * 8 / (record_width * 8 + 1);
+  if (capacity > 0xFFFE) {
+    capacity = 0xFFFE;
+  }
+  while (capacity > 0 &&
+         layOut(columns, bitmap_offset, capacity, NULL) > Page::DATA_SIZE) {
+    --capacity;
+  }
+  return capacity;
+}
+
+void PaxPage::format(Page& page, const std::vector<PaxColumn>& columns,
+                     const std::uint16_t record_length) {
+  if (columns.empty() || columns.size() > MAX_COLUMNS) {
+    std::stringstream ss;
+    ss << columns.size() << " columns";
+    throw InvalidPaxLayoutException(ss.str());
+  }
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    const PaxColumn& column = columns[i];
+    if (column.width == 0 || column.offset + column.width > record_length) {
+      std::stringstream ss;
+      ss << "column " << i << " at offset " << column.offset << " of width "
+         << column.width << " in a record of " << record_length << " bytes";
+      throw InvalidPaxLayoutException(ss.str());
+    }
+    for (std::size_t j = 0; j < i; ++j) {
+      if (column.offset < columns[j].offset + columns[j].width &&
+          columns[j].offset < column.offset + column.width) {
+        std::stringstream ss;
+        ss << "columns " << j << " and " << i << " overlap";
+        throw InvalidPaxLayoutException(ss.str());
+      }
+    }
+  }
+  const std::uint16_t capacity = capacityFor(columns);
+  if (capacity == 0) {
+    std::stringstream ss;
+    ss << "records of " << record_length << " bytes don't fit on a page";
+    throw InvalidPaxLayoutException(ss.str());
+  }
+
+  // Leave no free space or slots to the slotted page operations.
+  page.header_.fragmented_bytes = 0;
+  page.header_.free_space_upper_bound = 0;
+  page.header_.num_slots = 0;
+  page.header_.first_free_slot = Page::INVALID_SLOT;
+  memset(page.data_, '\0', Page::DATA_SIZE);
+
+  PaxHeader* header = reinterpret_cast<PaxHeader*>(page.data_);
+  header->magic = MAGIC;
+  header->record_length = record_length;
+  header->num_columns = columns.size();
+  header->capacity = capacity;
+  header->num_rows = 0;
+  header->num_free_rows = 0;
+
+  std::uint16_t offsets[MAX_COLUMNS];
+  layOut(columns, bitmapOffset(columns.size()), capacity, offsets);
+  PaxMinipage* minipages =
+      reinterpret_cast<PaxMinipage*>(&page.data_[sizeof(PaxHeader)]);
+  for (std::size_t i = 0; i < columns.size(); ++i) {
+    minipages[i].column = columns[i];
+    minipages[i].offset = offsets[i];
+  }
+}
+
+PaxPage::PaxPage()
+    : page_(NULL) {
+}
+
+PaxPage::PaxPage(Page* page)
+    : page_(page) {
+  if (!isPaxPage(*page_)) {
+    std::stringstream ss;
+    ss << "page " << page_->page_number() << " is not a PAX page";
+    throw InvalidPaxLayoutException(ss.str());
+  }
+}
+
+RecordId PaxPage::insertRecord(const char* record_data,
+                               const std::size_t record_length) {
+  if (record_length != recordLength()) {
+    std::stringstream ss;
+    ss << "record of " << record_length << " bytes on a page of "
+       << recordLength() << "-byte records";
+    throw InvalidPaxLayoutException(ss.str());
+  }
+  if (!hasSpaceForRecord()) {
+    throw InsufficientSpaceException(page_->page_number(), record_length, 0);
+  }
+
+  PaxHeader& page_header = header();
+  std::uint16_t row;
+  if (page_header.num_free_rows > 0) {
+    // Reuse the first free row.
+    for (row = 0; isUsed(row + 1); ++row) {
+    }
+    --page_header.num_free_rows;
+  } else {
+    row = page_header.num_rows++;
+  }
+  std::uint8_t* bitmap = const_cast<std::uint8_t*>(usedBitmap());
+  bitmap[row / 8] |= 1 << (row % 8);
+
+  const PaxMinipage* columns = minipages();
+  for (std::uint16_t i = 0; i < page_header.num_columns; ++i) {
+    const PaxColumn& column = columns[i].column;
+    memcpy(&page_->data_[columns[i].offset + row * column.width],
+           record_data + column.offset, column.width);
+  }
+  const RecordId record_id = {page_->page_number(),
+                              static_cast<SlotId>(row + 1), 0};
+  return record_id;
+}
+
+void PaxPage::deleteRecord(const RecordId& record_id) {
+  validateRecordId(record_id);
+  PaxHeader& page_header = header();
+  const std::uint16_t row = record_id.slot_number - 1;
+  std::uint8_t* bitmap = const_cast<std::uint8_t*>(usedBitmap());
+  bitmap[row / 8] &= ~(1 << (row % 8));
+
+  // Keep rows that aren't in use zeroed, so whole minipages can be read.
+  const PaxMinipage* columns = minipages();
+  for (std::uint16_t i = 0; i < page_header.num_columns; ++i) {
+    const std::uint16_t width = columns[i].column.width;
+    memset(&page_->data_[columns[i].offset + row * width], '\0', width);
+  }
+
+  ++page_header.num_free_rows;
+  while (page_header.num_rows > 0 && !isUsed(page_header.num_rows)) {
+    --page_header.num_rows;
+    --page_header.num_free_rows;
+  }
+}
+
+void PaxPage::getRecord(const RecordId& record_id, char* record_data) const {
+  validateRecordId(record_id);
+  const std::uint16_t row = record_id.slot_number - 1;
+  memset(record_data, '\0', recordLength());
+  const PaxMinipage* columns = minipages();
+  for (std::uint16_t i = 0; i < numColumns(); ++i) {
+    const PaxColumn& column = columns[i].column;
+    memcpy(record_data + column.offset,
+           &page_->data_[columns[i].offset + row * column.width],
+           column.width);
+  }
+}
+
+std::string PaxPage::getRecord(const RecordId& record_id) const {
+  std::string record_data(recordLength(), '\0');
+  getRecord(record_id, &record_data[0]);
+  return record_data;
+}
+
+SlotId PaxPage::nextUsedSlot(const SlotId slot_number) const {
+  const std::uint8_t* bitmap = usedBitmap();
+  const std::uint16_t num_rows = numRows();
+  // Slot s is row s - 1, so the row after slot s is row s.
+  for (std::uint16_t row = slot_number; row < num_rows; ++row) {
+    if ((bitmap[row / 8] & (1 << (row % 8))) != 0) {
+      return row + 1;
+    }
+  }
+  return Page::INVALID_SLOT;
+}
+
+void PaxPage::validateRecordId(const RecordId& record_id) const {
+  if (record_id.page_number != page_->page_number() ||
+      !isUsed(record_id.slot_number)) {
+    throw InvalidRecordException(record_id, page_->page_number());
+  }
+}
+
+}
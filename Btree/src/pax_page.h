@@ -0,0 +1,374 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cassert>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A fixed-width attribute of the records of a PAX page.
+ */
+struct PaxColumn {
+  /**
+   * Offset of the attribute within a record, in bytes.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Width of the attribute in bytes.
+   */
+  std::uint16_t width;
+};
+
+/**
+ * @brief Header metadata at the start of the data area of a PAX page.
+ */
+struct PaxHeader {
+  /**
+   * Identifies a PAX page.
+   */
+  std::uint32_t magic;
+
+  /**
+   * Length of every record on the page.
+   */
+  std::uint16_t record_length;
+
+  /**
+   * Number of columns.
+   */
+  std::uint16_t num_columns;
+
+  /**
+   * Number of records the page can hold.
+   */
+  std::uint16_t capacity;
+
+  /**
+   * Number of rows in use or freed by a deletion.  Rows past it have never
+   * been used.
+   */
+  std::uint16_t num_rows;
+
+  /**
+   * Number of rows below num_rows that are free.
+   */
+  std::uint16_t num_free_rows;
+
+  /**
+   * Unused; keeps the column table aligned.
+   */
+  std::uint16_t reserved;
+};
+
+/**
+ * @brief Entry of the column table of a PAX page.
+ */
+struct PaxMinipage {
+  /**
+   * Attribute stored in the minipage.
+   */
+  PaxColumn column;
+
+  /**
+   * Offset of the minipage in the data area of the page.
+   */
+  std::uint16_t offset;
+
+  /**
+   * Unused; keeps entries aligned.
+   */
+  std::uint16_t reserved;
+};
+
+/**
+ * @brief A page of fixed-width records stored column by column (PAX).
+ *
+ * Instead of placing each record contiguously in a slot, a PAX page splits the
+ * page into one minipage per column, each holding that attribute of every
+ * record on the page as a dense array.  A scan that only looks at one
+ * attribute then reads only that attribute's bytes, and the arrays are laid
+ * out so that a predicate can be evaluated over a whole minipage at once,
+ * e.g. with SIMD instructions.  Bytes of a record not covered by any column,
+ * such as struct padding, are not stored and read back as zero.
+ *
+ * A PAX page is an ordinary Page whose data area is laid out differently, so
+ * it is allocated, buffered, logged and written like any other page.  Its
+ * page header shows no slots and no free space, so slotted page operations
+ * and HeapFile leave it alone.  FileScan recognizes PAX pages and returns
+ * their records like those of slotted pages, and offers typed access to the
+ * columns.  The record in row r has slot number r + 1.
+ *
+ * This class is a view of a Page; it holds no data of its own and must not
+ * outlive the page.
+ *
+ * @warning This class is not threadsafe.
+ */
+class PaxPage {
+ public:
+  /**
+   * Identifies a PAX page.
+   */
+  static const std::uint32_t MAGIC = 0x58415050;
+
+  /**
+   * Maximum number of columns.
+   */
+  static const std::uint16_t MAX_COLUMNS = 64;
+
+  /**
+   * Returns whether the page is a PAX page.
+   *
+   * @param page  Page to check.
+   */
+  static bool isPaxPage(const Page& page);
+
+  /**
+   * Returns the number of records a PAX page with the given columns holds.
+   *
+   * @param columns  Columns of the records.
+   */
+  static std::uint16_t capacityFor(const std::vector<PaxColumn>& columns);
+
+  /**
+   * Lays the page out as an empty PAX page, discarding its records.
+   *
+   * @param page            Page to format.
+   * @param columns         Columns of the records, which must not overlap.
+   * @param record_length   Length of every record in bytes.
+   * @throws  InvalidPaxLayoutException  If a column lies outside the record,
+   *                                     there are too many columns, or a
+   *                                     record doesn't fit on a page.
+   */
+  static void format(Page& page, const std::vector<PaxColumn>& columns,
+                     const std::uint16_t record_length);
+
+  /**
+   * Constructs a view of no page.
+   */
+  PaxPage();
+
+  /**
+   * Constructs a view of a PAX page.
+   *
+   * @param page  PAX page.
+   * @throws  InvalidPaxLayoutException  If the page isn't a PAX page.
+   */
+  explicit PaxPage(Page* page);
+
+  /**
+   * Inserts a record, splitting it into its columns.
+   *
+   * @param record_data   First byte of the record.
+   * @param record_length Length of the record, which must be the page's.
+   * @return  ID of the new record.
+   * @throws  InvalidPaxLayoutException   If the length is wrong.
+   * @throws  InsufficientSpaceException  If the page is full.
+   */
+  RecordId insertRecord(const char* record_data,
+                        const std::size_t record_length);
+
+  /**
+   * Inserts a record, splitting it into its columns.
+   *
+   * @param record_data   Bytes that compose the record.
+   * @return  ID of the new record.
+   */
+  RecordId insertRecord(const std::string& record_data) {
+    return insertRecord(record_data.data(), record_data.length());
+  }
+
+  /**
+   * Deletes a record.  Other records keep their rows, and so their IDs.
+   *
+   * @param record_id   ID of the record to delete.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  void deleteRecord(const RecordId& record_id);
+
+  /**
+   * Assembles a record from its columns.
+   *
+   * @param record_id   ID of the record.
+   * @param record_data Buffer of recordLength() bytes to assemble it in.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  void getRecord(const RecordId& record_id, char* record_data) const;
+
+  /**
+   * Returns a copy of a record assembled from its columns.
+   *
+   * @param record_id   ID of the record.
+   * @throws  InvalidRecordException  If the record doesn't exist.
+   */
+  std::string getRecord(const RecordId& record_id) const;
+
+  /**
+   * Returns true if the page has room for another record.
+   */
+  bool hasSpaceForRecord() const {
+    return header().num_free_rows > 0 || header().num_rows < header().capacity;
+  }
+
+  /**
+   * Returns whether the given slot holds a record.
+   *
+   * @param slot_number   Slot number, which is the row plus one.
+   */
+  bool isUsed(const SlotId slot_number) const {
+    const std::uint16_t row = slot_number - 1;
+    return slot_number != Page::INVALID_SLOT && row < header().num_rows &&
+           (usedBitmap()[row / 8] & (1 << (row % 8))) != 0;
+  }
+
+  /**
+   * Returns the first slot after the given one that holds a record, or
+   * Page::INVALID_SLOT if there is none.  Page::INVALID_SLOT starts at the
+   * first record.
+   *
+   * @param slot_number   Slot to search after.
+   */
+  SlotId nextUsedSlot(const SlotId slot_number) const;
+
+  /**
+   * Returns the number of records on the page.
+   */
+  std::uint16_t numRecords() const {
+    return header().num_rows - header().num_free_rows;
+  }
+
+  /**
+   * Returns the number of rows of the column arrays in use or freed by a
+   * deletion.  Rows at or past this have never held a record.
+   */
+  std::uint16_t numRows() const { return header().num_rows; }
+
+  /**
+   * Returns the number of records the page can hold.
+   */
+  std::uint16_t capacity() const { return header().capacity; }
+
+  /**
+   * Returns the length of every record on the page.
+   */
+  std::uint16_t recordLength() const { return header().record_length; }
+
+  /**
+   * Returns the number of columns.
+   */
+  std::uint16_t numColumns() const { return header().num_columns; }
+
+  /**
+   * Returns the layout of a column.
+   *
+   * @param column  Number of column.
+   */
+  const PaxColumn& getColumn(const std::uint16_t column) const {
+    assert(column < numColumns());
+    return minipages()[column].column;
+  }
+
+  /**
+   * Returns the minipage of a column: the column's value for row r starts at
+   * byte r * width.  Rows that aren't in use hold zeroes.
+   *
+   * @param column  Number of column.
+   */
+  const char* columnData(const std::uint16_t column) const {
+    assert(column < numColumns());
+    return &page_->data_[minipages()[column].offset];
+  }
+
+  /**
+   * Returns the minipage of a column as an array of numRows() values.  T must
+   * be as wide as the column.
+   *
+   * @param column  Number of column.
+   */
+  template <typename T>
+  const T* columnArray(const std::uint16_t column) const {
+    assert(sizeof(T) == getColumn(column).width);
+    return reinterpret_cast<const T*>(columnData(column));
+  }
+
+  /**
+   * Returns one column of a record, reading only that column's bytes.  T must
+   * be as wide as the column.
+   *
+   * @param slot_number   Slot of the record.
+   * @param column        Number of column.
+   */
+  template <typename T>
+  T getValue(const SlotId slot_number, const std::uint16_t column) const {
+    assert(isUsed(slot_number));
+    return columnArray<T>(column)[slot_number - 1];
+  }
+
+  /**
+   * Returns the bitmap of rows in use; row r is bit r % 8 of byte r / 8.
+   */
+  const std::uint8_t* usedBitmap() const {
+    return reinterpret_cast<const std::uint8_t*>(
+        &page_->data_[bitmapOffset(header().num_columns)]);
+  }
+
+  /**
+   * Returns the page this is a view of.
+   */
+  Page* page() const { return page_; }
+
+ private:
+  /**
+   * Returns the offset in the data area of the used row bitmap.
+   *
+   * @param num_columns   Number of columns.
+   */
+  static std::size_t bitmapOffset(const std::size_t num_columns) {
+    return sizeof(PaxHeader) + num_columns * sizeof(PaxMinipage);
+  }
+
+  /**
+   * Returns the header of the page.
+   */
+  const PaxHeader& header() const {
+    return *reinterpret_cast<const PaxHeader*>(page_->data_);
+  }
+
+  PaxHeader& header() {
+    return *reinterpret_cast<PaxHeader*>(page_->data_);
+  }
+
+  /**
+   * Returns the column table of the page.
+   */
+  const PaxMinipage* minipages() const {
+    return reinterpret_cast<const PaxMinipage*>(&page_->data_[sizeof(PaxHeader)]);
+  }
+
+  /**
+   * Throws an exception if the record ID is not valid for this page.
+   *
+   * @param record_id   Record ID to validate.
+   * @throws  InvalidRecordException  If the ID has a bad page or slot number.
+   */
+  void validateRecordId(const RecordId& record_id) const;
+
+  /**
+   * Page this is a view of.
+   */
+  Page* page_;
+};
+
+}
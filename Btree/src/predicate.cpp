@@ -0,0 +1,280 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "predicate.h"
+
+#include <cstring>
+#include <sstream>
+
+#include "exceptions/invalid_predicate_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+template <typename T>
+bool compare(const T& attribute, const Comparison comparison, const T& value) {
+  switch (comparison) {
+    case EQUAL:
+      return attribute == value;
+    case NOT_EQUAL:
+      return attribute != value;
+    case LESS:
+      return attribute < value;
+    case LESS_EQUAL:
+      return attribute <= value;
+    case GREATER:
+      return attribute > value;
+    case GREATER_EQUAL:
+      return attribute >= value;
+  }
+  return false;
+}
+
+bool overlaps(const double min, const double max, const Comparison comparison,
+              const double value) {
+  switch (comparison) {
+    case EQUAL:
+      return min <= value && value <= max;
+    case NOT_EQUAL:
+      return !(min == value && max == value);
+    case LESS:
+      return min < value;
+    case LESS_EQUAL:
+      return min <= value;
+    case GREATER:
+      return max > value;
+    case GREATER_EQUAL:
+      return max >= value;
+  }
+  return true;
+}
+
+}
+
+Predicate::Predicate()
+    : extent_(0) {
+  Node node;
+  memset(&node, 0, sizeof(node));
+  node.kind = MATCH_ALL;
+  nodes_.push_back(node);
+}
+
+Predicate Predicate::intAt(const std::size_t offset,
+                           const Comparison comparison,
+                           const std::int32_t value) {
+  Predicate predicate =
+      term(INT_TERM, offset, sizeof(std::int32_t), comparison);
+  predicate.nodes_[0].int_value = value;
+  return predicate;
+}
+
+Predicate Predicate::doubleAt(const std::size_t offset,
+                              const Comparison comparison,
+                              const double value) {
+  Predicate predicate = term(DOUBLE_TERM, offset, sizeof(double), comparison);
+  predicate.nodes_[0].double_value = value;
+  return predicate;
+}
+
+Predicate Predicate::stringAt(const std::size_t offset,
+                              const std::size_t width,
+                              const Comparison comparison,
+                              const std::string& value) {
+  if (width == 0 || value.length() > width) {
+    std::stringstream ss;
+    ss << "string of " << value.length() << " bytes compared with an "
+       << "attribute of " << width << " bytes";
+    throw InvalidPredicateException(ss.str());
+  }
+  Predicate predicate = term(STRING_TERM, offset, width, comparison);
+  predicate.nodes_[0].string_index = 0;
+  predicate.strings_.push_back(value);
+  predicate.strings_[0].resize(width, '\0');
+  return predicate;
+}
+
+Predicate Predicate::allOf(const Predicate& left, const Predicate& right) {
+  if (left.matchesAll()) {
+    return right;
+  }
+  if (right.matchesAll()) {
+    return left;
+  }
+  return combine(ALL_OF, left, right);
+}
+
+Predicate Predicate::anyOf(const Predicate& left, const Predicate& right) {
+  if (left.matchesAll()) {
+    return left;
+  }
+  if (right.matchesAll()) {
+    return right;
+  }
+  return combine(ANY_OF, left, right);
+}
+
+Predicate Predicate::term(const NodeKind kind, const std::size_t offset,
+                          const std::size_t width,
+                          const Comparison comparison) {
+  Predicate predicate;
+  Node& node = predicate.nodes_[0];
+  node.kind = kind;
+  node.comparison = comparison;
+  node.offset = offset;
+  node.width = width;
+  predicate.extent_ = offset + width;
+  return predicate;
+}
+
+Predicate Predicate::combine(const NodeKind kind, const Predicate& left,
+                             const Predicate& right) {
+  Predicate predicate;
+  predicate.nodes_.clear();
+  Node node;
+  memset(&node, 0, sizeof(node));
+  node.kind = kind;
+  node.left = predicate.append(left);
+  predicate.append(right);
+  predicate.nodes_.push_back(node);
+  return predicate;
+}
+
+std::size_t Predicate::append(const Predicate& other) {
+  // Indices of the other predicate's nodes and strings shift by what is
+  // already here.
+  const std::size_t first_node = nodes_.size();
+  const std::size_t first_string = strings_.size();
+  for (std::size_t i = 0; i < other.nodes_.size(); ++i) {
+    Node node = other.nodes_[i];
+    if (node.kind == STRING_TERM) {
+      node.string_index += first_string;
+    } else if (node.kind == ALL_OF || node.kind == ANY_OF) {
+      node.left += first_node;
+    }
+    nodes_.push_back(node);
+  }
+  strings_.insert(strings_.end(), other.strings_.begin(),
+                  other.strings_.end());
+  if (other.extent_ > extent_) {
+    extent_ = other.extent_;
+  }
+  return nodes_.size() - 1;
+}
+
+bool Predicate::evaluate(const std::size_t index, const char* data,
+                         const std::size_t length) const {
+  const Node& node = nodes_[index];
+  switch (node.kind) {
+    case MATCH_ALL:
+      return true;
+    case ALL_OF:
+      return evaluate(node.left, data, length) &&
+             evaluate(index - 1, data, length);
+    case ANY_OF:
+      return evaluate(node.left, data, length) ||
+             evaluate(index - 1, data, length);
+    default:
+      break;
+  }
+  if (node.offset + node.width > length) {
+    return false;
+  }
+  const char* attribute = data + node.offset;
+  switch (node.kind) {
+    case INT_TERM: {
+      std::int32_t value;
+      memcpy(&value, attribute, sizeof(value));
+      return compare(value, node.comparison, node.int_value);
+    }
+    case DOUBLE_TERM: {
+      double value;
+      memcpy(&value, attribute, sizeof(value));
+      return compare(value, node.comparison, node.double_value);
+    }
+    case STRING_TERM: {
+      const int order =
+          strncmp(attribute, strings_[node.string_index].data(), node.width);
+      return compare(order, node.comparison, 0);
+    }
+    default:
+      return false;
+  }
+}
+
+bool Predicate::evaluateRanges(const std::size_t index,
+                               const AttributeRange* ranges,
+                               const std::size_t num_ranges) const {
+  const Node& node = nodes_[index];
+  AttributeType type;
+  switch (node.kind) {
+    case ALL_OF:
+      return evaluateRanges(node.left, ranges, num_ranges) &&
+             evaluateRanges(index - 1, ranges, num_ranges);
+    case ANY_OF:
+      return evaluateRanges(node.left, ranges, num_ranges) ||
+             evaluateRanges(index - 1, ranges, num_ranges);
+    case INT_TERM:
+      type = INT_ATTRIBUTE;
+      break;
+    case DOUBLE_TERM:
+      type = DOUBLE_ATTRIBUTE;
+      break;
+    default:
+      return true;
+  }
+  for (std::size_t i = 0; i < num_ranges; ++i) {
+    const AttributeRange& range = ranges[i];
+    if (range.offset != node.offset || range.type != type) {
+      continue;
+    }
+    if (range.min > range.max) {
+      // No record has the attribute, and a term on a missing one is false.
+      return false;
+    }
+    const double value =
+        type == INT_ATTRIBUTE ? node.int_value : node.double_value;
+    return overlaps(range.min, range.max, node.comparison, value);
+  }
+  return true;
+}
+
+bool Predicate::evaluateFilter(const std::size_t index,
+                               const ValueFilter& filter) const {
+  const Node& node = nodes_[index];
+  switch (node.kind) {
+    case ALL_OF:
+      return evaluateFilter(node.left, filter) &&
+             evaluateFilter(index - 1, filter);
+    case ANY_OF:
+      return evaluateFilter(node.left, filter) ||
+             evaluateFilter(index - 1, filter);
+    default:
+      break;
+  }
+  if (node.comparison != EQUAL) {
+    return true;
+  }
+  switch (node.kind) {
+    case INT_TERM:
+      return filter.mayContain(node.offset, INT_ATTRIBUTE,
+                               reinterpret_cast<const char*>(&node.int_value),
+                               node.width);
+    case DOUBLE_TERM:
+      return filter.mayContain(
+          node.offset, DOUBLE_ATTRIBUTE,
+          reinterpret_cast<const char*>(&node.double_value), node.width);
+    case STRING_TERM:
+      return filter.mayContain(node.offset, STRING_ATTRIBUTE,
+                               strings_[node.string_index].data(),
+                               node.width);
+    default:
+      return true;
+  }
+}
+
+}
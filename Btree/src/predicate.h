@@ -0,0 +1,331 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Comparison a term of a Predicate makes between an attribute of a
+ * record and a constant.
+ */
+enum Comparison {
+  EQUAL,
+  NOT_EQUAL,
+  LESS,
+  LESS_EQUAL,
+  GREATER,
+  GREATER_EQUAL
+};
+
+/**
+ * @brief Type of an attribute whose values are summarized, e.g. by an
+ * AttributeRange or a ValueFilter.  Ranges are only kept of numeric ones.
+ */
+enum AttributeType {
+  INT_ATTRIBUTE,
+  DOUBLE_ATTRIBUTE,
+  STRING_ATTRIBUTE
+};
+
+/**
+ * @brief Smallest and largest value of a numeric attribute over a set of
+ * records, such as those of one page.
+ *
+ * Int values are held exactly as doubles.  A range with min > max is empty:
+ * none of the records has the attribute.
+ */
+struct AttributeRange {
+  /**
+   * Offset of the attribute within a record, in bytes.
+   */
+  std::size_t offset;
+
+  /**
+   * Type of the attribute.
+   */
+  AttributeType type;
+
+  /**
+   * Smallest value.
+   */
+  double min;
+
+  /**
+   * Largest value.
+   */
+  double max;
+};
+
+/**
+ * @brief Summary of the values of attributes over a set of records, such as
+ * those of one page, that tells whether any record may have a given value.
+ */
+class ValueFilter {
+ public:
+  virtual ~ValueFilter() {}
+
+  /**
+   * Returns whether any of the records may have an attribute equal to a
+   * value.  A false answer is certain but a true one is not.
+   *
+   * @param offset  Offset of the attribute within a record, in bytes.
+   * @param type    Type of the attribute.
+   * @param value   Value, laid out as it is stored in a record.
+   * @param width   Width of the value in bytes.
+   */
+  virtual bool mayContain(const std::size_t offset, const AttributeType type,
+                          const char* value,
+                          const std::size_t width) const = 0;
+};
+
+/**
+ * @brief A condition on the raw bytes of a record.
+ *
+ * A predicate is built from terms that compare an attribute at a fixed byte
+ * offset of a record with a constant, combined with allOf (AND) and anyOf
+ * (OR).  It is compiled once into a flat array of nodes and then evaluated
+ * directly on the bytes of a record, e.g. on a pinned page, so records that
+ * don't match are never copied.  For example, for records laid out as
+ *
+ * @code
+ * struct Item { int rating; char location[32]; };
+ * @endcode
+ *
+ * the condition <tt>location = "New York" AND rating > 1000</tt> is
+ *
+ * @code
+ * Predicate::allOf(
+ *     Predicate::stringAt(offsetof(Item, location), 32, EQUAL, "New York"),
+ *     Predicate::intAt(offsetof(Item, rating), GREATER, 1000));
+ * @endcode
+ *
+ * Attributes may be unaligned.  String attributes are NUL padded character
+ * arrays compared like strncmp.  A term on an attribute that reaches past the
+ * end of a record is false.
+ *
+ * @warning This class is not threadsafe.
+ */
+class Predicate {
+ public:
+  /**
+   * Constructs a predicate every record matches.
+   */
+  Predicate();
+
+  /**
+   * Returns a predicate comparing an int attribute with a constant.
+   *
+   * @param offset      Offset of the attribute within a record, in bytes.
+   * @param comparison  Comparison of the attribute with the constant.
+   * @param value       Constant.
+   */
+  static Predicate intAt(const std::size_t offset, const Comparison comparison,
+                         const std::int32_t value);
+
+  /**
+   * Returns a predicate comparing a double attribute with a constant.
+   *
+   * @param offset      Offset of the attribute within a record, in bytes.
+   * @param comparison  Comparison of the attribute with the constant.
+   * @param value       Constant.
+   */
+  static Predicate doubleAt(const std::size_t offset,
+                            const Comparison comparison, const double value);
+
+  /**
+   * Returns a predicate comparing a string attribute with a constant.
+   *
+   * @param offset      Offset of the attribute within a record, in bytes.
+   * @param width       Width of the attribute in bytes.
+   * @param comparison  Comparison of the attribute with the constant.
+   * @param value       Constant.
+   * @throws  InvalidPredicateException  If the constant is longer than the
+   *                                     attribute.
+   */
+  static Predicate stringAt(const std::size_t offset, const std::size_t width,
+                            const Comparison comparison,
+                            const std::string& value);
+
+  /**
+   * Returns a predicate matching the records both predicates match.
+   */
+  static Predicate allOf(const Predicate& left, const Predicate& right);
+
+  /**
+   * Returns a predicate matching the records either predicate matches.
+   */
+  static Predicate anyOf(const Predicate& left, const Predicate& right);
+
+  /**
+   * Returns whether a record matches.
+   *
+   * @param data    First byte of the record.
+   * @param length  Length of the record in bytes.
+   */
+  bool matches(const char* data, const std::size_t length) const {
+    return matchesAll() || evaluate(nodes_.size() - 1, data, length);
+  }
+
+  /**
+   * Returns whether a record matches.
+   *
+   * @param record  Bytes of the record.
+   */
+  bool matches(const RecordView& record) const {
+    return matches(record.data, record.length);
+  }
+
+  /**
+   * Returns whether any record whose attributes lie within the given ranges
+   * may match.  Terms on attributes without a range, and string terms, may
+   * match any record, so a false answer is certain but a true one is not.
+   *
+   * @param ranges      Ranges of attributes of the records.
+   * @param num_ranges  Number of ranges.
+   */
+  bool mayMatch(const AttributeRange* ranges,
+                const std::size_t num_ranges) const {
+    return matchesAll() ||
+           evaluateRanges(nodes_.size() - 1, ranges, num_ranges);
+  }
+
+  /**
+   * Returns whether any record summarized by a filter may match.  Only
+   * equality terms are looked up in the filter; any other term may match
+   * any record.
+   *
+   * @param filter  Filter of the values of the records.
+   */
+  bool mayMatch(const ValueFilter& filter) const {
+    return matchesAll() || evaluateFilter(nodes_.size() - 1, filter);
+  }
+
+  /**
+   * Returns whether every record matches, so there is nothing to evaluate.
+   */
+  bool matchesAll() const {
+    return nodes_.size() == 1 && nodes_[0].kind == MATCH_ALL;
+  }
+
+  /**
+   * Returns the number of leading bytes of a record the predicate reads.
+   */
+  std::size_t extent() const { return extent_; }
+
+ private:
+  /**
+   * Kinds of nodes.
+   */
+  enum NodeKind {
+    MATCH_ALL,
+    INT_TERM,
+    DOUBLE_TERM,
+    STRING_TERM,
+    ALL_OF,
+    ANY_OF
+  };
+
+  /**
+   * @brief A term or operator of a compiled predicate.
+   */
+  struct Node {
+    /**
+     * What the node does.
+     */
+    NodeKind kind;
+
+    /**
+     * Comparison made by a term.
+     */
+    Comparison comparison;
+
+    /**
+     * Offset of the attribute a term reads.
+     */
+    std::size_t offset;
+
+    /**
+     * Width of the attribute a term reads.
+     */
+    std::size_t width;
+
+    /**
+     * Constant of an int or double term, or index into strings_ of the
+     * constant of a string term.  Operators store the index of their left
+     * operand in left; the right operand is the node just before them.
+     */
+    union {
+      std::int32_t int_value;
+      double double_value;
+      std::size_t string_index;
+      std::size_t left;
+    };
+  };
+
+  /**
+   * Returns a predicate made of one term.
+   */
+  static Predicate term(const NodeKind kind, const std::size_t offset,
+                        const std::size_t width, const Comparison comparison);
+
+  /**
+   * Returns a predicate combining two predicates with an operator.
+   */
+  static Predicate combine(const NodeKind kind, const Predicate& left,
+                           const Predicate& right);
+
+  /**
+   * Appends the nodes and constants of another predicate.
+   *
+   * @return  Index of the root of the appended nodes.
+   */
+  std::size_t append(const Predicate& other);
+
+  /**
+   * Evaluates the subtree rooted at a node on a record.
+   */
+  bool evaluate(const std::size_t index, const char* data,
+                const std::size_t length) const;
+
+  /**
+   * Returns whether the subtree rooted at a node may match a record whose
+   * attributes lie within the given ranges.
+   */
+  bool evaluateRanges(const std::size_t index, const AttributeRange* ranges,
+                      const std::size_t num_ranges) const;
+
+  /**
+   * Returns whether the subtree rooted at a node may match a record
+   * summarized by a filter.
+   */
+  bool evaluateFilter(const std::size_t index,
+                      const ValueFilter& filter) const;
+
+  /**
+   * Nodes in postfix order; the last one is the root.
+   */
+  std::vector<Node> nodes_;
+
+  /**
+   * Constants of string terms, NUL padded to the width of their attribute.
+   */
+  std::vector<std::string> strings_;
+
+  /**
+   * Number of leading bytes of a record the predicate reads.
+   */
+  std::size_t extent_;
+};
+
+}
@@ -0,0 +1,80 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "record_batch.h"
+
+#include <cstring>
+
+namespace badgerdb {
+
+const std::size_t RecordBatch::DEFAULT_CAPACITY;
+const std::size_t RecordBatch::MAX_PAGES;
+
+RecordBatch::RecordBatch(const std::size_t capacity, const bool record_views)
+    : capacity_(capacity > 0 ? capacity : 1),
+      record_views_(record_views),
+      size_(0) {
+  // Sized once, so appending a record is a few stores.
+  record_ids_.resize(capacity_);
+  if (record_views_) {
+    views_.resize(capacity_);
+  }
+}
+
+std::size_t RecordBatch::addColumn(const std::size_t offset,
+                                   const std::size_t width) {
+  Column column;
+  column.offset = offset;
+  column.width = width;
+  column.values.resize(capacity_ * width);
+  columns_.push_back(column);
+  return columns_.size() - 1;
+}
+
+void RecordBatch::clear() {
+  size_ = 0;
+  copies_.clear();
+  copy_offsets_.clear();
+}
+
+void RecordBatch::append(const RecordId& record_id, const RecordView& record,
+                         const bool copy) {
+  const std::size_t row = size_++;
+  record_ids_[row] = record_id;
+  for (std::size_t i = 0; i < columns_.size(); ++i) {
+    Column& column = columns_[i];
+    char* value = &column.values[row * column.width];
+    if (column.offset + column.width <= record.length) {
+      memcpy(value, record.data + column.offset, column.width);
+    } else {
+      memset(value, '\0', column.width);
+    }
+  }
+  if (!record_views_) {
+    return;
+  }
+  if (copy) {
+    // copies_ may still move, so the view is pointed at it by finish().
+    copy_offsets_.push_back(copies_.size());
+    copies_.insert(copies_.end(), record.data, record.data + record.length);
+    const RecordView view = {NULL, record.length};
+    views_[row] = view;
+  } else {
+    views_[row] = record;
+  }
+}
+
+void RecordBatch::finish() {
+  std::size_t copy = 0;
+  for (std::size_t i = 0; copy < copy_offsets_.size(); ++i) {
+    if (views_[i].data == NULL) {
+      views_[i].data = copies_.data() + copy_offsets_[copy++];
+    }
+  }
+}
+
+}
@@ -0,0 +1,210 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Records returned by one call of FileScan::scanNextBatch.
+ *
+ * A batch holds up to capacity() records: their RecordIds, views of their
+ * bytes, and any fixed-width attributes added with addColumn copied into one
+ * contiguous array per column, so an operator can work through a whole batch
+ * in a tight loop:
+ *
+ * @code
+ * RecordBatch batch;
+ * const std::size_t rating = batch.addColumn(offsetof(Item, rating),
+ *                                            sizeof(int));
+ * while (scan.scanNextBatch(batch)) {
+ *   const int* ratings = batch.column<int>(rating);
+ *   for (std::size_t i = 0; i < batch.size(); ++i) { ... }
+ * }
+ * @endcode
+ *
+ * Record views point into pages the scan keeps pinned, and stay valid until
+ * the next call of scanNextBatch or the scan is destroyed.  Records of PAX
+ * pages are assembled in a buffer of the batch instead.  For a record with
+ * an overflow chain, the view and columns cover only the part on the page.
+ * A batch that only needs columns can do without views, so the scan unpins
+ * each page as soon as it is done with it.  Attributes reaching past the end
+ * of a record read as zero.
+ *
+ * @warning This class is not threadsafe.
+ */
+class RecordBatch {
+ public:
+  /**
+   * Default number of records of a batch.
+   */
+  static const std::size_t DEFAULT_CAPACITY = 1024;
+
+  /**
+   * Most pages a batch with record views keeps pinned.  The batch ends early
+   * once its records span this many pages, so the buffer pool needs this many
+   * frames per scan.
+   */
+  static const std::size_t MAX_PAGES = 32;
+
+  /**
+   * Constructs an empty batch.
+   *
+   * @param capacity      Most records a batch holds.
+   * @param record_views  Whether to keep views of the records' bytes.
+   */
+  explicit RecordBatch(const std::size_t capacity = DEFAULT_CAPACITY,
+                       const bool record_views = true);
+
+  /**
+   * Projects a fixed-width attribute of every record into an array.
+   *
+   * @param offset  Offset of the attribute within a record, in bytes.
+   * @param width   Width of the attribute in bytes.
+   * @return  Index of the column.
+   */
+  std::size_t addColumn(const std::size_t offset, const std::size_t width);
+
+  /**
+   * Empties the batch, keeping its columns.
+   */
+  void clear();
+
+  /**
+   * Adds a record.  Called by FileScan.
+   *
+   * @param record_id   ID of the record.
+   * @param record      Bytes of the record, which stay valid until the next
+   *                    clear() unless copy is set.
+   * @param copy        Whether the bytes have to be copied into the batch.
+   */
+  void append(const RecordId& record_id, const RecordView& record,
+              const bool copy);
+
+  /**
+   * Points the views of copied records at their copies once the batch is
+   * complete.  Called by FileScan.
+   */
+  void finish();
+
+  /**
+   * Returns the number of records in the batch.
+   */
+  std::size_t size() const { return size_; }
+
+  /**
+   * Returns whether the batch holds no records.
+   */
+  bool empty() const { return size_ == 0; }
+
+  /**
+   * Returns whether the batch holds capacity() records.
+   */
+  bool full() const { return size_ == capacity_; }
+
+  /**
+   * Returns the most records the batch holds.
+   */
+  std::size_t capacity() const { return capacity_; }
+
+  /**
+   * Returns whether the batch keeps views of the records' bytes.
+   */
+  bool hasRecordViews() const { return record_views_; }
+
+  /**
+   * Returns the IDs of the records.
+   */
+  const RecordId* recordIds() const { return record_ids_.data(); }
+
+  /**
+   * Returns views of the records' bytes, or NULL if the batch keeps none.
+   */
+  const RecordView* records() const {
+    return record_views_ ? views_.data() : NULL;
+  }
+
+  /**
+   * Returns the values of a column, one per record.
+   *
+   * @param index   Index of the column returned by addColumn.
+   */
+  template <typename T>
+  const T* column(const std::size_t index) const {
+    return reinterpret_cast<const T*>(columns_[index].values.data());
+  }
+
+ private:
+  /**
+   * @brief An attribute projected into an array.
+   */
+  struct Column {
+    /**
+     * Offset of the attribute within a record.
+     */
+    std::size_t offset;
+
+    /**
+     * Width of the attribute.
+     */
+    std::size_t width;
+
+    /**
+     * Values of the attribute, capacity_ * width bytes.
+     */
+    std::vector<char> values;
+  };
+
+  /**
+   * Most records the batch holds.
+   */
+  std::size_t capacity_;
+
+  /**
+   * Whether the batch keeps views of the records' bytes.
+   */
+  bool record_views_;
+
+  /**
+   * Number of records in the batch.
+   */
+  std::size_t size_;
+
+  /**
+   * IDs of the records, capacity_ of them of which size_ are in use.
+   */
+  std::vector<RecordId> record_ids_;
+
+  /**
+   * Views of the records, like record_ids_.  Until finish(), copied
+   * records' views have no data.
+   */
+  std::vector<RecordView> views_;
+
+  /**
+   * Copies of records that aren't stored contiguously on their page.
+   */
+  std::vector<char> copies_;
+
+  /**
+   * Offset in copies_ of each copied record, in order.
+   */
+  std::vector<std::size_t> copy_offsets_;
+
+  /**
+   * Projected columns.
+   */
+  std::vector<Column> columns_;
+};
+
+}
@@ -0,0 +1,367 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "tablespace.h"
+
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+#include "exceptions/file_io_exception.h"
+#include "exceptions/file_not_found_exception.h"
+#include "exceptions/invalid_tablespace_exception.h"
+
+namespace badgerdb {
+
+const char Tablespace::SEPARATOR;
+const std::uint32_t Tablespace::EXTENT_BYTES;
+const std::uint32_t Tablespace::EXTENTS_PER_GROUP;
+const SegmentId Tablespace::NO_SEGMENT;
+const SegmentId Tablespace::DIRECTORY_SEGMENT;
+const ExtentId Tablespace::NO_EXTENT;
+const std::uint32_t TablespaceHeader::MAGIC;
+const std::uint32_t TablespaceHeader::VERSION;
+
+Tablespace::TablespaceMap Tablespace::open_tablespaces_;
+
+bool Tablespace::splitName(const std::string& filename, std::string& path,
+                           std::string& segment_name) {
+  const std::string::size_type separator = filename.find(SEPARATOR);
+  if (separator == std::string::npos || separator == 0 ||
+      separator + 1 == filename.size()) {
+    return false;
+  }
+  path = filename.substr(0, separator);
+  segment_name = filename.substr(separator + 1);
+  return true;
+}
+
+std::shared_ptr<Tablespace> Tablespace::open(const std::string& path) {
+  TablespaceMap::iterator entry = open_tablespaces_.find(path);
+  if (entry != open_tablespaces_.end()) {
+    return entry->second;
+  }
+  std::shared_ptr<Tablespace> tablespace(new Tablespace(path));
+  open_tablespaces_[path] = tablespace;
+  return tablespace;
+}
+
+Tablespace::Tablespace(const std::string& path)
+    : path_(path),
+      segment_extents_(DIRECTORY_SEGMENT + 1),
+      segment_names_(DIRECTORY_SEGMENT + 1) {
+  fd_ = ::open(path_.c_str(), O_RDWR | O_CREAT, 0644);
+  if (fd_ < 0) {
+    throw FileNotFoundException(path_);
+  }
+  struct stat file_stat;
+  try {
+    if (::fstat(fd_, &file_stat) == 0 && file_stat.st_size == 0) {
+      header_.magic = TablespaceHeader::MAGIC;
+      header_.version = TablespaceHeader::VERSION;
+      header_.num_extents = 0;
+      writeHeader();
+      return;
+    }
+    load();
+  } catch (...) {
+    ::close(fd_);
+    throw;
+  }
+}
+
+Tablespace::~Tablespace() {
+  ::close(fd_);
+}
+
+void Tablespace::load() {
+  if (::pread(fd_, &header_, sizeof(TablespaceHeader), 0 /* offset */) !=
+          static_cast<ssize_t>(sizeof(TablespaceHeader)) ||
+      header_.magic != TablespaceHeader::MAGIC ||
+      header_.version != TablespaceHeader::VERSION) {
+    throw InvalidTablespaceException(path_);
+  }
+
+  // Tables that were never written read short and leave their extents free.
+  owners_.resize(header_.num_extents);
+  for (ExtentId first = 0; first < header_.num_extents;
+       first += EXTENTS_PER_GROUP) {
+    const std::uint32_t count =
+        std::min(header_.num_extents - first, EXTENTS_PER_GROUP);
+    if (::pread(fd_, &owners_[first], count * sizeof(ExtentEntry),
+                entryPosition(first)) < 0) {
+      throw InvalidTablespaceException(path_);
+    }
+  }
+  for (ExtentId extent = 0; extent < header_.num_extents; ++extent) {
+    const ExtentEntry& owner = owners_[extent];
+    if (owner.segment == NO_SEGMENT) {
+      free_extents_.insert(extent);
+      continue;
+    }
+    if (owner.segment >= segment_extents_.size()) {
+      segment_extents_.resize(owner.segment + 1);
+      segment_names_.resize(owner.segment + 1);
+    }
+    std::vector<ExtentId>& extents = segment_extents_[owner.segment];
+    if (owner.index >= extents.size()) {
+      extents.resize(owner.index + 1, NO_EXTENT);
+    }
+    extents[owner.index] = extent;
+  }
+
+  const SegmentId num_entries = static_cast<SegmentId>(
+      segment_extents_[DIRECTORY_SEGMENT].size() * EXTENT_BYTES /
+      sizeof(SegmentEntry));
+  std::vector<SegmentEntry> entries(num_entries);
+  if (num_entries > 0) {
+    read(DIRECTORY_SEGMENT, 0 /* position */, &entries[0],
+         num_entries * sizeof(SegmentEntry));
+  }
+  for (SegmentId segment = DIRECTORY_SEGMENT + 1; segment < num_entries;
+       ++segment) {
+    const SegmentEntry& entry = entries[segment];
+    if (entry.name_length == 0 || entry.name_length > sizeof(entry.name)) {
+      continue;
+    }
+    if (segment >= segment_names_.size()) {
+      segment_extents_.resize(segment + 1);
+      segment_names_.resize(segment + 1);
+    }
+    segment_names_[segment].assign(entry.name, entry.name_length);
+    segment_ids_[segment_names_[segment]] = segment;
+  }
+
+  // A crash while a segment was dropped can leave extents whose segment is
+  // no longer in the directory.
+  for (SegmentId segment = DIRECTORY_SEGMENT + 1;
+       segment < segment_extents_.size(); ++segment) {
+    if (segment_names_[segment].empty()) {
+      freeExtents(segment);
+      free_segments_.insert(segment);
+    }
+  }
+}
+
+bool Tablespace::findSegment(const std::string& segment_name,
+                             SegmentId& segment) const {
+  std::map<std::string, SegmentId>::const_iterator entry =
+      segment_ids_.find(segment_name);
+  if (entry == segment_ids_.end()) {
+    return false;
+  }
+  segment = entry->second;
+  return true;
+}
+
+SegmentId Tablespace::createSegment(const std::string& segment_name) {
+  SegmentEntry entry;
+  if (segment_name.size() > sizeof(entry.name)) {
+    throw InvalidTablespaceException(path_ + SEPARATOR + segment_name);
+  }
+  SegmentId segment = static_cast<SegmentId>(segment_names_.size());
+  if (!free_segments_.empty()) {
+    segment = *free_segments_.begin();
+    free_segments_.erase(free_segments_.begin());
+  } else {
+    segment_extents_.resize(segment + 1);
+    segment_names_.resize(segment + 1);
+  }
+
+  memset(&entry, 0, sizeof(SegmentEntry));
+  entry.name_length = segment_name.size();
+  memcpy(entry.name, segment_name.data(), segment_name.size());
+  write(DIRECTORY_SEGMENT, segment * sizeof(SegmentEntry), &entry,
+        sizeof(SegmentEntry));
+  segment_names_[segment] = segment_name;
+  segment_ids_[segment_name] = segment;
+  return segment;
+}
+
+void Tablespace::dropSegment(const SegmentId segment) {
+  SegmentEntry entry;
+  memset(&entry, 0, sizeof(SegmentEntry));
+  write(DIRECTORY_SEGMENT, segment * sizeof(SegmentEntry), &entry,
+        sizeof(SegmentEntry));
+  segment_ids_.erase(segment_names_[segment]);
+  segment_names_[segment].clear();
+  free_segments_.insert(segment);
+
+  freeExtents(segment);
+}
+
+void Tablespace::freeExtents(const SegmentId segment) {
+  // Free extents read as zero, so the next segment to get one doesn't find
+  // this segment's bytes in the parts it hasn't written yet.
+  const std::vector<ExtentId> extents = segment_extents_[segment];
+  for (std::size_t index = 0; index < extents.size(); ++index) {
+    if (extents[index] == NO_EXTENT) {
+      continue;
+    }
+    bool zeroed = false;
+#ifdef __linux__
+    zeroed = ::fallocate(fd_, FALLOC_FL_PUNCH_HOLE | FALLOC_FL_KEEP_SIZE,
+                         extentPosition(extents[index]), EXTENT_BYTES) == 0;
+#endif
+    if (!zeroed) {
+      const std::vector<char> zeros(EXTENT_BYTES, 0);
+      writeAt(&zeros[0], EXTENT_BYTES, extentPosition(extents[index]));
+    }
+    setOwner(extents[index], NO_SEGMENT, 0 /* index */);
+  }
+  segment_extents_[segment].clear();
+}
+
+void Tablespace::read(const SegmentId segment, std::uint64_t position,
+                      void* data, std::size_t length) const {
+  const std::vector<ExtentId>& extents = segment_extents_[segment];
+  char* out = static_cast<char*>(data);
+  while (length > 0) {
+    const std::uint64_t index = position / EXTENT_BYTES;
+    const std::uint32_t offset = position % EXTENT_BYTES;
+    const std::size_t count =
+        std::min(length, static_cast<std::size_t>(EXTENT_BYTES - offset));
+    ssize_t num_read = 0;
+    if (index < extents.size() && extents[index] != NO_EXTENT) {
+      num_read = ::pread(fd_, out, count,
+                         extentPosition(extents[index]) + offset);
+    }
+    if (num_read < static_cast<ssize_t>(count)) {
+      // The extent was reserved but these bytes were never written.
+      num_read = std::max(num_read, static_cast<ssize_t>(0));
+      memset(out + num_read, 0, count - num_read);
+    }
+    out += count;
+    position += count;
+    length -= count;
+  }
+}
+
+void Tablespace::write(const SegmentId segment, std::uint64_t position,
+                       const void* data, std::size_t length) {
+  const char* in = static_cast<const char*>(data);
+  while (length > 0) {
+    const std::uint32_t offset = position % EXTENT_BYTES;
+    const std::size_t count =
+        std::min(length, static_cast<std::size_t>(EXTENT_BYTES - offset));
+    const ExtentId extent = extentFor(segment, position / EXTENT_BYTES);
+    writeAt(in, count, extentPosition(extent) + offset);
+    in += count;
+    position += count;
+    length -= count;
+  }
+}
+
+void Tablespace::reserve(const SegmentId segment, const std::uint64_t position,
+                         const std::size_t length) {
+  const std::uint64_t end = (position + length + EXTENT_BYTES - 1) /
+      EXTENT_BYTES;
+  for (std::uint64_t index = position / EXTENT_BYTES; index < end; ++index) {
+    extentFor(segment, index);
+  }
+}
+
+void Tablespace::sync() {
+  if (::fdatasync(fd_) != 0) {
+    throw FileIOException(path_, "sync", errno);
+  }
+}
+
+ExtentId Tablespace::extentFor(const SegmentId segment,
+                               const std::uint32_t index) {
+  const std::vector<ExtentId>& extents = segment_extents_[segment];
+  if (index < extents.size() && extents[index] != NO_EXTENT) {
+    return extents[index];
+  }
+
+  // The extent continuing the closest one before it keeps the segment
+  // contiguous.  A segment's first extent reuses space before growing the
+  // file.
+  std::uint32_t before = std::min(index, static_cast<std::uint32_t>(extents.size()));
+  while (before > 0 && extents[before - 1] == NO_EXTENT) {
+    --before;
+  }
+  ExtentId wanted = header_.num_extents;
+  if (before > 0) {
+    wanted = extents[before - 1] + (index - before + 1);
+  } else if (!free_extents_.empty()) {
+    wanted = *free_extents_.begin();
+  }
+
+  ExtentId extent = header_.num_extents;
+  if (free_extents_.count(wanted) > 0) {
+    extent = wanted;
+  } else if (wanted != header_.num_extents && !free_extents_.empty()) {
+    extent = *free_extents_.begin();
+  }
+  const bool appended = extent == header_.num_extents;
+  if (appended) {
+    owners_.resize(extent + 1);
+    owners_[extent].segment = NO_SEGMENT;
+    ++header_.num_extents;
+  }
+
+  // Claim the space now so the extent's pages end up together on disk.
+#ifdef __linux__
+  ::fallocate(fd_, 0 /* mode */, extentPosition(extent), EXTENT_BYTES);
+#else
+  ::posix_fallocate(fd_, extentPosition(extent), EXTENT_BYTES);
+#endif
+  setOwner(extent, segment, index);
+  if (appended) {
+    // The owner is recorded first, so a crash in between loses no extent.
+    writeHeader();
+  }
+  return extent;
+}
+
+void Tablespace::setOwner(const ExtentId extent, const SegmentId segment,
+                          const std::uint32_t index) {
+  const ExtentEntry old_owner = owners_[extent];
+  if (old_owner.segment != NO_SEGMENT) {
+    segment_extents_[old_owner.segment][old_owner.index] = NO_EXTENT;
+  }
+  owners_[extent].segment = segment;
+  owners_[extent].index = index;
+  if (segment == NO_SEGMENT) {
+    free_extents_.insert(extent);
+  } else {
+    free_extents_.erase(extent);
+    std::vector<ExtentId>& extents = segment_extents_[segment];
+    if (index >= extents.size()) {
+      extents.resize(index + 1, NO_EXTENT);
+    }
+    extents[index] = extent;
+  }
+  writeAt(&owners_[extent], sizeof(ExtentEntry), entryPosition(extent));
+}
+
+void Tablespace::writeHeader() {
+  writeAt(&header_, sizeof(TablespaceHeader), 0 /* position */);
+}
+
+void Tablespace::writeAt(const void* data, const std::size_t length,
+                         const std::uint64_t position) {
+  std::size_t written = 0;
+  while (written < length) {
+    const ssize_t result =
+        ::pwrite(fd_, static_cast<const char*>(data) + written,
+                 length - written, position + written);
+    if (result < 0 && errno == EINTR) {
+      continue;
+    }
+    if (result <= 0) {
+      throw FileIOException(path_, "write", result < 0 ? errno : 0);
+    }
+    written += result;
+  }
+}
+
+}
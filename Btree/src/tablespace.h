@@ -0,0 +1,383 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+
+namespace badgerdb {
+
+/**
+ * @brief Identifier for a segment of a tablespace.
+ */
+typedef std::uint32_t SegmentId;
+
+/**
+ * @brief Identifier for a data extent of a tablespace.
+ */
+typedef std::uint32_t ExtentId;
+
+/**
+ * @brief Owner of a data extent, as recorded in its group's extent table.
+ */
+struct ExtentEntry {
+  /**
+   * Segment the extent belongs to, or Tablespace::NO_SEGMENT if it is free.
+   */
+  SegmentId segment;
+
+  /**
+   * Position of the extent within the segment, in extents.
+   */
+  std::uint32_t index;
+};
+
+/**
+ * @brief Entry of the segment directory.
+ */
+struct SegmentEntry {
+  /**
+   * Length of name, or 0 if the entry is unused.
+   */
+  std::uint32_t name_length;
+
+  /**
+   * Name of the segment, which is the name of the file it holds without the
+   * tablespace path.
+   */
+  char name[124];
+};
+
+/**
+ * @brief Header at the start of a tablespace file.
+ */
+struct TablespaceHeader {
+  /**
+   * Identifies a tablespace file.
+   */
+  static const std::uint32_t MAGIC = 0x53544442;
+
+  /**
+   * Version of the layout.
+   */
+  static const std::uint32_t VERSION = 1;
+
+  std::uint32_t magic;
+
+  std::uint32_t version;
+
+  /**
+   * Number of data extents in the file, used or not.
+   */
+  std::uint32_t num_extents;
+};
+
+/**
+ * @brief A single file holding the bytes of many logical files.
+ *
+ * Each logical file is a segment of the tablespace.  Its bytes are stored in
+ * fixed-size extents, allocated from the tablespace as the segment grows, so
+ * thousands of small relations and indexes need one file descriptor and a
+ * handful of large files instead of thousands of tiny ones.  An extent is
+ * placed right after the one that holds the preceding bytes of the segment
+ * whenever that extent is free, so segments that grow alone are laid out
+ * contiguously.
+ *
+ * Like pages in a File, data extents come in groups, each preceded by an
+ * extent table recording which segment owns each extent of the group and at
+ * which position.  The segment directory, which names the segments, is
+ * itself segment DIRECTORY_SEGMENT, so the whole mapping is rebuilt from the
+ * extent tables when the tablespace is opened.  Bytes of a segment that were
+ * never written read as zero, like bytes past the end of an ordinary file.
+ *
+ * File objects open a segment when given a name of the form
+ * "<tablespace path>:<segment name>", e.g. "db.ts:relA"; names derived from
+ * it, such as the index files "db.ts:relA.0", land in the same tablespace.
+ * Tablespaces are opened once and shared by every segment of them.
+ *
+ * @warning This class is not threadsafe.  A tablespace file must not be
+ *          removed while the process that opened it runs.
+ */
+class Tablespace {
+ public:
+  /**
+   * Separates the tablespace path from the segment name in a file name.
+   */
+  static const char SEPARATOR = ':';
+
+  /**
+   * Size of an extent in bytes.  Pages of a segment never straddle extents.
+   */
+  static const std::uint32_t EXTENT_BYTES = 8 * Page::SIZE;
+
+  /**
+   * Number of data extents whose owners fit in one extent table.
+   */
+  static const std::uint32_t EXTENTS_PER_GROUP =
+      EXTENT_BYTES / sizeof(ExtentEntry);
+
+  /**
+   * Owner of free extents.
+   */
+  static const SegmentId NO_SEGMENT = 0;
+
+  /**
+   * Segment holding the segment directory, indexed by SegmentId.
+   */
+  static const SegmentId DIRECTORY_SEGMENT = 1;
+
+  /**
+   * Marks a position of a segment that has no extent.
+   */
+  static const ExtentId NO_EXTENT = 0xFFFFFFFF;
+
+  /**
+   * Splits a file name into the path of a tablespace and the name of a
+   * segment within it.
+   *
+   * @param filename      Name of file.
+   * @param path          Set to the tablespace path.
+   * @param segment_name  Set to the segment name.
+   * @return  False if the name doesn't refer to a segment of a tablespace.
+   */
+  static bool splitName(const std::string& filename, std::string& path,
+                        std::string& segment_name);
+
+  /**
+   * Returns the tablespace stored in the given file, opening the file the
+   * first time and creating it if it doesn't exist.  Tablespaces stay open
+   * until the process exits, so opening a segment never reads the extent
+   * tables again.
+   *
+   * @param path  Name of tablespace file.
+   * @throws  InvalidTablespaceException  If the file isn't a tablespace.
+   */
+  static std::shared_ptr<Tablespace> open(const std::string& path);
+
+  /**
+   * Closes the tablespace file.
+   */
+  ~Tablespace();
+
+  /**
+   * Looks up a segment by name.
+   *
+   * @param segment_name  Name of segment.
+   * @param segment       Set to the segment if it exists.
+   * @return  Whether the segment exists.
+   */
+  bool findSegment(const std::string& segment_name, SegmentId& segment) const;
+
+  /**
+   * Adds an empty segment.
+   *
+   * @param segment_name  Name of segment, which must not exist yet.
+   * @return  The new segment.
+   * @throws  InvalidTablespaceException  If the name is too long.
+   */
+  SegmentId createSegment(const std::string& segment_name);
+
+  /**
+   * Removes a segment and frees its extents.
+   *
+   * @param segment   Segment to remove.
+   */
+  void dropSegment(const SegmentId segment);
+
+  /**
+   * Reads bytes of a segment.  Bytes that were never written read as zero.
+   *
+   * @param segment   Segment to read.
+   * @param position  Position in the segment to read from.
+   * @param data      Buffer to read into.
+   * @param length    Number of bytes to read.
+   */
+  void read(const SegmentId segment, const std::uint64_t position,
+            void* data, const std::size_t length) const;
+
+  /**
+   * Writes bytes of a segment, giving it the extents it is missing.
+   *
+   * @param segment   Segment to write.
+   * @param position  Position in the segment to write to.
+   * @param data      Bytes to write.
+   * @param length    Number of bytes to write.
+   */
+  void write(const SegmentId segment, const std::uint64_t position,
+             const void* data, const std::size_t length);
+
+  /**
+   * Gives a segment the extents for a range of its bytes ahead of writing
+   * them, so they are laid out together.
+   *
+   * @param segment   Segment to extend.
+   * @param position  Position in the segment where the range starts.
+   * @param length    Length of range in bytes.
+   */
+  void reserve(const SegmentId segment, const std::uint64_t position,
+               const std::size_t length);
+
+  /**
+   * Syncs the tablespace file's data to disk.
+   *
+   * @throws  FileIOException   If the file can't be synced.
+   */
+  void sync();
+
+  /**
+   * Returns the name of the tablespace file.
+   */
+  const std::string& path() const { return path_; }
+
+  /**
+   * Returns the number of data extents in the tablespace file.
+   */
+  std::uint32_t numExtents() const { return header_.num_extents; }
+
+  /**
+   * Returns the number of extents not used by any segment.
+   */
+  std::size_t numFreeExtents() const { return free_extents_.size(); }
+
+ private:
+  typedef std::map<std::string, std::shared_ptr<Tablespace> > TablespaceMap;
+
+  /**
+   * Opens or creates the tablespace stored in the given file.
+   *
+   * @param path  Name of tablespace file.
+   */
+  explicit Tablespace(const std::string& path);
+
+  /**
+   * Reads the extent tables and the segment directory.
+   */
+  void load();
+
+  /**
+   * Returns the position in the tablespace file of a data extent.
+   */
+  static std::uint64_t extentPosition(const ExtentId extent) {
+    return (2 + extent / EXTENTS_PER_GROUP * (EXTENTS_PER_GROUP + 1) +
+            extent % EXTENTS_PER_GROUP) * static_cast<std::uint64_t>(EXTENT_BYTES);
+  }
+
+  /**
+   * Returns the position in the tablespace file of the extent table entry of
+   * a data extent.
+   */
+  static std::uint64_t entryPosition(const ExtentId extent) {
+    return (1 + extent / EXTENTS_PER_GROUP * (EXTENTS_PER_GROUP + 1)) *
+               static_cast<std::uint64_t>(EXTENT_BYTES) +
+           extent % EXTENTS_PER_GROUP * sizeof(ExtentEntry);
+  }
+
+  /**
+   * Returns the extent holding a position of a segment, allocating it if the
+   * segment has none there yet.
+   *
+   * @param segment   Segment.
+   * @param index     Position in the segment, in extents.
+   * @return  The extent.
+   */
+  ExtentId extentFor(const SegmentId segment, const std::uint32_t index);
+
+  /**
+   * Zeroes and frees every extent of a segment.
+   *
+   * @param segment   Segment.
+   */
+  void freeExtents(const SegmentId segment);
+
+  /**
+   * Records the owner of an extent in memory and in its extent table.
+   *
+   * @param extent    Extent.
+   * @param segment   New owner, or NO_SEGMENT to free the extent.
+   * @param index     Position of the extent in the owner.
+   */
+  void setOwner(const ExtentId extent, const SegmentId segment,
+                const std::uint32_t index);
+
+  /**
+   * Writes the header to the start of the tablespace file.
+   */
+  void writeHeader();
+
+  /**
+   * Writes bytes at the given position of the tablespace file.
+   *
+   * @param data      Bytes to write.
+   * @param length    Number of bytes.
+   * @param position  Position in the file.
+   * @throws  FileIOException   If the bytes can't be written.
+   */
+  void writeAt(const void* data, const std::size_t length,
+               const std::uint64_t position);
+
+  /**
+   * Tablespaces opened so far, by path.
+   */
+  static TablespaceMap open_tablespaces_;
+
+  /**
+   * Name of the tablespace file.
+   */
+  std::string path_;
+
+  /**
+   * Descriptor of the tablespace file.
+   */
+  int fd_;
+
+  /**
+   * Copy of the header on disk.
+   */
+  TablespaceHeader header_;
+
+  /**
+   * Owner of each data extent.
+   */
+  std::vector<ExtentEntry> owners_;
+
+  /**
+   * Extents of each segment by position, indexed by SegmentId.  Positions
+   * that were never written hold NO_EXTENT.
+   */
+  std::vector<std::vector<ExtentId> > segment_extents_;
+
+  /**
+   * Data extents owned by no segment.
+   */
+  std::set<ExtentId> free_extents_;
+
+  /**
+   * Segments by name.
+   */
+  std::map<std::string, SegmentId> segment_ids_;
+
+  /**
+   * Name of each segment, indexed by SegmentId.  Unused ids have an empty
+   * name.
+   */
+  std::vector<std::string> segment_names_;
+
+  /**
+   * Segment ids below segment_names_.size() that no segment uses.
+   */
+  std::set<SegmentId> free_segments_;
+};
+
+}
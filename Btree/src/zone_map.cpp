@@ -0,0 +1,288 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#include "zone_map.h"
+
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <limits>
+#include <sstream>
+
+#include "exceptions/invalid_zone_map_exception.h"
+
+namespace badgerdb {
+
+namespace {
+
+/**
+ * Marks the first page of a zone map.
+ */
+const std::uint32_t ZONE_MAP_MAGIC = 0x5a4d4150;
+
+/**
+ * Page holding the Header.
+ */
+const PageId HEADER_PAGE = 1;
+
+/**
+ * Flag at the start of an entry of a page that has one.
+ */
+const std::uint64_t HAS_ENTRY = 1;
+
+/**
+ * Bytes of a range within an entry: the smallest and the largest value.
+ */
+const std::size_t RANGE_SIZE = 2 * sizeof(double);
+
+/**
+ * Bound of a range that excludes nothing.
+ */
+const double UNBOUNDED = std::numeric_limits<double>::infinity();
+
+char* pageBytes(Page* page) {
+  return reinterpret_cast<char*>(page);
+}
+
+std::size_t attributeWidth(const ZoneAttribute& attribute) {
+  return attribute.type == INT_ATTRIBUTE ? sizeof(std::int32_t)
+                                         : sizeof(double);
+}
+
+double readDouble(const char* data) {
+  double value;
+  memcpy(&value, data, sizeof(value));
+  return value;
+}
+
+void writeDouble(char* data, const double value) {
+  memcpy(data, &value, sizeof(value));
+}
+
+void clearEntry(char* entry, const std::size_t num_attributes) {
+  memcpy(entry, &HAS_ENTRY, sizeof(HAS_ENTRY));
+  char* range = entry + sizeof(HAS_ENTRY);
+  for (std::size_t i = 0; i < num_attributes; ++i, range += RANGE_SIZE) {
+    writeDouble(range, UNBOUNDED);
+    writeDouble(range + sizeof(double), -UNBOUNDED);
+  }
+}
+
+}
+
+const std::size_t ZoneMap::MAX_ATTRIBUTES;
+
+std::string ZoneMap::nameFor(const std::string& relation_name) {
+  return relation_name + ".zonemap";
+}
+
+ZoneMap::ZoneMap(const std::string& relation_name, BufMgr* buf_mgr)
+    : name_(nameFor(relation_name)),
+      buf_mgr_(buf_mgr),
+      file_(new BlobFile(name_, false)) {
+  Page* page;
+  buf_mgr_->readPage(file_, HEADER_PAGE, page);
+  Header header;
+  memcpy(&header, pageBytes(page), sizeof(header));
+  buf_mgr_->unPinPage(file_, HEADER_PAGE, false);
+  if (header.magic != ZONE_MAP_MAGIC ||
+      header.num_attributes == 0 || header.num_attributes > MAX_ATTRIBUTES) {
+    delete file_;
+    throw InvalidZoneMapException(name_ + " is not a zone map");
+  }
+  setAttributes(header);
+}
+
+ZoneMap::ZoneMap(const std::string& relation_name, BufMgr* buf_mgr,
+                 const std::vector<ZoneAttribute>& attributes)
+    : name_(nameFor(relation_name)),
+      buf_mgr_(buf_mgr),
+      file_(NULL) {
+  if (attributes.empty() || attributes.size() > MAX_ATTRIBUTES) {
+    std::stringstream ss;
+    ss << attributes.size() << " attributes given, but a zone map keeps 1 to "
+       << MAX_ATTRIBUTES;
+    throw InvalidZoneMapException(ss.str());
+  }
+  Header header;
+  memset(&header, 0, sizeof(header));
+  header.magic = ZONE_MAP_MAGIC;
+  header.num_attributes = attributes.size();
+  for (std::size_t i = 0; i < attributes.size(); ++i) {
+    if (attributes[i].type != INT_ATTRIBUTE &&
+        attributes[i].type != DOUBLE_ATTRIBUTE) {
+      std::stringstream ss;
+      ss << "attribute at offset " << attributes[i].offset
+         << " has unknown type " << attributes[i].type;
+      throw InvalidZoneMapException(ss.str());
+    }
+    header.attributes[i] = attributes[i];
+  }
+
+  if (File::exists(name_)) {
+    File::remove(name_);
+  }
+  file_ = new BlobFile(name_, true);
+  PageId page_number;
+  Page* page;
+  buf_mgr_->allocPage(file_, page_number, page);
+  memset(pageBytes(page), 0, Page::SIZE);
+  memcpy(pageBytes(page), &header, sizeof(header));
+  buf_mgr_->unPinPage(file_, page_number, true);
+  setAttributes(header);
+}
+
+ZoneMap::~ZoneMap() {
+  try {
+    flush();
+  } catch (...) {
+    return;
+  }
+  delete file_;
+}
+
+void ZoneMap::flush() {
+  buf_mgr_->flushFile(file_);
+}
+
+void ZoneMap::setAttributes(const Header& header) {
+  attributes_.assign(header.attributes,
+                     header.attributes + header.num_attributes);
+  entry_size_ = sizeof(HAS_ENTRY) + attributes_.size() * RANGE_SIZE;
+  entries_per_page_ = Page::SIZE / entry_size_;
+  num_pages_ = header.num_pages;
+}
+
+char* ZoneMap::pinEntry(const PageId page_number, const bool allocate,
+                        PageId& zone_page) {
+  const std::uint32_t index = page_number / entries_per_page_;
+  if (index >= num_pages_) {
+    // Another instance may have added the page since the header was read.
+    Page* page;
+    buf_mgr_->readPage(file_, HEADER_PAGE, page);
+    memcpy(&num_pages_, pageBytes(page) +
+           offsetof(Header, num_pages), sizeof(num_pages_));
+    buf_mgr_->unPinPage(file_, HEADER_PAGE, false);
+  }
+  if (index >= num_pages_) {
+    if (!allocate) {
+      zone_page = Page::INVALID_NUMBER;
+      return NULL;
+    }
+    addPages(index + 1);
+  }
+  zone_page = HEADER_PAGE + 1 + index;
+  Page* page;
+  buf_mgr_->readPage(file_, zone_page, page);
+  return pageBytes(page) +
+         (page_number % entries_per_page_) * entry_size_;
+}
+
+void ZoneMap::addPages(const std::uint32_t num_pages) {
+  while (num_pages_ < num_pages) {
+    PageId page_number;
+    Page* page;
+    buf_mgr_->allocPage(file_, page_number, page);
+    memset(pageBytes(page), 0, Page::SIZE);
+    buf_mgr_->unPinPage(file_, page_number, true);
+    // Entries are found by position, so pages have to come in order, which
+    // they do since none is ever freed.
+    if (page_number != HEADER_PAGE + 1 + num_pages_) {
+      std::stringstream ss;
+      ss << "page " << page_number << " of " << name_ << " allocated where "
+         << "page " << HEADER_PAGE + 1 + num_pages_ << " was expected";
+      throw InvalidZoneMapException(ss.str());
+    }
+    ++num_pages_;
+  }
+  Page* header;
+  buf_mgr_->readPage(file_, HEADER_PAGE, header);
+  memcpy(pageBytes(header) + offsetof(Header, num_pages),
+         &num_pages_, sizeof(num_pages_));
+  buf_mgr_->unPinPage(file_, HEADER_PAGE, true);
+}
+
+void ZoneMap::clearPage(const PageId page_number) {
+  PageId zone_page;
+  clearEntry(pinEntry(page_number, true, zone_page), attributes_.size());
+  buf_mgr_->unPinPage(file_, zone_page, true);
+}
+
+void ZoneMap::include(const PageId page_number, const char* record,
+                      const std::size_t length, const bool truncated) {
+  PageId zone_page;
+  char* entry = pinEntry(page_number, true, zone_page);
+  std::uint64_t flag;
+  memcpy(&flag, entry, sizeof(flag));
+  bool dirty = false;
+  if (flag != HAS_ENTRY) {
+    clearEntry(entry, attributes_.size());
+    dirty = true;
+  }
+
+  // Most records fall within the ranges already, so the page is only
+  // dirtied when one widens.
+  char* range = entry + sizeof(HAS_ENTRY);
+  for (std::size_t i = 0; i < attributes_.size(); ++i, range += RANGE_SIZE) {
+    const ZoneAttribute& attribute = attributes_[i];
+    double low;
+    double high;
+    if (attribute.offset + attributeWidth(attribute) > length) {
+      if (!truncated) {
+        continue;
+      }
+      low = -UNBOUNDED;
+      high = UNBOUNDED;
+    } else if (attribute.type == INT_ATTRIBUTE) {
+      std::int32_t value;
+      memcpy(&value, record + attribute.offset, sizeof(value));
+      low = high = value;
+    } else {
+      low = high = readDouble(record + attribute.offset);
+      if (std::isnan(low)) {
+        low = -UNBOUNDED;
+        high = UNBOUNDED;
+      }
+    }
+    if (low < readDouble(range)) {
+      writeDouble(range, low);
+      dirty = true;
+    }
+    if (high > readDouble(range + sizeof(double))) {
+      writeDouble(range + sizeof(double), high);
+      dirty = true;
+    }
+  }
+  buf_mgr_->unPinPage(file_, zone_page, dirty);
+}
+
+bool ZoneMap::getRanges(const PageId page_number, AttributeRange* ranges) {
+  PageId zone_page;
+  const char* entry = pinEntry(page_number, false, zone_page);
+  if (entry == NULL) {
+    return false;
+  }
+  std::uint64_t flag;
+  memcpy(&flag, entry, sizeof(flag));
+  const char* range = entry + sizeof(HAS_ENTRY);
+  for (std::size_t i = 0; i < attributes_.size(); ++i, range += RANGE_SIZE) {
+    ranges[i].offset = attributes_[i].offset;
+    ranges[i].type = static_cast<AttributeType>(attributes_[i].type);
+    ranges[i].min = readDouble(range);
+    ranges[i].max = readDouble(range + sizeof(double));
+  }
+  buf_mgr_->unPinPage(file_, zone_page, false);
+  return flag == HAS_ENTRY;
+}
+
+bool ZoneMap::mayMatch(const PageId page_number, const Predicate& predicate) {
+  AttributeRange ranges[MAX_ATTRIBUTES];
+  return !getRanges(page_number, ranges) ||
+         predicate.mayMatch(ranges, attributes_.size());
+}
+
+}
@@ -0,0 +1,246 @@
+/**
+ * @author See Contributors.txt for code contributors and overview of BadgerDB.
+ *
+ * @section LICENSE
+ * Copyright (c) 2012 Database Group, Computer Sciences Department, University of Wisconsin-Madison.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include "types.h"
+#include "page.h"
+#include "file.h"
+#include "buffer.h"
+#include "predicate.h"
+
+namespace badgerdb {
+
+/**
+ * @brief A numeric attribute a ZoneMap keeps the range of.
+ */
+struct ZoneAttribute {
+  /**
+   * Offset of the attribute within a record, in bytes.
+   */
+  std::uint32_t offset;
+
+  /**
+   * Type of the attribute, an AttributeType.
+   */
+  std::uint32_t type;
+};
+
+/**
+ * @brief Smallest and largest value of chosen attributes on each page of a
+ * relation, so scans can skip pages no record of which can match.
+ *
+ * The zone map lives in a BlobFile of its own next to the relation, named by
+ * nameFor().  Its first page lists the attributes; the pages after it hold
+ * one entry per page of the relation, indexed by page number, with a range
+ * per attribute.  Zone pages are only ever added, in order, so the entry of
+ * a relation page is found without a directory.
+ *
+ * Ranges only ever widen: records that are deleted or updated leave their
+ * old values in, which keeps the map correct but less selective.  A page
+ * with no entry yet, e.g. one written around HeapFile, is never skipped.
+ * NaN values widen a range to every value, and an attribute of a record
+ * whose tail is in an overflow chain that can't be read from the page does
+ * the same.
+ *
+ * @warning This class is not threadsafe.
+ */
+class ZoneMap {
+ public:
+  /**
+   * Most attributes a zone map keeps ranges of.
+   */
+  static const std::size_t MAX_ATTRIBUTES = 16;
+
+  /**
+   * Returns the name of the file holding the zone map of a relation.
+   *
+   * @param relation_name   Name of the relation's file.
+   */
+  static std::string nameFor(const std::string& relation_name);
+
+  /**
+   * Opens the zone map of a relation.
+   *
+   * @param relation_name   Name of the relation's file.
+   * @param buf_mgr         Buffer Manager instance used to read and write
+   *                        pages of the zone map.
+   * @throws  FileNotFoundException     If the relation has no zone map.
+   * @throws  InvalidZoneMapException   If the file isn't a zone map.
+   */
+  ZoneMap(const std::string& relation_name, BufMgr* buf_mgr);
+
+  /**
+   * Creates an empty zone map of a relation, replacing any it has.  No page
+   * has an entry until one is added with clearPage or include.
+   *
+   * @param relation_name   Name of the relation's file.
+   * @param buf_mgr         Buffer Manager instance used to read and write
+   *                        pages of the zone map.
+   * @param attributes      Attributes to keep ranges of.
+   * @throws  InvalidZoneMapException   If there are no attributes, more than
+   *                                    MAX_ATTRIBUTES, or one has an unknown
+   *                                    type.
+   */
+  ZoneMap(const std::string& relation_name, BufMgr* buf_mgr,
+          const std::vector<ZoneAttribute>& attributes);
+
+  /**
+   * Flushes the pages of the zone map out of the buffer pool and closes it.
+   * If they can't be written, the file is left open, since frames of the
+   * buffer pool still refer to it; call flush first to find out.
+   */
+  ~ZoneMap();
+
+  /**
+   * Writes the pages of the zone map out of the buffer pool.
+   *
+   * @throws  PagePinnedException   If a page of the zone map is pinned.
+   * @throws  FileIOException       If a page can't be written.
+   */
+  void flush();
+
+  /**
+   * Returns the attributes the zone map keeps ranges of.
+   */
+  const std::vector<ZoneAttribute>& attributes() const { return attributes_; }
+
+  /**
+   * Gives a page an entry with empty ranges, as for a page without records.
+   *
+   * @param page_number   Number of the relation's page.
+   */
+  void clearPage(const PageId page_number);
+
+  /**
+   * Widens the ranges of a page to cover the attributes of a record.  A page
+   * without an entry gets one first.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param record        First byte of the record.
+   * @param length        Length of the record in bytes.
+   * @param truncated     Whether the record goes on past length, so that
+   *                      attributes past it have unknown values.
+   */
+  void include(const PageId page_number, const char* record,
+               const std::size_t length, const bool truncated = false);
+
+  /**
+   * Returns the ranges of the attributes of a page.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param ranges        Array of attributes().size() ranges to fill in.
+   * @return  False if the page has no entry.
+   */
+  bool getRanges(const PageId page_number, AttributeRange* ranges);
+
+  /**
+   * Returns whether any record of a page may match a predicate.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param predicate     Predicate to check.
+   */
+  bool mayMatch(const PageId page_number, const Predicate& predicate);
+
+ private:
+  /**
+   * @brief Layout of the first page of the zone map.
+   */
+  struct Header {
+    /**
+     * ZONE_MAP_MAGIC.
+     */
+    std::uint32_t magic;
+
+    /**
+     * Number of attributes.
+     */
+    std::uint32_t num_attributes;
+
+    /**
+     * Number of pages of entries following this one.
+     */
+    std::uint32_t num_pages;
+
+    /**
+     * Attributes, num_attributes of them.
+     */
+    ZoneAttribute attributes[MAX_ATTRIBUTES];
+  };
+
+  /**
+   * Not copyable; the file is closed when this is destroyed.
+   */
+  ZoneMap(const ZoneMap&);
+  ZoneMap& operator=(const ZoneMap&);
+
+  /**
+   * Sets up the layout of entries for the attributes.
+   */
+  void setAttributes(const Header& header);
+
+  /**
+   * Reads and pins the page of entries holding a relation page's entry.
+   *
+   * @param page_number   Number of the relation's page.
+   * @param allocate      Whether to add pages of entries up to it if the
+   *                      zone map doesn't reach it yet.
+   * @param zone_page     Set to the number of the pinned page, or
+   *                      Page::INVALID_NUMBER if there is none.
+   * @return  First byte of the entry, or NULL if there is no such page.
+   */
+  char* pinEntry(const PageId page_number, const bool allocate,
+                 PageId& zone_page);
+
+  /**
+   * Adds pages of entries, filled with entries of no page, until the zone
+   * map has the given number of them.
+   */
+  void addPages(const std::uint32_t num_pages);
+
+  /**
+   * Name of the file holding the zone map.
+   */
+  std::string name_;
+
+  /**
+   * Buffer Manager instance used to read and write pages of the zone map.
+   */
+  BufMgr* buf_mgr_;
+
+  /**
+   * File holding the zone map.
+   */
+  BlobFile* file_;
+
+  /**
+   * Attributes the zone map keeps ranges of.
+   */
+  std::vector<ZoneAttribute> attributes_;
+
+  /**
+   * Size of an entry in bytes: a flag followed by a range per attribute.
+   */
+  std::size_t entry_size_;
+
+  /**
+   * Number of entries each page of entries holds.
+   */
+  std::size_t entries_per_page_;
+
+  /**
+   * Number of pages of entries as last read from the header.  Another
+   * instance may have added more since.
+   */
+  std::uint32_t num_pages_;
+};
+
+}